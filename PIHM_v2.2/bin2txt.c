@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * File        : bin2txt.c                                                     *
+ * Function    : Convert a binary PIHM output file (binout.h) to text          *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * Usage: bin2txt [-t time | -e index] file                                   *
+ * a) Without options every record is written in the text layout of the      *
+ *    output files: time and values, tab separated, one record per line.      *
+ * b) -t time writes the field of the last record at or before time          *
+ *    (minutes), found in the index.                                          *
+ * c) -e index writes the time series of one element or river segment        *
+ *    (1 based, input numbering): one seek per record.                        *
+ * d) Chunk stores (OutFormat 1) are read a chunk at a time: a field reads    *
+ *    one row of chunks, a time series one column.                            *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "binout.h"
+
+chunk_reader   *ChunkReadOpen(FILE *);
+void            ChunkDecode(chunk_reader *, int, int, double *);
+void            ChunkReadClose(chunk_reader *);
+
+/* Next value at the file position */
+static double
+ReadValue(FILE * fp, out_header * H)
+{
+	float           v32;
+	double          v64;
+
+	if (H->Width == 4) {
+		fread(&v32, sizeof(float), 1, fp);
+		return (double) v32;
+	}
+	fread(&v64, sizeof(double), 1, fp);
+	return v64;
+}
+
+/* Record starting at offset off, in the text layout */
+static void
+PrintRecord(FILE * fp, out_header * H, int64_t off)
+{
+	double          t;
+	int             j;
+
+	fseeko(fp, (off_t) off, SEEK_SET);
+	fread(&t, sizeof(double), 1, fp);
+	printf("%lf\t", t);
+	for (j = 0; j < H->NumObj; j++) {
+		printf("%lf\t", ReadValue(fp, H));
+	}
+	printf("\n");
+}
+
+/* Record k of a chunk store, whose time block was decoded into v */
+static void
+PrintChunkRecord(chunk_reader * C, double *v, int64_t k)
+{
+	int             T, i, e;
+
+	T = (int) (C->H.NumRec - k / C->H.ChunkT * C->H.ChunkT);
+	T = (T < C->H.ChunkT) ? T : C->H.ChunkT;
+	printf("%lf\t", C->Time[k]);
+	for (i = 0; i < C->H.NumObj; i++) {
+		e = i / C->H.ChunkE;
+		/* chunk e holds objects e * ChunkE.., T records each */
+		printf("%lf\t", v[(int64_t) e * C->H.ChunkE * C->H.ChunkT + (int64_t) (i - e * C->H.ChunkE) * T + k % C->H.ChunkT]);
+	}
+	printf("\n");
+}
+
+/* bin2txt for a chunk store: mode and t or obj as in main */
+static int
+ChunkText(chunk_reader * C, int mode, double t, int obj)
+{
+	double         *v;
+	int64_t         k, lo, hi, T;
+	int             b, e;
+
+	v = (double *) malloc((int64_t) C->NumEB * C->H.ChunkE * C->H.ChunkT * sizeof(double));
+	if (mode == 0) {
+		for (b = 0; b < C->NumTB; b++) {
+			for (e = 0; e < C->NumEB; e++) {
+				ChunkDecode(C, b, e, v + (int64_t) e * C->H.ChunkE * C->H.ChunkT);
+			}
+			for (k = (int64_t) b * C->H.ChunkT; k < C->H.NumRec && k < (int64_t) (b + 1) * C->H.ChunkT; k++) {
+				PrintChunkRecord(C, v, k);
+			}
+		}
+	} else if (mode == 1) {
+		/* first record after t */
+		lo = 0;
+		hi = C->H.NumRec;
+		while (lo < hi) {
+			k = (lo + hi) / 2;
+			if (C->Time[k] <= t) {
+				lo = k + 1;
+			} else {
+				hi = k;
+			}
+		}
+		if (lo == 0) {
+			printf("bin2txt: no record at or before %lf\n", t);
+			free(v);
+			return 1;
+		}
+		b = (int) ((lo - 1) / C->H.ChunkT);
+		for (e = 0; e < C->NumEB; e++) {
+			ChunkDecode(C, b, e, v + (int64_t) e * C->H.ChunkE * C->H.ChunkT);
+		}
+		PrintChunkRecord(C, v, lo - 1);
+	} else {
+		if (obj < 1 || obj > C->H.NumObj) {
+			printf("bin2txt: index must be 1 to %d\n", C->H.NumObj);
+			free(v);
+			return 1;
+		}
+		e = (obj - 1) / C->H.ChunkE;
+		for (b = 0; b < C->NumTB; b++) {
+			ChunkDecode(C, b, e, v);
+			T = C->H.NumRec - (int64_t) b * C->H.ChunkT;
+			T = (T < C->H.ChunkT) ? T : C->H.ChunkT;
+			for (k = 0; k < T; k++) {
+				printf("%lf\t%lf\n", C->Time[(int64_t) b * C->H.ChunkT + k], v[(int64_t) (obj - 1 - e * C->H.ChunkE) * T + k]);
+			}
+		}
+	}
+	free(v);
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	FILE           *fp;
+	out_header      H;
+	out_index      *I;
+	chunk_reader   *C;
+	double          t, v;
+	int64_t         k, lo, hi;
+	int             mode, obj, ret;
+
+	mode = 0;
+	t = 0;
+	obj = 0;
+	if (argc == 4 && strcmp(argv[1], "-t") == 0) {
+		mode = 1;
+		t = atof(argv[2]);
+	} else if (argc == 4 && strcmp(argv[1], "-e") == 0) {
+		mode = 2;
+		obj = atoi(argv[2]);
+	} else if (argc != 2) {
+		printf("Usage: bin2txt [-t time | -e index] file\n");
+		return 1;
+	}
+	fp = fopen(argv[argc - 1], "rb");
+	if (fp == NULL) {
+		printf("bin2txt: cannot open %s\n", argv[argc - 1]);
+		return 1;
+	}
+	C = ChunkReadOpen(fp);
+	if (C != NULL) {
+		ret = ChunkText(C, mode, t, obj);
+		ChunkReadClose(C);
+		fclose(fp);
+		return ret;
+	}
+	fseeko(fp, 0, SEEK_SET);
+	if (fread(&H, sizeof(out_header), 1, fp) != 1 || strcmp(H.Magic, OUT_MAGIC) != 0 || H.Version != OUT_VERSION) {
+		printf("bin2txt: %s is not a PIHM binary output file\n", argv[argc - 1]);
+		return 1;
+	}
+	if (H.IndexOff == 0) {
+		/* the run did not finish: use the complete records */
+		fseeko(fp, 0, SEEK_END);
+		H.NumRec = ((int64_t) ftello(fp) - (int64_t) sizeof(out_header)) / OUT_RECLEN(&H);
+	}
+	if (mode == 0) {
+		for (k = 0; k < H.NumRec; k++) {
+			PrintRecord(fp, &H, (int64_t) sizeof(out_header) + k * OUT_RECLEN(&H));
+		}
+	} else if (mode == 1) {
+		if (H.IndexOff == 0) {
+			printf("bin2txt: %s has no index\n", argv[argc - 1]);
+			return 1;
+		}
+		I = (out_index *) malloc(H.NumRec * sizeof(out_index));
+		fseeko(fp, (off_t) H.IndexOff, SEEK_SET);
+		fread(I, sizeof(out_index), H.NumRec, fp);
+		/* first record after t */
+		lo = 0;
+		hi = H.NumRec;
+		while (lo < hi) {
+			k = (lo + hi) / 2;
+			if (I[k].Time <= t) {
+				lo = k + 1;
+			} else {
+				hi = k;
+			}
+		}
+		if (lo == 0) {
+			printf("bin2txt: no record at or before %lf\n", t);
+			return 1;
+		}
+		PrintRecord(fp, &H, I[lo - 1].Offset);
+		free(I);
+	} else {
+		if (obj < 1 || obj > H.NumObj) {
+			printf("bin2txt: index must be 1 to %d\n", H.NumObj);
+			return 1;
+		}
+		for (k = 0; k < H.NumRec; k++) {
+			fseeko(fp, (off_t) ((int64_t) sizeof(out_header) + k * OUT_RECLEN(&H)), SEEK_SET);
+			fread(&t, sizeof(double), 1, fp);
+			fseeko(fp, (off_t) (obj - 1) * H.Width, SEEK_CUR);
+			v = ReadValue(fp, &H);
+			printf("%lf\t%lf\n", t, v);
+		}
+	}
+	fclose(fp);
+	return 0;
+}
@@ -0,0 +1,93 @@
+/*******************************************************************************
+ * File        : binout.h                                                      *
+ * Function    : Layout of the binary output files (OutFormat 1, 4 or 8)      *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) Each output file (project.GW, .surf, ...) holds one variable: a header, *
+ *    NumRec fixed width records and an index, in native byte order.          *
+ * b) Record k starts at sizeof(out_header) + k * OUT_RECLEN(H): the time     *
+ *    (float64, minutes) followed by NumObj values of Width bytes (float32 or *
+ *    float64), in input numbering of elements or river segments.             *
+ * c) The index at IndexOff has NumRec entries {time, offset of the record};  *
+ *    a field at time t is found by a binary search of the index, the value   *
+ *    of object i in record k at OUT_RECLEN(H) * k + 8 + i * Width after the  *
+ *    header. bin2txt.c converts the files back to the text layout.           *
+ * d) OutFormat 1 writes a compressed chunk store instead (chunk.c): values   *
+ *    are grouped in chunks of ChunkT records x ChunkE objects, so a time     *
+ *    series or a field reads NumRec/ChunkT or NumObj/ChunkE chunks. The      *
+ *    index at IndexOff holds the NumRec record times, then {offset, size}    *
+ *    of each chunk, time blocks outer.                                       *
+ *******************************************************************************/
+
+#ifndef BINOUT_H
+#define BINOUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define OUT_MAGIC "PIHMOUT"
+#define OUT_VERSION 1
+
+typedef struct out_header_type {
+	char            Magic[8];	/* OUT_MAGIC */
+	int32_t         Version;
+	int32_t         Width;	/* bytes per value: 4 or 8 */
+	int32_t         NumObj;	/* values per record */
+	int32_t         NumEle;
+	int32_t         NumRiv;
+	int32_t         Interval;	/* output interval (minutes) */
+	double          StartTime;	/* simulation start (minutes) */
+	int64_t         NumRec;	/* records written */
+	int64_t         IndexOff;	/* file offset of the index, 0 until
+					 * the run ends */
+}               out_header;
+
+typedef struct out_index_type {
+	double          Time;
+	int64_t         Offset;
+}               out_index;
+
+#define CHUNK_MAGIC "PIHMCHK"
+#define CHUNK_VERSION 1
+
+typedef struct chunk_header_type {
+	char            Magic[8];	/* CHUNK_MAGIC */
+	int32_t         Version;
+	int32_t         NumObj;	/* values per record */
+	int32_t         NumEle;
+	int32_t         NumRiv;
+	int32_t         Interval;	/* output interval (minutes) */
+	int32_t         ChunkT;	/* records per chunk */
+	int32_t         ChunkE;	/* objects per chunk */
+	int32_t         Pad;
+	double          StartTime;	/* simulation start (minutes) */
+	double          MaxError;	/* 0: lossless; else values are
+					 * quantised to within MaxError */
+	int64_t         NumRec;	/* records written */
+	int64_t         IndexOff;	/* file offset of the index, 0 until
+					 * the run ends */
+}               chunk_header;
+
+typedef struct chunk_index_type {
+	int64_t         Offset;
+	int64_t         Size;	/* compressed bytes */
+}               chunk_index;
+
+typedef struct chunk_store_type chunk_store;	/* Store being written
+							 * (chunk.c) */
+
+typedef struct chunk_reader_type {	/* Store opened for reading (chunk.c) */
+	FILE           *fp;
+	chunk_header    H;
+	int             NumTB;	/* time blocks */
+	int             NumEB;	/* object blocks */
+	double         *Time;	/* time of each record */
+	chunk_index    *Index;	/* NumEB chunks per time block */
+	uint64_t       *Word;
+	unsigned char  *Plane;
+	unsigned char  *Z;
+}               chunk_reader;
+
+#define OUT_RECLEN(H) ((int64_t) sizeof(double) + (int64_t) (H)->NumObj * (H)->Width)
+
+#endif
@@ -0,0 +1,357 @@
+/*******************************************************************************
+ * File        : cache.c                                                       *
+ * Function    : Binary cache of the parsed input files (project.cache)        *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) After a first run has parsed the ten input files (read_alloc) and       *
+ *    renumbered the mesh (ReorderMesh), the resulting Model_Data and          *
+ *    Control_Data are written to project.cache. Later runs map the cache      *
+ *    instead of parsing. ./pihm --no-cache skips both.                        *
+ * b) The header holds a version, the sizes of the stored structures, the     *
+ *    --reorder flag and a 64 bit FNV-1a hash of the contents of every input   *
+ *    file. Any mismatch makes the cache stale; it is then rebuilt.            *
+ * c) Every array is stored as a section padded to CACHE_ALIGN bytes. Time    *
+ *    series records (the bulk of the file) are used in place from a private  *
+ *    mapping, the other arrays are copied so FreeData can free them as       *
+ *    before. The mapping is released by FreeData (CacheMap).                 *
+ * d) initialize() is run as usual on the loaded data: it also reads the      *
+ *    .init file, applies the calibration to the forcing and sets up the       *
+ *    solver side arrays.                                                      *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sundials_types.h"
+#include "pihm.h"
+
+#define CACHE_VERSION 1
+#define CACHE_ALIGN 64		/* section alignment (bytes) */
+#define CACHE_READ 0
+#define CACHE_WRITE 1
+
+typedef struct cache_header_type {
+	char            magic[8];	/* "PIHMBIN" */
+	int             version;
+	int             reorder;	/* --reorder flag of the writing run */
+	int             size[8];	/* sizes of the stored structures */
+	unsigned long long hash;	/* FNV-1a of the input files */
+}               cache_header;
+
+typedef struct cache_io_type {
+	int             mode;	/* CACHE_READ or CACHE_WRITE */
+	FILE           *fp;	/* CACHE_WRITE: output file */
+	char           *map;	/* CACHE_READ: mapped cache */
+	size_t          len;	/* CACHE_READ: size of the mapping */
+	size_t          pos;	/* current offset */
+	int             ok;	/* 0 after a short read or write */
+	void          **copy;	/* CACHE_READ: sections malloc'ed so far */
+	int             ncopy;	/* CACHE_READ: entries of copy */
+}               cache_io;
+
+/* FNV-1a hash of the input files of project filename */
+static unsigned long long
+InputHash(char *filename)
+{
+	static const char *ext[10] = {".riv", ".mesh", ".att", ".soil", ".geol", ".lc", ".forc", ".ibc", ".para", ".calib"};
+	unsigned long long h = 14695981039346656037ULL;
+	unsigned char  *buf;
+	char           *fn;
+	FILE           *fp;
+	size_t          n, j;
+	int             i;
+
+	buf = (unsigned char *) malloc(1 << 20);
+	fn = (char *) malloc((strlen(filename) + 7) * sizeof(char));
+	for (i = 0; i < 10; i++) {
+		strcpy(fn, filename);
+		fp = fopen(strcat(fn, ext[i]), "rb");
+		if (fp == NULL) {
+			h = 0;
+			break;
+		}
+		while ((n = fread(buf, 1, 1 << 20, fp)) > 0) {
+			for (j = 0; j < n; j++) {
+				h = (h ^ buf[j]) * 1099511628211ULL;
+			}
+		}
+		/* file boundary */
+		h = (h ^ 0xff) * 1099511628211ULL;
+		fclose(fp);
+	}
+	free(fn);
+	free(buf);
+	return (h);
+}
+
+static void
+Header(cache_header * H, int reorder, unsigned long long hash)
+{
+	memset(H, 0, sizeof(cache_header));
+	strcpy(H->magic, "PIHMBIN");
+	H->version = CACHE_VERSION;
+	H->reorder = reorder;
+	H->size[0] = sizeof(realtype);
+	H->size[1] = sizeof(struct model_data_structure);
+	H->size[2] = sizeof(Control_Data);
+	H->size[3] = sizeof(element);
+	H->size[4] = sizeof(river_segment);
+	H->size[5] = sizeof(TSD);
+	H->size[6] = sizeof(soils) + sizeof(geol) + sizeof(LC);
+	H->size[7] = sizeof(nodes) + sizeof(element_IC);
+	H->hash = hash;
+}
+
+/*
+ * One section of n bytes at *p. Writing: *p is written. Reading: *p is set
+ * to a malloc'ed copy of the section, or into the mapping if inPlace.
+ */
+static void
+Section(cache_io * c, void **p, size_t n, int inPlace)
+{
+	static const char pad[CACHE_ALIGN] = {0};
+	size_t          m;
+
+	m = (n + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+	if (c->mode == CACHE_WRITE) {
+		if (n > 0 && fwrite(*p, 1, n, c->fp) != n) {
+			c->ok = 0;
+		}
+		if (m > n && fwrite(pad, 1, m - n, c->fp) != m - n) {
+			c->ok = 0;
+		}
+	} else {
+		if (c->ok == 0 || c->pos + m > c->len) {
+			c->ok = 0;
+			*p = NULL;
+			return;
+		}
+		if (inPlace) {
+			*p = c->map + c->pos;
+		} else {
+			*p = malloc(n > 0 ? n : 1);
+			memcpy(*p, c->map + c->pos, n);
+			c->copy = (void **) realloc(c->copy, (c->ncopy + 1) * sizeof(void *));
+			c->copy[c->ncopy++] = *p;
+		}
+	}
+	c->pos = c->pos + m;
+}
+
+/* num series and their records */
+static void
+SeriesSection(cache_io * c, TSD ** ts, int num)
+{
+	int             i;
+
+	Section(c, (void **) ts, num * sizeof(TSD), 0);
+	for (i = 0; i < num && c->ok; i++) {
+		Section(c, (void **) &(*ts)[i].time, (*ts)[i].length * sizeof(realtype), 1);
+		Section(c, (void **) &(*ts)[i].value, (*ts)[i].length * sizeof(realtype), 1);
+	}
+}
+
+/* Every array set by read_alloc() and ReorderMesh(), in file order */
+static void
+Walk(cache_io * c, Model_Data DS, Control_Data * CS)
+{
+	void          **eh[22];
+	int             i, n;
+
+	n = DS->NumEle + DS->NumRiv;
+	Section(c, (void **) &DS->Riv, DS->NumRiv * sizeof(river_segment), 0);
+	Section(c, (void **) &DS->Riv_Shape, DS->NumRivShape * sizeof(river_shape), 0);
+	Section(c, (void **) &DS->Riv_Mat, DS->NumRivMaterial * sizeof(river_material), 0);
+	Section(c, (void **) &DS->Riv_IC, DS->NumRivIC * sizeof(river_IC), 0);
+	Section(c, (void **) &DS->Ele, n * sizeof(element), 0);
+	eh[0] = (void **) &DS->EleH.area;
+	eh[1] = (void **) &DS->EleH.zmin;
+	eh[2] = (void **) &DS->EleH.zmax;
+	eh[3] = (void **) &DS->EleH.KsatH;
+	eh[4] = (void **) &DS->EleH.KsatV;
+	eh[5] = (void **) &DS->EleH.infKsatV;
+	eh[6] = (void **) &DS->EleH.Porosity;
+	eh[7] = (void **) &DS->EleH.infD;
+	eh[8] = (void **) &DS->EleH.Alpha;
+	eh[9] = (void **) &DS->EleH.Beta;
+	eh[10] = (void **) &DS->EleH.RzD;
+	eh[11] = (void **) &DS->EleH.macD;
+	eh[12] = (void **) &DS->EleH.macKsatH;
+	eh[13] = (void **) &DS->EleH.macKsatV;
+	eh[14] = (void **) &DS->EleH.vAreaF;
+	eh[15] = (void **) &DS->EleH.hAreaF;
+	eh[16] = (void **) &DS->EleH.VegFrac;
+	eh[17] = (void **) &DS->EleH.Albedo;
+	eh[18] = (void **) &DS->EleH.Rs_ref;
+	eh[19] = (void **) &DS->EleH.Rmin;
+	eh[20] = (void **) &DS->EleH.Rough;
+	eh[21] = (void **) &DS->EleH.windH;
+	for (i = 0; i < 22; i++) {
+		Section(c, eh[i], n * sizeof(realtype), 0);
+	}
+	Section(c, (void **) &DS->EleH.Macropore, n * sizeof(int), 0);
+	Section(c, (void **) &DS->EleH.soil, n * sizeof(int), 0);
+	Section(c, (void **) &DS->EleH.LC, n * sizeof(int), 0);
+	Section(c, (void **) &DS->Node, DS->NumNode * sizeof(nodes), 0);
+	Section(c, (void **) &DS->Ele_IC, DS->NumEle * sizeof(element_IC), 0);
+	Section(c, (void **) &DS->Soil, DS->NumSoil * sizeof(soils), 0);
+	Section(c, (void **) &DS->Geol, DS->NumGeol * sizeof(geol), 0);
+	Section(c, (void **) &DS->LandC, DS->NumLC * sizeof(LC), 0);
+	Section(c, (void **) &DS->ISFactor, DS->NumLC * sizeof(realtype), 0);
+	Section(c, (void **) &DS->windH, DS->NumWindVel * sizeof(realtype), 0);
+	Section(c, (void **) &DS->EleNew, DS->NumEle * sizeof(int), 0);
+	Section(c, (void **) &DS->RivNew, DS->NumRiv * sizeof(int), 0);
+	Section(c, (void **) &CS->Tout, (CS->NumSteps + 1) * sizeof(realtype), 0);
+	SeriesSection(c, &DS->TSD_Riv, DS->NumRivBC);
+	SeriesSection(c, &DS->TSD_Prep, DS->NumPrep);
+	SeriesSection(c, &DS->TSD_Temp, DS->NumTemp);
+	SeriesSection(c, &DS->TSD_Humidity, DS->NumHumidity);
+	SeriesSection(c, &DS->TSD_WindVel, DS->NumWindVel);
+	SeriesSection(c, &DS->TSD_Rn, DS->NumRn);
+	SeriesSection(c, &DS->TSD_G, DS->NumG);
+	SeriesSection(c, &DS->TSD_Pressure, DS->NumP);
+	SeriesSection(c, &DS->TSD_LAI, DS->NumLC);
+	SeriesSection(c, &DS->TSD_RL, DS->NumLC);
+	SeriesSection(c, &DS->TSD_MeltF, DS->NumMeltF);
+	SeriesSection(c, &DS->TSD_Source, DS->NumSource);
+	if (DS->Num1BC + DS->Num2BC > 0) {
+		SeriesSection(c, &DS->TSD_EleBC, DS->Num1BC + DS->Num2BC);
+	}
+}
+
+/*
+ * Fill DS and CS from filename.cache. Returns 1 on success, 0 if the cache
+ * is missing, stale or unreadable (DS and CS are then untouched).
+ */
+int
+LoadCache(char *filename, Model_Data DS, Control_Data * CS, int reorder)
+{
+	struct model_data_structure MD;
+	Control_Data    C;
+	cache_header    H, *HF;
+	cache_io        c;
+	struct stat     st;
+	char           *fn;
+	int             fd, i;
+	void           *p;
+
+	fn = (char *) malloc((strlen(filename) + 7) * sizeof(char));
+	strcpy(fn, filename);
+	fd = open(strcat(fn, ".cache"), O_RDONLY);
+	free(fn);
+	if (fd < 0) {
+		return (0);
+	}
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(cache_header)) {
+		close(fd);
+		return (0);
+	}
+	c.map = (char *) mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (c.map == (char *) MAP_FAILED) {
+		return (0);
+	}
+	c.mode = CACHE_READ;
+	c.len = st.st_size;
+	c.pos = 0;
+	c.ok = 1;
+	c.copy = NULL;
+	c.ncopy = 0;
+	HF = (cache_header *) c.map;
+	Header(&H, reorder, InputHash(filename));
+	if (H.hash == 0 || memcmp(&H, HF, sizeof(cache_header)) != 0) {
+		munmap(c.map, c.len);
+		return (0);
+	}
+	Section(&c, &p, sizeof(cache_header), 1);
+	Section(&c, &p, sizeof(MD), 1);
+	if (c.ok) {
+		memcpy(&MD, p, sizeof(MD));
+	}
+	Section(&c, &p, sizeof(C), 1);
+	if (c.ok) {
+		memcpy(&C, p, sizeof(C));
+		Walk(&c, &MD, &C);
+	}
+	if (c.ok == 0) {
+		/* a truncated cache: drop what was copied and parse the inputs */
+		for (i = 0; i < c.ncopy; i++) {
+			free(c.copy[i]);
+		}
+		free(c.copy);
+		munmap(c.map, c.len);
+		return (0);
+	}
+	free(c.copy);
+	MD.TSArena = NULL;
+	MD.CacheMap = c.map;
+	MD.CacheLen = c.len;
+	*DS = MD;
+	*CS = C;
+	printf("\n Model cache: %s.cache loaded\n", filename);
+	return (1);
+}
+
+/* Write DS and CS, as left by read_alloc() and ReorderMesh(), to the cache */
+void
+WriteCache(char *filename, Model_Data DS, Control_Data * CS, int reorder)
+{
+	cache_header    H;
+	cache_io        c;
+	char           *fn, *tmp;
+	void           *p;
+
+	Header(&H, reorder, InputHash(filename));
+	if (H.hash == 0) {
+		return;
+	}
+	fn = (char *) malloc((strlen(filename) + 7) * sizeof(char));
+	tmp = (char *) malloc((strlen(filename) + 11) * sizeof(char));
+	strcpy(fn, filename);
+	strcat(fn, ".cache");
+	strcpy(tmp, fn);
+	strcat(tmp, ".tmp");
+	c.mode = CACHE_WRITE;
+	c.pos = 0;
+	c.ok = 1;
+	c.fp = fopen(tmp, "wb");
+	if (c.fp == NULL) {
+		printf("\n Warning: cannot write %s, model cache not saved\n", tmp);
+		free(fn);
+		free(tmp);
+		return;
+	}
+	p = &H;
+	Section(&c, &p, sizeof(cache_header), 0);
+	p = DS;
+	Section(&c, &p, sizeof(*DS), 0);
+	p = CS;
+	Section(&c, &p, sizeof(*CS), 0);
+	Walk(&c, DS, CS);
+	if (fclose(c.fp) != 0) {
+		c.ok = 0;
+	}
+	/* complete caches only: a later run never sees a partial file */
+	if (c.ok && rename(tmp, fn) == 0) {
+		printf("\n Model cache: %s written\n", fn);
+	} else {
+		printf("\n Warning: cannot write %s, model cache not saved\n", fn);
+		remove(tmp);
+	}
+	free(fn);
+	free(tmp);
+}
+
+/* Release the mapping of a loaded cache */
+void
+FreeCache(Model_Data DS)
+{
+	if (DS->CacheMap != NULL) {
+		munmap(DS->CacheMap, DS->CacheLen);
+	}
+}
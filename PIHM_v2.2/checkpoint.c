@@ -0,0 +1,312 @@
+/*******************************************************************************
+ * File        : checkpoint.c                                                  *
+ * Function    : Checkpoint and restart of a run (--checkpoint, --restart)     *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) With --checkpoint m the run writes project.ckpt at the first output      *
+ *    time (with DenseOut, the first end of an ET step) of every m minutes of  *
+ *    simulation. It holds the state vector, the interception, snow and ET     *
+ *    state of is_sm_et(), the fluxes of f(), the cursors of all time series,  *
+ *    the print accumulators, the last CVODE step size and the length of each  *
+ *    text output file. The arrays are kept in the numbering of the run; the   *
+ *    header records whether it was renumbered (--reorder).                    *
+ * b) The file is written to project.ckpt.tmp and renamed, so a run killed     *
+ *    while writing leaves the previous checkpoint.                            *
+ * c) Writing a checkpoint leaves CVODE as it is, so a run with --checkpoint   *
+ *    takes the same steps as one without. CVODE keeps its step history        *
+ *    (Nordsieck array) to itself: ./pihm --restart starts the integrator      *
+ *    afresh (order 1) with the last step size, and its outputs agree with     *
+ *    those of the uninterrupted run to the solver tolerances, not bitwise.    *
+ * d) On restart the output files are cut back to their length at the          *
+ *    checkpoint and appended to. Only text output (OutFormat 0) can be        *
+ *    resumed.                                                                 *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "sundials_types.h"
+#include "nvector_serial.h"
+#include "cvode.h"
+#include "pihm.h"
+
+#define CKPT_VERSION 3
+#define CKPT_BUF 1048576	/* stdio buffer of the checkpoint file */
+#define CKPT_READ 0
+#define CKPT_WRITE 1
+
+typedef struct ckpt_header_type {
+	char            magic[8];	/* "PIHMCKP" */
+	int             version;
+	int             size;	/* sizeof(realtype) */
+	int             N;	/* length of the state vector */
+	int             NumEle;
+	int             NumRiv;
+	int             NumSteps;
+	int             reorder;	/* arrays in --reorder numbering */
+	int             NumTSD;	/* series of all registered families */
+	int             NumFile;	/* output files */
+	int             Step;	/* next output step */
+	realtype        StartTime;
+	realtype        t;	/* time of the checkpoint (minutes) */
+	realtype        h;	/* last CVODE step size */
+	realtype        Interval;	/* --checkpoint interval (minutes) */
+}               ckpt_header;
+
+void            OutputSync(Output_Data);
+
+typedef struct ckpt_io_type {
+	int             mode;	/* CKPT_READ or CKPT_WRITE */
+	FILE           *fp;
+	int             ok;	/* 0 after a short read or write */
+}               ckpt_io;
+
+/* n bytes at p */
+static void
+Block(ckpt_io * c, void *p, size_t n)
+{
+	if (c->ok == 0 || n == 0) {
+		return;
+	}
+	if (c->mode == CKPT_WRITE) {
+		c->ok = (fwrite(p, 1, n, c->fp) == n);
+	} else {
+		c->ok = (fread(p, 1, n, c->fp) == n);
+	}
+}
+
+static int
+NumTSD(Model_Data DS)
+{
+	int             j, n;
+
+	n = 0;
+	for (j = 0; j < DS->NumFam; j++) {
+		n = n + DS->Fam[j].num;
+	}
+	return (n);
+}
+
+/*
+ * 1 if the mesh is held in a numbering other than that of the input files
+ * (--reorder); the arrays of the checkpoint are stored in it
+ */
+static int
+Reordered(Model_Data DS)
+{
+	int             i;
+
+	for (i = 0; i < DS->NumEle; i++) {
+		if (DS->EleNew[i] != i) {
+			return (1);
+		}
+	}
+	for (i = 0; i < DS->NumRiv; i++) {
+		if (DS->RivNew[i] != i) {
+			return (1);
+		}
+	}
+	return (0);
+}
+
+/* Every array of the run state, in file order; off[] are the file lengths */
+static void
+Walk(ckpt_io * c, Model_Data DS, N_Vector CV_Y, long long *off, int nfile)
+{
+	realtype       *ele[12];
+	int             i, j, n;
+
+	Block(c, NV_DATA_S(CV_Y), NV_LENGTH_S(CV_Y) * sizeof(realtype));
+	Block(c, DS->DummyY, (3 * DS->NumEle + 2 * DS->NumRiv) * sizeof(realtype));
+	ele[0] = DS->EleIS;
+	ele[1] = DS->EleISmax;
+	ele[2] = DS->EleISsnowmax;
+	ele[3] = DS->EleSnow;
+	ele[4] = DS->EleSnowGrnd;
+	ele[5] = DS->EleSnowCanopy;
+	ele[6] = DS->EleTF;
+	ele[7] = DS->EleETloss;
+	ele[8] = DS->EleNetPrep;
+	ele[9] = DS->ElePrep;
+	ele[10] = DS->EleViR;
+	ele[11] = DS->Recharge;
+	for (i = 0; i < 12; i++) {
+		Block(c, ele[i], DS->NumEle * sizeof(realtype));
+	}
+	for (i = 0; i < DS->NumEle; i++) {
+		Block(c, DS->EleET[i], 4 * sizeof(realtype));
+		Block(c, DS->FluxSurf[i], 3 * sizeof(realtype));
+		Block(c, DS->FluxSub[i], 3 * sizeof(realtype));
+	}
+	for (i = 0; i < DS->NumRiv; i++) {
+		Block(c, DS->FluxRiv[i], 11 * sizeof(realtype));
+	}
+	for (j = 0; j < DS->NumFam; j++) {
+		for (i = 0; i < DS->Fam[j].num; i++) {
+			Block(c, &DS->Fam[j].TS[i].iCounter, sizeof(int));
+		}
+	}
+	/* sizes as allocated in initialize() */
+	for (i = 0; i < 24; i++) {
+		n = (i == 0) ? DS->NumEle + DS->NumRiv : (i >= 7 && i < 19) ? DS->NumRiv : DS->NumEle;
+		Block(c, DS->PrintVar[i], n * sizeof(realtype));
+	}
+	Block(c, off, nfile * sizeof(long long));
+}
+
+static char    *
+CkptName(char *filename, char *ext)
+{
+	char           *fn;
+
+	fn = (char *) malloc((strlen(filename) + strlen(ext) + 1) * sizeof(char));
+	strcpy(fn, filename);
+	strcat(fn, ext);
+	return (fn);
+}
+
+/*
+ * Write project.ckpt at time t, before output step `step`. The records of
+ * the nfile output files fp must all have been written (OutputSync).
+ */
+static void
+WriteCheckpoint(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y, realtype t, int step, realtype h, realtype interval, FILE ** fp, int nfile)
+{
+	ckpt_header     H;
+	ckpt_io         c;
+	char           *fn, *tmp;
+	long long      *off;
+	int             k;
+
+	memset(&H, 0, sizeof(ckpt_header));
+	strcpy(H.magic, "PIHMCKP");
+	H.version = CKPT_VERSION;
+	H.size = sizeof(realtype);
+	H.N = NV_LENGTH_S(CV_Y);
+	H.NumEle = DS->NumEle;
+	H.NumRiv = DS->NumRiv;
+	H.NumSteps = CS->NumSteps;
+	H.reorder = Reordered(DS);
+	H.NumTSD = NumTSD(DS);
+	H.NumFile = nfile;
+	H.Step = step;
+	H.StartTime = CS->StartTime;
+	H.t = t;
+	H.h = h;
+	H.Interval = interval;
+	off = (long long *) malloc(nfile * sizeof(long long));
+	for (k = 0; k < nfile; k++) {
+		off[k] = (long long) ftello(fp[k]);
+	}
+	fn = CkptName(filename, ".ckpt");
+	tmp = CkptName(filename, ".ckpt.tmp");
+	c.mode = CKPT_WRITE;
+	c.ok = 1;
+	c.fp = fopen(tmp, "wb");
+	if (c.fp == NULL) {
+		printf("\n Warning: cannot write %s, no checkpoint at t = %lf\n", tmp, t);
+		free(off);
+		free(fn);
+		free(tmp);
+		return;
+	}
+	setvbuf(c.fp, NULL, _IOFBF, CKPT_BUF);
+	Block(&c, &H, sizeof(ckpt_header));
+	Walk(&c, DS, CV_Y, off, nfile);
+	if (fclose(c.fp) != 0) {
+		c.ok = 0;
+	}
+	if (c.ok == 0 || rename(tmp, fn) != 0) {
+		printf("\n Warning: cannot write %s, no checkpoint at t = %lf\n", fn, t);
+		remove(tmp);
+	}
+	free(off);
+	free(fn);
+	free(tmp);
+}
+
+/*
+ * Restore the run state from project.ckpt after initialize(): sets CV_Y,
+ * the time t, the next output step and the step size h, and cuts the output
+ * files fp back to their length at the checkpoint. *interval, if 0, is set
+ * to that of the run that wrote it. Any mismatch with the project is fatal.
+ */
+void
+ReadCheckpoint(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y, realtype * t, int *step, realtype * h, realtype * interval, FILE ** fp, int nfile)
+{
+	ckpt_header     H;
+	ckpt_io         c;
+	char           *fn;
+	long long      *off;
+	int             k;
+
+	fn = CkptName(filename, ".ckpt");
+	c.mode = CKPT_READ;
+	c.ok = 1;
+	c.fp = fopen(fn, "rb");
+	if (c.fp == NULL) {
+		printf("\n  Fatal Error: %s cannot be opened for --restart\n", fn);
+		exit(1);
+	}
+	setvbuf(c.fp, NULL, _IOFBF, CKPT_BUF);
+	Block(&c, &H, sizeof(ckpt_header));
+	if (c.ok == 0 || strcmp(H.magic, "PIHMCKP") != 0 || H.version != CKPT_VERSION || H.size != sizeof(realtype)) {
+		printf("\n  Fatal Error: %s is not a checkpoint of this version of PIHM\n", fn);
+		exit(1);
+	}
+	if (H.N != NV_LENGTH_S(CV_Y) || H.NumEle != DS->NumEle || H.NumRiv != DS->NumRiv || H.NumSteps != CS->NumSteps || H.reorder != Reordered(DS) || H.StartTime != CS->StartTime || H.NumTSD != NumTSD(DS) || H.NumFile != nfile) {
+		printf("\n  Fatal Error: %s was written by a run of a different project or .para\n", fn);
+		exit(1);
+	}
+	off = (long long *) malloc(nfile * sizeof(long long));
+	Walk(&c, DS, CV_Y, off, nfile);
+	fclose(c.fp);
+	if (c.ok == 0) {
+		printf("\n  Fatal Error: %s is truncated\n", fn);
+		exit(1);
+	}
+	for (k = 0; k < nfile; k++) {
+		fflush(fp[k]);
+		if (ftruncate(fileno(fp[k]), (off_t) off[k]) != 0 || fseeko(fp[k], (off_t) off[k], SEEK_SET) != 0) {
+			printf("\n  Fatal Error: output file %d cannot be cut back to the checkpoint\n", k);
+			exit(1);
+		}
+	}
+	/* forcing values are recomputed at the new time */
+	DS->ForcValid = 0;
+	*t = H.t;
+	*step = H.Step;
+	*h = H.h;
+	if (*interval == 0) {
+		/* the same checkpoints as the run that wrote this one */
+		*interval = H.Interval;
+	}
+	printf("\n Restart: %s, t = %lf, output step %d of %d\n", fn, H.t, H.Step, H.NumSteps);
+	free(off);
+	free(fn);
+}
+
+/* 1 if a checkpoint is due at the stop t1 of the run that follows t0 */
+int
+CheckpointDue(realtype interval, realtype start, realtype t0, realtype t1)
+{
+	return interval > 0 && floor((t1 - start) / interval) > floor((t0 - start) / interval);
+}
+
+/*
+ * Checkpoint of the run at time t, where CVODE has stopped, before output
+ * step `step`; the run goes on with CVODE as it is
+ */
+void
+Checkpoint(char *filename, void *cvode_mem, Output_Data W, Model_Data DS, Control_Data * CS, N_Vector CV_Y, realtype t, int step, realtype interval, FILE ** fp, int nfile)
+{
+	realtype        h;
+
+	OutputSync(W);
+	CVodeGetLastStep(cvode_mem, &h);
+	WriteCheckpoint(filename, DS, CS, CV_Y, t, step, h, interval, fp, nfile);
+}
@@ -0,0 +1,303 @@
+/*******************************************************************************
+ * File        : chunk.c                                                       *
+ * Function    : Compressed chunk store of one output variable (OutFormat 1)  *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) Records are collected for ChunkT output times and then written as one   *
+ *    chunk per ChunkE objects (layout in binout.h). Inside a chunk the       *
+ *    values of each object are consecutive in time.                          *
+ * b) Each value is replaced by the XOR of its bits with the previous value   *
+ *    of the object (lossless), or, with MaxError > 0, by the change of       *
+ *    round(v / (2 MaxError)) from the previous time (zigzag coded). The      *
+ *    eight bytes of the 64 bit words are then stored as eight planes and    *
+ *    deflated with zlib: slowly varying series give long runs of zero bytes. *
+ * c) A chunk with a value that cannot be quantised (inf, nan, too large) is  *
+ *    stored losslessly; the first byte of every chunk gives its coding.      *
+ * d) ChunkReadOpen/ChunkDecode read a store back (bin2txt.c).                 *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+#include "binout.h"
+
+#define CHUNK_T 256		/* Max. records per chunk */
+#define CHUNK_E 1024		/* Objects per chunk */
+#define CHUNK_BYTES 4194304	/* Records held per variable before a
+				 * chunk row is written */
+#define CHUNK_LEVEL 1		/* zlib compression level */
+
+#define CODE_XOR 0
+#define CODE_QUANT 1
+
+struct chunk_store_type {
+	FILE           *fp;
+	chunk_header    H;
+	int             Rows;	/* records in Block */
+	double         *Block;	/* Rows records, object i at i * ChunkT */
+	double         *Time;	/* time of each record */
+	int64_t         TimeCap;
+	chunk_index    *Index;	/* NumEB entries per written time block */
+	int64_t         NumChunk, IndexCap;
+	uint64_t       *Word;	/* coded values of one chunk */
+	unsigned char  *Plane;	/* their byte planes */
+	unsigned char  *Z;	/* deflated chunk */
+	uLongf          ZCap;
+	int64_t         Bytes;	/* bytes written */
+};
+
+/* Bits of each value of a chunk: n objects of T records, from v[i * stride] */
+static int
+Code(const double *v, int stride, int n, int T, double err, uint64_t * w)
+{
+	int             i, k;
+	uint64_t        u, prev;
+	int64_t         q, qprev;
+	double          s;
+
+	if (err > 0) {
+		for (i = 0; i < n; i++) {
+			qprev = 0;
+			for (k = 0; k < T; k++) {
+				s = v[i * stride + k] / (2 * err);
+				if (!(fabs(s) < 4.0e18)) {
+					break;
+				}
+				q = llround(s);
+				/* zigzag: small changes of either sign are small */
+				w[i * T + k] = ((uint64_t) (q - qprev) << 1) ^ (uint64_t) ((q - qprev) >> 63);
+				qprev = q;
+			}
+			if (k < T) {
+				break;
+			}
+		}
+		if (i == n) {
+			return CODE_QUANT;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		prev = 0;
+		for (k = 0; k < T; k++) {
+			memcpy(&u, &v[i * stride + k], sizeof(uint64_t));
+			w[i * T + k] = u ^ prev;
+			prev = u;
+		}
+	}
+	return CODE_XOR;
+}
+
+/* Write the chunk row of the records in S->Block */
+static void
+WriteRow(chunk_store * S)
+{
+	int             e, n, NumEB, j;
+	int64_t         N, m;
+	uLongf          len;
+
+	NumEB = (S->H.NumObj + S->H.ChunkE - 1) / S->H.ChunkE;
+	if (S->NumChunk + NumEB > S->IndexCap) {
+		S->IndexCap = 2 * (S->NumChunk + NumEB);
+		S->Index = (chunk_index *) realloc(S->Index, S->IndexCap * sizeof(chunk_index));
+	}
+	for (e = 0; e < NumEB; e++) {
+		n = S->H.NumObj - e * S->H.ChunkE;
+		n = (n < S->H.ChunkE) ? n : S->H.ChunkE;
+		N = (int64_t) n * S->Rows;
+		S->Z[0] = (unsigned char) Code(S->Block + (int64_t) e * S->H.ChunkE * S->H.ChunkT, S->H.ChunkT, n, S->Rows, S->H.MaxError, S->Word);
+		for (m = 0; m < N; m++) {
+			for (j = 0; j < 8; j++) {
+				S->Plane[j * N + m] = (unsigned char) (S->Word[m] >> (8 * j));
+			}
+		}
+		len = S->ZCap - 1;
+		if (compress2(S->Z + 1, &len, S->Plane, (uLong) (8 * N), CHUNK_LEVEL) != Z_OK) {
+			printf("\n  Fatal Error: compression of an output chunk failed\n");
+			exit(1);
+		}
+		S->Index[S->NumChunk].Offset = S->Bytes;
+		S->Index[S->NumChunk].Size = (int64_t) len + 1;
+		S->NumChunk++;
+		fwrite(S->Z, 1, len + 1, S->fp);
+		S->Bytes = S->Bytes + (int64_t) len + 1;
+	}
+	S->Rows = 0;
+}
+
+/*
+ * Start a store in fp for records of numObj values. H gives NumEle,
+ * NumRiv, Interval, StartTime and MaxError; the chunk shape is chosen here.
+ */
+chunk_store    *
+ChunkOpen(FILE * fp, chunk_header * H, int numObj)
+{
+	chunk_store    *S;
+	int64_t         n;
+
+	S = (chunk_store *) malloc(sizeof(chunk_store));
+	S->fp = fp;
+	S->H = *H;
+	strcpy(S->H.Magic, CHUNK_MAGIC);
+	S->H.Version = CHUNK_VERSION;
+	S->H.NumObj = numObj;
+	S->H.ChunkE = (numObj < CHUNK_E) ? numObj : CHUNK_E;
+	n = CHUNK_BYTES / ((int64_t) numObj * sizeof(double));
+	S->H.ChunkT = (n < 1) ? 1 : (n > CHUNK_T) ? CHUNK_T : (int) n;
+	S->H.Pad = 0;
+	S->H.NumRec = 0;
+	S->H.IndexOff = 0;
+	S->Rows = 0;
+	S->Block = (double *) malloc((int64_t) numObj * S->H.ChunkT * sizeof(double));
+	S->TimeCap = 1024;
+	S->Time = (double *) malloc(S->TimeCap * sizeof(double));
+	S->IndexCap = 0;
+	S->NumChunk = 0;
+	S->Index = NULL;
+	n = (int64_t) S->H.ChunkE * S->H.ChunkT;
+	S->Word = (uint64_t *) malloc(n * sizeof(uint64_t));
+	S->Plane = (unsigned char *) malloc(8 * n);
+	S->ZCap = compressBound((uLong) (8 * n)) + 1;
+	S->Z = (unsigned char *) malloc(S->ZCap);
+	fwrite(&S->H, sizeof(chunk_header), 1, fp);
+	S->Bytes = sizeof(chunk_header);
+	return S;
+}
+
+void
+ChunkAppend(chunk_store * S, double t, const double *v)
+{
+	int             i;
+
+	if (S->H.NumRec == S->TimeCap) {
+		S->TimeCap = 2 * S->TimeCap;
+		S->Time = (double *) realloc(S->Time, S->TimeCap * sizeof(double));
+	}
+	S->Time[S->H.NumRec] = t;
+	S->H.NumRec++;
+	for (i = 0; i < S->H.NumObj; i++) {
+		S->Block[(int64_t) i * S->H.ChunkT + S->Rows] = v[i];
+	}
+	S->Rows++;
+	if (S->Rows == S->H.ChunkT) {
+		WriteRow(S);
+	}
+}
+
+/* Write the last chunks, the index and the header; returns the file size */
+int64_t
+ChunkClose(chunk_store * S)
+{
+	int64_t         bytes;
+
+	if (S->Rows > 0) {
+		WriteRow(S);
+	}
+	S->H.IndexOff = S->Bytes;
+	fwrite(S->Time, sizeof(double), S->H.NumRec, S->fp);
+	fwrite(S->Index, sizeof(chunk_index), S->NumChunk, S->fp);
+	S->Bytes = S->Bytes + S->H.NumRec * sizeof(double) + S->NumChunk * sizeof(chunk_index);
+	fseeko(S->fp, 0, SEEK_SET);
+	fwrite(&S->H, sizeof(chunk_header), 1, S->fp);
+	fseeko(S->fp, 0, SEEK_END);
+	bytes = S->Bytes;
+	free(S->Block);
+	free(S->Time);
+	free(S->Index);
+	free(S->Word);
+	free(S->Plane);
+	free(S->Z);
+	free(S);
+	return bytes;
+}
+
+/* Header and index of the store in fp; NULL if fp holds no finished store */
+chunk_reader   *
+ChunkReadOpen(FILE * fp)
+{
+	chunk_reader   *R;
+	int64_t         n;
+
+	R = (chunk_reader *) malloc(sizeof(chunk_reader));
+	fseeko(fp, 0, SEEK_SET);
+	if (fread(&R->H, sizeof(chunk_header), 1, fp) != 1 || strcmp(R->H.Magic, CHUNK_MAGIC) != 0 || R->H.Version != CHUNK_VERSION || R->H.IndexOff == 0) {
+		free(R);
+		return NULL;
+	}
+	R->fp = fp;
+	R->NumTB = (int) ((R->H.NumRec + R->H.ChunkT - 1) / R->H.ChunkT);
+	R->NumEB = (R->H.NumObj + R->H.ChunkE - 1) / R->H.ChunkE;
+	R->Time = (double *) malloc(R->H.NumRec * sizeof(double));
+	R->Index = (chunk_index *) malloc((int64_t) R->NumTB * R->NumEB * sizeof(chunk_index));
+	fseeko(fp, (off_t) R->H.IndexOff, SEEK_SET);
+	fread(R->Time, sizeof(double), R->H.NumRec, fp);
+	fread(R->Index, sizeof(chunk_index), (int64_t) R->NumTB * R->NumEB, fp);
+	n = (int64_t) R->H.ChunkE * R->H.ChunkT;
+	R->Word = (uint64_t *) malloc(n * sizeof(uint64_t));
+	R->Plane = (unsigned char *) malloc(8 * n);
+	R->Z = (unsigned char *) malloc(compressBound((uLong) (8 * n)) + 1);
+	return R;
+}
+
+/*
+ * Values of chunk (time block b, object block e) into out: object i of the
+ * block, record k of the block at out[i * T + k], T records in block b
+ */
+void
+ChunkDecode(chunk_reader * R, int b, int e, double *out)
+{
+	chunk_index    *I;
+	int             n, T, i, k, j;
+	int64_t         N, m, q;
+	uLongf          len;
+	uint64_t        u, prev;
+
+	I = &R->Index[(int64_t) b * R->NumEB + e];
+	n = R->H.NumObj - e * R->H.ChunkE;
+	n = (n < R->H.ChunkE) ? n : R->H.ChunkE;
+	T = (int) (R->H.NumRec - (int64_t) b * R->H.ChunkT);
+	T = (T < R->H.ChunkT) ? T : R->H.ChunkT;
+	N = (int64_t) n * T;
+	fseeko(R->fp, (off_t) I->Offset, SEEK_SET);
+	fread(R->Z, 1, I->Size, R->fp);
+	len = (uLongf) (8 * N);
+	if (uncompress(R->Plane, &len, R->Z + 1, (uLong) (I->Size - 1)) != Z_OK || len != (uLongf) (8 * N)) {
+		printf("chunk.c: corrupt chunk %d, %d\n", b, e);
+		exit(1);
+	}
+	for (m = 0; m < N; m++) {
+		u = 0;
+		for (j = 0; j < 8; j++) {
+			u = u | ((uint64_t) R->Plane[j * N + m] << (8 * j));
+		}
+		R->Word[m] = u;
+	}
+	for (i = 0; i < n; i++) {
+		prev = 0;
+		q = 0;
+		for (k = 0; k < T; k++) {
+			u = R->Word[(int64_t) i * T + k];
+			if (R->Z[0] == CODE_QUANT) {
+				q = q + (int64_t) ((u >> 1) ^ (~(u & 1) + 1));
+				out[(int64_t) i * T + k] = (double) q * 2 * R->H.MaxError;
+			} else {
+				prev = prev ^ u;
+				memcpy(&out[(int64_t) i * T + k], &prev, sizeof(double));
+			}
+		}
+	}
+}
+
+void
+ChunkReadClose(chunk_reader * R)
+{
+	free(R->Time);
+	free(R->Index);
+	free(R->Word);
+	free(R->Plane);
+	free(R->Z);
+	free(R);
+}
@@ -0,0 +1,486 @@
+/*******************************************************************************
+ * File        : ensemble.c                                                    *
+ * Function    : Ensemble of runs sharing the model data (--ensemble file)     *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) ./pihm --ensemble file project reads and initializes project once and    *
+ *    runs each member of file on it. The file holds the number of members,    *
+ *    then for each member a name and the factors of a .calib file, in the     *
+ *    same order. Member name writes project.name.GW etc.; all members start   *
+ *    from the initial state of the project.                                   *
+ * b) A member has its own Model_Data, a copy of that of the project whose     *
+ *    arrays are shared, except those written during a run (states, fluxes,    *
+ *    print sums, forcing values and the headers of the time series, which     *
+ *    hold the cursors) and those derived from a calibration factor that the   *
+ *    member changes. These are copied when the member starts and freed when   *
+ *    it ends (copy on write), so memory grows with what differs.              *
+ * c) A changed factor scales the arrays derived from it by the ratio of the   *
+ *    member and project factors, which agrees with a run of the member's      *
+ *    .calib to rounding; macD and the cells beneath the rivers are worked     *
+ *    out again as initialize() does. A factor that is 0 in the project        *
+ *    cannot be changed. The initial state is not recomputed, so init_type 0   *
+ *    and 1 start every member from the project's heads and storages.          *
+ * d) The members run on the OpenMP threads (--threads N), one member per      *
+ *    thread; the loops of f() then run serially within each member. Each      *
+ *    member has its own CVODE memory, solver data and output writer.          *
+ * e) The run reports members/hour, the resident memory after loading and      *
+ *    its peak, and the bytes private to each member.                          *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "sundials_types.h"
+#include "nvector_serial.h"
+#include "cvode.h"
+#include "pihm.h"
+
+#define MEMBER_NAME 64		/* Max. length of a member name + 1 */
+
+typedef struct member_type {
+	char            name[MEMBER_NAME];
+	globalCal       Cal;	/* calibration of the member */
+	processCal      pcCal;
+	Model_Data      MD;	/* model data of the member while it runs */
+	void          **own;	/* arrays of MD private to the member */
+	int             nOwn;
+	size_t          bytes;	/* size of own */
+	int             nStop;	/* ET steps, -1: failed */
+	long int        nSteps;	/* CVODE steps */
+	double          wall;	/* run time (s) */
+}               member;
+
+/* Buffered tokenizer (parse.c) */
+text_file      *TextOpen(char *, char *);
+void            TextClose(text_file *);
+int             TextInt(text_file *, char *);
+void            TextWord(text_file *, char *, int, char *);
+void            ReadCalib(text_file *, globalCal *, processCal *);
+/* Parts of a run (pihm.c, print.c) */
+void            OpenOutput(char *, char *, FILE **);
+void           *SolverAlloc(Model_Data, Control_Data *, N_Vector, realtype, realtype, Precond_Data *, Jac_Data *, Sparse_Data *);
+void            SolverFree(void *, Precond_Data, Jac_Data, Sparse_Data);
+int             Simulate(char *, void *, Output_Data, FILE **, Model_Data, Control_Data *, N_Vector, N_Vector, realtype, int, realtype, int);
+Output_Data     OutputAlloc(Model_Data, Control_Data *);
+void            OutputFinish(Output_Data);
+void            OutputFree(Output_Data);
+
+/* n bytes private to member M */
+static void    *
+Own(member * M, size_t n)
+{
+	M->own = (void **) realloc(M->own, (M->nOwn + 1) * sizeof(void *));
+	M->own[M->nOwn] = malloc(n);
+	M->nOwn++;
+	M->bytes = M->bytes + n;
+	return (M->own[M->nOwn - 1]);
+}
+
+/* A private copy of the n bytes at p */
+static void    *
+OwnCopy(member * M, void *p, size_t n)
+{
+	return (memcpy(Own(M, n), p, n));
+}
+
+/* A private copy of the n rows of m values a[i] */
+static realtype **
+Rows(member * M, realtype ** a, int n, int m)
+{
+	realtype      **r;
+	realtype       *v;
+	int             i;
+
+	r = (realtype **) Own(M, n * sizeof(realtype *));
+	v = (realtype *) Own(M, n * m * sizeof(realtype));
+	for (i = 0; i < n; i++) {
+		r[i] = v + i * m;
+		memcpy(r[i], a[i], m * sizeof(realtype));
+	}
+	return (r);
+}
+
+/*
+ * The n values of a times fm/fb: a itself if the member factor fm is that
+ * of the project fb, else a private copy
+ */
+static realtype *
+Scale(member * M, realtype * a, int n, realtype fm, realtype fb)
+{
+	realtype       *p;
+	int             i;
+
+	if (fm == fb) {
+		return (a);
+	}
+	p = (realtype *) Own(M, n * sizeof(realtype));
+	for (i = 0; i < n; i++) {
+		p[i] = a[i] * (fm / fb);
+	}
+	return (p);
+}
+
+/*
+ * Private headers of all registered time series, with the forcing values
+ * read from them; the records stay shared
+ */
+static void
+Series(member * M, Model_Data B)
+{
+	Model_Data      MD;
+	TSD           **ts[13];
+	realtype      **fv[10];
+	int             j, k;
+
+	MD = M->MD;
+	ts[0] = &MD->TSD_Prep;
+	ts[1] = &MD->TSD_Temp;
+	ts[2] = &MD->TSD_Humidity;
+	ts[3] = &MD->TSD_WindVel;
+	ts[4] = &MD->TSD_Rn;
+	ts[5] = &MD->TSD_G;
+	ts[6] = &MD->TSD_Pressure;
+	ts[7] = &MD->TSD_LAI;
+	ts[8] = &MD->TSD_RL;
+	ts[9] = &MD->TSD_MeltF;
+	ts[10] = &MD->TSD_Source;
+	ts[11] = &MD->TSD_EleBC;
+	ts[12] = &MD->TSD_Riv;
+	fv[0] = &MD->ForcPrep;
+	fv[1] = &MD->ForcTemp;
+	fv[2] = &MD->ForcHumidity;
+	fv[3] = &MD->ForcWindVel;
+	fv[4] = &MD->ForcRn;
+	fv[5] = &MD->ForcLAI;
+	fv[6] = &MD->ForcRL;
+	fv[7] = &MD->ForcMeltF;
+	fv[8] = &MD->ForcEleBC;
+	fv[9] = &MD->ForcRiv;
+	MD->Fam = (tsd_family *) OwnCopy(M, B->Fam, B->NumFam * sizeof(tsd_family));
+	for (j = 0; j < B->NumFam; j++) {
+		if (B->Fam[j].num == 0) {
+			continue;
+		}
+		MD->Fam[j].TS = (TSD *) OwnCopy(M, B->Fam[j].TS, B->Fam[j].num * sizeof(TSD));
+		for (k = 0; k < 13; k++) {
+			if (*ts[k] == B->Fam[j].TS) {
+				*ts[k] = MD->Fam[j].TS;
+			}
+		}
+		if (B->Fam[j].value != NULL) {
+			MD->Fam[j].value = (realtype *) Own(M, B->Fam[j].num * sizeof(realtype));
+			for (k = 0; k < 10; k++) {
+				if (*fv[k] == B->Fam[j].value) {
+					*fv[k] = MD->Fam[j].value;
+				}
+			}
+		}
+	}
+	MD->ForcValid = 0;
+}
+
+/* Ratio of a member factor to that of the project, 1 where they agree */
+static realtype
+Ratio(realtype fm, realtype fb)
+{
+	return ((fm == fb) ? 1.0 : fm / fb);
+}
+
+/* Parameter arrays of the member's calibration Cm; Cb is the project's */
+static void
+Calibrate(member * M, Model_Data B, globalCal * Cb)
+{
+	Model_Data      MD;
+	globalCal      *Cm;
+	realtype        a;
+	int             i, n, l, r;
+
+	MD = M->MD;
+	Cm = &M->Cal;
+	n = B->NumEle + B->NumRiv;
+	MD->EleH.KsatH = Scale(M, B->EleH.KsatH, n, Cm->KsatH, Cb->KsatH);
+	MD->EleH.KsatV = Scale(M, B->EleH.KsatV, n, Cm->KsatV, Cb->KsatV);
+	MD->EleH.infKsatV = Scale(M, B->EleH.infKsatV, n, Cm->infKsatV, Cb->infKsatV);
+	MD->EleH.macKsatH = Scale(M, B->EleH.macKsatH, n, Cm->macKsatH, Cb->macKsatH);
+	MD->EleH.macKsatV = Scale(M, B->EleH.macKsatV, n, Cm->macKsatV, Cb->macKsatV);
+	MD->EleH.infD = Scale(M, B->EleH.infD, n, Cm->infD, Cb->infD);
+	MD->EleH.RzD = Scale(M, B->EleH.RzD, n, Cm->RzD, Cb->RzD);
+	MD->EleH.Porosity = Scale(M, B->EleH.Porosity, n, Cm->Porosity, Cb->Porosity);
+	MD->EleH.Alpha = Scale(M, B->EleH.Alpha, n, Cm->Alpha, Cb->Alpha);
+	MD->EleH.Beta = Scale(M, B->EleH.Beta, n, Cm->Beta, Cb->Beta);
+	MD->EleH.vAreaF = Scale(M, B->EleH.vAreaF, n, Cm->vAreaF, Cb->vAreaF);
+	MD->EleH.hAreaF = Scale(M, B->EleH.hAreaF, n, Cm->hAreaF, Cb->hAreaF);
+	MD->EleH.VegFrac = Scale(M, B->EleH.VegFrac, n, Cm->VegFrac, Cb->VegFrac);
+	MD->EleH.Albedo = Scale(M, B->EleH.Albedo, n, Cm->Albedo, Cb->Albedo);
+	MD->EleH.Rough = Scale(M, B->EleH.Rough, n, Cm->Rough, Cb->Rough);
+	if (Cm->Porosity != Cb->Porosity) {
+		/* f() reads ThetaR of the soils, scaled with the porosity */
+		MD->Soil = (soils *) OwnCopy(M, B->Soil, B->NumSoil * sizeof(soils));
+		for (i = 0; i < B->NumSoil; i++) {
+			MD->Soil[i].ThetaS = MD->Soil[i].ThetaS * (Cm->Porosity / Cb->Porosity);
+			MD->Soil[i].ThetaR = MD->Soil[i].ThetaR * (Cm->Porosity / Cb->Porosity);
+		}
+	}
+	for (i = 0; i < B->NumPrep; i++) {
+		MD->TSD_Prep[i].value = Scale(M, B->TSD_Prep[i].value, B->TSD_Prep[i].length, Cm->Prep, Cb->Prep);
+	}
+	for (i = 0; i < B->NumTemp; i++) {
+		MD->TSD_Temp[i].value = Scale(M, B->TSD_Temp[i].value, B->TSD_Temp[i].length, Cm->Temp, Cb->Temp);
+	}
+	if (Cm->rivRough != Cb->rivRough || Cm->rivKsatH != Cb->rivKsatH || Cm->rivKsatV != Cb->rivKsatV || Cm->rivbedThick != Cb->rivbedThick || Cm->rivDepth != Cb->rivDepth || Cm->rivShapeCoeff != Cb->rivShapeCoeff) {
+		MD->Riv = (river_segment *) OwnCopy(M, B->Riv, B->NumRiv * sizeof(river_segment));
+		for (i = 0; i < B->NumRiv; i++) {
+			MD->Riv[i].Rough = MD->Riv[i].Rough * Ratio(Cm->rivRough, Cb->rivRough);
+			MD->Riv[i].KsatH = MD->Riv[i].KsatH * Ratio(Cm->rivKsatH, Cb->rivKsatH);
+			MD->Riv[i].KsatV = MD->Riv[i].KsatV * Ratio(Cm->rivKsatV, Cb->rivKsatV);
+			MD->Riv[i].bedThick = MD->Riv[i].bedThick * Ratio(Cm->rivbedThick, Cb->rivbedThick);
+			MD->Riv[i].depth = MD->Riv[i].depth * Ratio(Cm->rivDepth, Cb->rivDepth);
+			MD->Riv[i].coeff = MD->Riv[i].coeff * Ratio(Cm->rivShapeCoeff, Cb->rivShapeCoeff);
+			MD->Riv[i].zmin = MD->Riv[i].zmax - MD->Riv[i].depth;
+		}
+	}
+	if (Cm->rivDepth != Cb->rivDepth || Cm->macD != Cb->macD) {
+		/*
+		 * As in initialize(): the cells beneath the rivers take the
+		 * mean macD of their banks before these are clipped to the
+		 * aquifer, so macD cannot be scaled
+		 */
+		MD->EleH.macD = (realtype *) Own(M, n * sizeof(realtype));
+		for (i = 0; i < B->NumEle; i++) {
+			MD->EleH.macD[i] = Cm->macD * B->Geol[B->Ele[i].geol - 1].macD;
+		}
+		if (Cm->rivDepth != Cb->rivDepth) {
+			MD->EleH.zmax = (realtype *) OwnCopy(M, B->EleH.zmax, n * sizeof(realtype));
+		}
+		for (i = 0; i < B->NumRiv; i++) {
+			l = MD->Riv[i].LeftEle - 1;
+			r = MD->Riv[i].RightEle - 1;
+			if (Cm->rivDepth != Cb->rivDepth) {
+				MD->EleH.zmax[i + B->NumEle] = MD->Riv[i].zmin;
+			}
+			a = 0.5 * (MD->EleH.macD[l] + MD->EleH.macD[r]);
+			MD->EleH.macD[i + B->NumEle] = (a > MD->Riv[i].depth) ? a - MD->Riv[i].depth : 0;
+		}
+		for (i = 0; i < B->NumEle; i++) {
+			if (MD->EleH.macD[i] > MD->EleH.zmax[i] - MD->EleH.zmin[i]) {
+				MD->EleH.macD[i] = MD->EleH.zmax[i] - MD->EleH.zmin[i];
+			}
+		}
+	}
+	MD->pcCal = M->pcCal;
+}
+
+/* Model data of member M: that of the project B, copied where it differs */
+static void
+MemberData(member * M, Model_Data B, Control_Data * CS)
+{
+	Model_Data      MD;
+	realtype      **ele[13];
+	int             i;
+
+	M->MD = (Model_Data) OwnCopy(M, B, sizeof *B);
+	MD = M->MD;
+	/* states and fluxes of f() and is_sm_et() */
+	MD->FluxSurf = Rows(M, B->FluxSurf, B->NumEle, 3);
+	MD->FluxSub = Rows(M, B->FluxSub, B->NumEle, 3);
+	MD->EleET = Rows(M, B->EleET, B->NumEle, 4);
+	MD->FluxRiv = Rows(M, B->FluxRiv, B->NumRiv, 11);
+	ele[0] = &MD->ElePrep;
+	ele[1] = &MD->EleETloss;
+	ele[2] = &MD->EleNetPrep;
+	ele[3] = &MD->EleViR;
+	ele[4] = &MD->Recharge;
+	ele[5] = &MD->EleSnow;
+	ele[6] = &MD->EleSnowGrnd;
+	ele[7] = &MD->EleSnowCanopy;
+	ele[8] = &MD->EleIS;
+	ele[9] = &MD->EleISmax;
+	ele[10] = &MD->EleISsnowmax;
+	ele[11] = &MD->EleTF;
+	for (i = 0; i < 12; i++) {
+		*ele[i] = (realtype *) OwnCopy(M, *ele[i], B->NumEle * sizeof(realtype));
+	}
+	MD->DummyY = (realtype *) OwnCopy(M, B->DummyY, (3 * B->NumEle + 2 * B->NumRiv) * sizeof(realtype));
+	if (B->SurfMode == 2) {
+		/* f() keeps the surface heads of the neighbours in Ele */
+		MD->Ele = (element *) OwnCopy(M, B->Ele, B->NumEle * sizeof(element));
+	}
+	/* sizes as allocated in initialize() */
+	for (i = 0; i < 24; i++) {
+		MD->PrintVar[i] = (realtype *) OwnCopy(M, B->PrintVar[i], ((i == 0) ? B->NumEle + B->NumRiv : (i >= 7 && i < 19) ? B->NumRiv : B->NumEle) * sizeof(realtype));
+	}
+	Series(M, B);
+	Calibrate(M, B, &CS->Cal);
+}
+
+static void
+MemberFree(member * M)
+{
+	int             i;
+
+	for (i = 0; i < M->nOwn; i++) {
+		free(M->own[i]);
+	}
+	free(M->own);
+	M->own = NULL;
+	M->nOwn = 0;
+	M->MD = NULL;
+}
+
+/* Run member M from the state CV_Y0 of the project B */
+static void
+RunMember(char *filename, member * M, Model_Data B, Control_Data * CS, N_Vector CV_Y0)
+{
+	Precond_Data    pData;
+	Jac_Data        jData;
+	Sparse_Data     sData;
+	Output_Data     oData;
+	N_Vector        CV_Y, CV_Ydot;
+	void           *cvode_mem;
+	FILE           *Ofile[23];
+	char           *prefix;
+	struct timeval  tv0, tv1;
+	int             k;
+
+	gettimeofday(&tv0, NULL);
+	MemberData(M, B, CS);
+	prefix = (char *) malloc((strlen(filename) + strlen(M->name) + 2) * sizeof(char));
+	sprintf(prefix, "%s.%s", filename, M->name);
+	OpenOutput(prefix, "w", Ofile);
+	M->nStop = 0;
+	for (k = 0; k < 23; k++) {
+		if (Ofile[k] == NULL) {
+			printf("\n Warning: output file %d of %s cannot be opened, member %s is not run\n", k, prefix, M->name);
+			M->nStop = -1;
+		}
+	}
+	if (M->nStop == 0) {
+		CV_Y = N_VNew_Serial(NV_LENGTH_S(CV_Y0));
+		CV_Ydot = N_VNew_Serial(NV_LENGTH_S(CV_Y0));
+		N_VScale(1.0, CV_Y0, CV_Y);
+		cvode_mem = SolverAlloc(M->MD, CS, CV_Y, CS->StartTime, CS->InitStep, &pData, &jData, &sData);
+		if (cvode_mem == NULL) {
+			M->nStop = -1;
+		} else {
+			oData = OutputAlloc(M->MD, CS);
+			M->nStop = Simulate(prefix, cvode_mem, oData, Ofile, M->MD, CS, CV_Y, CV_Ydot, CS->StartTime, 0, 0, 0);
+			OutputFinish(oData);
+			OutputFree(oData);
+			CVodeGetNumSteps(cvode_mem, &M->nSteps);
+			SolverFree(cvode_mem, pData, jData, sData);
+		}
+		N_VDestroy_Serial(CV_Y);
+		N_VDestroy_Serial(CV_Ydot);
+	}
+	for (k = 0; k < 23; k++) {
+		if (Ofile[k] != NULL) {
+			fclose(Ofile[k]);
+		}
+	}
+	free(prefix);
+	MemberFree(M);
+	gettimeofday(&tv1, NULL);
+	M->wall = (tv1.tv_sec - tv0.tv_sec) + 1.0e-6 * (tv1.tv_usec - tv0.tv_usec);
+}
+
+/* Field key of /proc/self/status (kB), 0 if there is none */
+static long
+Status(char *key)
+{
+	FILE           *fp;
+	char            line[256];
+	long            v;
+
+	v = 0;
+	fp = fopen("/proc/self/status", "r");
+	if (fp == NULL) {
+		return (v);
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (strncmp(line, key, strlen(key)) == 0) {
+			v = atol(line + strlen(key));
+			break;
+		}
+	}
+	fclose(fp);
+	return (v);
+}
+
+/*
+ * Run the members listed in ensFile on the model data B of the project
+ * filename, from its initial state CV_Y0
+ */
+void
+Ensemble(char *filename, char *ensFile, Model_Data B, Control_Data * CS, N_Vector CV_Y0)
+{
+	text_file      *T;
+	member         *M;
+	realtype       *fm, *fb;
+	struct timeval  tv0, tv1;
+	double          wall;
+	size_t          bytes;
+	long            rss0;
+	int             K, k, j, nThreads, nFail;
+
+	T = TextOpen(ensFile, "");
+	if (T == NULL) {
+		printf("\n  Fatal Error: %s is in use or does not exist!\n", ensFile);
+		exit(1);
+	}
+	K = TextInt(T, "NumMember");
+	M = (member *) calloc(K, sizeof(member));
+	for (k = 0; k < K; k++) {
+		TextWord(T, M[k].name, MEMBER_NAME, "member name");
+		ReadCalib(T, &M[k].Cal, &M[k].pcCal);
+		/* globalCal holds realtypes only */
+		fm = (realtype *) &M[k].Cal;
+		fb = (realtype *) &CS->Cal;
+		for (j = 0; j < (int) (sizeof(globalCal) / sizeof(realtype)); j++) {
+			if (fm[j] != fb[j] && fb[j] == 0) {
+				printf("\n  Fatal Error: member %s of %s changes a calibration factor that is 0 in %s.calib\n", M[k].name, ensFile, filename);
+				exit(1);
+			}
+		}
+	}
+	TextClose(T);
+	if (B->StreamForc || B->Pool != NULL) {
+		printf("\n  Fatal Error: the members of an ensemble cannot share streamed forcing\n");
+		exit(1);
+	}
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+	/* f() runs serially within each member */
+	omp_set_max_active_levels(1);
+#else
+	nThreads = 1;
+#endif
+	rss0 = Status("VmRSS:");
+	printf("\n Ensemble of %d members on %d threads ...\n", K, nThreads);
+	gettimeofday(&tv0, NULL);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (k = 0; k < K; k++) {
+		RunMember(filename, &M[k], B, CS, CV_Y0);
+	}
+	gettimeofday(&tv1, NULL);
+	wall = (tv1.tv_sec - tv0.tv_sec) + 1.0e-6 * (tv1.tv_usec - tv0.tv_usec);
+
+	nFail = 0;
+	bytes = 0;
+	for (k = 0; k < K; k++) {
+		if (M[k].nStop < 0) {
+			nFail++;
+			printf("\n Member %s: failed after %lf s", M[k].name, M[k].wall);
+		} else {
+			printf("\n Member %s: %ld steps, %d ET steps, %lf s, %.1f kB private", M[k].name, M[k].nSteps, M[k].nStop, M[k].wall, M[k].bytes / 1024.0);
+		}
+		bytes = bytes + M[k].bytes;
+	}
+	printf("\n Ensemble: %d members (%d failed) in %lf s = %.1f members/hour", K, nFail, wall, (wall > 0) ? 3600.0 * (K - nFail) / wall : 0);
+	printf("\n Memory: %ld kB resident after loading, peak %ld kB, %.1f kB private per member\n", rss0, Status("VmHWM:"), (K > 0) ? bytes / 1024.0 / K : 0);
+	free(M);
+}
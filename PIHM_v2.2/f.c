@@ -45,6 +45,13 @@
  * e) Computational:							       *
  *	--> Use of temporary state variables in calculation. Note: Never change*
  *		core state variables					       *
+ *	--> Lateral fluxes between elements are calculated once per edge    *
+ *		(edge table built in initialize.c)			       *
+ *	--> Element, edge and river loops run in parallel (OpenMP); each     *
+ *		flux slot has a single writer so results do not depend on the  *
+ *		number of threads					       *
+ *	--> OutputFluxes gives the fluxes printed by PrintData without the  *
+ *		lateral element fluxes and the assembly of DY		       *
  * f) Miscellaneous (other advantages realtive to PIHM1.0): No maximum         *
  *    constraint on gw level. Accordingly, no numerical constraints on subsur- *
  *    face flux terms.Faster Implementation. Led to first large scale model    *
@@ -95,6 +102,9 @@
 #define R_v 461.5
 
 realtype        Interpolation(TSD * Data, realtype t);
+int             TSDSeek(TSD * Data, realtype t);
+void            EvalForcing(realtype, Model_Data);
+void            CanopyRates(Model_Data, realtype *, realtype *);
 
 realtype
 returnVal(realtype rArea, realtype rPerem, realtype eqWid, realtype ap_Bool)
@@ -270,11 +280,17 @@ effKH(int mp, realtype tmpY, realtype aqDepth, realtype MacD, realtype MacKsatH,
 
 
 
-int
-f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
+/*
+ * Fluxes of the state CV_Y at time t, and with full = 1 the right hand side
+ * CV_Ydot of the ODE system. With full = 0 only the fluxes read by
+ * PrintData (EleET, EleViR, Recharge, FluxRiv, the interception and snow
+ * storages) are set; CV_Ydot is then scratch space.
+ */
+static int
+Rhs(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS, int full)
 {
 
-	int             i, j, k, inabr;
+	int             i, j, k, inabr, numEdge;
 	realtype        Delta, Gamma;
 	realtype        Rn, G, T, Vel, RH, VP, P, LAI, zero_dh, cnpy_h, rl,
 	                r_a, r_s, alpha_r, f_r, eta_s, beta_s, gamma_s, Rmax,
@@ -292,21 +308,24 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 	Y = NV_DATA_S(CV_Y);
 	DY = NV_DATA_S(CV_Ydot);
 	MD = (Model_Data) DS;
+	EvalForcing(t, MD);
+	if (MD->CanopyODE == 1) {
+		/* interception and snow are state variables */
+		CanopyRates(MD, Y, DY);
+	}
 
 	/* Initialization of temporary state variables */
+#pragma omp parallel for
 	for (i = 0; i < 3 * MD->NumEle + 2 * MD->NumRiv; i++) {
 		MD->DummyY[i] = (Y[i] >= 0) ? Y[i] : 0;
 	}
+#pragma omp parallel for private(j)
 	for (i = 0; i < 3 * MD->NumEle + 2 * MD->NumRiv; i++) {
 		DY[i] = 0;
-		if (i < MD->NumRiv) {
-			MD->FluxRiv[i][0] = 0;
-			MD->FluxRiv[i][10] = 0;
-		}
-		if ((MD->SurfMode == 2) && (i < MD->NumEle)) {
+		if ((full == 1) && (MD->SurfMode == 2) && (i < MD->NumEle)) {
 			for (j = 0; j < 3; j++) {
 				// BHATT: MAJOR BUG DUMMYY OF NABR MAY BE NOT INITIALIZED
-				MD->Ele[i].surfH[j] = (MD->Ele[i].nabr[j] > 0) ? ((MD->Ele[i].BC[j] > -4) ? (MD->Ele[MD->Ele[i].nabr[j] - 1].zmax + MD->DummyY[MD->Ele[i].nabr[j] - 1]) : ((MD->DummyY[-(MD->Ele[i].BC[j] / 4) - 1 + 3 * MD->NumEle] > MD->Riv[-(MD->Ele[i].BC[j] / 4) - 1].depth) ? MD->Riv[-(MD->Ele[i].BC[j] / 4) - 1].zmin + MD->DummyY[-(MD->Ele[i].BC[j] / 4) - 1 + 3 * MD->NumEle] : MD->Riv[-(MD->Ele[i].BC[j] / 4) - 1].zmax)) : ((MD->Ele[i].BC[j] != 1) ? (MD->Ele[i].zmax + MD->DummyY[i]) : Interpolation(&MD->TSD_EleBC[(MD->Ele[i].BC[j]) - 1], t));
+				MD->Ele[i].surfH[j] = (MD->Ele[i].nabr[j] > 0) ? ((MD->Ele[i].BC[j] > -4) ? (MD->EleH.zmax[MD->Ele[i].nabr[j] - 1] + MD->DummyY[MD->Ele[i].nabr[j] - 1]) : ((MD->DummyY[-(MD->Ele[i].BC[j] / 4) - 1 + 3 * MD->NumEle] > MD->Riv[-(MD->Ele[i].BC[j] / 4) - 1].depth) ? MD->Riv[-(MD->Ele[i].BC[j] / 4) - 1].zmin + MD->DummyY[-(MD->Ele[i].BC[j] / 4) - 1 + 3 * MD->NumEle] : MD->Riv[-(MD->Ele[i].BC[j] / 4) - 1].zmax)) : ((MD->Ele[i].BC[j] != 1) ? (MD->EleH.zmax[i] + MD->DummyY[i]) : MD->ForcEleBC[(MD->Ele[i].BC[j]) - 1]);
 			}
 			MD->Ele[i].dhBYdx = -1 * (MD->Ele[i].surfY[2] * (MD->Ele[i].surfH[1] - MD->Ele[i].surfH[0]) + MD->Ele[i].surfY[1] * (MD->Ele[i].surfH[0] - MD->Ele[i].surfH[2]) + MD->Ele[i].surfY[0] * (MD->Ele[i].surfH[2] - MD->Ele[i].surfH[1])) / (MD->Ele[i].surfX[2] * (MD->Ele[i].surfY[1] - MD->Ele[i].surfY[0]) + MD->Ele[i].surfX[1] * (MD->Ele[i].surfY[0] - MD->Ele[i].surfY[2]) + MD->Ele[i].surfX[0] * (MD->Ele[i].surfY[2] - MD->Ele[i].surfY[1]));
 			MD->Ele[i].dhBYdy = -1 * (MD->Ele[i].surfX[2] * (MD->Ele[i].surfH[1] - MD->Ele[i].surfH[0]) + MD->Ele[i].surfX[1] * (MD->Ele[i].surfH[0] - MD->Ele[i].surfH[2]) + MD->Ele[i].surfX[0] * (MD->Ele[i].surfH[2] - MD->Ele[i].surfH[1])) / (MD->Ele[i].surfY[2] * (MD->Ele[i].surfX[1] - MD->Ele[i].surfX[0]) + MD->Ele[i].surfY[1] * (MD->Ele[i].surfX[0] - MD->Ele[i].surfX[2]) + MD->Ele[i].surfY[0] * (MD->Ele[i].surfX[2] - MD->Ele[i].surfX[1]));
@@ -315,102 +334,124 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 
 
 
-	/* Lateral Flux Calculation between Triangular elements Follows  */
-	for (i = 0; i < MD->NumEle; i++) {
-		AquiferDepth = (MD->Ele[i].zmax - MD->Ele[i].zmin);
-		if (AquiferDepth < MD->Ele[i].macD)
-			MD->Ele[i].macD = AquiferDepth;
-		for (j = 0; j < 3; j++) {
-			if (MD->Ele[i].nabr[j] > 0) {
-				/***************************************************************************/
-				/*
-				 * Subsurface Lateral Flux Calculation
-				 * between Triangular elements Follows
-				 */
-				/***************************************************************************/
-				Dif_Y_Sub = (MD->DummyY[i + 2 * MD->NumEle] + MD->Ele[i].zmin) - (MD->DummyY[MD->Ele[i].nabr[j] - 1 + 2 * MD->NumEle] + MD->Ele[MD->Ele[i].nabr[j] - 1].zmin);
-				//Avg_Y_Sub = avgY(MD->Ele[i].zmin, MD->Ele[MD->Ele[i].nabr[j] - 1].zmin, MD->DummyY[i + 2 * MD->NumEle], MD->DummyY[MD->Ele[i].nabr[j] - 1 + 2 * MD->NumEle]);
-				Avg_Y_Sub = avgY(Dif_Y_Sub, MD->DummyY[i + 2 * MD->NumEle], MD->DummyY[MD->Ele[i].nabr[j] - 1 + 2 * MD->NumEle]);
-				Distance = sqrt(pow((MD->Ele[i].x - MD->Ele[MD->Ele[i].nabr[j] - 1].x), 2) + pow((MD->Ele[i].y - MD->Ele[MD->Ele[i].nabr[j] - 1].y), 2));
-				Grad_Y_Sub = Dif_Y_Sub / Distance;
-				/* take care of macropore effect */
-				effK = effKH(MD->Ele[i].Macropore, MD->DummyY[i + 2 * MD->NumEle], AquiferDepth, MD->Ele[i].macD, MD->Ele[i].macKsatH, MD->Ele[i].vAreaF, MD->Ele[i].KsatH);
-				inabr = MD->Ele[i].nabr[j] - 1;
-				nabrAqDepth = (MD->Ele[inabr].zmax - MD->Ele[inabr].zmin);
-				effKnabr = effKH(MD->Ele[inabr].Macropore, MD->DummyY[inabr + 2 * MD->NumEle], nabrAqDepth, MD->Ele[inabr].macD, MD->Ele[inabr].macKsatH, MD->Ele[inabr].vAreaF, MD->Ele[inabr].KsatH);
+	/*
+	 * Lateral Flux Calculation between Triangular elements Follows. Each
+	 * edge is visited once and its flux is assigned to both elements
+	 * with opposite sign. Every (element, edge) slot of FluxSurf/FluxSub
+	 * belongs to exactly one edge, so edges are independent. They are not
+	 * printed: OutputFluxes skips them (except river edges, set below)
+	 */
+	numEdge = (full == 1) ? MD->NumEdge : 0;
+#pragma omp parallel for private(i, j, inabr, AquiferDepth, Dif_Y_Sub, Avg_Y_Sub, Distance, Grad_Y_Sub, effK, nabrAqDepth, effKnabr, Avg_Ksat, Dif_Y_Surf, Avg_Y_Surf, Grad_Y_Surf, Avg_Sf, Avg_Rough, CrossA)
+	for (k = 0; k < numEdge; k++) {
+		i = MD->Edge[k].ele[0];
+		j = MD->Edge[k].loc[0];
+		AquiferDepth = (MD->EleH.zmax[i] - MD->EleH.zmin[i]);
+		if (MD->Edge[k].ele[1] >= 0) {
+			if (MD->Edge[k].BC <= -4) {
+				/* river edge: fluxes are set in river loop */
+				continue;
+			}
+			inabr = MD->Edge[k].ele[1];
+			/***************************************************************************/
+			/*
+			 * Subsurface Lateral Flux Calculation between
+			 * Triangular elements Follows
+			 */
+			/***************************************************************************/
+			Dif_Y_Sub = (MD->DummyY[i + 2 * MD->NumEle] + MD->EleH.zmin[i]) - (MD->DummyY[inabr + 2 * MD->NumEle] + MD->EleH.zmin[inabr]);
+			Avg_Y_Sub = avgY(Dif_Y_Sub, MD->DummyY[i + 2 * MD->NumEle], MD->DummyY[inabr + 2 * MD->NumEle]);
+			Distance = MD->Edge[k].Distance;
+			Grad_Y_Sub = Dif_Y_Sub / Distance;
+			/* take care of macropore effect */
+			effK = effKH(MD->EleH.Macropore[i], MD->DummyY[i + 2 * MD->NumEle], AquiferDepth, MD->EleH.macD[i], MD->EleH.macKsatH[i], MD->EleH.vAreaF[i], MD->EleH.KsatH[i]);
+			nabrAqDepth = (MD->EleH.zmax[inabr] - MD->EleH.zmin[inabr]);
+			effKnabr = effKH(MD->EleH.Macropore[inabr], MD->DummyY[inabr + 2 * MD->NumEle], nabrAqDepth, MD->EleH.macD[inabr], MD->EleH.macKsatH[inabr], MD->EleH.vAreaF[inabr], MD->EleH.KsatH[inabr]);
+			/*
+			 * It should be weighted average. However, there is
+			 * an ambiguity about distance used
+			 */
+			Avg_Ksat = 0.5 * (effK + effKnabr);
+			/* groundwater flow modeled by Darcy's law */
+			MD->FluxSub[i][j] = Avg_Ksat * Grad_Y_Sub * Avg_Y_Sub * MD->Edge[k].length;
+			MD->FluxSub[inabr][MD->Edge[k].loc[1]] = -MD->FluxSub[i][j];
+			/***************************************************************************/
+			/*
+			 * Surface Lateral Flux Calculation between
+			 * Triangular elements Follows
+			 */
+			/***************************************************************************/
+			Dif_Y_Surf = (MD->SurfMode == 1) ? (MD->EleH.zmax[i] - MD->EleH.zmax[inabr]) : (MD->DummyY[i] + MD->EleH.zmax[i]) - (MD->DummyY[inabr] + MD->EleH.zmax[inabr]);
+			Avg_Y_Surf = avgY(Dif_Y_Surf, MD->DummyY[i], MD->DummyY[inabr]);
+			Grad_Y_Surf = Dif_Y_Surf / Distance;
+			Avg_Sf = 0.5 * (sqrt(pow(MD->Ele[i].dhBYdx, 2) + pow(MD->Ele[i].dhBYdy, 2)) + sqrt(pow(MD->Ele[inabr].dhBYdx, 2) + pow(MD->Ele[inabr].dhBYdy, 2)));
+			/*
+			 * updated in 2.2. Note: kinematic slope is taken
+			 * from the upslope element
+			 */
+			Avg_Sf = (MD->SurfMode == 1) ? (Grad_Y_Surf > 0 ? Grad_Y_Surf : EPS / pow(10.0, 6)) : (Avg_Sf > EPS / pow(10.0, 6)) ? Avg_Sf : EPS / pow(10.0, 6);
+			/* Weighting needed */
+			Avg_Rough = 0.5 * (MD->EleH.Rough[i] + MD->EleH.Rough[inabr]);
+			CrossA = Avg_Y_Surf * MD->Edge[k].length;
+			OverlandFlow(MD->FluxSurf, i, j, Avg_Y_Surf, Grad_Y_Surf, Avg_Sf, CrossA, Avg_Rough);
+			if (MD->SurfMode == 1) {
 				/*
-				 * It should be weighted average. However,
-				 * there is an ambiguity about distance used
+				 * the kinematic flux of each side uses its own
+				 * slope, so it is worked out from inabr too
 				 */
-				Avg_Ksat = 0.5 * (effK + effKnabr);
-				/* groundwater flow modeled by Darcy's law */
-				MD->FluxSub[i][j] = Avg_Ksat * Grad_Y_Sub * Avg_Y_Sub * MD->Ele[i].edge[j];
-				/***************************************************************************/
+				Avg_Y_Surf = avgY(-Dif_Y_Surf, MD->DummyY[inabr], MD->DummyY[i]);
+				Avg_Sf = (-Grad_Y_Surf > 0) ? -Grad_Y_Surf : EPS / pow(10.0, 6);
+				CrossA = Avg_Y_Surf * MD->Edge[k].length;
+				OverlandFlow(MD->FluxSurf, inabr, MD->Edge[k].loc[1], Avg_Y_Surf, -Grad_Y_Surf, Avg_Sf, CrossA, Avg_Rough);
+			} else {
+				MD->FluxSurf[inabr][MD->Edge[k].loc[1]] = -MD->FluxSurf[i][j];
+			}
+		}
+		/************************************************/
+		/* Boundary condition Flux Calculations Follows */
+		/************************************************/
+		else {
+			/*
+			 * No flow (natural) boundary condition is default
+			 */
+			if (MD->Edge[k].BC == 0) {
+				MD->FluxSurf[i][j] = 0;
+				MD->FluxSub[i][j] = 0;
+			} else if (MD->Edge[k].BC == 1) {	/* Note: ideally different
+								 * boundary conditions need
+								 * to be incorporated	for
+								 * surf and subsurf
+								 * respectively */
 				/*
-				 * Surface Lateral Flux Calculation between
-				 * Triangular elements Follows
+				 * Note: the formulation assumes only
+				 * dirichlet TS right now
 				 */
-				/***************************************************************************/
-				Dif_Y_Surf = (MD->SurfMode == 1) ? (MD->Ele[i].zmax - MD->Ele[MD->Ele[i].nabr[j] - 1].zmax) : (MD->DummyY[i] + MD->Ele[i].zmax) - (MD->DummyY[MD->Ele[i].nabr[j] - 1] + MD->Ele[MD->Ele[i].nabr[j] - 1].zmax);
-				//Avg_Y_Surf = avgY(MD->Ele[i].zmax, MD->Ele[MD->Ele[i].nabr[j] - 1].zmax, MD->DummyY[i], MD->DummyY[MD->Ele[i].nabr[j] - 1]);
-				Avg_Y_Surf = avgY(Dif_Y_Surf, MD->DummyY[i], MD->DummyY[MD->Ele[i].nabr[j] - 1]);
-				Grad_Y_Surf = Dif_Y_Surf / Distance;
-				Avg_Sf = 0.5*(sqrt(pow(MD->Ele[i].dhBYdx, 2) + pow(MD->Ele[i].dhBYdy, 2))+sqrt(pow(MD->Ele[MD->Ele[i].nabr[j] - 1].dhBYdx, 2) + pow(MD->Ele[MD->Ele[i].nabr[j] - 1].dhBYdy, 2)));
-				//updated in 2.2
-				Avg_Sf = (MD->SurfMode == 1) ? (Grad_Y_Surf > 0 ? Grad_Y_Surf : EPS / pow(10.0, 6)) : (Avg_Sf > EPS / pow(10.0, 6)) ? Avg_Sf : EPS / pow(10.0, 6);
-				/* Weighting needed */
-				Avg_Rough = 0.5 * (MD->Ele[i].Rough + MD->Ele[MD->Ele[i].nabr[j] - 1].Rough);
-				CrossA = Avg_Y_Surf * MD->Ele[i].edge[j];
-				OverlandFlow(MD->FluxSurf, i, j, Avg_Y_Surf, Grad_Y_Surf, Avg_Sf, CrossA, Avg_Rough);
-				//? ? MD->FluxSurf[i][j] = 0.0;
-				//? ? BHATT
-			}
-			/************************************************/
-			/* Boundary condition Flux Calculations Follows */
-			/************************************************/
-			else {
+				MD->FluxSurf[i][j] = 0;	/* Note the assumption here
+							 * is no flow for surface */
+				Dif_Y_Sub = (MD->DummyY[i + 2 * MD->NumEle] + MD->EleH.zmin[i]) - MD->ForcEleBC[(MD->Edge[k].BC) - 1];
+				Avg_Y_Sub = avgY(Dif_Y_Sub, MD->DummyY[i + 2 * MD->NumEle], (MD->ForcEleBC[(MD->Edge[k].BC) - 1] - MD->EleH.zmin[i]));
 				/*
-				 * No flow (natural) boundary condition is
-				 * default
+				 * Minimum Distance from circumcenter to the
+				 * edge of the triangle on which BDD.
+				 * condition is defined
 				 */
-				if (MD->Ele[i].BC[j] == 0) {
-					MD->FluxSurf[i][j] = 0;
-					MD->FluxSub[i][j] = 0;
-				} else if (MD->Ele[i].BC[j] == 1) {	/* Note: ideally
-									 * different boundary
-									 * conditions need to be
-									 * incorporated	for surf
-									 * and subsurf
-									 * respectively */
-					/*
-					 * Note: the formulation assumes only
-					 * dirichlet TS right now
-					 */
-					MD->FluxSurf[i][j] = 0;	/* Note the assumption
-								 * here is no flow for
-								 * surface */
-					Dif_Y_Sub = (MD->DummyY[i + 2 * MD->NumEle] + MD->Ele[i].zmin) - Interpolation(&MD->TSD_EleBC[(MD->Ele[i].BC[j]) - 1], t);
-					Avg_Y_Sub = avgY(Dif_Y_Sub, MD->DummyY[i + 2 * MD->NumEle], (Interpolation(&MD->TSD_EleBC[(MD->Ele[i].BC[j]) - 1], t) - MD->Ele[i].zmin));
-					//Avg_Y_Sub = (MD->DummyY[i + 2 * MD->NumEle] + (Interpolation(&MD->TSD_EleBC[(MD->Ele[i].BC[j]) - 1], t) - MD->Ele[i].zmin)) / 2;
-					/*
-					 * Minimum Distance from circumcenter
-					 * to the edge of the triangle on
-					 * which BDD. condition is defined
-					 */
-					Distance = sqrt(pow(MD->Ele[i].edge[0] * MD->Ele[i].edge[1] * MD->Ele[i].edge[2] / (4 * MD->Ele[i].area), 2) - pow(MD->Ele[i].edge[j] / 2, 2));
-					effK = effKH(MD->Ele[i].Macropore, MD->DummyY[i + 2 * MD->NumEle], AquiferDepth, MD->Ele[i].macD, MD->Ele[i].macKsatH, MD->Ele[i].vAreaF, MD->Ele[i].KsatH);
-					Avg_Ksat = effK;
-					Grad_Y_Sub = Dif_Y_Sub / Distance;
-					MD->FluxSub[i][j] = Avg_Ksat * Grad_Y_Sub * Avg_Y_Sub * MD->Ele[i].edge[j];
-				} else {	/* Neumann BC (Note:
-						 * MD->Ele[i].BC[j] value
-						 * have to be = 2+(index of
-						 * neumann boundary TS) */
-					MD->FluxSurf[i][j] = Interpolation(&MD->TSD_EleBC[(MD->Ele[i].BC[j]) - 1], t);
-					MD->FluxSub[i][j] = Interpolation(&MD->TSD_EleBC[(-MD->Ele[i].BC[j]) - 1], t);
-				}
+				Distance = MD->Edge[k].Distance;
+				effK = effKH(MD->EleH.Macropore[i], MD->DummyY[i + 2 * MD->NumEle], AquiferDepth, MD->EleH.macD[i], MD->EleH.macKsatH[i], MD->EleH.vAreaF[i], MD->EleH.KsatH[i]);
+				Avg_Ksat = effK;
+				Grad_Y_Sub = Dif_Y_Sub / Distance;
+				MD->FluxSub[i][j] = Avg_Ksat * Grad_Y_Sub * Avg_Y_Sub * MD->Edge[k].length;
+			} else {	/* Neumann BC (Note: MD->Ele[i].BC[j]
+					 * value have to be = 2+(index of
+					 * neumann boundary TS) */
+				MD->FluxSurf[i][j] = MD->ForcEleBC[(MD->Edge[k].BC) - 1];
+				MD->FluxSub[i][j] = MD->ForcEleBC[(-MD->Edge[k].BC) - 1];
 			}
 		}
+	}
+
+#pragma omp parallel for private(AquiferDepth, Avg_Y_Sub, Deficit, Delta, ETp, G, Gamma, Grad_Y_Sub, LAI, P, P_c, RH, Rmax, Rn, T, ThetaRef, ThetaW, TotalY_Ele, VP, Vel, alpha_r, beta_s, effK, elemSatn, eta_s, f_r, gamma_s, qv, qv_sat, r_a, r_s, rl, satKfunc)
+	for (i = 0; i < MD->NumEle; i++) {
+		AquiferDepth = (MD->EleH.zmax[i] - MD->EleH.zmin[i]);
 		/**************************************************************************************************/
 		/*
 		 * Evaporation Module: [2] is ET from OVLF/SUBF, [1] is
@@ -418,63 +459,63 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 		 */
 		/**************************************************************************************************/
 		/* Physical Unit Dependent. Change this */
-		Rn = Interpolation(&MD->TSD_Rn[MD->Ele[i].Rn - 1], t);
+		Rn = MD->ForcRn[MD->Ele[i].Rn - 1];
 		//G = Interpolation(&MD->TSD_G[MD->Ele[i].G - 1], t);
 		G = 0.1 * Rn;
-		T = Interpolation(&MD->TSD_Temp[MD->Ele[i].temp - 1], t);
-		Vel = Interpolation(&MD->TSD_WindVel[MD->Ele[i].WindVel - 1], t);
-		RH = Interpolation(&MD->TSD_Humidity[MD->Ele[i].humidity - 1], t);
+		T = MD->ForcTemp[MD->Ele[i].temp - 1];
+		Vel = MD->ForcWindVel[MD->Ele[i].WindVel - 1];
+		RH = MD->ForcHumidity[MD->Ele[i].humidity - 1];
 		VP = 611.2 * exp(17.67 * T / (T + 243.5)) * RH;
-		P = 101.325 * pow(10, 3) * pow((293 - 0.0065 * MD->Ele[i].zmax) / 293, 5.26);
+		P = 101.325 * pow(10, 3) * pow((293 - 0.0065 * MD->EleH.zmax[i]) / 293, 5.26);
 		qv = 0.622 * VP / P;
 		qv_sat = 0.622 * (VP / RH) / P;
-		//P = 101.325 * pow(10, 3) * pow((293 - 0.0065 * MD->Ele[i].zmax) / 293, 5.26);
+		//P = 101.325 * pow(10, 3) * pow((293 - 0.0065 * MD->EleH.zmax[i]) / 293, 5.26);
 		//Delta = 2503 * pow(10, 3) * exp(17.27 * T / (T + 237.3)) / (pow(237.3 + T, 2));
 		//Gamma = P * 1.0035 * 0.92 / (0.622 * 2441);
-		LAI = Interpolation(&MD->TSD_LAI[MD->Ele[i].LC - 1], t);
+		LAI = MD->ForcLAI[MD->EleH.LC[i] - 1];
 		/*
-		 * zero_dh=Interpolation(&MD->TSD_DH[MD->Ele[i].LC-1], t);
+		 * zero_dh=Interpolation(&MD->TSD_DH[MD->EleH.LC[i]-1], t);
 		 * cnpy_h =
 		 * zero_dh/(1.1*(0.0000001+log(1+pow(0.007*LAI,0.25))));
 		 * if(LAI<2.85)	{ rl= 0.0002 + 0.3*cnpy_h*pow(0.07*LAI,0.5);
 		 * } else { rl= 0.3*cnpy_h*(1-(zero_dh/cnpy_h)); }
 		 */
-		rl = Interpolation(&MD->TSD_RL[MD->Ele[i].LC - 1], t);
-		r_a = 12 * 4.72 * log(MD->Ele[i].windH / rl) / (0.54 * Vel / UNIT_C / 60 + 1) / UNIT_C / 60;
+		rl = MD->ForcRL[MD->EleH.LC[i] - 1];
+		r_a = 12 * 4.72 * log(MD->EleH.windH[i] / rl) / (0.54 * Vel / UNIT_C / 60 + 1) / UNIT_C / 60;
 
 		Gamma = 4 * 0.7 * SIGMA * UNIT_C * R_dry / C_air * pow(T + 273.15, 4) / (P / r_a) + 1;
 		Delta = Lv * Lv * 0.622 / R_v / C_air / pow(T + 273.15, 2) * qv_sat;
 		ETp = (Rn * Delta + Gamma * (1.2 * Lv * (qv_sat - qv) / r_a)) / (1000.0 * Lv * (Delta + Gamma));
-		//MD->EleET[i][2] = MD->pcCal.Et2 * (1 - MD->Ele[i].VegFrac) * (Rn * (1 - MD->Ele[i].Albedo) * Delta + (1.2 * 1003.5 * ((VP / RH) - VP) / r_a)) / (1000.0 * 2441000.0 * (Delta + Gamma));
+		//MD->EleET[i][2] = MD->pcCal.Et2 * (1 - MD->EleH.VegFrac[i]) * (Rn * (1 - MD->EleH.Albedo[i]) * Delta + (1.2 * 1003.5 * ((VP / RH) - VP) / r_a)) / (1000.0 * 2441000.0 * (Delta + Gamma));
 		// BHATT: MAJOR BUG = AQUIFER DEPTH NOT CALCULATED EARLIER
-		if ((MD->Ele[i].zmax - MD->Ele[i].zmin) - MD->DummyY[i + 2 * MD->NumEle] < MD->Ele[i].RzD) {
+		if ((MD->EleH.zmax[i] - MD->EleH.zmin[i]) - MD->DummyY[i + 2 * MD->NumEle] < MD->EleH.RzD[i]) {
 			elemSatn = 1.0;
 		} else {
 			elemSatn = ((MD->DummyY[i + MD->NumEle] / (AquiferDepth - MD->DummyY[i + 2 * MD->NumEle])) > 1) ? 1 : ((MD->DummyY[i + MD->NumEle] / (AquiferDepth - MD->DummyY[i + 2 * MD->NumEle])) < 0) ? 0 : 0.5 * (1 - cos(3.14 * (MD->DummyY[i + MD->NumEle] / (AquiferDepth - MD->DummyY[i + 2 * MD->NumEle]))));
 		}
-		ThetaRef = 0.7 * MD->Soil[(MD->Ele[i].soil - 1)].ThetaS;
-		ThetaW = 1.05 * MD->Soil[(MD->Ele[i].soil - 1)].ThetaR;
-		beta_s = (elemSatn * MD->Ele[i].Porosity + MD->Soil[(MD->Ele[i].soil - 1)].ThetaR - ThetaW) / (ThetaRef - ThetaW);
+		ThetaRef = 0.7 * MD->Soil[(MD->EleH.soil[i] - 1)].ThetaS;
+		ThetaW = 1.05 * MD->Soil[(MD->EleH.soil[i] - 1)].ThetaR;
+		beta_s = (elemSatn * MD->EleH.Porosity[i] + MD->Soil[(MD->EleH.soil[i] - 1)].ThetaR - ThetaW) / (ThetaRef - ThetaW);
 		beta_s = (beta_s < 0.0001) ? 0.0001 : (beta_s > 1 ? 1 : beta_s);
-		MD->EleET[i][2] = MD->pcCal.Et2 * (1 - MD->Ele[i].VegFrac) * beta_s * ETp;
+		MD->EleET[i][2] = MD->pcCal.Et2 * (1 - MD->EleH.VegFrac[i]) * beta_s * ETp;
 		MD->EleET[i][2] = MD->EleET[i][2] < 0 ? 0 : MD->EleET[i][2];
 		if (LAI > 0.0) {
 			Rmax = 5000.0 / (60 * UNIT_C);	/* Unit day_per_m */
-			f_r = 1.1 * 1.5 * Rn / (MD->Ele[i].Rs_ref * LAI);
+			f_r = 1.1 * 1.5 * Rn / (MD->EleH.Rs_ref[i] * LAI);
 			f_r = f_r < 0 ? 0 : f_r;
-			alpha_r = (1 + f_r) / (f_r + (MD->Ele[i].Rmin / Rmax));
+			alpha_r = (1 + f_r) / (f_r + (MD->EleH.Rmin[i] / Rmax));
 			alpha_r = alpha_r > 10000 ? 10000 : alpha_r;
 			eta_s = 1 - 0.0016 * (pow((24.85 - T), 2));
 			eta_s = eta_s < 0.0001 ? 0.0001 : eta_s;
 			gamma_s = 1 / (1 + 0.00025 * (VP / RH - VP));
 			gamma_s = (gamma_s < 0.01) ? 0.01 : gamma_s;
-			r_s = ((MD->Ele[i].Rmin * alpha_r / (beta_s * LAI * eta_s * gamma_s)) > Rmax) ? Rmax : (MD->Ele[i].Rmin * alpha_r / (beta_s * LAI * eta_s * gamma_s));
+			r_s = ((MD->EleH.Rmin[i] * alpha_r / (beta_s * LAI * eta_s * gamma_s)) > Rmax) ? Rmax : (MD->EleH.Rmin[i] * alpha_r / (beta_s * LAI * eta_s * gamma_s));
 			P_c = (1 + Delta / Gamma) / (1 + r_s / r_a + Delta / Gamma);
-			MD->EleET[i][1] = MD->pcCal.Et1 * MD->Ele[i].VegFrac * P_c * (1 - pow(((MD->EleIS[i] + MD->EleSnowCanopy[i] < 0) ? 0 : (MD->EleIS[i] + MD->EleSnowCanopy[i])) / (MD->EleISmax[i] + MD->EleISsnowmax[i]), 1.0 / 2.0)) * ETp;
+			MD->EleET[i][1] = MD->pcCal.Et1 * MD->EleH.VegFrac[i] * P_c * (1 - pow(((MD->EleIS[i] + MD->EleSnowCanopy[i] < 0) ? 0 : (MD->EleIS[i] + MD->EleSnowCanopy[i])) / (MD->EleISmax[i] + MD->EleISsnowmax[i]), 1.0 / 2.0)) * ETp;
 			MD->EleET[i][1] = MD->EleET[i][1] < 0 ? 0 : MD->EleET[i][1];
-			AquiferDepth = MD->Ele[i].zmax - MD->Ele[i].zmin;
+			AquiferDepth = MD->EleH.zmax[i] - MD->EleH.zmin[i];
 			//? ? BHATT
-				MD->EleET[i][1] = ((MD->DummyY[i + 2 * MD->NumEle] < (AquiferDepth - MD->Ele[i].RzD)) && MD->DummyY[i + MD->NumEle] <= 0) ? 0 : MD->EleET[i][1];
+				MD->EleET[i][1] = ((MD->DummyY[i + 2 * MD->NumEle] < (AquiferDepth - MD->EleH.RzD[i])) && MD->DummyY[i + MD->NumEle] <= 0) ? 0 : MD->EleET[i][1];
 			//? ? BHATT
 		} else {
 			MD->EleET[i][1] = 0.0;
@@ -483,19 +524,19 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 		 * Note: Assumption is OVL flow depth less than EPS/100 is
 		 * immobile water
 		 */
-		if (MD->DummyY[i + 2 * MD->NumEle] > AquiferDepth - MD->Ele[i].infD) {
+		if (MD->DummyY[i + 2 * MD->NumEle] > AquiferDepth - MD->EleH.infD[i]) {
 			/* Assumption: infD<macD */
-			Grad_Y_Sub = (MD->DummyY[i] + MD->Ele[i].zmax - (MD->DummyY[i + 2 * MD->NumEle] + MD->Ele[i].zmin)) / MD->Ele[i].infD;
+			Grad_Y_Sub = (MD->DummyY[i] + MD->EleH.zmax[i] - (MD->DummyY[i + 2 * MD->NumEle] + MD->EleH.zmin[i])) / MD->EleH.infD[i];
 			Grad_Y_Sub = ((MD->DummyY[i] < EPS / 100) && (Grad_Y_Sub > 0)) ? 0 : Grad_Y_Sub;
 			elemSatn = 1.0;
-			satKfunc = pow(elemSatn, 0.5) * pow(-1 + pow(1 - pow(elemSatn, MD->Ele[i].Beta / (MD->Ele[i].Beta - 1)), (MD->Ele[i].Beta - 1) / MD->Ele[i].Beta), 2);
-			effK = (1) ? effKV(satKfunc, Grad_Y_Sub, MD->Ele[i].macKsatV, MD->Ele[i].infKsatV, MD->Ele[i].hAreaF) : MD->Ele[i].infKsatV;
+			satKfunc = pow(elemSatn, 0.5) * pow(-1 + pow(1 - pow(elemSatn, MD->EleH.Beta[i] / (MD->EleH.Beta[i] - 1)), (MD->EleH.Beta[i] - 1) / MD->EleH.Beta[i]), 2);
+			effK = (1) ? effKV(satKfunc, Grad_Y_Sub, MD->EleH.macKsatV[i], MD->EleH.infKsatV[i], MD->EleH.hAreaF[i]) : MD->EleH.infKsatV[i];
 			MD->EleViR[i] = effK * Grad_Y_Sub;
 			MD->Recharge[i] = MD->EleViR[i];
 			DY[i + MD->NumEle] = DY[i + MD->NumEle] + MD->EleViR[i] - MD->Recharge[i];
 			DY[i + 2 * MD->NumEle] = DY[i + 2 * MD->NumEle] + MD->Recharge[i] - ((MD->DummyY[i] < EPS / 100) ? MD->EleET[i][2] : 0);
 			//? ? if (DY[i + 2 * MD->NumEle] < 0 && MD->DummyY[i + 2 * MD->NumEle] < .002)
-				//? ?printf("1 %d %lf %lf\n", MD->Ele[i].soil, MD->Recharge[i], MD->EleET[i][2]);
+				//? ?printf("1 %d %lf %lf\n", MD->EleH.soil[i], MD->Recharge[i], MD->EleET[i][2]);
 			//? ? BHATT
 		} else {
 			Deficit = AquiferDepth - MD->DummyY[i + 2 * MD->NumEle];
@@ -508,14 +549,14 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			 * comment the statement that follows
 			 */
 			elemSatn = (elemSatn < multF * EPS) ? multF * EPS : elemSatn;
-			Avg_Y_Sub = (-(pow(pow(1 / elemSatn, MD->Ele[i].Beta / (MD->Ele[i].Beta - 1)) - 1, 1 / MD->Ele[i].Beta) / MD->Ele[i].Alpha) < MINpsi) ? MINpsi : -(pow(pow(1 / elemSatn, MD->Ele[i].Beta / (MD->Ele[i].Beta - 1)) - 1, 1 / MD->Ele[i].Beta) / MD->Ele[i].Alpha);
-			TotalY_Ele = Avg_Y_Sub + MD->Ele[i].zmin + AquiferDepth - MD->Ele[i].infD;
-			Grad_Y_Sub = (MD->DummyY[i] + MD->Ele[i].zmax - TotalY_Ele) / MD->Ele[i].infD;
+			Avg_Y_Sub = (-(pow(pow(1 / elemSatn, MD->EleH.Beta[i] / (MD->EleH.Beta[i] - 1)) - 1, 1 / MD->EleH.Beta[i]) / MD->EleH.Alpha[i]) < MINpsi) ? MINpsi : -(pow(pow(1 / elemSatn, MD->EleH.Beta[i] / (MD->EleH.Beta[i] - 1)) - 1, 1 / MD->EleH.Beta[i]) / MD->EleH.Alpha[i]);
+			TotalY_Ele = Avg_Y_Sub + MD->EleH.zmin[i] + AquiferDepth - MD->EleH.infD[i];
+			Grad_Y_Sub = (MD->DummyY[i] + MD->EleH.zmax[i] - TotalY_Ele) / MD->EleH.infD[i];
 			Grad_Y_Sub = ((MD->DummyY[i] < EPS / 100) && (Grad_Y_Sub > 0)) ? 0 : Grad_Y_Sub;
-			satKfunc = pow(elemSatn, 0.5) * pow(-1 + pow(1 - pow(elemSatn, MD->Ele[i].Beta / (MD->Ele[i].Beta - 1)), (MD->Ele[i].Beta - 1) / MD->Ele[i].Beta), 2);
+			satKfunc = pow(elemSatn, 0.5) * pow(-1 + pow(1 - pow(elemSatn, MD->EleH.Beta[i] / (MD->EleH.Beta[i] - 1)), (MD->EleH.Beta[i] - 1) / MD->EleH.Beta[i]), 2);
 			
-				effK = (1) ? effKV(satKfunc, Grad_Y_Sub, MD->Ele[i].macKsatV, MD->Ele[i].infKsatV, MD->Ele[i].hAreaF) : MD->Ele[i].infKsatV;
-			//MD->EleViR[i] = 0.5 * (effK + MD->Ele[i].infKsatV) * Grad_Y_Sub;
+				effK = (1) ? effKV(satKfunc, Grad_Y_Sub, MD->EleH.macKsatV[i], MD->EleH.infKsatV[i], MD->EleH.hAreaF[i]) : MD->EleH.infKsatV[i];
+			//MD->EleViR[i] = 0.5 * (effK + MD->EleH.infKsatV[i]) * Grad_Y_Sub;
 			//BHATT ? ?
 				MD->EleViR[i] = 0.5 * (effK) * Grad_Y_Sub;
 			/*
@@ -523,10 +564,10 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			 * unsaturated zone has low saturation, satKfunc
 			 * becomes very small. Use arithmetic mean instead
 			 */
-			//MD->Recharge[i] = (elemSatn == 0.0) ? 0 : (Deficit <= 0) ? 0 : (MD->Ele[i].KsatV * satKfunc * (MD->Ele[i].Alpha * Deficit - 2 * pow(-1 + pow(elemSatn, MD->Ele[i].Beta / (-MD->Ele[i].Beta + 1)), 1 / MD->Ele[i].Beta)) / (MD->Ele[i].Alpha * ((Deficit + MD->DummyY[i + 2 * MD->NumEle] * satKfunc))));
+			//MD->Recharge[i] = (elemSatn == 0.0) ? 0 : (Deficit <= 0) ? 0 : (MD->EleH.KsatV[i] * satKfunc * (MD->EleH.Alpha[i] * Deficit - 2 * pow(-1 + pow(elemSatn, MD->EleH.Beta[i] / (-MD->EleH.Beta[i] + 1)), 1 / MD->EleH.Beta[i])) / (MD->EleH.Alpha[i] * ((Deficit + MD->DummyY[i + 2 * MD->NumEle] * satKfunc))));
 			/* Arithmetic Mean Formulation */
-			effK = (MD->Ele[i].Macropore == 1) ? ((MD->DummyY[i + 2 * MD->NumEle] > AquiferDepth - MD->Ele[i].macD) ? effK : MD->Ele[i].KsatV * satKfunc) : MD->Ele[i].KsatV * satKfunc;
-			MD->Recharge[i] = (elemSatn == 0.0) ? 0 : (Deficit <= 0) ? 0 : (MD->Ele[i].KsatV * MD->DummyY[i + 2 * MD->NumEle] + effK * Deficit) * (MD->Ele[i].Alpha * Deficit - 2 * pow(-1 + pow(elemSatn, MD->Ele[i].Beta / (-MD->Ele[i].Beta + 1)), 1 / MD->Ele[i].Beta)) / (MD->Ele[i].Alpha * pow(Deficit + MD->DummyY[i + 2 * MD->NumEle], 2));
+			effK = (MD->EleH.Macropore[i] == 1) ? ((MD->DummyY[i + 2 * MD->NumEle] > AquiferDepth - MD->EleH.macD[i]) ? effK : MD->EleH.KsatV[i] * satKfunc) : MD->EleH.KsatV[i] * satKfunc;
+			MD->Recharge[i] = (elemSatn == 0.0) ? 0 : (Deficit <= 0) ? 0 : (MD->EleH.KsatV[i] * MD->DummyY[i + 2 * MD->NumEle] + effK * Deficit) * (MD->EleH.Alpha[i] * Deficit - 2 * pow(-1 + pow(elemSatn, MD->EleH.Beta[i] / (-MD->EleH.Beta[i] + 1)), 1 / MD->EleH.Beta[i])) / (MD->EleH.Alpha[i] * pow(Deficit + MD->DummyY[i + 2 * MD->NumEle], 2));
 			MD->Recharge[i] = (MD->Recharge[i] > 0 && MD->DummyY[i + MD->NumEle] <= 0) ? 0 : MD->Recharge[i];
 			//? ? BHATT
 				MD->Recharge[i] = (MD->Recharge[i] < 0 && MD->DummyY[i + 2 * MD->NumEle] <= 0) ? 0 : MD->Recharge[i];
@@ -538,16 +579,16 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			DY[i + 2 * MD->NumEle] = DY[i + 2 * MD->NumEle] + MD->Recharge[i];
 		}
 		DY[i] = DY[i] + MD->EleNetPrep[i] - MD->EleViR[i] - ((MD->DummyY[i] < EPS / 100) ? 0 : MD->EleET[i][2]);
-		if (MD->DummyY[i + 2 * MD->NumEle] > AquiferDepth - MD->Ele[i].RzD) {
+		if (MD->DummyY[i + 2 * MD->NumEle] > AquiferDepth - MD->EleH.RzD[i]) {
 			DY[i + 2 * MD->NumEle] = DY[i + 2 * MD->NumEle] - MD->EleET[i][1];
 		} else {
 			DY[i + MD->NumEle] = DY[i + MD->NumEle] - MD->EleET[i][1];
 		}
 		//? ? if (DY[i + MD->NumEle] < 0 && MD->DummyY[i + MD->NumEle] < .002)
-			//printf("2 %d %lf %lf %lf %lf\n", MD->Ele[i].soil, MD->EleViR[i], MD->Recharge[i], MD->EleET[i][2], MD->EleET[i][1]);
+			//printf("2 %d %lf %lf %lf %lf\n", MD->EleH.soil[i], MD->EleViR[i], MD->Recharge[i], MD->EleET[i][2], MD->EleET[i][1]);
 		//? ? BHATT
 			// ? ? if (DY[i + 2 * MD->NumEle] < 0 && MD->DummyY[i + 2 * MD->NumEle] < .002) {
-			//printf("3 %d %lf %lf\n", MD->Ele[i].soil, MD->Recharge[i], MD->EleET[i][1]);
+			//printf("3 %d %lf %lf\n", MD->EleH.soil[i], MD->Recharge[i], MD->EleET[i][1]);
 			//getchar();
 		//} //? ? BHATT
 	}
@@ -555,6 +596,7 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 	 * * Lateral Flux Calculation between River-River and
 	 * River-Triangular * elements Follows
 	 */
+#pragma omp parallel for private(j, inabr, AquiferDepth, AvgCrossA, Avg_Ksat, Avg_Perem, Avg_Rough, Avg_Sf, Avg_Wid, Avg_Y_Riv, Avg_Y_Sub, CrossA, CrossAdown, Dif_Y_Riv, Dif_Y_Sub, Distance, Grad_Y_Riv, Grad_Y_Sub, Perem, Perem_down, TotalY_Ele, TotalY_Ele_down, TotalY_Riv, TotalY_Riv_down, Wid, Wid_down, effK, effKnabr, nabrAqDepth)
 	for (i = 0; i < MD->NumRiv; i++) {
 		TotalY_Riv = MD->DummyY[i + 3 * MD->NumEle] + MD->Riv[i].zmin;
 		Perem = CS_AreaOrPerem(MD->Riv_Shape[MD->Riv[i].shape - 1].interpOrd, MD->DummyY[i + 3 * MD->NumEle], MD->Riv[i].coeff, 2);
@@ -578,35 +620,30 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			AvgCrossA = 0.5 * (CrossA + CrossAdown);
 			Avg_Y_Riv = (Avg_Perem == 0) ? 0 : (AvgCrossA / Avg_Perem);
 			OverlandFlow(MD->FluxRiv, i, 1, Avg_Y_Riv, Grad_Y_Riv, Avg_Sf, CrossA, Avg_Rough);
-			/*
-			 * accumulate to get in-flow for down segments: [0]
-			 * for inflow, [1] for outflow
-			 */
-			MD->FluxRiv[MD->Riv[i].down - 1][0] = MD->FluxRiv[MD->Riv[i].down - 1][0] - MD->FluxRiv[i][1];
 			/************************************************************************/
 			/*
 			 * Lateral Flux Calculation between Element Beneath
 			 * River (EBR) and EBR
 			 */
 			/************************************************************************/
-			TotalY_Ele = MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv] + MD->Ele[i + MD->NumEle].zmin;
-			TotalY_Ele_down = MD->DummyY[MD->Riv[i].down - 1 + 3 * MD->NumEle + MD->NumRiv] + MD->Ele[MD->Riv[i].down - 1 + MD->NumEle].zmin;
+			TotalY_Ele = MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv] + MD->EleH.zmin[i + MD->NumEle];
+			TotalY_Ele_down = MD->DummyY[MD->Riv[i].down - 1 + 3 * MD->NumEle + MD->NumRiv] + MD->EleH.zmin[MD->Riv[i].down - 1 + MD->NumEle];
 			Wid = CS_AreaOrPerem(MD->Riv_Shape[MD->Riv[i].shape - 1].interpOrd, MD->Riv[i].depth, MD->Riv[i].coeff, 3);
 			Wid_down = CS_AreaOrPerem(MD->Riv_Shape[MD->Riv[MD->Riv[i].down - 1].shape - 1].interpOrd, MD->Riv[MD->Riv[i].down - 1].depth, MD->Riv[MD->Riv[i].down - 1].coeff, 3);
 			Avg_Wid = (Wid + Wid_down) / 2.0;
 			Distance = 0.5 * (MD->Riv[i].Length + MD->Riv[MD->Riv[i].down - 1].Length);
 			Dif_Y_Sub = TotalY_Ele - TotalY_Ele_down;
-			//Avg_Y_Sub = avgY(MD->Ele[i + MD->NumEle].zmin, MD->Ele[MD->Riv[i].down - 1 + MD->NumEle].zmin, MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv], MD->DummyY[MD->Riv[i].down - 1 + 3 * MD->NumEle + MD->NumRiv]);
+			//Avg_Y_Sub = avgY(MD->EleH.zmin[i + MD->NumEle], MD->EleH.zmin[MD->Riv[i].down - 1 + MD->NumEle], MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv], MD->DummyY[MD->Riv[i].down - 1 + 3 * MD->NumEle + MD->NumRiv]);
 			Avg_Y_Sub = avgY(Dif_Y_Sub, MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv], MD->DummyY[MD->Riv[i].down - 1 + 3 * MD->NumEle + MD->NumRiv]);
 			Grad_Y_Sub = Dif_Y_Sub / Distance;
 			/* take care of macropore effect */
-			AquiferDepth = MD->Ele[i + MD->NumEle].zmax - MD->Ele[i + MD->NumEle].zmin;
-			//effK = MD->Ele[i + MD->NumEle].KsatH;
-			effK = 0.5 * (effKH(MD->Ele[MD->Riv[i].LeftEle - 1].Macropore, MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle], MD->Ele[MD->Riv[i].LeftEle - 1].zmax - MD->Ele[MD->Riv[i].LeftEle - 1].zmin, MD->Ele[MD->Riv[i].LeftEle - 1].macD, MD->Ele[MD->Riv[i].LeftEle - 1].macKsatH, MD->Ele[MD->Riv[i].LeftEle - 1].vAreaF, MD->Ele[MD->Riv[i].LeftEle - 1].KsatH) + effKH(MD->Ele[MD->Riv[i].RightEle - 1].Macropore, MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle], MD->Ele[MD->Riv[i].RightEle - 1].zmax - MD->Ele[MD->Riv[i].RightEle - 1].zmin, MD->Ele[MD->Riv[i].RightEle - 1].macD, MD->Ele[MD->Riv[i].RightEle - 1].macKsatH, MD->Ele[MD->Riv[i].RightEle - 1].vAreaF, MD->Ele[MD->Riv[i].RightEle - 1].KsatH));
+			AquiferDepth = MD->EleH.zmax[i + MD->NumEle] - MD->EleH.zmin[i + MD->NumEle];
+			//effK = MD->EleH.KsatH[i + MD->NumEle];
+			effK = 0.5 * (effKH(MD->EleH.Macropore[MD->Riv[i].LeftEle - 1], MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle], MD->EleH.zmax[MD->Riv[i].LeftEle - 1] - MD->EleH.zmin[MD->Riv[i].LeftEle - 1], MD->EleH.macD[MD->Riv[i].LeftEle - 1], MD->EleH.macKsatH[MD->Riv[i].LeftEle - 1], MD->EleH.vAreaF[MD->Riv[i].LeftEle - 1], MD->EleH.KsatH[MD->Riv[i].LeftEle - 1]) + effKH(MD->EleH.Macropore[MD->Riv[i].RightEle - 1], MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle], MD->EleH.zmax[MD->Riv[i].RightEle - 1] - MD->EleH.zmin[MD->Riv[i].RightEle - 1], MD->EleH.macD[MD->Riv[i].RightEle - 1], MD->EleH.macKsatH[MD->Riv[i].RightEle - 1], MD->EleH.vAreaF[MD->Riv[i].RightEle - 1], MD->EleH.KsatH[MD->Riv[i].RightEle - 1]));
 			inabr = MD->Riv[i].down - 1;
-			nabrAqDepth = (MD->Ele[inabr].zmax - MD->Ele[inabr].zmin);
-			//effKnabr = MD->Ele[inabr + MD->NumEle].KsatH;
-			effKnabr = 0.5 * (effKH(MD->Ele[MD->Riv[inabr].LeftEle - 1].Macropore, MD->DummyY[MD->Riv[inabr].LeftEle - 1 + 2 * MD->NumEle], MD->Ele[MD->Riv[inabr].LeftEle - 1].zmax - MD->Ele[MD->Riv[inabr].LeftEle - 1].zmin, MD->Ele[MD->Riv[inabr].LeftEle - 1].macD, MD->Ele[MD->Riv[inabr].LeftEle - 1].macKsatH, MD->Ele[MD->Riv[inabr].LeftEle - 1].vAreaF, MD->Ele[MD->Riv[inabr].LeftEle - 1].KsatH) + effKH(MD->Ele[MD->Riv[inabr].RightEle - 1].Macropore, MD->DummyY[MD->Riv[inabr].RightEle - 1 + 2 * MD->NumEle], MD->Ele[MD->Riv[inabr].RightEle - 1].zmax - MD->Ele[MD->Riv[inabr].RightEle - 1].zmin, MD->Ele[MD->Riv[inabr].RightEle - 1].macD, MD->Ele[MD->Riv[inabr].RightEle - 1].macKsatH, MD->Ele[MD->Riv[inabr].RightEle - 1].vAreaF, MD->Ele[MD->Riv[inabr].RightEle - 1].KsatH));
+			nabrAqDepth = (MD->EleH.zmax[inabr] - MD->EleH.zmin[inabr]);
+			//effKnabr = MD->EleH.KsatH[inabr + MD->NumEle];
+			effKnabr = 0.5 * (effKH(MD->EleH.Macropore[MD->Riv[inabr].LeftEle - 1], MD->DummyY[MD->Riv[inabr].LeftEle - 1 + 2 * MD->NumEle], MD->EleH.zmax[MD->Riv[inabr].LeftEle - 1] - MD->EleH.zmin[MD->Riv[inabr].LeftEle - 1], MD->EleH.macD[MD->Riv[inabr].LeftEle - 1], MD->EleH.macKsatH[MD->Riv[inabr].LeftEle - 1], MD->EleH.vAreaF[MD->Riv[inabr].LeftEle - 1], MD->EleH.KsatH[MD->Riv[inabr].LeftEle - 1]) + effKH(MD->EleH.Macropore[MD->Riv[inabr].RightEle - 1], MD->DummyY[MD->Riv[inabr].RightEle - 1 + 2 * MD->NumEle], MD->EleH.zmax[MD->Riv[inabr].RightEle - 1] - MD->EleH.zmin[MD->Riv[inabr].RightEle - 1], MD->EleH.macD[MD->Riv[inabr].RightEle - 1], MD->EleH.macKsatH[MD->Riv[inabr].RightEle - 1], MD->EleH.vAreaF[MD->Riv[inabr].RightEle - 1], MD->EleH.KsatH[MD->Riv[inabr].RightEle - 1]));
 			Avg_Ksat = 0.5 * (effK + effKnabr);
 			/* groundwater flow modeled by Darcy's law */
 			MD->FluxRiv[i][9] = Avg_Ksat * Grad_Y_Sub * Avg_Y_Sub * Avg_Wid;
@@ -614,12 +651,11 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			 * accumulate to get in-flow for down segments: [10]
 			 * for inflow, [9] for outflow
 			 */
-			MD->FluxRiv[MD->Riv[i].down - 1][10] = MD->FluxRiv[MD->Riv[i].down - 1][10] - MD->FluxRiv[i][9];
 		} else {
 			switch (MD->Riv[i].down) {
 			case -1:
 				/* Dirichlet boundary condition */
-				TotalY_Riv_down = Interpolation(&MD->TSD_Riv[(MD->Riv[i].BC) - 1], t) + (MD->Node[MD->Riv[i].ToNode - 1].zmax - MD->Riv[i].depth);
+				TotalY_Riv_down = MD->ForcRiv[(MD->Riv[i].BC) - 1] + (MD->Node[MD->Riv[i].ToNode - 1].zmax - MD->Riv[i].depth);
 				Distance = sqrt(pow(MD->Riv[i].x - MD->Node[MD->Riv[i].ToNode - 1].x, 2) + pow(MD->Riv[i].y - MD->Node[MD->Riv[i].ToNode - 1].y, 2));
 				Grad_Y_Riv = (TotalY_Riv - TotalY_Riv_down) / Distance;
 				/*
@@ -628,7 +664,7 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 				 */
 				Avg_Sf = (MD->RivMode == 1) ? Grad_Y_Riv : Grad_Y_Riv;;
 				Avg_Rough = MD->Riv_Mat[MD->Riv[i].material - 1].Rough;
-				Avg_Y_Riv = avgY(Grad_Y_Riv, MD->DummyY[i + 3 * MD->NumEle], Interpolation(&MD->TSD_Riv[(MD->Riv[i].BC) - 1], t));
+				Avg_Y_Riv = avgY(Grad_Y_Riv, MD->DummyY[i + 3 * MD->NumEle], MD->ForcRiv[(MD->Riv[i].BC) - 1]);
 				Avg_Perem = Perem;
 				CrossA = CS_AreaOrPerem(MD->Riv_Shape[MD->Riv[i].shape - 1].interpOrd, MD->DummyY[i + 3 * MD->NumEle], MD->Riv[i].coeff, 1);
 				Avg_Y_Riv = (Perem == 0) ? 0 : (CrossA / Avg_Perem);
@@ -636,7 +672,7 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 				break;
 			case -2:
 				/* Neumann boundary condition */
-				MD->FluxRiv[i][1] = Interpolation(&MD->TSD_Riv[MD->Riv[i].BC - 1], t);
+				MD->FluxRiv[i][1] = MD->ForcRiv[MD->Riv[i].BC - 1];
 				break;
 			case -3:
 				/* zero-depth-gradient boundary conditions */
@@ -671,19 +707,19 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			 * River-Triangular element Follows
 			 */
 			/*****************************************************************************/
-			OLFeleToriv(MD->DummyY[MD->Riv[i].LeftEle - 1] + MD->Ele[MD->Riv[i].LeftEle - 1].zmax, MD->Ele[MD->Riv[i].LeftEle - 1].zmax, MD->Riv_Mat[MD->Riv[i].material - 1].Cwr, MD->Riv[i].zmax, TotalY_Riv, MD->FluxRiv, i, 2, MD->Riv[i].Length);
+			OLFeleToriv(MD->DummyY[MD->Riv[i].LeftEle - 1] + MD->EleH.zmax[MD->Riv[i].LeftEle - 1], MD->EleH.zmax[MD->Riv[i].LeftEle - 1], MD->Riv_Mat[MD->Riv[i].material - 1].Cwr, MD->Riv[i].zmax, TotalY_Riv, MD->FluxRiv, i, 2, MD->Riv[i].Length);
 			/*********************************************************************************/
 			/*
 			 * Lateral Sub-surface Flux Calculation between
 			 * River-Triangular element Follows
 			 */
 			/*********************************************************************************/
-			Dif_Y_Sub = (MD->DummyY[i + 3 * MD->NumEle] + MD->Riv[i].zmin) - (MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] + MD->Ele[MD->Riv[i].LeftEle - 1].zmin);
-			//Avg_Y_Sub = (MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] + MD->Ele[MD->Riv[i].LeftEle - 1].zmin - MD->Riv[i].zmin) > 0 ? MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] + MD->Ele[MD->Riv[i].LeftEle - 1].zmin - MD->Riv[i].zmin : 0;
+			Dif_Y_Sub = (MD->DummyY[i + 3 * MD->NumEle] + MD->Riv[i].zmin) - (MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] + MD->EleH.zmin[MD->Riv[i].LeftEle - 1]);
+			//Avg_Y_Sub = (MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] + MD->EleH.zmin[MD->Riv[i].LeftEle - 1] - MD->Riv[i].zmin) > 0 ? MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] + MD->EleH.zmin[MD->Riv[i].LeftEle - 1] - MD->Riv[i].zmin : 0;
 			/* This is head at river edge representation */
-			//Avg_Y_Sub = ((MD->Riv[i].zmax - (MD->Ele[MD->Riv[i].LeftEle - 1].zmax - MD->Ele[MD->Riv[i].LeftEle - 1].zmin) + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin) ? ((MD->Riv[i].zmax - (MD->Ele[MD->Riv[i].LeftEle - 1].zmax - MD->Ele[MD->Riv[i].LeftEle - 1].zmin) + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]) - MD->Riv[i].zmin) : 0;
+			//Avg_Y_Sub = ((MD->Riv[i].zmax - (MD->EleH.zmax[MD->Riv[i].LeftEle - 1] - MD->EleH.zmin[MD->Riv[i].LeftEle - 1]) + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin) ? ((MD->Riv[i].zmax - (MD->EleH.zmax[MD->Riv[i].LeftEle - 1] - MD->EleH.zmin[MD->Riv[i].LeftEle - 1]) + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]) - MD->Riv[i].zmin) : 0;
 			/* This is head in neighboring cell represention */
-			Avg_Y_Sub = MD->Ele[MD->Riv[i].LeftEle - 1].zmin > MD->Riv[i].zmin ? MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] : ((MD->Ele[MD->Riv[i].LeftEle - 1].zmin + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin ? (MD->Ele[MD->Riv[i].LeftEle - 1].zmin + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] - MD->Riv[i].zmin) : 0);
+			Avg_Y_Sub = MD->EleH.zmin[MD->Riv[i].LeftEle - 1] > MD->Riv[i].zmin ? MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] : ((MD->EleH.zmin[MD->Riv[i].LeftEle - 1] + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin ? (MD->EleH.zmin[MD->Riv[i].LeftEle - 1] + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] - MD->Riv[i].zmin) : 0);
 			//Avg_Y_Sub = avgY(MD->Riv[i].zmin, MD->Riv[i].zmin, MD->DummyY[i + 3 * MD->NumEle], Avg_Y_Sub);
 			Avg_Y_Sub = avgY(Dif_Y_Sub, MD->DummyY[i + 3 * MD->NumEle], Avg_Y_Sub);
 			effK = MD->Riv[i].KsatH;
@@ -691,8 +727,8 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			Grad_Y_Sub = Dif_Y_Sub / Distance;
 			/* take care of macropore effect */
 			inabr = MD->Riv[i].LeftEle - 1;
-			AquiferDepth = (MD->Ele[inabr].zmax - MD->Ele[inabr].zmin);
-			effKnabr = effKH(MD->Ele[inabr].Macropore, MD->DummyY[inabr + 2 * MD->NumEle], AquiferDepth, MD->Ele[inabr].macD, MD->Ele[inabr].macKsatH, MD->Ele[inabr].vAreaF, MD->Ele[inabr].KsatH);
+			AquiferDepth = (MD->EleH.zmax[inabr] - MD->EleH.zmin[inabr]);
+			effKnabr = effKH(MD->EleH.Macropore[inabr], MD->DummyY[inabr + 2 * MD->NumEle], AquiferDepth, MD->EleH.macD[inabr], MD->EleH.macKsatH[inabr], MD->EleH.vAreaF[inabr], MD->EleH.KsatH[inabr]);
 			Avg_Ksat = 0.5 * (effK + effKnabr);
 			MD->FluxRiv[i][4] = MD->Riv[i].Length * Avg_Ksat * Grad_Y_Sub * Avg_Y_Sub;
 			/***********************************************************************************/
@@ -701,20 +737,20 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			 * river) and triangular element
 			 */
 			/***********************************************************************************/
-			Dif_Y_Sub = (MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv] + MD->Ele[i + MD->NumEle].zmin) - (MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] + MD->Ele[MD->Riv[i].LeftEle - 1].zmin);
-			//Avg_Y_Sub = ((MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] + MD->Ele[MD->Riv[i].LeftEle - 1].zmin - MD->Riv[i].zmin) > 0) ? MD->Riv[i].zmin - MD->Ele[MD->Riv[i].LeftEle - 1].zmin : MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle];
+			Dif_Y_Sub = (MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv] + MD->EleH.zmin[i + MD->NumEle]) - (MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] + MD->EleH.zmin[MD->Riv[i].LeftEle - 1]);
+			//Avg_Y_Sub = ((MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle] + MD->EleH.zmin[MD->Riv[i].LeftEle - 1] - MD->Riv[i].zmin) > 0) ? MD->Riv[i].zmin - MD->EleH.zmin[MD->Riv[i].LeftEle - 1] : MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle];
 			/* This is head at river edge representation */
-			//Avg_Y_Sub = ((MD->Riv[i].zmax - (MD->Ele[MD->Riv[i].LeftEle - 1].zmax - MD->Ele[MD->Riv[i].LeftEle - 1].zmin) + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin) ? MD->Riv[i].zmin - (MD->Riv[i].zmax - (MD->Ele[MD->Riv[i].LeftEle - 1].zmax - MD->Ele[MD->Riv[i].LeftEle - 1].zmin)) : MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle];
+			//Avg_Y_Sub = ((MD->Riv[i].zmax - (MD->EleH.zmax[MD->Riv[i].LeftEle - 1] - MD->EleH.zmin[MD->Riv[i].LeftEle - 1]) + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin) ? MD->Riv[i].zmin - (MD->Riv[i].zmax - (MD->EleH.zmax[MD->Riv[i].LeftEle - 1] - MD->EleH.zmin[MD->Riv[i].LeftEle - 1])) : MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle];
 			/* This is head in neighboring cell represention */
-			Avg_Y_Sub = MD->Ele[MD->Riv[i].LeftEle - 1].zmin > MD->Riv[i].zmin ? 0 : ((MD->Ele[MD->Riv[i].LeftEle - 1].zmin + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin ? (MD->Riv[i].zmin - MD->Ele[MD->Riv[i].LeftEle - 1].zmin) : MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]);
-			//Avg_Y_Sub = avgY(MD->Ele[i + MD->NumEle].zmin, MD->Ele[MD->Riv[i].LeftEle - 1].zmin, MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv], Avg_Y_Sub);
+			Avg_Y_Sub = MD->EleH.zmin[MD->Riv[i].LeftEle - 1] > MD->Riv[i].zmin ? 0 : ((MD->EleH.zmin[MD->Riv[i].LeftEle - 1] + MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin ? (MD->Riv[i].zmin - MD->EleH.zmin[MD->Riv[i].LeftEle - 1]) : MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle]);
+			//Avg_Y_Sub = avgY(MD->EleH.zmin[i + MD->NumEle], MD->EleH.zmin[MD->Riv[i].LeftEle - 1], MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv], Avg_Y_Sub);
 			Avg_Y_Sub = avgY(Dif_Y_Sub, MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv], Avg_Y_Sub);
-			AquiferDepth = (MD->Ele[i + MD->NumEle].zmax - MD->Ele[i + MD->NumEle].zmin);
-			//effK = MD->Ele[i + MD->NumEle].KsatH;
-			effK = 0.5 * (effKH(MD->Ele[MD->Riv[i].LeftEle - 1].Macropore, MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle], MD->Ele[MD->Riv[i].LeftEle - 1].zmax - MD->Ele[MD->Riv[i].LeftEle - 1].zmin, MD->Ele[MD->Riv[i].LeftEle - 1].macD, MD->Ele[MD->Riv[i].LeftEle - 1].macKsatH, MD->Ele[MD->Riv[i].LeftEle - 1].vAreaF, MD->Ele[MD->Riv[i].LeftEle - 1].KsatH) + effKH(MD->Ele[MD->Riv[i].RightEle - 1].Macropore, MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle], MD->Ele[MD->Riv[i].RightEle - 1].zmax - MD->Ele[MD->Riv[i].RightEle - 1].zmin, MD->Ele[MD->Riv[i].RightEle - 1].macD, MD->Ele[MD->Riv[i].RightEle - 1].macKsatH, MD->Ele[MD->Riv[i].RightEle - 1].vAreaF, MD->Ele[MD->Riv[i].RightEle - 1].KsatH));
+			AquiferDepth = (MD->EleH.zmax[i + MD->NumEle] - MD->EleH.zmin[i + MD->NumEle]);
+			//effK = MD->EleH.KsatH[i + MD->NumEle];
+			effK = 0.5 * (effKH(MD->EleH.Macropore[MD->Riv[i].LeftEle - 1], MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle], MD->EleH.zmax[MD->Riv[i].LeftEle - 1] - MD->EleH.zmin[MD->Riv[i].LeftEle - 1], MD->EleH.macD[MD->Riv[i].LeftEle - 1], MD->EleH.macKsatH[MD->Riv[i].LeftEle - 1], MD->EleH.vAreaF[MD->Riv[i].LeftEle - 1], MD->EleH.KsatH[MD->Riv[i].LeftEle - 1]) + effKH(MD->EleH.Macropore[MD->Riv[i].RightEle - 1], MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle], MD->EleH.zmax[MD->Riv[i].RightEle - 1] - MD->EleH.zmin[MD->Riv[i].RightEle - 1], MD->EleH.macD[MD->Riv[i].RightEle - 1], MD->EleH.macKsatH[MD->Riv[i].RightEle - 1], MD->EleH.vAreaF[MD->Riv[i].RightEle - 1], MD->EleH.KsatH[MD->Riv[i].RightEle - 1]));
 			inabr = MD->Riv[i].LeftEle - 1;
-			nabrAqDepth = (MD->Ele[inabr].zmax - MD->Ele[inabr].zmin);
-			effKnabr = effKH(MD->Ele[inabr].Macropore, MD->DummyY[inabr + 2 * MD->NumEle], nabrAqDepth, MD->Ele[inabr].macD, MD->Ele[inabr].macKsatH, MD->Ele[inabr].vAreaF, MD->Ele[inabr].KsatH);
+			nabrAqDepth = (MD->EleH.zmax[inabr] - MD->EleH.zmin[inabr]);
+			effKnabr = effKH(MD->EleH.Macropore[inabr], MD->DummyY[inabr + 2 * MD->NumEle], nabrAqDepth, MD->EleH.macD[inabr], MD->EleH.macKsatH[inabr], MD->EleH.vAreaF[inabr], MD->EleH.KsatH[inabr]);
 			Avg_Ksat = 0.5 * (effK + effKnabr);
 			Grad_Y_Sub = Dif_Y_Sub / Distance;	/* take care of
 								 * macropore effect */
@@ -736,19 +772,19 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			 * River-Triangular element Follows
 			 */
 			/*****************************************************************************/
-			OLFeleToriv(MD->DummyY[MD->Riv[i].RightEle - 1] + MD->Ele[MD->Riv[i].RightEle - 1].zmax, MD->Ele[MD->Riv[i].RightEle - 1].zmax, MD->Riv_Mat[MD->Riv[i].material - 1].Cwr, MD->Riv[i].zmax, TotalY_Riv, MD->FluxRiv, i, 3, MD->Riv[i].Length);
+			OLFeleToriv(MD->DummyY[MD->Riv[i].RightEle - 1] + MD->EleH.zmax[MD->Riv[i].RightEle - 1], MD->EleH.zmax[MD->Riv[i].RightEle - 1], MD->Riv_Mat[MD->Riv[i].material - 1].Cwr, MD->Riv[i].zmax, TotalY_Riv, MD->FluxRiv, i, 3, MD->Riv[i].Length);
 			/*********************************************************************************/
 			/*
 			 * Lateral Sub-surface Flux Calculation between
 			 * River-Triangular element Follows
 			 */
 			/*********************************************************************************/
-			Dif_Y_Sub = (MD->DummyY[i + 3 * MD->NumEle] + MD->Riv[i].zmin) - (MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] + MD->Ele[MD->Riv[i].RightEle - 1].zmin);
-			//Avg_Y_Sub = (MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] + MD->Ele[MD->Riv[i].RightEle - 1].zmin - MD->Riv[i].zmin > 0) ? MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] + MD->Ele[MD->Riv[i].RightEle - 1].zmin - MD->Riv[i].zmin : 0;
+			Dif_Y_Sub = (MD->DummyY[i + 3 * MD->NumEle] + MD->Riv[i].zmin) - (MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] + MD->EleH.zmin[MD->Riv[i].RightEle - 1]);
+			//Avg_Y_Sub = (MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] + MD->EleH.zmin[MD->Riv[i].RightEle - 1] - MD->Riv[i].zmin > 0) ? MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] + MD->EleH.zmin[MD->Riv[i].RightEle - 1] - MD->Riv[i].zmin : 0;
 			/* This is head at river edge representation */
-			//Avg_Y_Sub = ((MD->Riv[i].zmax - (MD->Ele[MD->Riv[i].RightEle - 1].zmax - MD->Ele[MD->Riv[i].RightEle - 1].zmin) + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin) ? ((MD->Riv[i].zmax - (MD->Ele[MD->Riv[i].RightEle - 1].zmax - MD->Ele[MD->Riv[i].RightEle - 1].zmin) + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]) - MD->Riv[i].zmin) : 0;
+			//Avg_Y_Sub = ((MD->Riv[i].zmax - (MD->EleH.zmax[MD->Riv[i].RightEle - 1] - MD->EleH.zmin[MD->Riv[i].RightEle - 1]) + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin) ? ((MD->Riv[i].zmax - (MD->EleH.zmax[MD->Riv[i].RightEle - 1] - MD->EleH.zmin[MD->Riv[i].RightEle - 1]) + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]) - MD->Riv[i].zmin) : 0;
 			/* This is head in neighboring cell represention */
-			Avg_Y_Sub = MD->Ele[MD->Riv[i].RightEle - 1].zmin > MD->Riv[i].zmin ? MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] : ((MD->Ele[MD->Riv[i].RightEle - 1].zmin + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin ? (MD->Ele[MD->Riv[i].RightEle - 1].zmin + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] - MD->Riv[i].zmin) : 0);
+			Avg_Y_Sub = MD->EleH.zmin[MD->Riv[i].RightEle - 1] > MD->Riv[i].zmin ? MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] : ((MD->EleH.zmin[MD->Riv[i].RightEle - 1] + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin ? (MD->EleH.zmin[MD->Riv[i].RightEle - 1] + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] - MD->Riv[i].zmin) : 0);
 			//Avg_Y_Sub = avgY(MD->Riv[i].zmin, MD->Riv[i].zmin, MD->DummyY[i + 3 * MD->NumEle], Avg_Y_Sub);
 			Avg_Y_Sub = avgY(Dif_Y_Sub, MD->DummyY[i + 3 * MD->NumEle], Avg_Y_Sub);
 			effK = MD->Riv[i].KsatH;
@@ -756,8 +792,8 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			Grad_Y_Sub = Dif_Y_Sub / Distance;
 			/* take care of macropore effect */
 			inabr = MD->Riv[i].RightEle - 1;
-			AquiferDepth = (MD->Ele[inabr].zmax - MD->Ele[inabr].zmin);
-			effKnabr = effKH(MD->Ele[inabr].Macropore, MD->DummyY[inabr + 2 * MD->NumEle], AquiferDepth, MD->Ele[inabr].macD, MD->Ele[inabr].macKsatH, MD->Ele[inabr].vAreaF, MD->Ele[inabr].KsatH);
+			AquiferDepth = (MD->EleH.zmax[inabr] - MD->EleH.zmin[inabr]);
+			effKnabr = effKH(MD->EleH.Macropore[inabr], MD->DummyY[inabr + 2 * MD->NumEle], AquiferDepth, MD->EleH.macD[inabr], MD->EleH.macKsatH[inabr], MD->EleH.vAreaF[inabr], MD->EleH.KsatH[inabr]);
 			Avg_Ksat = 0.5 * (effK + effKnabr);
 			MD->FluxRiv[i][5] = MD->Riv[i].Length * Avg_Ksat * Grad_Y_Sub * Avg_Y_Sub;
 			/***********************************************************************************/
@@ -766,20 +802,20 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			 * river) and triangular element
 			 */
 			/***********************************************************************************/
-			Dif_Y_Sub = (MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv] + MD->Ele[i + MD->NumEle].zmin) - (MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] + MD->Ele[MD->Riv[i].RightEle - 1].zmin);
-			//Avg_Y_Sub = ((MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] + MD->Ele[MD->Riv[i].RightEle - 1].zmin - MD->Riv[i].zmin) > 0) ? MD->Riv[i].zmin - MD->Ele[MD->Riv[i].RightEle - 1].zmin : MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle];
+			Dif_Y_Sub = (MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv] + MD->EleH.zmin[i + MD->NumEle]) - (MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] + MD->EleH.zmin[MD->Riv[i].RightEle - 1]);
+			//Avg_Y_Sub = ((MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle] + MD->EleH.zmin[MD->Riv[i].RightEle - 1] - MD->Riv[i].zmin) > 0) ? MD->Riv[i].zmin - MD->EleH.zmin[MD->Riv[i].RightEle - 1] : MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle];
 			/* This is head at river edge representation */
-			//Avg_Y_Sub = ((MD->Riv[i].zmax - (MD->Ele[MD->Riv[i].RightEle - 1].zmax - MD->Ele[MD->Riv[i].RightEle - 1].zmin) + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin) ? MD->Riv[i].zmin - (MD->Riv[i].zmax - (MD->Ele[MD->Riv[i].RightEle - 1].zmax - MD->Ele[MD->Riv[i].RightEle - 1].zmin)) : MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle];
+			//Avg_Y_Sub = ((MD->Riv[i].zmax - (MD->EleH.zmax[MD->Riv[i].RightEle - 1] - MD->EleH.zmin[MD->Riv[i].RightEle - 1]) + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin) ? MD->Riv[i].zmin - (MD->Riv[i].zmax - (MD->EleH.zmax[MD->Riv[i].RightEle - 1] - MD->EleH.zmin[MD->Riv[i].RightEle - 1])) : MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle];
 			/* This is head in neighboring cell represention */
-			Avg_Y_Sub = MD->Ele[MD->Riv[i].RightEle - 1].zmin > MD->Riv[i].zmin ? 0 : ((MD->Ele[MD->Riv[i].RightEle - 1].zmin + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin ? (MD->Riv[i].zmin - MD->Ele[MD->Riv[i].RightEle - 1].zmin) : MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]);
-			//Avg_Y_Sub = avgY(MD->Ele[i + MD->NumEle].zmin, MD->Ele[MD->Riv[i].RightEle - 1].zmin, MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv], Avg_Y_Sub);
+			Avg_Y_Sub = MD->EleH.zmin[MD->Riv[i].RightEle - 1] > MD->Riv[i].zmin ? 0 : ((MD->EleH.zmin[MD->Riv[i].RightEle - 1] + MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]) > MD->Riv[i].zmin ? (MD->Riv[i].zmin - MD->EleH.zmin[MD->Riv[i].RightEle - 1]) : MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle]);
+			//Avg_Y_Sub = avgY(MD->EleH.zmin[i + MD->NumEle], MD->EleH.zmin[MD->Riv[i].RightEle - 1], MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv], Avg_Y_Sub);
 			Avg_Y_Sub = avgY(Dif_Y_Sub, MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv], Avg_Y_Sub);
-			AquiferDepth = (MD->Ele[i + MD->NumEle].zmax - MD->Ele[i + MD->NumEle].zmin);
-			//effK = MD->Ele[i + MD->NumEle].KsatH;
-			effK = 0.5 * (effKH(MD->Ele[MD->Riv[i].LeftEle - 1].Macropore, MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle], MD->Ele[MD->Riv[i].LeftEle - 1].zmax - MD->Ele[MD->Riv[i].LeftEle - 1].zmin, MD->Ele[MD->Riv[i].LeftEle - 1].macD, MD->Ele[MD->Riv[i].LeftEle - 1].macKsatH, MD->Ele[MD->Riv[i].LeftEle - 1].vAreaF, MD->Ele[MD->Riv[i].LeftEle - 1].KsatH) + effKH(MD->Ele[MD->Riv[i].RightEle - 1].Macropore, MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle], MD->Ele[MD->Riv[i].RightEle - 1].zmax - MD->Ele[MD->Riv[i].RightEle - 1].zmin, MD->Ele[MD->Riv[i].RightEle - 1].macD, MD->Ele[MD->Riv[i].RightEle - 1].macKsatH, MD->Ele[MD->Riv[i].RightEle - 1].vAreaF, MD->Ele[MD->Riv[i].RightEle - 1].KsatH));
+			AquiferDepth = (MD->EleH.zmax[i + MD->NumEle] - MD->EleH.zmin[i + MD->NumEle]);
+			//effK = MD->EleH.KsatH[i + MD->NumEle];
+			effK = 0.5 * (effKH(MD->EleH.Macropore[MD->Riv[i].LeftEle - 1], MD->DummyY[MD->Riv[i].LeftEle - 1 + 2 * MD->NumEle], MD->EleH.zmax[MD->Riv[i].LeftEle - 1] - MD->EleH.zmin[MD->Riv[i].LeftEle - 1], MD->EleH.macD[MD->Riv[i].LeftEle - 1], MD->EleH.macKsatH[MD->Riv[i].LeftEle - 1], MD->EleH.vAreaF[MD->Riv[i].LeftEle - 1], MD->EleH.KsatH[MD->Riv[i].LeftEle - 1]) + effKH(MD->EleH.Macropore[MD->Riv[i].RightEle - 1], MD->DummyY[MD->Riv[i].RightEle - 1 + 2 * MD->NumEle], MD->EleH.zmax[MD->Riv[i].RightEle - 1] - MD->EleH.zmin[MD->Riv[i].RightEle - 1], MD->EleH.macD[MD->Riv[i].RightEle - 1], MD->EleH.macKsatH[MD->Riv[i].RightEle - 1], MD->EleH.vAreaF[MD->Riv[i].RightEle - 1], MD->EleH.KsatH[MD->Riv[i].RightEle - 1]));
 			inabr = MD->Riv[i].RightEle - 1;
-			nabrAqDepth = (MD->Ele[inabr].zmax - MD->Ele[inabr].zmin);
-			effKnabr = effKH(MD->Ele[inabr].Macropore, MD->DummyY[inabr + 2 * MD->NumEle], nabrAqDepth, MD->Ele[inabr].macD, MD->Ele[inabr].macKsatH, MD->Ele[inabr].vAreaF, MD->Ele[inabr].KsatH);
+			nabrAqDepth = (MD->EleH.zmax[inabr] - MD->EleH.zmin[inabr]);
+			effKnabr = effKH(MD->EleH.Macropore[inabr], MD->DummyY[inabr + 2 * MD->NumEle], nabrAqDepth, MD->EleH.macD[inabr], MD->EleH.macKsatH[inabr], MD->EleH.vAreaF[inabr], MD->EleH.KsatH[inabr]);
 			Avg_Ksat = 0.5 * (effK + effKnabr);
 			Grad_Y_Sub = Dif_Y_Sub / Distance;	/* take care of
 								 * macropore effect */
@@ -795,19 +831,37 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 			}
 		}
 		Avg_Wid = CS_AreaOrPerem(MD->Riv_Shape[MD->Riv[i].shape - 1].interpOrd, MD->DummyY[i + 3 * MD->NumEle], MD->Riv[i].coeff, 3);
-		Dif_Y_Riv = (MD->Riv[i].zmin - (MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv] + MD->Ele[i + MD->NumEle].zmin)) > 0 ? MD->DummyY[i + 3 * MD->NumEle] : MD->DummyY[i + 3 * MD->NumEle] + MD->Riv[i].zmin - (MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv] + MD->Ele[i + MD->NumEle].zmin);
+		Dif_Y_Riv = (MD->Riv[i].zmin - (MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv] + MD->EleH.zmin[i + MD->NumEle])) > 0 ? MD->DummyY[i + 3 * MD->NumEle] : MD->DummyY[i + 3 * MD->NumEle] + MD->Riv[i].zmin - (MD->DummyY[i + 3 * MD->NumEle + MD->NumRiv] + MD->EleH.zmin[i + MD->NumEle]);
 		Grad_Y_Riv = Dif_Y_Riv / MD->Riv[i].bedThick;
 		MD->FluxRiv[i][6] = MD->Riv[i].KsatV * Avg_Wid * MD->Riv[i].Length * Grad_Y_Riv;
 	}
+	/*
+	 * in-flow from up stream segments ([0] from [1], [10] from [9]) is
+	 * gathered by the receiving segment in increasing upstream index
+	 */
+#pragma omp parallel for private(j)
+	for (i = 0; i < MD->NumRiv; i++) {
+		MD->FluxRiv[i][0] = 0;
+		MD->FluxRiv[i][10] = 0;
+		for (j = 0; j < MD->Riv[i].NumUp; j++) {
+			MD->FluxRiv[i][0] = MD->FluxRiv[i][0] - MD->FluxRiv[MD->Riv[i].up[j]][1];
+			MD->FluxRiv[i][10] = MD->FluxRiv[i][10] - MD->FluxRiv[MD->Riv[i].up[j]][9];
+		}
+	}
+	if (full == 0) {
+		return 0;
+	}
+#pragma omp parallel for private(j)
 	for (i = 0; i < MD->NumEle; i++) {
 		for (j = 0; j < 3; j++) {
-			DY[i] = DY[i] - MD->FluxSurf[i][j] / MD->Ele[i].area;
-			DY[i + 2 * MD->NumEle] = DY[i + 2 * MD->NumEle] - MD->FluxSub[i][j] / MD->Ele[i].area;
+			DY[i] = DY[i] - MD->FluxSurf[i][j] / MD->EleH.area[i];
+			DY[i + 2 * MD->NumEle] = DY[i + 2 * MD->NumEle] - MD->FluxSub[i][j] / MD->EleH.area[i];
 		}
-		DY[i + MD->NumEle] = DY[i + MD->NumEle] / (MD->Ele[i].Porosity * UNIT_C);
-		DY[i + 2 * MD->NumEle] = DY[i + 2 * MD->NumEle] / (MD->Ele[i].Porosity * UNIT_C);
+		DY[i + MD->NumEle] = DY[i + MD->NumEle] / (MD->EleH.Porosity[i] * UNIT_C);
+		DY[i + 2 * MD->NumEle] = DY[i + 2 * MD->NumEle] / (MD->EleH.Porosity[i] * UNIT_C);
 		DY[i] = DY[i] / (UNIT_C);
 	}
+#pragma omp parallel for private(j)
 	for (i = 0; i < MD->NumRiv; i++) {
 		for (j = 0; j <= 6; j++) {
 			/*
@@ -818,30 +872,43 @@ f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
 		}
 		DY[i + 3 * MD->NumEle] = DY[i + 3 * MD->NumEle] / (UNIT_C);
 		DY[i + 3 * MD->NumEle + MD->NumRiv] = DY[i + 3 * MD->NumEle + MD->NumRiv] - MD->FluxRiv[i][7] - MD->FluxRiv[i][8] - MD->FluxRiv[i][9] - MD->FluxRiv[i][10] + MD->FluxRiv[i][6];
-		DY[i + 3 * MD->NumEle + MD->NumRiv] = DY[i + 3 * MD->NumEle + MD->NumRiv] / (MD->Ele[i + MD->NumEle].Porosity * MD->Riv[i].Length * CS_AreaOrPerem(MD->Riv_Shape[MD->Riv[i].shape - 1].interpOrd, MD->Riv[i].depth, MD->Riv[i].coeff, 3) * UNIT_C);
+		DY[i + 3 * MD->NumEle + MD->NumRiv] = DY[i + 3 * MD->NumEle + MD->NumRiv] / (MD->EleH.Porosity[i + MD->NumEle] * MD->Riv[i].Length * CS_AreaOrPerem(MD->Riv_Shape[MD->Riv[i].shape - 1].interpOrd, MD->Riv[i].depth, MD->Riv[i].coeff, 3) * UNIT_C);
 	}
 
 	return 0;
 }
 
+int
+f(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
+{
+	return Rhs(t, CV_Y, CV_Ydot, DS, 1);
+}
+
+/* Fluxes printed at an output time: replaces a call of f() before PrintData */
+void
+OutputFluxes(realtype t, N_Vector CV_Y, N_Vector CV_Ydot, void *DS)
+{
+	Rhs(t, CV_Y, CV_Ydot, DS, 0);
+}
+
 realtype
 Interpolation(TSD * Data, realtype t)
 {
-	int             i, success;
+	int             i, k, success;
 	realtype        result;
-	i = Data->iCounter;
 	success = 0;
 	t = t / (UNIT_C);
-	while (i < Data->length && t > Data->TS[i][0]) {
-		i++;
-	}
+	/* moves the cursor: call from serial code only */
+	i = TSDSeek(Data, t);
+	/* records held from Data->first on */
+	k = i - Data->first;
 	if (i == 0) {
 		/* t is smaller than the 1st node */
-		result = Data->TS[i][1];
+		result = Data->value[k];
 	} else if (i >= Data->length) {
-		result = Data->TS[i - 1][1];
+		result = Data->value[k - 1];
 	} else {
-		result = ((Data->TS[i][0] - t) * Data->TS[i - 1][1] + (t - Data->TS[i - 1][0]) * Data->TS[i][1]) / (Data->TS[i][0] - Data->TS[i - 1][0]);
+		result = ((Data->time[k] - t) * Data->value[k - 1] + (t - Data->time[k - 1]) * Data->value[k]) / (Data->time[k] - Data->time[k - 1]);
 		success = 1;
 	}
 	if (success == 0) {
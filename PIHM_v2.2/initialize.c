@@ -30,6 +30,8 @@
 #include "nvector_serial.h"
 #include "pihm.h"
 
+void            RegisterTSD(Model_Data, TSD *, int, realtype *);
+void            TSDScale(TSD *, realtype);
 
 void
 initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
@@ -63,6 +65,32 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 	DS->EleTF = (realtype *) malloc(DS->NumEle * sizeof(realtype));
 	DS->EleETloss = (realtype *) malloc(DS->NumEle * sizeof(realtype));
 	DS->EleNetPrep = (realtype *) malloc(DS->NumEle * sizeof(realtype));
+	DS->ForcPrep = (realtype *) malloc(DS->NumPrep * sizeof(realtype));
+	DS->ForcTemp = (realtype *) malloc(DS->NumTemp * sizeof(realtype));
+	DS->ForcHumidity = (realtype *) malloc(DS->NumHumidity * sizeof(realtype));
+	DS->ForcWindVel = (realtype *) malloc(DS->NumWindVel * sizeof(realtype));
+	DS->ForcRn = (realtype *) malloc(DS->NumRn * sizeof(realtype));
+	DS->ForcLAI = (realtype *) malloc(DS->NumLC * sizeof(realtype));
+	DS->ForcRL = (realtype *) malloc(DS->NumLC * sizeof(realtype));
+	DS->ForcMeltF = (realtype *) malloc(DS->NumMeltF * sizeof(realtype));
+	DS->ForcEleBC = (realtype *) malloc((DS->Num1BC + DS->Num2BC) * sizeof(realtype));
+	DS->ForcRiv = (realtype *) malloc(DS->NumRivBC * sizeof(realtype));
+	DS->ForcValid = 0;
+	DS->NumFam = 0;
+	DS->Fam = NULL;
+	RegisterTSD(DS, DS->TSD_Prep, DS->NumPrep, DS->ForcPrep);
+	RegisterTSD(DS, DS->TSD_Temp, DS->NumTemp, DS->ForcTemp);
+	RegisterTSD(DS, DS->TSD_Humidity, DS->NumHumidity, DS->ForcHumidity);
+	RegisterTSD(DS, DS->TSD_WindVel, DS->NumWindVel, DS->ForcWindVel);
+	RegisterTSD(DS, DS->TSD_Rn, DS->NumRn, DS->ForcRn);
+	RegisterTSD(DS, DS->TSD_G, DS->NumG, NULL);
+	RegisterTSD(DS, DS->TSD_Pressure, DS->NumP, NULL);
+	RegisterTSD(DS, DS->TSD_LAI, DS->NumLC, DS->ForcLAI);
+	RegisterTSD(DS, DS->TSD_RL, DS->NumLC, DS->ForcRL);
+	RegisterTSD(DS, DS->TSD_MeltF, DS->NumMeltF, DS->ForcMeltF);
+	RegisterTSD(DS, DS->TSD_Source, DS->NumSource, NULL);
+	RegisterTSD(DS, DS->TSD_EleBC, DS->Num1BC + DS->Num2BC, DS->ForcEleBC);
+	RegisterTSD(DS, DS->TSD_Riv, DS->NumRivBC, DS->ForcRiv);
 
 
 	for(i=0;i<DS->NumSoil;i++)
@@ -91,9 +119,9 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 		b_zmax = DS->Node[DS->Ele[i].node[1] - 1].zmax;
 		c_zmax = DS->Node[DS->Ele[i].node[2] - 1].zmax;
 
-		DS->Ele[i].area = 0.5 * ((b_x - a_x) * (c_y - a_y) - (b_y - a_y) * (c_x - a_x));
-		DS->Ele[i].zmax = (a_zmax + b_zmax + c_zmax) / 3.0;
-		DS->Ele[i].zmin = (a_zmin + b_zmin + c_zmin) / 3.0;
+		DS->EleH.area[i] = 0.5 * ((b_x - a_x) * (c_y - a_y) - (b_y - a_y) * (c_x - a_x));
+		DS->EleH.zmax[i] = (a_zmax + b_zmax + c_zmax) / 3.0;
+		DS->EleH.zmin[i] = (a_zmin + b_zmin + c_zmin) / 3.0;
 		DS->Ele[i].edge[0] = pow((b_x - c_x), 2) + pow((b_y - c_y), 2);
 		DS->Ele[i].edge[1] = pow((c_x - a_x), 2) + pow((c_y - a_y), 2);
 		DS->Ele[i].edge[2] = pow((a_x - b_x), 2) + pow((a_y - b_y), 2);
@@ -106,58 +134,58 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 		/* calculate circumcenter of triangle */
 		/*
 		 * DS->Ele[i].x = a_x - ((b_y - a_y)*DS->Ele[i].edge[2] -
-		 * (c_y - a_y)*DS->Ele[i].edge[0])/(4*DS->Ele[i].area);
+		 * (c_y - a_y)*DS->Ele[i].edge[0])/(4*DS->EleH.area[i]);
 		 * DS->Ele[i].y = a_y + ((b_x - a_x)*DS->Ele[i].edge[2] -
-		 * (c_x - a_x)*DS->Ele[i].edge[0])/(4*DS->Ele[i].area);
+		 * (c_x - a_x)*DS->Ele[i].edge[0])/(4*DS->EleH.area[i]);
 		 */
 		DS->Ele[i].edge[0] = sqrt(DS->Ele[i].edge[0]);
 		DS->Ele[i].edge[1] = sqrt(DS->Ele[i].edge[1]);
 		DS->Ele[i].edge[2] = sqrt(DS->Ele[i].edge[2]);
-		DS->Ele[i].KsatH = CS->Cal.KsatH * DS->Geol[(DS->Ele[i].geol - 1)].KsatH;
-		DS->Ele[i].KsatV = CS->Cal.KsatV * DS->Geol[(DS->Ele[i].geol - 1)].KsatV;
-		DS->Ele[i].infKsatV = CS->Cal.infKsatV * DS->Soil[(DS->Ele[i].soil - 1)].KsatV;
-		//? ? THIS IS ORIG DS->Ele[i].Porosity = CS->Cal.Porosity * (DS->Soil[(DS->Ele[i].soil - 1)].ThetaS - DS->Soil[(DS->Ele[i].soil - 1)].ThetaR);
-		DS->Ele[i].Porosity = (DS->Soil[(DS->Ele[i].soil - 1)].ThetaS - DS->Soil[(DS->Ele[i].soil - 1)].ThetaR);
+		DS->EleH.KsatH[i] = CS->Cal.KsatH * DS->Geol[(DS->Ele[i].geol - 1)].KsatH;
+		DS->EleH.KsatV[i] = CS->Cal.KsatV * DS->Geol[(DS->Ele[i].geol - 1)].KsatV;
+		DS->EleH.infKsatV[i] = CS->Cal.infKsatV * DS->Soil[(DS->EleH.soil[i] - 1)].KsatV;
+		//? ? THIS IS ORIG DS->EleH.Porosity[i] = CS->Cal.Porosity * (DS->Soil[(DS->EleH.soil[i] - 1)].ThetaS - DS->Soil[(DS->EleH.soil[i] - 1)].ThetaR);
+		DS->EleH.Porosity[i] = (DS->Soil[(DS->EleH.soil[i] - 1)].ThetaS - DS->Soil[(DS->EleH.soil[i] - 1)].ThetaR);
 		
 		/*
 		 * Note above porosity statement should be replaced by
 		 * geologic porosity (in comments below) if the data is
 		 * available
 		 */
-			// DS->Ele[i].Porosity = CS->Cal.Porosity * (DS->Geol[(DS->Ele[i].geol - 1)].ThetaS - DS->Geol[(DS->Ele[i].geol - 1)].ThetaR);
-		if ((DS->Ele[i].Porosity > 1) && (DS->Ele[i].Porosity == 0)) {
+			// DS->EleH.Porosity[i] = CS->Cal.Porosity * (DS->Geol[(DS->Ele[i].geol - 1)].ThetaS - DS->Geol[(DS->Ele[i].geol - 1)].ThetaR);
+		if ((DS->EleH.Porosity[i] > 1) && (DS->EleH.Porosity[i] == 0)) {
 			printf("Warning: Porosity value out of bounds");
 			getchar();
 		}
-		DS->Ele[i].Alpha = CS->Cal.Alpha * DS->Soil[(DS->Ele[i].soil - 1)].Alpha;
-		DS->Ele[i].Beta = CS->Cal.Beta * DS->Soil[(DS->Ele[i].soil - 1)].Beta;
+		DS->EleH.Alpha[i] = CS->Cal.Alpha * DS->Soil[(DS->EleH.soil[i] - 1)].Alpha;
+		DS->EleH.Beta[i] = CS->Cal.Beta * DS->Soil[(DS->EleH.soil[i] - 1)].Beta;
 		/*
 		 * Note above van genuchten statement should be replaced by
 		 * geologic parameters (in comments below) if the data is
 		 * available
 		 */
-		//DS->Ele[i].Alpha = CS->Cal.Alpha * DS->Geol[(DS->Ele[i].geol - 1)].Alpha;
-		//DS->Ele[i].Beta = CS->Cal.Beta * DS->Geol[(DS->Ele[i].geol - 1)].Beta;
-		DS->Ele[i].hAreaF = CS->Cal.hAreaF * DS->Soil[(DS->Ele[i].soil - 1)].hAreaF;
-		DS->Ele[i].vAreaF = CS->Cal.vAreaF * DS->Geol[(DS->Ele[i].geol - 1)].vAreaF;
-		DS->Ele[i].macKsatV = CS->Cal.macKsatV * DS->Soil[(DS->Ele[i].soil - 1)].macKsatV;
-		DS->Ele[i].macKsatH = CS->Cal.macKsatH * DS->Geol[(DS->Ele[i].geol - 1)].macKsatH;
-		DS->Ele[i].macD = CS->Cal.macD * DS->Geol[DS->Ele[i].geol - 1].macD;
-		DS->Ele[i].infD = CS->Cal.infD * DS->Soil[DS->Ele[i].soil - 1].infD;
+		//DS->EleH.Alpha[i] = CS->Cal.Alpha * DS->Geol[(DS->Ele[i].geol - 1)].Alpha;
+		//DS->EleH.Beta[i] = CS->Cal.Beta * DS->Geol[(DS->Ele[i].geol - 1)].Beta;
+		DS->EleH.hAreaF[i] = CS->Cal.hAreaF * DS->Soil[(DS->EleH.soil[i] - 1)].hAreaF;
+		DS->EleH.vAreaF[i] = CS->Cal.vAreaF * DS->Geol[(DS->Ele[i].geol - 1)].vAreaF;
+		DS->EleH.macKsatV[i] = CS->Cal.macKsatV * DS->Soil[(DS->EleH.soil[i] - 1)].macKsatV;
+		DS->EleH.macKsatH[i] = CS->Cal.macKsatH * DS->Geol[(DS->Ele[i].geol - 1)].macKsatH;
+		DS->EleH.macD[i] = CS->Cal.macD * DS->Geol[DS->Ele[i].geol - 1].macD;
+		DS->EleH.infD[i] = CS->Cal.infD * DS->Soil[DS->EleH.soil[i] - 1].infD;
 
-		DS->Ele[i].RzD = CS->Cal.RzD * DS->LandC[DS->Ele[i].LC - 1].RzD;
-		DS->Ele[i].LAImax = DS->LandC[DS->Ele[i].LC - 1].LAImax;
-		DS->Ele[i].Rmin = DS->LandC[DS->Ele[i].LC - 1].Rmin;
-		DS->Ele[i].Rs_ref = DS->LandC[DS->Ele[i].LC - 1].Rs_ref;
-		DS->Ele[i].Albedo = CS->Cal.Albedo * DS->LandC[DS->Ele[i].LC - 1].Albedo;
-		if (DS->Ele[i].Albedo > 1) {
+		DS->EleH.RzD[i] = CS->Cal.RzD * DS->LandC[DS->EleH.LC[i] - 1].RzD;
+		DS->Ele[i].LAImax = DS->LandC[DS->EleH.LC[i] - 1].LAImax;
+		DS->EleH.Rmin[i] = DS->LandC[DS->EleH.LC[i] - 1].Rmin;
+		DS->EleH.Rs_ref[i] = DS->LandC[DS->EleH.LC[i] - 1].Rs_ref;
+		DS->EleH.Albedo[i] = CS->Cal.Albedo * DS->LandC[DS->EleH.LC[i] - 1].Albedo;
+		if (DS->EleH.Albedo[i] > 1) {
 			printf("Warning: Albedo out of bounds");
 			getchar();
 		}
-		DS->Ele[i].VegFrac = CS->Cal.VegFrac * DS->LandC[DS->Ele[i].LC - 1].VegFrac;
-		DS->Ele[i].Rough = CS->Cal.Rough * DS->LandC[DS->Ele[i].LC - 1].Rough;
+		DS->EleH.VegFrac[i] = CS->Cal.VegFrac * DS->LandC[DS->EleH.LC[i] - 1].VegFrac;
+		DS->EleH.Rough[i] = CS->Cal.Rough * DS->LandC[DS->EleH.LC[i] - 1].Rough;
 
-		DS->Ele[i].windH = DS->windH[DS->Ele[i].WindVel - 1];
+		DS->EleH.windH[i] = DS->windH[DS->Ele[i].WindVel - 1];
 	}
 	for (i = 0; i < DS->NumRiv; i++) {
 		DS->FluxRiv[i] = (realtype *) malloc(11 * sizeof(realtype));
@@ -193,24 +221,20 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 		 * but it is not supported right now in PIHMgis (Bhatt, G and
 		 * Kumar, M; 2007)
 		 */
-		DS->Ele[i + DS->NumEle].zmax = DS->Riv[i].zmin;
-		DS->Ele[i + DS->NumEle].zmin = DS->Riv[i].zmax - (0.5 * (DS->Ele[DS->Riv[i].LeftEle - 1].zmax + DS->Ele[DS->Riv[i].RightEle - 1].zmax) - 0.5 * (DS->Ele[DS->Riv[i].LeftEle - 1].zmin + DS->Ele[DS->Riv[i].RightEle - 1].zmin));
-		//DS->Ele[i + DS->NumEle].zmin = DS->Riv[i].zmax - 40;
-		DS->Ele[i + DS->NumEle].macD = 0.5 * (DS->Ele[DS->Riv[i].LeftEle - 1].macD + DS->Ele[DS->Riv[i].RightEle - 1].macD) > DS->Riv[i].depth ? 0.5 * (DS->Ele[DS->Riv[i].LeftEle - 1].macD + DS->Ele[DS->Riv[i].RightEle - 1].macD) - DS->Riv[i].depth : 0;
-		DS->Ele[i + DS->NumEle].macKsatH = 0.5 * (DS->Ele[DS->Riv[i].LeftEle - 1].macKsatH + DS->Ele[DS->Riv[i].RightEle - 1].macKsatH);
-		DS->Ele[i + DS->NumEle].vAreaF = 0.5 * (DS->Ele[DS->Riv[i].LeftEle - 1].vAreaF + DS->Ele[DS->Riv[i].RightEle - 1].vAreaF);
-		DS->Ele[i + DS->NumEle].KsatH = 0.5 * (DS->Ele[DS->Riv[i].LeftEle - 1].KsatH + DS->Ele[DS->Riv[i].RightEle - 1].KsatH);
-		DS->Ele[i + DS->NumEle].Porosity = 0.5 * (DS->Ele[DS->Riv[i].LeftEle - 1].Porosity + DS->Ele[DS->Riv[i].RightEle - 1].Porosity);
+		DS->EleH.zmax[i + DS->NumEle] = DS->Riv[i].zmin;
+		DS->EleH.zmin[i + DS->NumEle] = DS->Riv[i].zmax - (0.5 * (DS->EleH.zmax[DS->Riv[i].LeftEle - 1] + DS->EleH.zmax[DS->Riv[i].RightEle - 1]) - 0.5 * (DS->EleH.zmin[DS->Riv[i].LeftEle - 1] + DS->EleH.zmin[DS->Riv[i].RightEle - 1]));
+		//DS->EleH.zmin[i + DS->NumEle] = DS->Riv[i].zmax - 40;
+		DS->EleH.macD[i + DS->NumEle] = 0.5 * (DS->EleH.macD[DS->Riv[i].LeftEle - 1] + DS->EleH.macD[DS->Riv[i].RightEle - 1]) > DS->Riv[i].depth ? 0.5 * (DS->EleH.macD[DS->Riv[i].LeftEle - 1] + DS->EleH.macD[DS->Riv[i].RightEle - 1]) - DS->Riv[i].depth : 0;
+		DS->EleH.macKsatH[i + DS->NumEle] = 0.5 * (DS->EleH.macKsatH[DS->Riv[i].LeftEle - 1] + DS->EleH.macKsatH[DS->Riv[i].RightEle - 1]);
+		DS->EleH.vAreaF[i + DS->NumEle] = 0.5 * (DS->EleH.vAreaF[DS->Riv[i].LeftEle - 1] + DS->EleH.vAreaF[DS->Riv[i].RightEle - 1]);
+		DS->EleH.KsatH[i + DS->NumEle] = 0.5 * (DS->EleH.KsatH[DS->Riv[i].LeftEle - 1] + DS->EleH.KsatH[DS->Riv[i].RightEle - 1]);
+		DS->EleH.Porosity[i + DS->NumEle] = 0.5 * (DS->EleH.Porosity[DS->Riv[i].LeftEle - 1] + DS->EleH.Porosity[DS->Riv[i].RightEle - 1]);
 	}
 	for (i = 0; i < DS->NumPrep; i++) {
-		for (j = 0; j < DS->TSD_Prep[i].length; j++) {
-			DS->TSD_Prep[i].TS[j][1] = CS->Cal.Prep * DS->TSD_Prep[i].TS[j][1];
-		}
+		TSDScale(&DS->TSD_Prep[i], CS->Cal.Prep);
 	}
 	for (i = 0; i < DS->NumTemp; i++) {
-		for (j = 0; j < DS->TSD_Temp[i].length; j++) {
-			DS->TSD_Temp[i].TS[j][1] = CS->Cal.Temp * DS->TSD_Temp[i].TS[j][1];
-		}
+		TSDScale(&DS->TSD_Temp[i], CS->Cal.Temp);
 	}
 	/* Memory allocation of print variables */
 	for (i = 0; i < 24; i++) {
@@ -236,8 +260,8 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 			tmpBool = 1;
 			for (j = 0; j < 3; j++) {
 				if (DS->Ele[i].nabr[j] > 0) {
-					tempvalue1 = DS->Ele[i].BC[j] > -4 ? DS->Ele[DS->Ele[i].nabr[j] - 1].zmax : DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].zmax;
-					if (DS->Ele[i].zmax - tempvalue1 >= 0) {
+					tempvalue1 = DS->Ele[i].BC[j] > -4 ? DS->EleH.zmax[DS->Ele[i].nabr[j] - 1] : DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].zmax;
+					if (DS->EleH.zmax[i] - tempvalue1 >= 0) {
 						tmpBool = 0;
 						break;
 					}
@@ -249,17 +273,17 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 				 * Note: Following correction is being
 				 * applied for debug==1 case only
 				 */
-				printf("\tBfore: %lf Corrected using:", DS->Ele[i].zmax);
+				printf("\tBfore: %lf Corrected using:", DS->EleH.zmax[i]);
 				tempvalue1 = 10000000;
 				for (j = 0; j < 3; j++) {
 					if (DS->Ele[i].nabr[j] > 0) {
-						DS->Ele[i].zmax = (DS->Ele[i].BC[j] > -4 ? DS->Ele[DS->Ele[i].nabr[j] - 1].zmax : DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].zmax);
-						tempvalue1 = tempvalue1 > DS->Ele[i].zmax ? DS->Ele[i].zmax : tempvalue1;
-						printf("(%d)%lf  ", j + 1, (DS->Ele[i].BC[j] > -4 ? DS->Ele[DS->Ele[i].nabr[j] - 1].zmax : DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].zmax));
+						DS->EleH.zmax[i] = (DS->Ele[i].BC[j] > -4 ? DS->EleH.zmax[DS->Ele[i].nabr[j] - 1] : DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].zmax);
+						tempvalue1 = tempvalue1 > DS->EleH.zmax[i] ? DS->EleH.zmax[i] : tempvalue1;
+						printf("(%d)%lf  ", j + 1, (DS->Ele[i].BC[j] > -4 ? DS->EleH.zmax[DS->Ele[i].nabr[j] - 1] : DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].zmax));
 					}
 				}
-				DS->Ele[i].zmax = tempvalue1;
-				printf("=(New)%lf  ", DS->Ele[i].zmax);
+				DS->EleH.zmax[i] = tempvalue1;
+				printf("=(New)%lf  ", DS->EleH.zmax[i]);
 			}
 		}
 		/* Correction of BedRck Elev. Is this needed? */
@@ -270,8 +294,8 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 				tmpBool = 1;
 				for (j = 0; j < 3; j++) {
 					if (DS->Ele[i].nabr[j] > 0) {
-						tempvalue1 = DS->Ele[i].BC[j] > -4 ? DS->Ele[DS->Ele[i].nabr[j] - 1].zmin : DS->Ele[-(DS->Ele[i].BC[j] / 4) - 1 + DS->NumEle].zmin;
-						if (DS->Ele[i].zmin - tempvalue1 >= 0) {
+						tempvalue1 = DS->Ele[i].BC[j] > -4 ? DS->EleH.zmin[DS->Ele[i].nabr[j] - 1] : DS->EleH.zmin[-(DS->Ele[i].BC[j] / 4) - 1 + DS->NumEle];
+						if (DS->EleH.zmin[i] - tempvalue1 >= 0) {
 							tmpBool = 0;
 							break;
 						}
@@ -284,17 +308,17 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 					 * being applied for debug==1 case
 					 * only
 					 */
-					printf("\tBfore: %lf Corrected using:", DS->Ele[i].zmin);
+					printf("\tBfore: %lf Corrected using:", DS->EleH.zmin[i]);
 					tempvalue1 = 10000000;
 					for (j = 0; j < 3; j++) {
 						if (DS->Ele[i].nabr[j] > 0) {
-							DS->Ele[i].zmin = (DS->Ele[i].BC[j] > -4 ? DS->Ele[DS->Ele[i].nabr[j] - 1].zmin : DS->Ele[-(DS->Ele[i].BC[j] / 4) - 1 + DS->NumEle].zmin);
-							tempvalue1 = tempvalue1 > DS->Ele[i].zmin ? DS->Ele[i].zmin : tempvalue1;
-							printf("(%d)%lf  ", j + 1, (DS->Ele[i].BC[j] > -4 ? DS->Ele[DS->Ele[i].nabr[j] - 1].zmin : DS->Ele[-(DS->Ele[i].BC[j] / 4) - 1 + DS->NumEle].zmin));
+							DS->EleH.zmin[i] = (DS->Ele[i].BC[j] > -4 ? DS->EleH.zmin[DS->Ele[i].nabr[j] - 1] : DS->EleH.zmin[-(DS->Ele[i].BC[j] / 4) - 1 + DS->NumEle]);
+							tempvalue1 = tempvalue1 > DS->EleH.zmin[i] ? DS->EleH.zmin[i] : tempvalue1;
+							printf("(%d)%lf  ", j + 1, (DS->Ele[i].BC[j] > -4 ? DS->EleH.zmin[DS->Ele[i].nabr[j] - 1] : DS->EleH.zmin[-(DS->Ele[i].BC[j] / 4) - 1 + DS->NumEle]));
 						}
 					}
-					DS->Ele[i].zmin = tempvalue1;
-					printf("=(New)%lf  ", DS->Ele[i].zmin);
+					DS->EleH.zmin[i] = tempvalue1;
+					printf("=(New)%lf  ", DS->EleH.zmin[i]);
 				}
 			}
 		}
@@ -339,13 +363,76 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 				distY = (DS->Ele[i].y - 0.5 * (a_y + b_y));
 				break;
 			}
-			DS->Ele[i].surfH[j] = (DS->Ele[i].nabr[j] > 0) ? (DS->Ele[i].BC[j] > -4 ? (DS->Ele[DS->Ele[i].nabr[j] - 1].zmax) : DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].zmax) : DS->Ele[i].BC[j] <= -4 ? DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].zmax : (DS->Ele[i].zmax);
+			DS->Ele[i].surfH[j] = (DS->Ele[i].nabr[j] > 0) ? (DS->Ele[i].BC[j] > -4 ? (DS->EleH.zmax[DS->Ele[i].nabr[j] - 1]) : DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].zmax) : DS->Ele[i].BC[j] <= -4 ? DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].zmax : (DS->EleH.zmax[i]);
 			DS->Ele[i].surfX[j] = (DS->Ele[i].nabr[j] > 0) ? (DS->Ele[i].BC[j] > -4 ? DS->Ele[DS->Ele[i].nabr[j] - 1].x : DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].x) : (DS->Ele[i].x - 2 * distX);
 			DS->Ele[i].surfY[j] = DS->Ele[i].nabr[j] > 0 ? (DS->Ele[i].BC[j] > -4 ? DS->Ele[DS->Ele[i].nabr[j] - 1].y : DS->Riv[-(DS->Ele[i].BC[j] / 4) - 1].y) : (DS->Ele[i].y - 2 * distY);
 		}
 		DS->Ele[i].dhBYdx = -(DS->Ele[i].surfY[2] * (DS->Ele[i].surfH[1] - DS->Ele[i].surfH[0]) + DS->Ele[i].surfY[1] * (DS->Ele[i].surfH[0] - DS->Ele[i].surfH[2]) + DS->Ele[i].surfY[0] * (DS->Ele[i].surfH[2] - DS->Ele[i].surfH[1])) / (DS->Ele[i].surfX[2] * (DS->Ele[i].surfY[1] - DS->Ele[i].surfY[0]) + DS->Ele[i].surfX[1] * (DS->Ele[i].surfY[0] - DS->Ele[i].surfY[2]) + DS->Ele[i].surfX[0] * (DS->Ele[i].surfY[2] - DS->Ele[i].surfY[1]));
 		DS->Ele[i].dhBYdy = -(DS->Ele[i].surfX[2] * (DS->Ele[i].surfH[1] - DS->Ele[i].surfH[0]) + DS->Ele[i].surfX[1] * (DS->Ele[i].surfH[0] - DS->Ele[i].surfH[2]) + DS->Ele[i].surfX[0] * (DS->Ele[i].surfH[2] - DS->Ele[i].surfH[1])) / (DS->Ele[i].surfY[2] * (DS->Ele[i].surfX[1] - DS->Ele[i].surfX[0]) + DS->Ele[i].surfY[1] * (DS->Ele[i].surfX[0] - DS->Ele[i].surfX[2]) + DS->Ele[i].surfY[0] * (DS->Ele[i].surfX[2] - DS->Ele[i].surfX[1]));
 	}
+	/*
+	 * Edge table: each element edge once, with the geometry used in the
+	 * lateral flux calculation of f.c
+	 */
+	DS->Edge = (edge *) malloc(3 * DS->NumEle * sizeof(edge));
+	DS->NumEdge = 0;
+	for (i = 0; i < DS->NumEle; i++) {
+		if (DS->EleH.macD[i] > DS->EleH.zmax[i] - DS->EleH.zmin[i]) {
+			DS->EleH.macD[i] = DS->EleH.zmax[i] - DS->EleH.zmin[i];
+		}
+		for (j = 0; j < 3; j++) {
+			if (DS->Ele[i].nabr[j] > 0 && DS->Ele[i].nabr[j] - 1 < i) {
+				/* already stored from the neighbor */
+				continue;
+			}
+			DS->Edge[DS->NumEdge].ele[0] = i;
+			DS->Edge[DS->NumEdge].loc[0] = j;
+			DS->Edge[DS->NumEdge].length = DS->Ele[i].edge[j];
+			DS->Edge[DS->NumEdge].BC = DS->Ele[i].BC[j];
+			if (DS->Ele[i].nabr[j] > 0) {
+				k = DS->Ele[i].nabr[j] - 1;
+				DS->Edge[DS->NumEdge].ele[1] = k;
+				DS->Edge[DS->NumEdge].loc[1] = (DS->Ele[k].nabr[0] == i + 1) ? 0 : ((DS->Ele[k].nabr[1] == i + 1) ? 1 : ((DS->Ele[k].nabr[2] == i + 1) ? 2 : -1));
+				if (DS->Edge[DS->NumEdge].loc[1] < 0) {
+					printf("\n Element %d is neighbor of element %d but not vice versa", k + 1, i + 1);
+					exit(1);
+				}
+				DS->Edge[DS->NumEdge].Distance = sqrt(pow((DS->Ele[i].x - DS->Ele[k].x), 2) + pow((DS->Ele[i].y - DS->Ele[k].y), 2));
+			} else {
+				DS->Edge[DS->NumEdge].ele[1] = -1;
+				DS->Edge[DS->NumEdge].loc[1] = -1;
+				/*
+				 * Minimum Distance from circumcenter to the
+				 * edge of the triangle
+				 */
+				DS->Edge[DS->NumEdge].Distance = sqrt(pow(DS->Ele[i].edge[0] * DS->Ele[i].edge[1] * DS->Ele[i].edge[2] / (4 * DS->EleH.area[i]), 2) - pow(DS->Ele[i].edge[j] / 2, 2));
+			}
+			DS->NumEdge++;
+		}
+	}
+	/*
+	 * Up stream segments of each river segment, in increasing index, so
+	 * that the in-flow to a segment can be gathered by the segment itself
+	 */
+	for (i = 0; i < DS->NumRiv; i++) {
+		DS->Riv[i].NumUp = 0;
+	}
+	for (i = 0; i < DS->NumRiv; i++) {
+		if (DS->Riv[i].down > 0) {
+			DS->Riv[DS->Riv[i].down - 1].NumUp++;
+		}
+	}
+	for (i = 0; i < DS->NumRiv; i++) {
+		DS->Riv[i].up = (int *) malloc(DS->Riv[i].NumUp * sizeof(int));
+		DS->Riv[i].NumUp = 0;
+	}
+	for (i = 0; i < DS->NumRiv; i++) {
+		if (DS->Riv[i].down > 0) {
+			k = DS->Riv[i].down - 1;
+			DS->Riv[k].up[DS->Riv[k].NumUp] = i;
+			DS->Riv[k].NumUp++;
+		}
+	}
 	/* initialize state variable */
 	/* relax case */
 	if (CS->init_type == 0) {
@@ -353,11 +440,11 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 			DS->EleIS[i] = 0;
 			DS->EleSnow[i] = 0;
 			/* Note Two components can be separately read too */
-			DS->EleSnowGrnd[i] = (1 - DS->Ele[i].VegFrac) * DS->EleSnow[i];
-			DS->EleSnowCanopy[i] = DS->Ele[i].VegFrac * DS->EleSnow[i];
+			DS->EleSnowGrnd[i] = (1 - DS->EleH.VegFrac[i]) * DS->EleSnow[i];
+			DS->EleSnowCanopy[i] = DS->EleH.VegFrac[i] * DS->EleSnow[i];
 			NV_Ith_S(CV_Y, i) = 0;
 			NV_Ith_S(CV_Y, i + DS->NumEle) = 0;
-			NV_Ith_S(CV_Y, i + 2 * DS->NumEle) = DS->Ele[i].zmax - DS->Ele[i].zmin - 0.1;
+			NV_Ith_S(CV_Y, i + 2 * DS->NumEle) = DS->EleH.zmax[i] - DS->EleH.zmin[i] - 0.1;
 		}
 		for (i = 0; i < DS->NumRiv; i++) {
 			NV_Ith_S(CV_Y, i + 3 * DS->NumEle) = 0;
@@ -368,7 +455,7 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 			 * location data instead of average of neighbor
 			 * properties
 			 */
-			NV_Ith_S(CV_Y, i + 3 * DS->NumEle + DS->NumRiv) = (DS->Ele[i + DS->NumEle].zmax - DS->Ele[i + DS->NumEle].zmin) - 0.1;
+			NV_Ith_S(CV_Y, i + 3 * DS->NumEle + DS->NumRiv) = (DS->EleH.zmax[i + DS->NumEle] - DS->EleH.zmin[i + DS->NumEle]) - 0.1;
 		}
 	}
 	/* data initialization mode */
@@ -383,16 +470,16 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 				 * Note Two components can be separately read
 				 * too
 				 */
-				DS->EleSnowGrnd[i] = (1 - DS->Ele[i].VegFrac) * DS->EleSnow[i];
-				DS->EleSnowCanopy[i] = DS->Ele[i].VegFrac * DS->EleSnow[i];
+				DS->EleSnowGrnd[i] = (1 - DS->EleH.VegFrac[i]) * DS->EleSnow[i];
+				DS->EleSnowCanopy[i] = DS->EleH.VegFrac[i] * DS->EleSnow[i];
 				NV_Ith_S(CV_Y, i) = DS->Ele_IC[i].surf;
 				/* Note: delete 0.1 here */
 				NV_Ith_S(CV_Y, i + DS->NumEle) = DS->Ele_IC[i].unsat;
 				NV_Ith_S(CV_Y, i + 2 * DS->NumEle) = DS->Ele_IC[i].sat;
 				/* Note: delete line below for general */
-				//NV_Ith_S(CV_Y, i + 2 * DS->NumEle) = 0 * DS->Ele_IC[i].sat + (DS->Ele[i].zmax - DS->Ele[i].zmin) * 0.1;
-				if ((NV_Ith_S(CV_Y, i + DS->NumEle) + NV_Ith_S(CV_Y, i + 2 * DS->NumEle)) >= (DS->Ele[i].zmax - DS->Ele[i].zmin)) {
-					NV_Ith_S(CV_Y, i + DS->NumEle) = ((DS->Ele[i].zmax - DS->Ele[i].zmin) - NV_Ith_S(CV_Y, i + 2 * DS->NumEle)) * 0.98;
+				//NV_Ith_S(CV_Y, i + 2 * DS->NumEle) = 0 * DS->Ele_IC[i].sat + (DS->EleH.zmax[i] - DS->EleH.zmin[i]) * 0.1;
+				if ((NV_Ith_S(CV_Y, i + DS->NumEle) + NV_Ith_S(CV_Y, i + 2 * DS->NumEle)) >= (DS->EleH.zmax[i] - DS->EleH.zmin[i])) {
+					NV_Ith_S(CV_Y, i + DS->NumEle) = ((DS->EleH.zmax[i] - DS->EleH.zmin[i]) - NV_Ith_S(CV_Y, i + 2 * DS->NumEle)) * 0.98;
 					if (NV_Ith_S(CV_Y, i + DS->NumEle) < 0) {
 						NV_Ith_S(CV_Y, i + DS->NumEle) = 0;
 					}
@@ -408,7 +495,7 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 				 * average of neighbor properties
 				 */
 				//NV_Ith_S(CV_Y, i + 3 * DS->NumEle + DS->NumRiv) = 0.5 * (DS->Ele_IC[DS->Riv[i].LeftEle - 1].sat + DS->Ele_IC[DS->Riv[i].RightEle - 1].sat);
-				NV_Ith_S(CV_Y, i + 3 * DS->NumEle + DS->NumRiv) = (DS->Ele[i + DS->NumEle].zmax - DS->Ele[i + DS->NumEle].zmin) - 0.1;
+				NV_Ith_S(CV_Y, i + 3 * DS->NumEle + DS->NumRiv) = (DS->EleH.zmax[i + DS->NumEle] - DS->EleH.zmin[i + DS->NumEle]) - 0.1;
 			}
 		}
 	}
@@ -422,15 +509,18 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 			printf("\n  Fatal Error: %s.init is in use or does not exist!\n", filename);
 			exit(1);
 		} else {
-			for (i = 0; i < DS->NumEle; i++) {
+			/* file is in input numbering */
+			for (j = 0; j < DS->NumEle; j++) {
+				i = DS->EleNew[j];
 				fscanf(init_file, "%lf %lf %lf %lf %lf", &DS->EleIS[i], &DS->EleSnow[i], &tempvalue1, &tempvalue2, &tempvalue3);
-				DS->EleSnowGrnd[i] = (1 - DS->Ele[i].VegFrac) * DS->EleSnow[i];
-				DS->EleSnowCanopy[i] = DS->Ele[i].VegFrac * DS->EleSnow[i];
+				DS->EleSnowGrnd[i] = (1 - DS->EleH.VegFrac[i]) * DS->EleSnow[i];
+				DS->EleSnowCanopy[i] = DS->EleH.VegFrac[i] * DS->EleSnow[i];
 				NV_Ith_S(CV_Y, i) = tempvalue1;
 				NV_Ith_S(CV_Y, i + DS->NumEle) = tempvalue2;
 				NV_Ith_S(CV_Y, i + 2 * DS->NumEle) = tempvalue3;
 			}
-			for (i = 0; i < DS->NumRiv; i++) {
+			for (j = 0; j < DS->NumRiv; j++) {
+				i = DS->RivNew[j];
 				fscanf(init_file, "%lf %lf", &tempvalue1, &tempvalue2);
 				NV_Ith_S(CV_Y, i + 3 * DS->NumEle) = tempvalue1;
 				NV_Ith_S(CV_Y, i + 3 * DS->NumEle + DS->NumRiv) = tempvalue2;
@@ -438,4 +528,56 @@ initialize(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y)
 		}
 		fclose(init_file);
 	}
+	if (DS->CanopyODE == 1) {
+		/* interception and snow storages follow the other states */
+		k = 3 * DS->NumEle + 2 * DS->NumRiv;
+		for (i = 0; i < DS->NumEle; i++) {
+			NV_Ith_S(CV_Y, k + i) = DS->EleIS[i];
+			NV_Ith_S(CV_Y, k + DS->NumEle + i) = DS->EleSnowGrnd[i];
+			NV_Ith_S(CV_Y, k + 2 * DS->NumEle + i) = DS->EleSnowCanopy[i];
+		}
+	}
+}
+
+/*
+ * Write the state CV_Y, with the interception and snow storages, to
+ * filename + ext in the layout of .init (input numbering), for init_type 3;
+ * 0 if the file cannot be written
+ */
+int
+WriteInit(char *filename, char *ext, Model_Data DS, N_Vector CV_Y)
+{
+	FILE           *fp;
+	char           *fn;
+	realtype        is, snow;
+	int             i, j, k;
+
+	fn = (char *) malloc((strlen(filename) + strlen(ext) + 1) * sizeof(char));
+	strcpy(fn, filename);
+	strcat(fn, ext);
+	fp = fopen(fn, "w");
+	if (fp == NULL) {
+		printf("\n Warning: cannot write %s\n", fn);
+		free(fn);
+		return 0;
+	}
+	k = 3 * DS->NumEle + 2 * DS->NumRiv;
+	for (j = 0; j < DS->NumEle; j++) {
+		i = DS->EleNew[j];
+		if (DS->CanopyODE == 1) {
+			is = NV_Ith_S(CV_Y, k + i);
+			snow = NV_Ith_S(CV_Y, k + DS->NumEle + i) + NV_Ith_S(CV_Y, k + 2 * DS->NumEle + i);
+		} else {
+			is = DS->EleIS[i];
+			snow = DS->EleSnowGrnd[i] + DS->EleSnowCanopy[i];
+		}
+		fprintf(fp, "%lf \t %lf \t %lf \t %lf \t %lf \n", is, snow, NV_Ith_S(CV_Y, i), NV_Ith_S(CV_Y, i + DS->NumEle), NV_Ith_S(CV_Y, i + 2 * DS->NumEle));
+	}
+	for (j = 0; j < DS->NumRiv; j++) {
+		i = DS->RivNew[j];
+		fprintf(fp, "%lf\t%lf\n", NV_Ith_S(CV_Y, i + 3 * DS->NumEle), NV_Ith_S(CV_Y, i + 3 * DS->NumEle + DS->NumRiv));
+	}
+	fclose(fp);
+	free(fn);
+	return 1;
 }
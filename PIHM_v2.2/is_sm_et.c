@@ -14,6 +14,8 @@
  * e) Change in maximum interception storage due to snow accretion has been     *
  *	accounted for								*
  * f) Incorporation of Interception storage for rainfall as well as snow	*
+ * g) CanopyRates gives the same processes as rates, for CanopyODE = 1 where   *
+ *    the storages are integrated by CVODE instead of once per ETStep here     *
  ********************************************************************************/
 
 #include <stdio.h>
@@ -38,41 +40,65 @@
 #define R_dry 287.04
 #define R_v 461.5
 
+#define CAN_EPS 1.0e-5	/* Depth (m) over which the outflows of an empty
+			 * store and the overflow of a full one are
+			 * ramped in CanopyRates */
+
 realtype        Interpolation(TSD * Data, realtype t);
+void            EvalForcing(realtype, Model_Data);
+
+/* Potential evaporation from the wet canopy of element i (m/day) */
+static realtype
+CanopyETp(Model_Data MD, int i, realtype T)
+{
+	realtype        Delta, Gamma;
+	realtype        Rn, Vel, RH, VP, P, rl, r_a, qv_sat, qv;
+
+	Rn = MD->ForcRn[MD->Ele[i].Rn - 1];
+	Vel = MD->ForcWindVel[MD->Ele[i].WindVel - 1];
+	RH = MD->ForcHumidity[MD->Ele[i].humidity - 1];
+	//VP = Interpolation(&MD->TSD_Pressure[MD->Ele[i].pressure - 1], t);
+	VP = 611.2 * exp(17.67 * T / (T + 243.5)) * RH;
+	P = 101.325 * pow(10, 3) * pow((293 - 0.0065 * MD->EleH.zmax[i]) / 293, 5.26);
+	qv = 0.622 * VP / P;
+	qv_sat = 0.622 * (VP / RH) / P;
+	/*
+	 * zero_dh=Interpolation(&MD->TSD_DH[MD->EleH.LC[i]-1], t); cnpy_h =
+	 * zero_dh/(1.1*(0.0000001+log(1+pow(0.007*LAI,0.25)))); if(LAI<2.85)
+	 * { rl= 0.0002 + 0.3*cnpy_h*pow(0.07*LAI,0.5); } else { rl=
+	 * 0.3*cnpy_h*(1-(zero_dh/cnpy_h)); }
+	 */
+	rl = MD->ForcRL[MD->EleH.LC[i] - 1];
+	//r_a = log(MD->EleH.windH[i] / rl) * log(10 * MD->EleH.windH[i] / rl) / (Vel * 0.16);
+	r_a = 12 * 4.72 * log(MD->EleH.windH[i] / rl) / (0.54 * Vel / UNIT_C / 60 + 1) / UNIT_C / 60;
+
+	Gamma = 4 * 0.7 * SIGMA * UNIT_C * R_dry / C_air * pow(T + 273.15, 4) / (P / r_a) + 1;
+	Delta = Lv * Lv * 0.622 / R_v / C_air / pow(T + 273.15, 2) * qv_sat;
+
+	return (Rn * Delta + Gamma * (1.2 * Lv * (qv_sat - qv) / r_a)) / (1000.0 * Lv * (Delta + Gamma));
+}
 
 void
-is_sm_et(realtype t, realtype stepsize, void *DS, N_Vector VY)
+is_sm_et(realtype t, realtype stepsize, void *DS)
 {
 	int             i;
-	realtype        totEvap;
-	realtype        Delta, Gamma, Lambda;
-	realtype        Rn, G, T, Vel, RH, VP, P, LAI, zero_dh, cnpy_h, rl,
-	                r_a, qv_sat, qv, ETp;
-	realtype        isval = 0, etval = 0;
-	realtype        fracSnow, snowRate, MeltRateGrnd, MeltRateCanopy, eltRate,
+	realtype        T, LAI, ETp;
+	realtype        isval = 0;
+	realtype        fracSnow, snowRate, MeltRateGrnd, MeltRateCanopy,
 	                MF, Ts = -3.0, Tr = 1.0, To = 0.0, ret;
 
 	Model_Data      MD;
 
 	MD = (Model_Data) DS;
+	EvalForcing(t, MD);
 
 	stepsize = stepsize / UNIT_C;
 	for (i = 0; i < MD->NumEle; i++) {
 		/* Note the dependence on physical units */
-		MD->ElePrep[i] = Interpolation(&MD->TSD_Prep[MD->Ele[i].prep - 1], t);
-		Rn = Interpolation(&MD->TSD_Rn[MD->Ele[i].Rn - 1], t);
-		//G = Interpolation(&MD->TSD_G[MD->Ele[i].G - 1], t);
-		G = 0.1 * Rn;
-		T = Interpolation(&MD->TSD_Temp[MD->Ele[i].temp - 1], t);
-		Vel = Interpolation(&MD->TSD_WindVel[MD->Ele[i].WindVel - 1], t);
-		RH = Interpolation(&MD->TSD_Humidity[MD->Ele[i].humidity - 1], t);
-		//VP = Interpolation(&MD->TSD_Pressure[MD->Ele[i].pressure - 1], t);
-		VP = 611.2 * exp(17.67 * T / (T + 243.5)) * RH;
-		P = 101.325 * pow(10, 3) * pow((293 - 0.0065 * MD->Ele[i].zmax) / 293, 5.26);
-		qv = 0.622 * VP / P;
-		qv_sat = 0.622 * (VP / RH) / P;
-		LAI = Interpolation(&MD->TSD_LAI[MD->Ele[i].LC - 1], t);
-		MF = multF2 * Interpolation(&MD->TSD_MeltF[MD->Ele[i].meltF - 1], t);
+		MD->ElePrep[i] = MD->ForcPrep[MD->Ele[i].prep - 1];
+		T = MD->ForcTemp[MD->Ele[i].temp - 1];
+		LAI = MD->ForcLAI[MD->EleH.LC[i] - 1];
+		MF = multF2 * MD->ForcMeltF[MD->Ele[i].meltF - 1];
 		/******************************************************************************************/
 		/* Snow Accumulation/Melt Calculation				  */
 		/******************************************************************************************/
@@ -83,9 +109,9 @@ is_sm_et(realtype t, realtype stepsize, void *DS, N_Vector VY)
 		 * MeltRateGrnd,MeltRateCanopy are the average value prorated
 		 * over the whole elemental area
 		 */
-		MD->EleSnowGrnd[i] = MD->EleSnowGrnd[i] + (1 - MD->Ele[i].VegFrac) * snowRate * stepsize;
-		MD->EleSnowCanopy[i] = MD->EleSnowCanopy[i] + MD->Ele[i].VegFrac * snowRate * stepsize;
-		MD->EleISsnowmax[i] = MD->EleSnowCanopy[i] > 0 ? 0.003 * LAI * MD->Ele[i].VegFrac : 0;
+		MD->EleSnowGrnd[i] = MD->EleSnowGrnd[i] + (1 - MD->EleH.VegFrac[i]) * snowRate * stepsize;
+		MD->EleSnowCanopy[i] = MD->EleSnowCanopy[i] + MD->EleH.VegFrac[i] * snowRate * stepsize;
+		MD->EleISsnowmax[i] = MD->EleSnowCanopy[i] > 0 ? 0.003 * LAI * MD->EleH.VegFrac[i] : 0;
 		MD->EleISsnowmax[i] = multF1 * MD->EleISsnowmax[i];
 		if (MD->EleSnowCanopy[i] > MD->EleISsnowmax[i]) {
 			MD->EleSnowGrnd[i] = MD->EleSnowGrnd[i] + MD->EleSnowCanopy[i] - MD->EleISsnowmax[i];
@@ -113,30 +139,15 @@ is_sm_et(realtype t, realtype stepsize, void *DS, N_Vector VY)
 		 * element. Logistics are simpler if assumed in volumetric
 		 * form by multiplication of Area on either side of equation
 		 */
-		MD->EleISmax[i] = multF1 * MD->ISFactor[MD->Ele[i].LC - 1] * LAI * MD->Ele[i].VegFrac;
+		MD->EleISmax[i] = multF1 * MD->ISFactor[MD->EleH.LC[i] - 1] * LAI * MD->EleH.VegFrac[i];
 		/* Note the dependence on physical units */
 		if (LAI > 0.0) {
+			ETp = CanopyETp(MD, i, T);
 
-			/*
-			 * zero_dh=Interpolation(&MD->TSD_DH[MD->Ele[i].LC-1],
-			 *  t); cnpy_h =
-			 * zero_dh/(1.1*(0.0000001+log(1+pow(0.007*LAI,0.25)))
-			 * ); if(LAI<2.85)	{ rl= 0.0002 +
-			 * 0.3*cnpy_h*pow(0.07*LAI,0.5); } else { rl=
-			 * 0.3*cnpy_h*(1-(zero_dh/cnpy_h)); }
-			 			 */ rl = Interpolation(&MD->TSD_RL[MD->Ele[i].LC - 1], t);
-			//r_a = log(MD->Ele[i].windH / rl) * log(10 * MD->Ele[i].windH / rl) / (Vel * 0.16);
-			r_a = 12 * 4.72 * log(MD->Ele[i].windH / rl) / (0.54 * Vel / UNIT_C / 60 + 1) / UNIT_C / 60;
-
-			Gamma = 4 * 0.7 * SIGMA * UNIT_C * R_dry / C_air * pow(T + 273.15, 4) / (P / r_a) + 1;
-			Delta = Lv * Lv * 0.622 / R_v / C_air / pow(T + 273.15, 2) * qv_sat;
-
-			ETp = (Rn * Delta + Gamma * (1.2 * Lv * (qv_sat - qv) / r_a)) / (1000.0 * Lv * (Delta + Gamma));
-
-			MD->EleET[i][0] = MD->pcCal.Et0 * MD->Ele[i].VegFrac * (pow((MD->EleIS[i] < 0 ? 0 : (MD->EleIS[i] > MD->EleISmax[i] ? MD->EleISmax[i] : MD->EleIS[i])) / MD->EleISmax[i], 1.0 / 2.0)) * ETp;
+			MD->EleET[i][0] = MD->pcCal.Et0 * MD->EleH.VegFrac[i] * (pow((MD->EleIS[i] < 0 ? 0 : (MD->EleIS[i] > MD->EleISmax[i] ? MD->EleISmax[i] : MD->EleIS[i])) / MD->EleISmax[i], 1.0 / 2.0)) * ETp;
 			MD->EleET[i][0] = MD->EleET[i][0] < 0 ? 0 : MD->EleET[i][0];
 
-			//MD->EleET[i][0] = MD->pcCal.Et0 * MD->Ele[i].VegFrac * (LAI / MD->Ele[i].LAImax) * (pow((MD->EleIS[i] < 0 ? 0 : MD->EleIS[i]) / MD->EleISmax[i], 2.0 / 3.0)) * (Rn * (1 - MD->Ele[i].Albedo) * Delta + (1.2 * 1003.5 * ((VP / RH) - VP) / r_a)) / (1000 * 2441000.0 * (Delta + Gamma));
+			//MD->EleET[i][0] = MD->pcCal.Et0 * MD->EleH.VegFrac[i] * (LAI / MD->Ele[i].LAImax) * (pow((MD->EleIS[i] < 0 ? 0 : MD->EleIS[i]) / MD->EleISmax[i], 2.0 / 3.0)) * (Rn * (1 - MD->EleH.Albedo[i]) * Delta + (1.2 * 1003.5 * ((VP / RH) - VP) / r_a)) / (1000 * 2441000.0 * (Delta + Gamma));
 			MD->EleTF[i] = MD->EleIS[i] <= 0 ? 0 : 5.65 * pow(10, -2) * MD->EleISmax[i] * exp(3.89 * (MD->EleIS[i] < 0 ? 0 : MD->EleIS[i]) / MD->EleISmax[i]);	/* Note the dependece on
 																						 * physical units */
 			MD->EleTF[i] = multF3 * MD->EleTF[i];
@@ -147,32 +158,32 @@ is_sm_et(realtype t, realtype stepsize, void *DS, N_Vector VY)
 		if(MD->EleTF[i]<0)MD->EleTF[i] = 0.0;
 		if(MD->EleTF[i]*stepsize>MD->EleIS[i])MD->EleTF[i]=MD->EleIS[i]/stepsize;
 		if (MD->EleIS[i] >= MD->EleISmax[i]) {
-			if (((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy) >= MD->EleET[i][0] + MD->EleTF[i]) {
+			if (((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy) >= MD->EleET[i][0] + MD->EleTF[i]) {
 				MD->EleETloss[i] = MD->EleET[i][0];
-				ret = MD->EleTF[i] + (MD->EleIS[i] - MD->EleISmax[i])/stepsize + (((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy) - (MD->EleET[i][0] + MD->EleTF[i]));
+				ret = MD->EleTF[i] + (MD->EleIS[i] - MD->EleISmax[i])/stepsize + (((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy) - (MD->EleET[i][0] + MD->EleTF[i]));
 				isval = MD->EleISmax[i];
 				//MD->EleIS[i] = MD->EleISmax[i];
-			} else if ((((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy) < MD->EleET[i][0] + MD->EleTF[i]) && (MD->EleIS[i] + stepsize * ((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy - MD->EleET[i][0] - MD->EleTF[i]) <= 0)) {
-				MD->EleETloss[i] = (MD->EleET[i][0] / (MD->EleET[i][0] + MD->EleTF[i])) * (MD->EleIS[i] / stepsize + ((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy));
-				ret = (MD->EleTF[i] / (MD->EleET[i][0] + MD->EleTF[i])) * (MD->EleIS[i] / stepsize + ((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy));
+			} else if ((((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy) < MD->EleET[i][0] + MD->EleTF[i]) && (MD->EleIS[i] + stepsize * ((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy - MD->EleET[i][0] - MD->EleTF[i]) <= 0)) {
+				MD->EleETloss[i] = (MD->EleET[i][0] / (MD->EleET[i][0] + MD->EleTF[i])) * (MD->EleIS[i] / stepsize + ((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy));
+				ret = (MD->EleTF[i] / (MD->EleET[i][0] + MD->EleTF[i])) * (MD->EleIS[i] / stepsize + ((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy));
 				MD->EleET[i][0]=MD->EleETloss[i];
 				//MD->EleIS[i] = 0;
 				isval = 0;
 				MD->EleETloss[i] = MD->EleET[i][0];
 			} else {
-				isval = MD->EleIS[i] + stepsize * (((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]);
-				//MD->EleIS[i] = MD->EleIS[i] + stepsize * (((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]);
+				isval = MD->EleIS[i] + stepsize * (((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]);
+				//MD->EleIS[i] = MD->EleIS[i] + stepsize * (((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]);
 				ret = MD->EleTF[i];
 				MD->EleETloss[i] = MD->EleET[i][0];
 			}
-		} else if ((MD->EleIS[i] < MD->EleISmax[i]) && ((MD->EleIS[i] + (((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]) * stepsize) >= MD->EleISmax[i])) {
+		} else if ((MD->EleIS[i] < MD->EleISmax[i]) && ((MD->EleIS[i] + (((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]) * stepsize) >= MD->EleISmax[i])) {
 			MD->EleETloss[i] = MD->EleET[i][0];
 			isval = MD->EleISmax[i];
-			ret = MD->EleTF[i] + (((MD->EleIS[i] + (((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]) * stepsize) - MD->EleISmax[i]))/stepsize;
-		} else if ((MD->EleIS[i] < MD->EleISmax[i]) && ((MD->EleIS[i] + (((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]) * stepsize) <= 0)) {
+			ret = MD->EleTF[i] + (((MD->EleIS[i] + (((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]) * stepsize) - MD->EleISmax[i]))/stepsize;
+		} else if ((MD->EleIS[i] < MD->EleISmax[i]) && ((MD->EleIS[i] + (((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]) * stepsize) <= 0)) {
 			if ((MD->EleET[i][0] > 0) || (MD->EleTF[i] > 0)) {
-				MD->EleETloss[i] = (MD->EleET[i][0] / (MD->EleET[i][0] + MD->EleTF[i])) * (MD->EleIS[i] / stepsize + ((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy));
-				ret = (MD->EleTF[i] / (MD->EleET[i][0] + MD->EleTF[i])) * (MD->EleIS[i] / stepsize + ((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy));
+				MD->EleETloss[i] = (MD->EleET[i][0] / (MD->EleET[i][0] + MD->EleTF[i])) * (MD->EleIS[i] / stepsize + ((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy));
+				ret = (MD->EleTF[i] / (MD->EleET[i][0] + MD->EleTF[i])) * (MD->EleIS[i] / stepsize + ((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy));
 				MD->EleET[i][0]=MD->EleETloss[i];
 			} else {
 				MD->EleET[i][0] = 0;
@@ -181,13 +192,82 @@ is_sm_et(realtype t, realtype stepsize, void *DS, N_Vector VY)
 			MD->EleETloss[i] = MD->EleET[i][0];
 			isval = 0;
 		} else {
-			isval = MD->EleIS[i] + (((1 - fracSnow) * MD->ElePrep[i] * MD->Ele[i].VegFrac + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]) * stepsize;
+			isval = MD->EleIS[i] + (((1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy) - MD->EleET[i][0] - MD->EleTF[i]) * stepsize;
 			MD->EleETloss[i] = MD->EleET[i][0];
 			ret = MD->EleTF[i];
 		}
-		MD->EleNetPrep[i] = (1 - MD->Ele[i].VegFrac) * (1 - fracSnow) * MD->ElePrep[i] + ret + MeltRateGrnd;
+		MD->EleNetPrep[i] = (1 - MD->EleH.VegFrac[i]) * (1 - fracSnow) * MD->ElePrep[i] + ret + MeltRateGrnd;
 		MD->EleTF[i] = ret;
 		MD->EleIS[i] = isval;
 		//MD->EleNetPrep[i] = MD->ElePrep[i];
 	}
 }
+
+/* Linear ramp from 0 at s <= 0 to 1 at s >= CAN_EPS */
+static realtype
+Ramp(realtype s)
+{
+	return (s <= 0) ? 0 : (s >= CAN_EPS) ? 1 : s / CAN_EPS;
+}
+
+/*
+ * CanopyODE = 1: rates of the interception and snow storages at time t,
+ * from the states Y[3*NumEle+2*NumRiv..] (interception, snow on the ground,
+ * snow on the canopy), into DY (m/min). The processes of is_sm_et are
+ * taken as rates: snowfall beyond the canopy capacity and rain and melt
+ * beyond the interception capacity pass through, and the outflows of an
+ * empty store vanish. ElePrep, EleNetPrep, EleTF, EleET[.][0], EleETloss
+ * and the storages of MD are set as is_sm_et sets them for f().
+ */
+void
+CanopyRates(Model_Data MD, realtype * Y, realtype * DY)
+{
+	int             i, k;
+	realtype        T, LAI, MF, fracSnow, snowRate, snowCanopy, MeltRate,
+	                MeltRateGrnd, MeltRateCanopy, inflow, net, drip, IS,
+	                Ts = -3.0, Tr = 1.0, To = 0.0;
+
+	k = 3 * MD->NumEle + 2 * MD->NumRiv;
+#pragma omp parallel for private(T, LAI, MF, fracSnow, snowRate, snowCanopy, MeltRate, MeltRateGrnd, MeltRateCanopy, inflow, net, drip, IS)
+	for (i = 0; i < MD->NumEle; i++) {
+		MD->ElePrep[i] = MD->ForcPrep[MD->Ele[i].prep - 1];
+		T = MD->ForcTemp[MD->Ele[i].temp - 1];
+		LAI = MD->ForcLAI[MD->EleH.LC[i] - 1];
+		MF = multF2 * MD->ForcMeltF[MD->Ele[i].meltF - 1];
+		MD->EleIS[i] = (Y[k + i] > 0) ? Y[k + i] : 0;
+		MD->EleSnowGrnd[i] = (Y[k + MD->NumEle + i] > 0) ? Y[k + MD->NumEle + i] : 0;
+		MD->EleSnowCanopy[i] = (Y[k + 2 * MD->NumEle + i] > 0) ? Y[k + 2 * MD->NumEle + i] : 0;
+		MD->EleSnow[i] = MD->EleSnowGrnd[i] + MD->EleSnowCanopy[i];
+
+		/* snow accumulation and melt */
+		fracSnow = T < Ts ? 1.0 : T > Tr ? 0 : (Tr - T) / (Tr - Ts);
+		snowRate = fracSnow * MD->ElePrep[i];
+		MD->EleISsnowmax[i] = multF1 * 0.003 * LAI * MD->EleH.VegFrac[i];
+		snowCanopy = MD->EleH.VegFrac[i] * snowRate * (1 - Ramp(MD->EleSnowCanopy[i] - MD->EleISsnowmax[i] + CAN_EPS));
+		MeltRate = (T > To ? (T - To) * MF : 0);
+		MeltRateGrnd = MeltRate * Ramp(MD->EleSnowGrnd[i]);
+		MeltRateCanopy = MeltRate * Ramp(MD->EleSnowCanopy[i]);
+		DY[k + MD->NumEle + i] = (snowRate - snowCanopy - MeltRateGrnd) / UNIT_C;
+		DY[k + 2 * MD->NumEle + i] = (snowCanopy - MeltRateCanopy) / UNIT_C;
+
+		/* throughfall and evaporation from the canopy */
+		MD->EleISmax[i] = multF1 * MD->ISFactor[MD->EleH.LC[i] - 1] * LAI * MD->EleH.VegFrac[i];
+		IS = MD->EleIS[i];
+		if (LAI > 0.0) {
+			MD->EleET[i][0] = MD->pcCal.Et0 * MD->EleH.VegFrac[i] * pow((IS > MD->EleISmax[i] ? MD->EleISmax[i] : IS) / MD->EleISmax[i], 1.0 / 2.0) * CanopyETp(MD, i, T);
+			MD->EleET[i][0] = MD->EleET[i][0] < 0 ? 0 : MD->EleET[i][0];
+			MD->EleTF[i] = multF3 * 5.65 * pow(10, -2) * MD->EleISmax[i] * exp(3.89 * IS / MD->EleISmax[i]) * Ramp(IS);
+		} else {
+			MD->EleET[i][0] = 0.0;
+			MD->EleTF[i] = 0.0;
+		}
+		inflow = (1 - fracSnow) * MD->ElePrep[i] * MD->EleH.VegFrac[i] + MeltRateCanopy;
+		net = inflow - MD->EleET[i][0] - MD->EleTF[i];
+		/* a full store passes its net inflow on */
+		drip = (net > 0) ? net * Ramp(IS - MD->EleISmax[i] + CAN_EPS) : 0;
+		DY[k + i] = (net - drip) / UNIT_C;
+		MD->EleETloss[i] = MD->EleET[i][0];
+		MD->EleTF[i] = MD->EleTF[i] + drip;
+		MD->EleNetPrep[i] = (1 - MD->EleH.VegFrac[i]) * (1 - fracSnow) * MD->ElePrep[i] + MD->EleTF[i] + MeltRateGrnd;
+	}
+}
@@ -0,0 +1,730 @@
+/*******************************************************************************
+ * File        : jtimes.c                                                      *
+ * Function    : Analytic Jacobian-vector product for the CVSPGMR linear solve *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) Used when Solver = 4 or 5 in .para file. Replaces the finite difference  *
+ *    J*v of CVSPILS, which costs one f() call per Krylov iteration.           *
+ * b) Linearization: once for every new (t,y) the partial derivatives of each  *
+ *    flux of f() are stored as a flux list (state columns, dFlux/dy, and the  *
+ *    rows/scales through which the flux enters dy/dt), together with a 3x3   *
+ *    block of the vertical (infiltration/recharge) terms of each element.    *
+ *    Each J*v is then a sparse product over that list.                        *
+ * c) Covered: Darcy subsurface fluxes (including macropore effKH), Manning    *
+ *    overland flux, OLFeleToriv, river-river and river bed fluxes, river      *
+ *    boundary conditions and van Genuchten infiltration/recharge. The surface *
+ *    slope (Avg_Sf) of diffusion wave overland flow and the ET terms are      *
+ *    frozen at their values at y.                                             *
+ * d) Debug = 2 in .para compares each new linearization with the finite      *
+ *    difference product and prints the relative error of each state group.  *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include "sundials_types.h"
+#include "nvector_serial.h"
+#include "cvode_spgmr.h"
+#include "pihm.h"
+
+#define multF	2
+#define MINpsi	-70
+#define EPS 0.05
+#define UNIT_C 1440
+#define GRAV 9.8*60*60
+#define SRUR 1.4901161193847656e-08	/* sqrt of unit roundoff */
+
+int             f(realtype, N_Vector, N_Vector, void *);
+realtype        Interpolation(TSD * Data, realtype t);
+realtype        avgY(realtype diff, realtype yi, realtype yinabr);
+realtype        effKH(int mp, realtype tmpY, realtype aqDepth, realtype MacD, realtype MacKsatH, realtype areaF, realtype ksatH);
+realtype        effKV(realtype ksatFunc, realtype gradY, realtype macKV, realtype KV, realtype areaF);
+realtype        CS_AreaOrPerem(int rivOrder, realtype rivDepth, realtype rivCoeff, realtype a_pBool);
+
+/* derivative of clipped state DummyY = max(Y,0) */
+#define dPos(y)	((y) >= 0 ? 1.0 : 0.0)
+
+/* d(avgY)/d(yi) and d(avgY)/d(yinabr) */
+static void
+dAvgY(realtype diff, realtype yi, realtype yinabr, realtype * di, realtype * dn)
+{
+	*di = 0;
+	*dn = 0;
+	if (diff > 0) {
+		if (yi > 1 * EPS / 100)
+			*di = 1.0;
+	} else {
+		if (yinabr > 1 * EPS / 100)
+			*dn = 1.0;
+	}
+}
+
+/* d(effKH)/d(tmpY) */
+static realtype
+dEffKH(int mp, realtype tmpY, realtype aqDepth, realtype MacD, realtype MacKsatH, realtype areaF, realtype ksatH)
+{
+	realtype        u, num;
+
+	if (mp == 1 && tmpY > aqDepth - MacD && tmpY <= aqDepth) {
+		u = tmpY - (aqDepth - MacD);
+		num = MacKsatH * u * areaF + ksatH * (aqDepth - MacD + u * (1 - areaF));
+		return ((MacKsatH * areaF + ksatH * (1 - areaF)) * tmpY - num) / (tmpY * tmpY);
+	}
+	return 0;
+}
+
+/* d(effKV)/d(ksatFunc); effKV is piecewise constant in gradY */
+static realtype
+dEffKV(realtype ksatFunc, realtype gradY, realtype macKV, realtype KV, realtype areaF)
+{
+	if (ksatFunc >= 0.98) {
+		return KV * (1 - areaF);
+	} else {
+		if (fabs(gradY) * ksatFunc * KV <= 1 * KV * ksatFunc) {
+			return KV;
+		} else {
+			if (fabs(gradY) * ksatFunc * KV < (macKV * areaF + KV * (1 - areaF) * ksatFunc)) {
+				return (macKV * areaF + KV * (1 - areaF));
+			} else {
+				return KV * (1 - areaF);
+			}
+		}
+	}
+}
+
+/* d(CS_AreaOrPerem)/d(rivDepth) */
+static realtype
+dCS_AreaOrPerem(int rivOrder, realtype rivDepth, realtype rivCoeff, realtype a_pBool)
+{
+	realtype        u, w, k, c3;
+	int             e;
+
+	if (a_pBool == 3) {
+		/* Note: integer exponent as in CS_AreaOrPerem */
+		if (rivOrder == 1)
+			return 0;
+		e = 1 / (rivOrder - 1);
+		return (e == 0) ? 0 : 2.0 * e * pow(rivDepth + EPS, e - 1) / pow(rivCoeff, e);
+	}
+	if (rivDepth <= 0)
+		return 0;
+	switch (rivOrder) {
+	case 1:
+		return (a_pBool == 1) ? rivCoeff : 2.0;
+	case 2:
+		return (a_pBool == 1) ? 2.0 * rivDepth / rivCoeff : 2.0 * pow(1 + pow(rivCoeff, 2), 0.5) / rivCoeff;
+	case 3:
+		if (a_pBool == 1)
+			return 2.0 * pow(rivDepth, 0.5) / pow(rivCoeff, 0.5);
+		u = rivDepth * (1 + 4 * rivCoeff * rivDepth) / rivCoeff;
+		w = 2 * pow(rivCoeff * rivDepth, 0.5) + pow(1 + 4 * rivCoeff * rivDepth, 0.5);
+		return (1 + 8 * rivCoeff * rivDepth) / (2 * rivCoeff * pow(u, 0.5)) + (pow(rivCoeff / rivDepth, 0.5) + 2 * rivCoeff / pow(1 + 4 * rivCoeff * rivDepth, 0.5)) / (2 * rivCoeff * w);
+	case 4:
+		if (a_pBool == 1)
+			return 2.0 * pow(rivDepth / rivCoeff, 1.0 / 3.0);
+		k = 9 * pow(rivCoeff, 2.0 / 3.0);
+		c3 = pow(rivCoeff, 1.0 / 3.0);
+		u = rivDepth * (1 + k * rivDepth);
+		w = 3 * c3 * pow(rivDepth, 0.5) + pow(1 + k * rivDepth, 0.5);
+		return 2 * ((1 + 2 * k * rivDepth) / (6 * pow(u, 0.5)) + (1.5 * c3 / pow(rivDepth, 0.5) + 0.5 * k / pow(1 + k * rivDepth, 0.5)) / (9 * c3 * w));
+	default:
+		return 0;
+	}
+}
+
+/* derivatives of OLFeleToriv w.r.t. eleYtot and rivYtot */
+static void
+dOLFeleToriv(realtype eleYtot, realtype EleZ, realtype cwr, realtype rivZmax, realtype rivYtot, realtype length, realtype * dEle, realtype * dRiv)
+{
+	realtype        threshEle, C;
+
+	threshEle = (rivZmax < EleZ) ? EleZ : rivZmax;
+	C = cwr * 2.0 * sqrt(2 * GRAV * UNIT_C * UNIT_C) * length / 3.0;
+	*dEle = 0;
+	*dRiv = 0;
+	if (rivYtot > eleYtot) {
+		if (eleYtot > threshEle) {
+			*dEle = -C * 0.5 * (rivYtot - threshEle) / sqrt(rivYtot - eleYtot);
+			*dRiv = C * sqrt(rivYtot - eleYtot) - *dEle;
+		} else if (threshEle < rivYtot) {
+			*dRiv = 1.5 * C * sqrt(rivYtot - threshEle);
+		}
+	} else {
+		if (rivYtot > threshEle) {
+			if (eleYtot > rivYtot) {
+				*dRiv = C * 0.5 * (eleYtot - threshEle) / sqrt(eleYtot - rivYtot);
+				*dEle = -C * sqrt(eleYtot - rivYtot) - *dRiv;
+			}
+		} else if (threshEle < eleYtot) {
+			*dEle = -1.5 * C * sqrt(eleYtot - threshEle);
+		}
+	}
+}
+
+/*
+ * Manning flux F = crossA*avg_y^(2/3)*grad_y/(sqrt(|avg_sf|)*avg_rough) of
+ * OverlandFlow(): dF from the differentials of its arguments
+ */
+static realtype
+dOverlandFlow(realtype avg_y, realtype grad_y, realtype avg_sf, realtype crossA, realtype avg_rough, realtype d_avg_y, realtype d_grad_y, realtype d_avg_sf, realtype d_crossA)
+{
+	realtype        dF, sf;
+
+	sf = fabs(avg_sf);
+	if (sf == 0)
+		return 0;
+	dF = d_crossA * pow(avg_y, 2.0 / 3.0) * grad_y / sqrt(sf) + crossA * pow(avg_y, 2.0 / 3.0) * (d_grad_y / sqrt(sf) - 0.5 * grad_y * ((avg_sf > 0) ? 1 : -1) * d_avg_sf / (sf * sqrt(sf)));
+	if (avg_y > 0)
+		dF = dF + crossA * (2.0 / 3.0) * pow(avg_y, -1.0 / 3.0) * d_avg_y * grad_y / sqrt(sf);
+	return dF / avg_rough;
+}
+
+static void
+AddFlux(Jac_Data JD, int rowA, realtype scaleA, int rowB, realtype scaleB, int n, int *col, realtype * der)
+{
+	int             k, m;
+
+	m = JD->NumFlux++;
+	JD->Row[2 * m] = rowA;
+	JD->Row[2 * m + 1] = rowB;
+	JD->Scale[2 * m] = scaleA;
+	JD->Scale[2 * m + 1] = scaleB;
+	JD->NumCol[m] = n;
+	for (k = 0; k < n; k++) {
+		JD->Col[JV_MAXCOL * m + k] = col[k];
+		JD->Der[JV_MAXCOL * m + k] = der[k];
+	}
+}
+
+Jac_Data
+JacAlloc(Model_Data MD, int Verify)
+{
+	Jac_Data        JD;
+	int             N, MaxFlux;
+
+	JD = (Jac_Data) malloc(sizeof *JD);
+	N = 3 * MD->NumEle + 2 * MD->NumRiv;
+	MaxFlux = 6 * MD->NumEle + 9 * MD->NumRiv;
+	JD->MD = MD;
+	JD->NumFlux = 0;
+	JD->Row = (int *) malloc(2 * MaxFlux * sizeof(int));
+	JD->Scale = (realtype *) malloc(2 * MaxFlux * sizeof(realtype));
+	JD->NumCol = (int *) malloc(MaxFlux * sizeof(int));
+	JD->Col = (int *) malloc(JV_MAXCOL * MaxFlux * sizeof(int));
+	JD->Der = (realtype *) malloc(JV_MAXCOL * MaxFlux * sizeof(realtype));
+	JD->EleBlk = (realtype *) malloc(9 * MD->NumEle * sizeof(realtype));
+	JD->Ylin = (realtype *) malloc(N * sizeof(realtype));
+	JD->Ftmp = N_VNew_Serial(N);
+	JD->tlin = 0;
+	JD->Valid = 0;
+	JD->Verify = Verify;
+	JD->NumLin = 0;
+	return JD;
+}
+
+void
+JacFree(Jac_Data JD)
+{
+	free(JD->Row);
+	free(JD->Scale);
+	free(JD->NumCol);
+	free(JD->Col);
+	free(JD->Der);
+	free(JD->EleBlk);
+	free(JD->Ylin);
+	N_VDestroy_Serial(JD->Ftmp);
+	free(JD);
+}
+
+/* Vertical (infiltration/recharge) 3x3 block of element i in dy/dt units */
+static void
+VerticalBlk(Model_Data MD, realtype * Y, int i, realtype * J)
+{
+	int             k, NumEle;
+	realtype        S, U, G, AquiferDepth, Deficit, elemSatn, Grad_Y_Sub,
+	                satKfunc, effK, effK2, a, q, x, w, psi, T, Recharge;
+	realtype        dSatn[3], dGrad[3], dK[3], dEffK[3], dEffK2[3], dViR[3],
+	                dR[3], dD[3], dT[3], dPsi, dq, dKdS;
+
+	NumEle = MD->NumEle;
+	S = MD->DummyY[i];
+	U = MD->DummyY[i + NumEle];
+	G = MD->DummyY[i + 2 * NumEle];
+	AquiferDepth = MD->EleH.zmax[i] - MD->EleH.zmin[i];
+	for (k = 0; k < 3; k++) {
+		dViR[k] = 0;
+		dR[k] = 0;
+	}
+	if (G > AquiferDepth - MD->EleH.infD[i]) {
+		Grad_Y_Sub = (S + MD->EleH.zmax[i] - (G + MD->EleH.zmin[i])) / MD->EleH.infD[i];
+		if (!((S < EPS / 100) && (Grad_Y_Sub > 0))) {
+			effK = effKV(1.0, Grad_Y_Sub, MD->EleH.macKsatV[i], MD->EleH.infKsatV[i], MD->EleH.hAreaF[i]);
+			dViR[0] = effK / MD->EleH.infD[i];
+			dViR[2] = -effK / MD->EleH.infD[i];
+		}
+		for (k = 0; k < 3; k++)
+			dR[k] = dViR[k];
+	} else {
+		Deficit = AquiferDepth - G;
+		dD[0] = 0;
+		dD[1] = 0;
+		dD[2] = -1;
+		dSatn[0] = dSatn[1] = dSatn[2] = 0;
+		if ((U / Deficit) > 1) {
+			elemSatn = 1;
+		} else if (U <= 0) {
+			elemSatn = EPS / 1000.0;
+		} else {
+			elemSatn = U / Deficit;
+			dSatn[1] = 1 / Deficit;
+			dSatn[2] = U / (Deficit * Deficit);
+		}
+		if (elemSatn < multF * EPS) {
+			elemSatn = multF * EPS;
+			dSatn[1] = dSatn[2] = 0;
+		}
+		a = MD->EleH.Beta[i] / (MD->EleH.Beta[i] - 1);
+		q = pow(1 / elemSatn, a) - 1;
+		dq = -a * pow(elemSatn, -a - 1);
+		psi = -pow(q, 1 / MD->EleH.Beta[i]) / MD->EleH.Alpha[i];
+		dPsi = (psi < MINpsi || q <= 0) ? 0 : -pow(q, 1 / MD->EleH.Beta[i] - 1) * dq / (MD->EleH.Beta[i] * MD->EleH.Alpha[i]);
+		psi = (psi < MINpsi) ? MINpsi : psi;
+		Grad_Y_Sub = (S + MD->EleH.zmax[i] - (psi + MD->EleH.zmin[i] + AquiferDepth - MD->EleH.infD[i])) / MD->EleH.infD[i];
+		for (k = 0; k < 3; k++)
+			dGrad[k] = ((k == 0) ? 1 : 0) / MD->EleH.infD[i] - dPsi * dSatn[k] / MD->EleH.infD[i];
+		if ((S < EPS / 100) && (Grad_Y_Sub > 0)) {
+			Grad_Y_Sub = 0;
+			dGrad[0] = dGrad[1] = dGrad[2] = 0;
+		}
+		w = 1 - pow(elemSatn, a);
+		x = pow(w, 1 / a);
+		satKfunc = pow(elemSatn, 0.5) * pow(-1 + x, 2);
+		dKdS = 0.5 * pow(-1 + x, 2) / pow(elemSatn, 0.5) + ((w > 0) ? 2 * pow(elemSatn, 0.5) * (1 - x) * pow(elemSatn, a - 1) * pow(w, 1 / a - 1) : 0);
+		effK = effKV(satKfunc, Grad_Y_Sub, MD->EleH.macKsatV[i], MD->EleH.infKsatV[i], MD->EleH.hAreaF[i]);
+		for (k = 0; k < 3; k++) {
+			dK[k] = dKdS * dSatn[k];
+			dEffK[k] = dEffKV(satKfunc, Grad_Y_Sub, MD->EleH.macKsatV[i], MD->EleH.infKsatV[i], MD->EleH.hAreaF[i]) * dK[k];
+			dViR[k] = 0.5 * (dEffK[k] * Grad_Y_Sub + effK * dGrad[k]);
+		}
+		if ((MD->EleH.Macropore[i] == 1) && (G > AquiferDepth - MD->EleH.macD[i])) {
+			effK2 = effK;
+			for (k = 0; k < 3; k++)
+				dEffK2[k] = dEffK[k];
+		} else {
+			effK2 = MD->EleH.KsatV[i] * satKfunc;
+			for (k = 0; k < 3; k++)
+				dEffK2[k] = MD->EleH.KsatV[i] * dK[k];
+		}
+		if (Deficit > 0) {
+			T = MD->EleH.Alpha[i] * Deficit - 2 * pow(q, 1 / MD->EleH.Beta[i]);
+			Recharge = (MD->EleH.KsatV[i] * G + effK2 * Deficit) * T / (MD->EleH.Alpha[i] * pow(Deficit + G, 2));
+			for (k = 0; k < 3; k++) {
+				dT[k] = MD->EleH.Alpha[i] * dD[k] + ((q > 0) ? -2 * pow(q, 1 / MD->EleH.Beta[i] - 1) * dq * dSatn[k] / MD->EleH.Beta[i] : 0);
+				/* Note: Deficit + G is the (constant) aquifer depth */
+				dR[k] = ((MD->EleH.KsatV[i] * ((k == 2) ? 1 : 0) + dEffK2[k] * Deficit + effK2 * dD[k]) * T + (MD->EleH.KsatV[i] * G + effK2 * Deficit) * dT[k]) / (MD->EleH.Alpha[i] * pow(Deficit + G, 2));
+			}
+			if ((Recharge > 0 && U <= 0) || (Recharge < 0 && G <= 0)) {
+				dR[0] = dR[1] = dR[2] = 0;
+			}
+		}
+	}
+	for (k = 0; k < 3; k++) {
+		J[k] = -dViR[k] / UNIT_C * dPos(Y[i + k * NumEle]);
+		J[3 + k] = (dViR[k] - dR[k]) / (MD->EleH.Porosity[i] * UNIT_C) * dPos(Y[i + k * NumEle]);
+		J[6 + k] = dR[k] / (MD->EleH.Porosity[i] * UNIT_C) * dPos(Y[i + k * NumEle]);
+	}
+}
+
+/*
+ * Linearization of f() at (t,y). Follows the flux calculation of f(); see
+ * f.c for the physical meaning of each term
+ */
+static void
+Linearize(realtype t, N_Vector CV_Y, Jac_Data JD)
+{
+	int             i, j, k, inabr, iLeft, iRight, iDown, NumEle, NumRiv, order, orderDown, found;
+	int             col[JV_MAXCOL];
+	realtype        der[JV_MAXCOL];
+	realtype       *Y, *DummyY;
+	realtype        AquiferDepth, nabrAqDepth, Distance, Dif_Y, Grad_Y, Avg_Y, effK,
+	                effKnabr, Avg_Ksat, dAi, dAn, dKi, dKn, Avg_Sf, Avg_Rough,
+	                TotalY_Riv, TotalY_Riv_down, Perem, Perem_down, dP, dPd, Avg_Perem,
+	                CrossA, CrossAdown, dA, dAd, AvgCrossA, Avg_Y_Riv, dAvgYRiv, dAvgYRivd,
+	                Wid, Wid_down, Avg_Wid, dW, dEle, dRiv, h, RivScale, RivScaleDown,
+	                BedScale, BedScaleDown, EleScale, dKL, dKR, dKLd, dKRd;
+	Model_Data      MD;
+
+	MD = JD->MD;
+	NumEle = MD->NumEle;
+	NumRiv = MD->NumRiv;
+	Y = NV_DATA_S(CV_Y);
+
+	/* refresh state dependent variables of MD (DummyY, dh/ds) at y */
+	f(t, CV_Y, JD->Ftmp, MD);
+	DummyY = MD->DummyY;
+	JD->NumFlux = 0;
+
+	for (k = 0; k < MD->NumEdge; k++) {
+		i = MD->Edge[k].ele[0];
+		j = MD->Edge[k].loc[0];
+		AquiferDepth = MD->EleH.zmax[i] - MD->EleH.zmin[i];
+		if (MD->Edge[k].ele[1] >= 0 && MD->Edge[k].BC > -4) {
+			inabr = MD->Edge[k].ele[1];
+			/* subsurface Darcy flux */
+			Dif_Y = (DummyY[i + 2 * NumEle] + MD->EleH.zmin[i]) - (DummyY[inabr + 2 * NumEle] + MD->EleH.zmin[inabr]);
+			Avg_Y = avgY(Dif_Y, DummyY[i + 2 * NumEle], DummyY[inabr + 2 * NumEle]);
+			dAvgY(Dif_Y, DummyY[i + 2 * NumEle], DummyY[inabr + 2 * NumEle], &dAi, &dAn);
+			Distance = MD->Edge[k].Distance;
+			Grad_Y = Dif_Y / Distance;
+			nabrAqDepth = (MD->EleH.zmax[inabr] - MD->EleH.zmin[inabr]);
+			effK = effKH(MD->EleH.Macropore[i], DummyY[i + 2 * NumEle], AquiferDepth, MD->EleH.macD[i], MD->EleH.macKsatH[i], MD->EleH.vAreaF[i], MD->EleH.KsatH[i]);
+			effKnabr = effKH(MD->EleH.Macropore[inabr], DummyY[inabr + 2 * NumEle], nabrAqDepth, MD->EleH.macD[inabr], MD->EleH.macKsatH[inabr], MD->EleH.vAreaF[inabr], MD->EleH.KsatH[inabr]);
+			dKi = 0.5 * dEffKH(MD->EleH.Macropore[i], DummyY[i + 2 * NumEle], AquiferDepth, MD->EleH.macD[i], MD->EleH.macKsatH[i], MD->EleH.vAreaF[i], MD->EleH.KsatH[i]);
+			dKn = 0.5 * dEffKH(MD->EleH.Macropore[inabr], DummyY[inabr + 2 * NumEle], nabrAqDepth, MD->EleH.macD[inabr], MD->EleH.macKsatH[inabr], MD->EleH.vAreaF[inabr], MD->EleH.KsatH[inabr]);
+			Avg_Ksat = 0.5 * (effK + effKnabr);
+			col[0] = i + 2 * NumEle;
+			col[1] = inabr + 2 * NumEle;
+			der[0] = MD->Edge[k].length * (dKi * Grad_Y * Avg_Y + Avg_Ksat * Avg_Y / Distance + Avg_Ksat * Grad_Y * dAi) * dPos(Y[col[0]]);
+			der[1] = MD->Edge[k].length * (dKn * Grad_Y * Avg_Y - Avg_Ksat * Avg_Y / Distance + Avg_Ksat * Grad_Y * dAn) * dPos(Y[col[1]]);
+			AddFlux(JD, i + 2 * NumEle, -1 / (MD->EleH.area[i] * MD->EleH.Porosity[i] * UNIT_C), inabr + 2 * NumEle, 1 / (MD->EleH.area[inabr] * MD->EleH.Porosity[inabr] * UNIT_C), 2, col, der);
+			/* overland Manning flux */
+			Dif_Y = (MD->SurfMode == 1) ? (MD->EleH.zmax[i] - MD->EleH.zmax[inabr]) : (DummyY[i] + MD->EleH.zmax[i]) - (DummyY[inabr] + MD->EleH.zmax[inabr]);
+			Avg_Y = avgY(Dif_Y, DummyY[i], DummyY[inabr]);
+			dAvgY(Dif_Y, DummyY[i], DummyY[inabr], &dAi, &dAn);
+			Grad_Y = Dif_Y / Distance;
+			Avg_Sf = 0.5 * (sqrt(pow(MD->Ele[i].dhBYdx, 2) + pow(MD->Ele[i].dhBYdy, 2)) + sqrt(pow(MD->Ele[inabr].dhBYdx, 2) + pow(MD->Ele[inabr].dhBYdy, 2)));
+			Avg_Sf = (MD->SurfMode == 1) ? (Grad_Y > 0 ? Grad_Y : EPS / pow(10.0, 6)) : (Avg_Sf > EPS / pow(10.0, 6)) ? Avg_Sf : EPS / pow(10.0, 6);
+			Avg_Rough = 0.5 * (MD->EleH.Rough[i] + MD->EleH.Rough[inabr]);
+			col[0] = i;
+			col[1] = inabr;
+			der[0] = dOverlandFlow(Avg_Y, Grad_Y, Avg_Sf, Avg_Y * MD->Edge[k].length, Avg_Rough, dAi, (MD->SurfMode == 1) ? 0 : 1 / Distance, 0, dAi * MD->Edge[k].length) * dPos(Y[i]);
+			der[1] = dOverlandFlow(Avg_Y, Grad_Y, Avg_Sf, Avg_Y * MD->Edge[k].length, Avg_Rough, dAn, (MD->SurfMode == 1) ? 0 : -1 / Distance, 0, dAn * MD->Edge[k].length) * dPos(Y[inabr]);
+			if (MD->SurfMode == 1) {
+				/* the flux of each side, as in f() */
+				AddFlux(JD, i, -1 / (MD->EleH.area[i] * UNIT_C), -1, 0, 2, col, der);
+				Avg_Y = avgY(-Dif_Y, DummyY[inabr], DummyY[i]);
+				dAvgY(-Dif_Y, DummyY[inabr], DummyY[i], &dAn, &dAi);
+				Avg_Sf = (-Grad_Y > 0) ? -Grad_Y : EPS / pow(10.0, 6);
+				der[0] = dOverlandFlow(Avg_Y, -Grad_Y, Avg_Sf, Avg_Y * MD->Edge[k].length, Avg_Rough, dAi, 0, 0, dAi * MD->Edge[k].length) * dPos(Y[i]);
+				der[1] = dOverlandFlow(Avg_Y, -Grad_Y, Avg_Sf, Avg_Y * MD->Edge[k].length, Avg_Rough, dAn, 0, 0, dAn * MD->Edge[k].length) * dPos(Y[inabr]);
+				AddFlux(JD, inabr, -1 / (MD->EleH.area[inabr] * UNIT_C), -1, 0, 2, col, der);
+			} else {
+				AddFlux(JD, i, -1 / (MD->EleH.area[i] * UNIT_C), inabr, 1 / (MD->EleH.area[inabr] * UNIT_C), 2, col, der);
+			}
+		} else if (MD->Edge[k].ele[1] < 0 && MD->Edge[k].BC == 1) {
+			/* Dirichlet boundary condition */
+			h = Interpolation(&MD->TSD_EleBC[(MD->Edge[k].BC) - 1], t);
+			Dif_Y = (DummyY[i + 2 * NumEle] + MD->EleH.zmin[i]) - h;
+			Avg_Y = avgY(Dif_Y, DummyY[i + 2 * NumEle], h - MD->EleH.zmin[i]);
+			dAvgY(Dif_Y, DummyY[i + 2 * NumEle], h - MD->EleH.zmin[i], &dAi, &dAn);
+			Distance = MD->Edge[k].Distance;
+			effK = effKH(MD->EleH.Macropore[i], DummyY[i + 2 * NumEle], AquiferDepth, MD->EleH.macD[i], MD->EleH.macKsatH[i], MD->EleH.vAreaF[i], MD->EleH.KsatH[i]);
+			dKi = dEffKH(MD->EleH.Macropore[i], DummyY[i + 2 * NumEle], AquiferDepth, MD->EleH.macD[i], MD->EleH.macKsatH[i], MD->EleH.vAreaF[i], MD->EleH.KsatH[i]);
+			Grad_Y = Dif_Y / Distance;
+			col[0] = i + 2 * NumEle;
+			der[0] = MD->Edge[k].length * (dKi * Grad_Y * Avg_Y + effK * Avg_Y / Distance + effK * Grad_Y * dAi) * dPos(Y[col[0]]);
+			AddFlux(JD, i + 2 * NumEle, -1 / (MD->EleH.area[i] * MD->EleH.Porosity[i] * UNIT_C), -1, 0, 1, col, der);
+		}
+	}
+	for (i = 0; i < NumEle; i++) {
+		VerticalBlk(MD, Y, i, JD->EleBlk + 9 * i);
+	}
+
+	for (i = 0; i < NumRiv; i++) {
+		order = MD->Riv_Shape[MD->Riv[i].shape - 1].interpOrd;
+		iLeft = MD->Riv[i].LeftEle - 1;
+		iRight = MD->Riv[i].RightEle - 1;
+		RivScale = 1 / (MD->Riv[i].Length * CS_AreaOrPerem(order, MD->Riv[i].depth, MD->Riv[i].coeff, 3) * UNIT_C);
+		BedScale = RivScale / MD->EleH.Porosity[i + NumEle];
+		TotalY_Riv = DummyY[i + 3 * NumEle] + MD->Riv[i].zmin;
+		Perem = CS_AreaOrPerem(order, DummyY[i + 3 * NumEle], MD->Riv[i].coeff, 2);
+		dP = dCS_AreaOrPerem(order, DummyY[i + 3 * NumEle], MD->Riv[i].coeff, 2);
+		CrossA = CS_AreaOrPerem(order, DummyY[i + 3 * NumEle], MD->Riv[i].coeff, 1);
+		dA = dCS_AreaOrPerem(order, DummyY[i + 3 * NumEle], MD->Riv[i].coeff, 1);
+		dKL = dEffKH(MD->EleH.Macropore[iLeft], DummyY[iLeft + 2 * NumEle], MD->EleH.zmax[iLeft] - MD->EleH.zmin[iLeft], MD->EleH.macD[iLeft], MD->EleH.macKsatH[iLeft], MD->EleH.vAreaF[iLeft], MD->EleH.KsatH[iLeft]);
+		dKR = dEffKH(MD->EleH.Macropore[iRight], DummyY[iRight + 2 * NumEle], MD->EleH.zmax[iRight] - MD->EleH.zmin[iRight], MD->EleH.macD[iRight], MD->EleH.macKsatH[iRight], MD->EleH.vAreaF[iRight], MD->EleH.KsatH[iRight]);
+		effK = 0.5 * (effKH(MD->EleH.Macropore[iLeft], DummyY[iLeft + 2 * NumEle], MD->EleH.zmax[iLeft] - MD->EleH.zmin[iLeft], MD->EleH.macD[iLeft], MD->EleH.macKsatH[iLeft], MD->EleH.vAreaF[iLeft], MD->EleH.KsatH[iLeft]) + effKH(MD->EleH.Macropore[iRight], DummyY[iRight + 2 * NumEle], MD->EleH.zmax[iRight] - MD->EleH.zmin[iRight], MD->EleH.macD[iRight], MD->EleH.macKsatH[iRight], MD->EleH.vAreaF[iRight], MD->EleH.KsatH[iRight]));
+		if (MD->Riv[i].down > 0) {
+			/* river-river Manning flux */
+			iDown = MD->Riv[i].down - 1;
+			orderDown = MD->Riv_Shape[MD->Riv[iDown].shape - 1].interpOrd;
+			RivScaleDown = 1 / (MD->Riv[iDown].Length * CS_AreaOrPerem(orderDown, MD->Riv[iDown].depth, MD->Riv[iDown].coeff, 3) * UNIT_C);
+			BedScaleDown = RivScaleDown / MD->EleH.Porosity[iDown + NumEle];
+			TotalY_Riv_down = DummyY[iDown + 3 * NumEle] + MD->Riv[iDown].zmin;
+			Perem_down = CS_AreaOrPerem(orderDown, DummyY[iDown + 3 * NumEle], MD->Riv[iDown].coeff, 2);
+			dPd = dCS_AreaOrPerem(orderDown, DummyY[iDown + 3 * NumEle], MD->Riv[iDown].coeff, 2);
+			Avg_Perem = (Perem + Perem_down) / 2.0;
+			Avg_Rough = (MD->Riv_Mat[MD->Riv[i].material - 1].Rough + MD->Riv_Mat[MD->Riv[iDown].material - 1].Rough) / 2.0;
+			Distance = 0.5 * (MD->Riv[i].Length + MD->Riv[iDown].Length);
+			Dif_Y = (MD->RivMode == 1) ? (MD->Riv[i].zmin - MD->Riv[iDown].zmin) : (TotalY_Riv - TotalY_Riv_down);
+			Grad_Y = Dif_Y / Distance;
+			Avg_Sf = (Grad_Y > 0) ? Grad_Y : EPS;
+			CrossAdown = CS_AreaOrPerem(orderDown, DummyY[iDown + 3 * NumEle], MD->Riv[iDown].coeff, 1);
+			dAd = dCS_AreaOrPerem(orderDown, DummyY[iDown + 3 * NumEle], MD->Riv[iDown].coeff, 1);
+			AvgCrossA = 0.5 * (CrossA + CrossAdown);
+			Avg_Y_Riv = (Avg_Perem == 0) ? 0 : (AvgCrossA / Avg_Perem);
+			dAvgYRiv = (Avg_Perem == 0) ? 0 : (0.5 * dA * Avg_Perem - AvgCrossA * 0.5 * dP) / (Avg_Perem * Avg_Perem);
+			dAvgYRivd = (Avg_Perem == 0) ? 0 : (0.5 * dAd * Avg_Perem - AvgCrossA * 0.5 * dPd) / (Avg_Perem * Avg_Perem);
+			col[0] = i + 3 * NumEle;
+			col[1] = iDown + 3 * NumEle;
+			der[0] = dOverlandFlow(Avg_Y_Riv, Grad_Y, Avg_Sf, CrossA, Avg_Rough, dAvgYRiv, (MD->RivMode == 1) ? 0 : 1 / Distance, (MD->RivMode == 1 || Grad_Y <= 0) ? 0 : 1 / Distance, dA) * dPos(Y[col[0]]);
+			der[1] = dOverlandFlow(Avg_Y_Riv, Grad_Y, Avg_Sf, CrossA, Avg_Rough, dAvgYRivd, (MD->RivMode == 1) ? 0 : -1 / Distance, (MD->RivMode == 1 || Grad_Y <= 0) ? 0 : -1 / Distance, 0) * dPos(Y[col[1]]);
+			AddFlux(JD, i + 3 * NumEle, -RivScale, iDown + 3 * NumEle, RivScaleDown, 2, col, der);
+			/* flux between elements beneath river segments */
+			Dif_Y = (DummyY[i + 3 * NumEle + NumRiv] + MD->EleH.zmin[i + NumEle]) - (DummyY[iDown + 3 * NumEle + NumRiv] + MD->EleH.zmin[iDown + NumEle]);
+			Avg_Y = avgY(Dif_Y, DummyY[i + 3 * NumEle + NumRiv], DummyY[iDown + 3 * NumEle + NumRiv]);
+			dAvgY(Dif_Y, DummyY[i + 3 * NumEle + NumRiv], DummyY[iDown + 3 * NumEle + NumRiv], &dAi, &dAn);
+			Wid = CS_AreaOrPerem(order, MD->Riv[i].depth, MD->Riv[i].coeff, 3);
+			Wid_down = CS_AreaOrPerem(orderDown, MD->Riv[iDown].depth, MD->Riv[iDown].coeff, 3);
+			Avg_Wid = (Wid + Wid_down) / 2.0;
+			Grad_Y = Dif_Y / Distance;
+			effKnabr = 0.5 * (effKH(MD->EleH.Macropore[MD->Riv[iDown].LeftEle - 1], DummyY[MD->Riv[iDown].LeftEle - 1 + 2 * NumEle], MD->EleH.zmax[MD->Riv[iDown].LeftEle - 1] - MD->EleH.zmin[MD->Riv[iDown].LeftEle - 1], MD->EleH.macD[MD->Riv[iDown].LeftEle - 1], MD->EleH.macKsatH[MD->Riv[iDown].LeftEle - 1], MD->EleH.vAreaF[MD->Riv[iDown].LeftEle - 1], MD->EleH.KsatH[MD->Riv[iDown].LeftEle - 1]) + effKH(MD->EleH.Macropore[MD->Riv[iDown].RightEle - 1], DummyY[MD->Riv[iDown].RightEle - 1 + 2 * NumEle], MD->EleH.zmax[MD->Riv[iDown].RightEle - 1] - MD->EleH.zmin[MD->Riv[iDown].RightEle - 1], MD->EleH.macD[MD->Riv[iDown].RightEle - 1], MD->EleH.macKsatH[MD->Riv[iDown].RightEle - 1], MD->EleH.vAreaF[MD->Riv[iDown].RightEle - 1], MD->EleH.KsatH[MD->Riv[iDown].RightEle - 1]));
+			dKLd = dEffKH(MD->EleH.Macropore[MD->Riv[iDown].LeftEle - 1], DummyY[MD->Riv[iDown].LeftEle - 1 + 2 * NumEle], MD->EleH.zmax[MD->Riv[iDown].LeftEle - 1] - MD->EleH.zmin[MD->Riv[iDown].LeftEle - 1], MD->EleH.macD[MD->Riv[iDown].LeftEle - 1], MD->EleH.macKsatH[MD->Riv[iDown].LeftEle - 1], MD->EleH.vAreaF[MD->Riv[iDown].LeftEle - 1], MD->EleH.KsatH[MD->Riv[iDown].LeftEle - 1]);
+			dKRd = dEffKH(MD->EleH.Macropore[MD->Riv[iDown].RightEle - 1], DummyY[MD->Riv[iDown].RightEle - 1 + 2 * NumEle], MD->EleH.zmax[MD->Riv[iDown].RightEle - 1] - MD->EleH.zmin[MD->Riv[iDown].RightEle - 1], MD->EleH.macD[MD->Riv[iDown].RightEle - 1], MD->EleH.macKsatH[MD->Riv[iDown].RightEle - 1], MD->EleH.vAreaF[MD->Riv[iDown].RightEle - 1], MD->EleH.KsatH[MD->Riv[iDown].RightEle - 1]);
+			Avg_Ksat = 0.5 * (effK + effKnabr);
+			col[0] = i + 3 * NumEle + NumRiv;
+			col[1] = iDown + 3 * NumEle + NumRiv;
+			col[2] = iLeft + 2 * NumEle;
+			col[3] = iRight + 2 * NumEle;
+			col[4] = MD->Riv[iDown].LeftEle - 1 + 2 * NumEle;
+			col[5] = MD->Riv[iDown].RightEle - 1 + 2 * NumEle;
+			der[0] = Avg_Wid * (Avg_Ksat * Avg_Y / Distance + Avg_Ksat * Grad_Y * dAi) * dPos(Y[col[0]]);
+			der[1] = Avg_Wid * (-Avg_Ksat * Avg_Y / Distance + Avg_Ksat * Grad_Y * dAn) * dPos(Y[col[1]]);
+			der[2] = Avg_Wid * 0.25 * dKL * Grad_Y * Avg_Y * dPos(Y[col[2]]);
+			der[3] = Avg_Wid * 0.25 * dKR * Grad_Y * Avg_Y * dPos(Y[col[3]]);
+			der[4] = Avg_Wid * 0.25 * dKLd * Grad_Y * Avg_Y * dPos(Y[col[4]]);
+			der[5] = Avg_Wid * 0.25 * dKRd * Grad_Y * Avg_Y * dPos(Y[col[5]]);
+			AddFlux(JD, i + 3 * NumEle + NumRiv, -BedScale, iDown + 3 * NumEle + NumRiv, BedScaleDown, 6, col, der);
+		} else {
+			col[0] = i + 3 * NumEle;
+			der[0] = 0;
+			switch (MD->Riv[i].down) {
+			case -1:
+				/* Dirichlet boundary condition */
+				h = Interpolation(&MD->TSD_Riv[(MD->Riv[i].BC) - 1], t);
+				TotalY_Riv_down = h + (MD->Node[MD->Riv[i].ToNode - 1].zmax - MD->Riv[i].depth);
+				Distance = sqrt(pow(MD->Riv[i].x - MD->Node[MD->Riv[i].ToNode - 1].x, 2) + pow(MD->Riv[i].y - MD->Node[MD->Riv[i].ToNode - 1].y, 2));
+				Grad_Y = (TotalY_Riv - TotalY_Riv_down) / Distance;
+				Avg_Rough = MD->Riv_Mat[MD->Riv[i].material - 1].Rough;
+				Avg_Y_Riv = (Perem == 0) ? 0 : (CrossA / Perem);
+				dAvgYRiv = (Perem == 0) ? 0 : (dA * Perem - CrossA * dP) / (Perem * Perem);
+				der[0] = dOverlandFlow(Avg_Y_Riv, Grad_Y, Grad_Y, CrossA, Avg_Rough, dAvgYRiv, 1 / Distance, 1 / Distance, dA);
+				break;
+			case -3:
+				/* zero-depth-gradient boundary conditions */
+				Distance = sqrt(pow(MD->Riv[i].x - MD->Node[MD->Riv[i].ToNode - 1].x, 2) + pow(MD->Riv[i].y - MD->Node[MD->Riv[i].ToNode - 1].y, 2));
+				Grad_Y = (MD->Riv[i].zmin - (MD->Node[MD->Riv[i].ToNode - 1].zmax - MD->Riv[i].depth)) / Distance;
+				Avg_Rough = MD->Riv_Mat[MD->Riv[i].material - 1].Rough;
+				if (Perem > 0 && CrossA > 0)
+					der[0] = sqrt(Grad_Y) * (dA * pow(CrossA / Perem, 2.0 / 3.0) + CrossA * (2.0 / 3.0) * pow(CrossA / Perem, -1.0 / 3.0) * (dA * Perem - CrossA * dP) / (Perem * Perem)) / Avg_Rough;
+				break;
+			case -4:
+				/* Critical Depth boundary conditions */
+				if (DummyY[i + 3 * NumEle] > 0)
+					der[0] = dA * sqrt(GRAV * UNIT_C * UNIT_C * DummyY[i + 3 * NumEle]) + CrossA * 0.5 * GRAV * UNIT_C * UNIT_C / sqrt(GRAV * UNIT_C * UNIT_C * DummyY[i + 3 * NumEle]);
+				break;
+			default:
+				break;
+			}
+			der[0] = der[0] * dPos(Y[col[0]]);
+			AddFlux(JD, i + 3 * NumEle, -RivScale, -1, 0, 1, col, der);
+		}
+		/* element-river fluxes of left (k = 0) and right (k = 1) banks */
+		for (k = 0; k < 2; k++) {
+			inabr = (k == 0) ? iLeft : iRight;
+			if (inabr < 0)
+				continue;
+			found = 0;
+			for (j = 0; j < 3; j++) {
+				if (MD->Ele[inabr].nabr[j] == ((k == 0) ? MD->Riv[i].RightEle : MD->Riv[i].LeftEle)) {
+					found = 1;
+					break;
+				}
+			}
+			EleScale = (found == 1) ? 1 / (MD->EleH.area[inabr] * UNIT_C) : 0;
+			/* overland flow to/from river */
+			dOLFeleToriv(DummyY[inabr] + MD->EleH.zmax[inabr], MD->EleH.zmax[inabr], MD->Riv_Mat[MD->Riv[i].material - 1].Cwr, MD->Riv[i].zmax, TotalY_Riv, MD->Riv[i].Length, &dEle, &dRiv);
+			col[0] = inabr;
+			col[1] = i + 3 * NumEle;
+			der[0] = dEle * dPos(Y[col[0]]);
+			der[1] = dRiv * dPos(Y[col[1]]);
+			AddFlux(JD, i + 3 * NumEle, -RivScale, inabr, EleScale, 2, col, der);
+			/* subsurface flux between river and bank element */
+			Dif_Y = (DummyY[i + 3 * NumEle] + MD->Riv[i].zmin) - (DummyY[inabr + 2 * NumEle] + MD->EleH.zmin[inabr]);
+			if (MD->EleH.zmin[inabr] > MD->Riv[i].zmin) {
+				Avg_Y = DummyY[inabr + 2 * NumEle];
+				dW = 1;
+			} else if (MD->EleH.zmin[inabr] + DummyY[inabr + 2 * NumEle] > MD->Riv[i].zmin) {
+				Avg_Y = MD->EleH.zmin[inabr] + DummyY[inabr + 2 * NumEle] - MD->Riv[i].zmin;
+				dW = 1;
+			} else {
+				Avg_Y = 0;
+				dW = 0;
+			}
+			dAvgY(Dif_Y, DummyY[i + 3 * NumEle], Avg_Y, &dAi, &dAn);
+			dAn = dAn * dW;
+			Avg_Y = avgY(Dif_Y, DummyY[i + 3 * NumEle], Avg_Y);
+			Distance = sqrt(pow((MD->Riv[i].x - MD->Ele[inabr].x), 2) + pow((MD->Riv[i].y - MD->Ele[inabr].y), 2));
+			Grad_Y = Dif_Y / Distance;
+			AquiferDepth = (MD->EleH.zmax[inabr] - MD->EleH.zmin[inabr]);
+			effKnabr = effKH(MD->EleH.Macropore[inabr], DummyY[inabr + 2 * NumEle], AquiferDepth, MD->EleH.macD[inabr], MD->EleH.macKsatH[inabr], MD->EleH.vAreaF[inabr], MD->EleH.KsatH[inabr]);
+			dKn = 0.5 * ((k == 0) ? dKL : dKR);
+			Avg_Ksat = 0.5 * (MD->Riv[i].KsatH + effKnabr);
+			col[0] = i + 3 * NumEle;
+			col[1] = inabr + 2 * NumEle;
+			der[0] = MD->Riv[i].Length * (Avg_Ksat * Avg_Y / Distance + Avg_Ksat * Grad_Y * dAi) * dPos(Y[col[0]]);
+			der[1] = MD->Riv[i].Length * (dKn * Grad_Y * Avg_Y - Avg_Ksat * Avg_Y / Distance + Avg_Ksat * Grad_Y * dAn) * dPos(Y[col[1]]);
+			AddFlux(JD, i + 3 * NumEle, -RivScale, inabr + 2 * NumEle, EleScale / MD->EleH.Porosity[inabr], 2, col, der);
+			/* flux between element beneath river and bank element */
+			Dif_Y = (DummyY[i + 3 * NumEle + NumRiv] + MD->EleH.zmin[i + NumEle]) - (DummyY[inabr + 2 * NumEle] + MD->EleH.zmin[inabr]);
+			if (MD->EleH.zmin[inabr] > MD->Riv[i].zmin) {
+				Avg_Y = 0;
+				dW = 0;
+			} else if (MD->EleH.zmin[inabr] + DummyY[inabr + 2 * NumEle] > MD->Riv[i].zmin) {
+				Avg_Y = MD->Riv[i].zmin - MD->EleH.zmin[inabr];
+				dW = 0;
+			} else {
+				Avg_Y = DummyY[inabr + 2 * NumEle];
+				dW = 1;
+			}
+			dAvgY(Dif_Y, DummyY[i + 3 * NumEle + NumRiv], Avg_Y, &dAi, &dAn);
+			dAn = dAn * dW;
+			Avg_Y = avgY(Dif_Y, DummyY[i + 3 * NumEle + NumRiv], Avg_Y);
+			Avg_Ksat = 0.5 * (effK + effKnabr);
+			Grad_Y = Dif_Y / Distance;
+			col[0] = i + 3 * NumEle + NumRiv;
+			col[1] = iLeft + 2 * NumEle;
+			col[2] = iRight + 2 * NumEle;
+			der[0] = MD->Riv[i].Length * (Avg_Ksat * Avg_Y / Distance + Avg_Ksat * Grad_Y * dAi) * dPos(Y[col[0]]);
+			/* effK averages both banks, effKnabr is the bank itself */
+			der[1] = MD->Riv[i].Length * ((0.25 * dKL + ((k == 0) ? 0.5 * dKL : 0)) * Grad_Y * Avg_Y + ((k == 0) ? -Avg_Ksat / Distance * Avg_Y + Avg_Ksat * Grad_Y * dAn : 0)) * dPos(Y[col[1]]);
+			der[2] = MD->Riv[i].Length * ((0.25 * dKR + ((k == 1) ? 0.5 * dKR : 0)) * Grad_Y * Avg_Y + ((k == 1) ? -Avg_Ksat / Distance * Avg_Y + Avg_Ksat * Grad_Y * dAn : 0)) * dPos(Y[col[2]]);
+			AddFlux(JD, i + 3 * NumEle + NumRiv, -BedScale, inabr + 2 * NumEle, EleScale / MD->EleH.Porosity[inabr], 3, col, der);
+		}
+		/* leakage through river bed */
+		Avg_Wid = CS_AreaOrPerem(order, DummyY[i + 3 * NumEle], MD->Riv[i].coeff, 3);
+		dW = dCS_AreaOrPerem(order, DummyY[i + 3 * NumEle], MD->Riv[i].coeff, 3);
+		if ((MD->Riv[i].zmin - (DummyY[i + 3 * NumEle + NumRiv] + MD->EleH.zmin[i + NumEle])) > 0) {
+			Dif_Y = DummyY[i + 3 * NumEle];
+			dAn = 0;
+		} else {
+			Dif_Y = DummyY[i + 3 * NumEle] + MD->Riv[i].zmin - (DummyY[i + 3 * NumEle + NumRiv] + MD->EleH.zmin[i + NumEle]);
+			dAn = -1;
+		}
+		col[0] = i + 3 * NumEle;
+		col[1] = i + 3 * NumEle + NumRiv;
+		der[0] = MD->Riv[i].KsatV * MD->Riv[i].Length * (dW * Dif_Y + Avg_Wid) / MD->Riv[i].bedThick * dPos(Y[col[0]]);
+		der[1] = MD->Riv[i].KsatV * MD->Riv[i].Length * Avg_Wid * dAn / MD->Riv[i].bedThick * dPos(Y[col[1]]);
+		AddFlux(JD, i + 3 * NumEle, -RivScale, i + 3 * NumEle + NumRiv, BedScale, 2, col, der);
+	}
+}
+
+static void
+JvProduct(Jac_Data JD, realtype * V, realtype * JV)
+{
+	int             i, k, m, NumEle;
+	realtype        dF, *J;
+
+	NumEle = JD->MD->NumEle;
+	for (i = 0; i < 3 * NumEle + 2 * JD->MD->NumRiv; i++) {
+		JV[i] = 0;
+	}
+	for (i = 0; i < NumEle; i++) {
+		J = JD->EleBlk + 9 * i;
+		for (k = 0; k < 3; k++) {
+			JV[i + k * NumEle] = J[3 * k] * V[i] + J[3 * k + 1] * V[i + NumEle] + J[3 * k + 2] * V[i + 2 * NumEle];
+		}
+	}
+	for (m = 0; m < JD->NumFlux; m++) {
+		dF = 0;
+		for (k = 0; k < JD->NumCol[m]; k++) {
+			dF = dF + JD->Der[JV_MAXCOL * m + k] * V[JD->Col[JV_MAXCOL * m + k]];
+		}
+		JV[JD->Row[2 * m]] = JV[JD->Row[2 * m]] + JD->Scale[2 * m] * dF;
+		if (JD->Row[2 * m + 1] >= 0)
+			JV[JD->Row[2 * m + 1]] = JV[JD->Row[2 * m + 1]] + JD->Scale[2 * m + 1] * dF;
+	}
+}
+
+/*
+ * Compare analytic J*v with the finite difference product used by CVSPILS.
+ * The perturbed state is built in tmp, CV_Y is not touched; f is then
+ * evaluated at CV_Y again so that the fluxes it leaves in MD are those of
+ * Linearize.
+ */
+static void
+JvVerify(realtype t, N_Vector v, N_Vector Jv, N_Vector CV_Y, N_Vector fy, N_Vector tmp, Jac_Data JD)
+{
+	int             i, g, N, NumEle, NumRiv, start[6];
+	realtype        sig, vnorm, ynorm, diff[5], scale[5];
+	realtype       *V, *JV, *Y, *FY, *FT;
+	const char     *name[5] = {"surf", "unsat", "sat", "stage", "bed"};
+
+	NumEle = JD->MD->NumEle;
+	NumRiv = JD->MD->NumRiv;
+	N = 3 * NumEle + 2 * NumRiv;
+	V = NV_DATA_S(v);
+	JV = NV_DATA_S(Jv);
+	Y = NV_DATA_S(CV_Y);
+	FY = NV_DATA_S(fy);
+	FT = NV_DATA_S(JD->Ftmp);
+	vnorm = 0;
+	ynorm = 0;
+	for (i = 0; i < N; i++) {
+		vnorm = (fabs(V[i]) > vnorm) ? fabs(V[i]) : vnorm;
+		ynorm = (fabs(Y[i]) > ynorm) ? fabs(Y[i]) : ynorm;
+	}
+	if (vnorm == 0)
+		return;
+	sig = SRUR * (1 + ynorm) / vnorm;
+	N_VLinearSum(1.0, CV_Y, sig, v, tmp);
+	f(t, tmp, JD->Ftmp, JD->MD);
+	start[0] = 0;
+	start[1] = NumEle;
+	start[2] = 2 * NumEle;
+	start[3] = 3 * NumEle;
+	start[4] = 3 * NumEle + NumRiv;
+	start[5] = N;
+	for (g = 0; g < 5; g++) {
+		diff[g] = 0;
+		scale[g] = 0;
+		for (i = start[g]; i < start[g + 1]; i++) {
+			FT[i] = (FT[i] - FY[i]) / sig;
+			diff[g] = (fabs(FT[i] - JV[i]) > diff[g]) ? fabs(FT[i] - JV[i]) : diff[g];
+			scale[g] = (fabs(FT[i]) > scale[g]) ? fabs(FT[i]) : scale[g];
+		}
+	}
+	printf("\n J*v check t = %lf:", t);
+	for (g = 0; g < 5; g++) {
+		printf(" %s %.3e", name[g], (scale[g] > 0) ? diff[g] / scale[g] : diff[g]);
+	}
+	f(t, CV_Y, JD->Ftmp, JD->MD);
+}
+
+int
+JTimes(N_Vector v, N_Vector Jv, realtype t, N_Vector CV_Y, N_Vector fy, void *jac_data, N_Vector tmp)
+{
+	int             i, N, newLin;
+	realtype       *Y;
+	Jac_Data        JD;
+
+	JD = (Jac_Data) jac_data;
+	N = 3 * JD->MD->NumEle + 2 * JD->MD->NumRiv;
+	Y = NV_DATA_S(CV_Y);
+	newLin = (JD->Valid == 0 || t != JD->tlin || memcmp(Y, JD->Ylin, N * sizeof(realtype)) != 0);
+	if (newLin) {
+		Linearize(t, CV_Y, JD);
+		for (i = 0; i < N; i++) {
+			JD->Ylin[i] = Y[i];
+		}
+		JD->tlin = t;
+		JD->Valid = 1;
+		JD->NumLin++;
+	}
+	JvProduct(JD, NV_DATA_S(v), NV_DATA_S(Jv));
+	if (JD->Verify == 1 && newLin)
+		JvVerify(t, v, Jv, CV_Y, fy, tmp, JD);
+	return 0;
+}
@@ -0,0 +1,271 @@
+/*******************************************************************************
+ * File        : parse.c                                                       *
+ * Function    : Buffered tokenizer for the text input files (read_alloc.c)    *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) Files are read in blocks of TEXT_BUF bytes; TextInt, TextReal and       *
+ *    TextWord return whitespace separated fields from the buffer, replacing  *
+ *    fscanf. TextTell/TextSeek allow reading again from a saved position.    *
+ * b) TextReal parses decimal numbers without the C library: when the digits  *
+ *    fit in 53 bits and the power of ten is at most 22, one multiplication   *
+ *    or division by an exact power of ten gives the correctly rounded value  *
+ *    (the strtod result). Other forms (long mantissas, large exponents, inf, *
+ *    nan, hex) are passed to strtod.                                         *
+ * c) A malformed or missing field stops the run with the file name, line     *
+ *    and the name of the field that was expected.                            *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sundials_types.h"
+#include "pihm.h"
+
+/* exact powers of ten in double precision */
+static const double Pow10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/* filename+ext opened for reading, NULL if it cannot be opened */
+text_file      *
+TextOpen(char *filename, char *ext)
+{
+	text_file      *T;
+
+	T = (text_file *) malloc(sizeof(text_file));
+	T->name = (char *) malloc((strlen(filename) + strlen(ext) + 1) * sizeof(char));
+	strcpy(T->name, filename);
+	strcat(T->name, ext);
+	T->fp = fopen(T->name, "rb");
+	if (T->fp == NULL) {
+		free(T->name);
+		free(T);
+		return (NULL);
+	}
+	T->buf = (char *) malloc(TEXT_BUF + 1);
+	T->buf[0] = '\0';
+	T->len = 0;
+	T->pos = 0;
+	T->off = 0;
+	T->line = 1;
+	return (T);
+}
+
+void
+TextClose(text_file * T)
+{
+	fclose(T->fp);
+	free(T->buf);
+	free(T->name);
+	free(T);
+}
+
+/* Continue reading at file offset off, which is on line line */
+void
+TextSeek(text_file * T, long off, int line)
+{
+	fseek(T->fp, off, SEEK_SET);
+	T->off = off;
+	T->len = 0;
+	T->pos = 0;
+	T->buf[0] = '\0';
+	T->line = line;
+}
+
+/* File offset of the next unread byte */
+long
+TextTell(text_file * T)
+{
+	return (T->off + (long) T->pos);
+}
+
+/*
+ * Move the unread bytes to the front of the buffer and read the next
+ * block behind them. Returns the number of bytes read (0 at end of file).
+ */
+static size_t
+Fill(text_file * T)
+{
+	size_t          n;
+
+	memmove(T->buf, T->buf + T->pos, T->len - T->pos);
+	T->off = T->off + (long) T->pos;
+	T->len = T->len - T->pos;
+	T->pos = 0;
+	n = fread(T->buf + T->len, 1, TEXT_BUF - T->len, T->fp);
+	T->len = T->len + n;
+	T->buf[T->len] = '\0';
+	return (n);
+}
+
+static void
+TextError(text_file * T, char *expect, char *what, char *tok, size_t n)
+{
+	if (n == 0) {
+		printf("\n  Fatal Error: %s line %d: end of file, %s expected for %s\n", T->name, T->line, expect, what);
+	} else {
+		printf("\n  Fatal Error: %s line %d: %s expected for %s, found \"%.*s\"\n", T->name, T->line, expect, what, (int) (n < 40 ? n : 40), tok);
+	}
+	exit(1);
+}
+
+#define IS_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r' || (c) == '\f' || (c) == '\v')
+
+static void
+SkipSpace(text_file * T)
+{
+	do {
+		while (T->pos < T->len && IS_SPACE(T->buf[T->pos])) {
+			if (T->buf[T->pos] == '\n') {
+				T->line++;
+			}
+			T->pos++;
+		}
+	} while (T->pos == T->len && Fill(T) > 0);
+}
+
+/*
+ * Next field of T: start in *tok, length returned (0 at end of file). The
+ * field is followed by white space or the NUL at buf[len].
+ */
+static size_t
+Token(text_file * T, char **tok)
+{
+	size_t          n;
+
+	SkipSpace(T);
+	n = 0;
+	do {
+		while (T->pos + n < T->len && !IS_SPACE(T->buf[T->pos + n])) {
+			n++;
+		}
+	} while (T->pos + n == T->len && Fill(T) > 0);
+	*tok = T->buf + T->pos;
+	T->pos = T->pos + n;
+	return (n);
+}
+
+int
+TextInt(text_file * T, char *what)
+{
+	char           *s;
+	size_t          n, k;
+	long            v;
+	int             neg;
+
+	n = Token(T, &s);
+	k = 0;
+	neg = 0;
+	if (n > 0 && (s[0] == '-' || s[0] == '+')) {
+		neg = (s[0] == '-');
+		k = 1;
+	}
+	if (k == n || n - k > 10) {
+		TextError(T, "an integer", what, s, n);
+	}
+	v = 0;
+	for (; k < n; k++) {
+		if (s[k] < '0' || s[k] > '9') {
+			TextError(T, "an integer", what, s, n);
+		}
+		v = 10 * v + (s[k] - '0');
+	}
+	return ((int) (neg ? -v : v));
+}
+
+realtype
+TextReal(text_file * T, char *what)
+{
+	char           *s, *end, c;
+	size_t          n, k;
+	unsigned long long m;
+	int             neg, ok, digits, e, ed, eneg;
+	double          v;
+
+	n = Token(T, &s);
+	if (n == 0) {
+		TextError(T, "a number", what, s, n);
+	}
+	k = 0;
+	neg = 0;
+	if (s[0] == '-' || s[0] == '+') {
+		neg = (s[0] == '-');
+		k = 1;
+	}
+	/* [digits][.digits][(e|E)[sign]digits], ok once a digit is seen */
+	m = 0;
+	ok = 0;
+	digits = 0;
+	e = 0;
+	while (k < n && s[k] >= '0' && s[k] <= '9') {
+		digits = digits + (m > 0 || s[k] != '0');
+		m = 10 * m + (s[k] - '0');
+		ok = 1;
+		k++;
+	}
+	if (k < n && s[k] == '.') {
+		k++;
+		while (k < n && s[k] >= '0' && s[k] <= '9') {
+			digits = digits + (m > 0 || s[k] != '0');
+			m = 10 * m + (s[k] - '0');
+			ok = 1;
+			e--;
+			k++;
+		}
+	}
+	if (ok && k < n && (s[k] == 'e' || s[k] == 'E')) {
+		k++;
+		eneg = 0;
+		if (k < n && (s[k] == '-' || s[k] == '+')) {
+			eneg = (s[k] == '-');
+			k++;
+		}
+		ok = 0;
+		ed = 0;
+		while (k < n && s[k] >= '0' && s[k] <= '9') {
+			ed = (ed < 10000) ? 10 * ed + (s[k] - '0') : ed;
+			ok = 1;
+			k++;
+		}
+		e = eneg ? e - ed : e + ed;
+	}
+	if (ok && k == n && digits <= 19 && m <= (1ULL << 53) && e >= -22 && e <= 22) {
+		v = (double) m;
+		v = (e < 0) ? v / Pow10[-e] : v * Pow10[e];
+		return (neg ? -v : v);
+	}
+	/* anything else: the C library, on the NUL terminated field */
+	c = s[n];
+	s[n] = '\0';
+	v = strtod(s, &end);
+	s[n] = c;
+	if (end != s + n) {
+		TextError(T, "a number", what, s, n);
+	}
+	return (v);
+}
+
+/* Next field into w (at most size-1 characters are kept) */
+void
+TextWord(text_file * T, char *w, int size, char *what)
+{
+	char           *s;
+	size_t          n;
+
+	n = Token(T, &s);
+	if (n == 0) {
+		TextError(T, "a name", what, s, n);
+	}
+	if (n > (size_t) (size - 1)) {
+		n = size - 1;
+	}
+	memcpy(w, s, n);
+	w[n] = '\0';
+}
+
+/* 1 if another field follows, 0 at end of file */
+int
+TextMore(text_file * T)
+{
+	SkipSpace(T);
+	return (T->pos < T->len);
+}
@@ -54,6 +54,9 @@
 #include <math.h>
 #include <string.h>
 #include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /* SUNDIAL Header Files */
 #include "sundials_types.h"	/* realtype, integertype, booleantype
@@ -69,45 +72,148 @@
 #include "sundials_dense.h"	/* generic dense solver header file              */
 #include "pihm.h"		/* Data Model and Variable Declarations     */
 #define UNIT_C 1440		/* Unit Conversions */
+#define SPINUP_MAX 50		/* Default max. spin-up cycles */
+#define BREAK_TOL 1.0e-9	/* (min) ETBreaks: stop missed by more is fatal */
 
 /* Function Declarations */
 void            initialize(char *, Model_Data, Control_Data *, N_Vector);
-void            is_sm_et(realtype, realtype, Model_Data, N_Vector);
+void            is_sm_et(realtype, realtype, Model_Data);
 /* Function to calculate right hand side of ODE systems */
 int             f(realtype, N_Vector, N_Vector, void *);
+void            OutputFluxes(realtype, N_Vector, N_Vector, void *);
 void            read_alloc(char *, Model_Data, Control_Data *);	/* Variable definition */
 void            update(realtype, Model_Data);
-void            PrintData(FILE **, Control_Data *, Model_Data, N_Vector, realtype);
+realtype        NextBreak(Model_Data, realtype, realtype);
+void            PrintData(Output_Data, FILE **, Control_Data *, Model_Data, N_Vector, realtype);
+/* Output ring written by a separate thread (print.c) */
+Output_Data     OutputAlloc(Model_Data, Control_Data *);
+void            OutputFinish(Output_Data);
+void            OutputFree(Output_Data);
+void            OutputQuad(Output_Data, Control_Data *, Model_Data, realtype);
 void            FreeData(Model_Data, Control_Data *);
+/* Load time renumbering of the mesh (--reorder) */
+void            ReorderMesh(Model_Data, int);
+/* Binary cache of the parsed input files (project.cache) */
+int             LoadCache(char *, Model_Data, Control_Data *, int);
+void            WriteCache(char *, Model_Data, Control_Data *, int);
+/* Checkpoint and restart of the run state (project.ckpt) */
+int             CheckpointDue(realtype, realtype, realtype, realtype);
+void            Checkpoint(char *, void *, Output_Data, Model_Data, Control_Data *, N_Vector, realtype, int, realtype, FILE **, int);
+void            ReadCheckpoint(char *, Model_Data, Control_Data *, N_Vector, realtype *, int *, realtype *, realtype *, FILE **, int);
+/* Block preconditioner for CVSPGMR (Solver = 3) */
+Precond_Data    PrecondAlloc(Model_Data);
+void            PrecondFree(Precond_Data);
+int             PSetup(realtype, N_Vector, N_Vector, booleantype, booleantype *, realtype, void *, N_Vector, N_Vector, N_Vector);
+int             PSolve(realtype, N_Vector, N_Vector, N_Vector, N_Vector, realtype, realtype, int, void *, N_Vector);
+/* Analytic Jacobian-vector product (Solver = 4, 5) */
+Jac_Data        JacAlloc(Model_Data, int);
+void            JacFree(Jac_Data);
+int             JTimes(N_Vector, N_Vector, realtype, N_Vector, N_Vector, void *, N_Vector);
+/* Sparse LU preconditioner (Solver = 6) */
+Sparse_Data     SparseAlloc(Model_Data);
+void            SparseFree(Sparse_Data);
+int             SpSetup(realtype, N_Vector, N_Vector, booleantype, booleantype *, realtype, void *, N_Vector, N_Vector, N_Vector);
+int             SpSolve(realtype, N_Vector, N_Vector, N_Vector, N_Vector, realtype, realtype, int, void *, N_Vector);
+/* Steady state groundwater as initial condition (--steady R) */
+void            SteadyState(char *, Model_Data, Control_Data *, N_Vector, realtype);
+/* State in the layout of .init (initialize.c) */
+int             WriteInit(char *, char *, Model_Data, N_Vector);
+/* Cyclic spin-up over a forcing window (--spinup D tol) */
+void            SpinUp(char *, void *, Model_Data, Control_Data *, N_Vector, realtype, realtype, int);
+/* Parts of a run, also used for each member of an ensemble */
+void            OpenOutput(char *, char *, FILE **);
+void           *SolverAlloc(Model_Data, Control_Data *, N_Vector, realtype, realtype, Precond_Data *, Jac_Data *, Sparse_Data *);
+void            SolverFree(void *, Precond_Data, Jac_Data, Sparse_Data);
+int             Simulate(char *, void *, Output_Data, FILE **, Model_Data, Control_Data *, N_Vector, N_Vector, realtype, int, realtype, int);
+/* Ensemble of runs sharing the model data (--ensemble file) */
+void            Ensemble(char *, char *, Model_Data, Control_Data *, N_Vector);
 
 /* Main Function */
 int
 main(int argc, char *argv[])
 {
-	char            tmpLName[20], tmpFName[20];	/* rivFlux File names */
 	Model_Data      mData;	/* Model Data                */
 	Control_Data    cData;	/* Solver Control Data       */
+	Precond_Data    pData = NULL;	/* Preconditioner Data       */
+	Jac_Data        jData = NULL;	/* J*v Data                  */
+	Sparse_Data     sData = NULL;	/* Sparse LU Data            */
+	Output_Data     oData;	/* Output writer             */
 	N_Vector        CV_Y,CV_Ydot;	/* State Variables Vector    */
 	void           *cvode_mem;	/* Model Data Pointer        */
-	int             flag;	/* flag to test return value */
 	FILE           *Ofile[25];	/* Output file     */
-	char           *ofn[25];
 	FILE           *iproj;	/* Project File */
 	int             N;	/* Problem size              */
-	int             i, j, k;/* loop index                */
+	int             i, k;	/* loop index                */
 	realtype        t;	/* simulation time           */
-	realtype        NextPtr, StepSize;	/* stress period & step size */
-	clock_t         start, end_r, end_s;	/* system clock at points    */
-	realtype        cputime_r, cputime_s;	/* for duration in realtype  */
+	clock_t         start, end_s;	/* system clock at points    */
+	realtype        cputime_s;	/* for duration in realtype  */
 	char           *filename;
+	char           *projName = NULL;	/* project name on command line */
+	int             nThreads = 0;	/* --threads N, 0: OpenMP default */
+	int             reorder = 0;	/* --reorder: RCM renumbering of the mesh */
+	int             useCache = 1;	/* --no-cache: always parse the inputs */
+	int             stream = 0;	/* --stream: window the forcing series */
+	realtype        ckptIntv = 0;	/* --checkpoint m: minutes between
+					 * checkpoints, 0: none */
+	int             restart = 0;	/* --restart: resume from project.ckpt */
+	int             i0 = 0;	/* first output step of this run */
+	realtype        h0;	/* initial CVODE step size */
+	char           *omode;	/* open mode of the output files */
+	int             nStop = 0;	/* ET steps taken */
+	int             steady = 0;	/* --steady R: start from steady state
+					 * groundwater */
+	realtype        steadyR = 0;	/* its mean recharge (m/day) */
+	int             spinup = 0;	/* --spinup D tol: cycle the first D days */
+	realtype        spinDays = 0;	/* of the run (0: all of it) until the */
+	realtype        spinTol = 0;	/* storages change by less than tol (m) */
+	int             spinMax = SPINUP_MAX;	/* --spinup-max N: at most N
+						 * cycles */
+	char           *ensFile = NULL;	/* --ensemble file: run its members */
 
+	/*
+	 * Command line: [--threads N] [--reorder] [--no-cache] [--stream]
+	 * [--checkpoint m] [--restart] [--steady R] [--spinup D tol]
+	 * [--spinup-max N] [--ensemble file] [project_name]
+	 */
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			nThreads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--reorder") == 0) {
+			reorder = 1;
+		} else if (strcmp(argv[i], "--no-cache") == 0) {
+			useCache = 0;
+		} else if (strcmp(argv[i], "--stream") == 0) {
+			stream = 1;
+		} else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+			ckptIntv = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--restart") == 0) {
+			restart = 1;
+		} else if (strcmp(argv[i], "--steady") == 0 && i + 1 < argc) {
+			steady = 1;
+			steadyR = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--spinup") == 0 && i + 2 < argc) {
+			spinup = 1;
+			spinDays = atof(argv[++i]);
+			spinTol = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--spinup-max") == 0 && i + 1 < argc) {
+			spinMax = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--ensemble") == 0 && i + 1 < argc) {
+			ensFile = argv[++i];
+		} else if (projName == NULL && argv[i][0] != '-') {
+			projName = argv[i];
+		} else {
+			printf("\t\nUnknown argument %s", argv[i]);
+			printf("\t\nUsage ./pihm [--threads N] [--reorder] [--no-cache] [--stream] [--checkpoint m] [--restart] [--steady R] [--spinup D tol] [--spinup-max N] [--ensemble file] project_name\n");
+			exit(1);
+		}
+	}
 	/* Project Input Name */
-	if (argc != 2) {
+	if (projName == NULL) {
 		iproj = fopen("projectName.txt", "r");
 		if (iproj == NULL) {
-			printf("\t\nUsage ./pihm project_name");
+			printf("\t\nUsage ./pihm [--threads N] [--reorder] [--no-cache] [--stream] [--checkpoint m] [--restart] [--steady R] [--spinup D tol] [--spinup-max N] [--ensemble file] project_name");
 			printf("\t\n         OR              ");
-			printf("\t\nUsage ./pihm, and have a file in the current directory named projectName.txt with the project name in it");
+			printf("\t\nUsage ./pihm [--threads N] [--reorder] [--no-cache] [--stream] [--checkpoint m] [--restart] [--steady R] [--spinup D tol] [--spinup-max N] [--ensemble file], and have a file in the current directory named projectName.txt with the project name in it");
 			exit(0);
 		} else {
 			filename = (char *) malloc(15 * sizeof(char));
@@ -116,60 +222,43 @@ main(int argc, char *argv[])
 		}
 	} else {
 		/* get user specified file name in command line */
-		filename = (char *) malloc(strlen(argv[1]) * sizeof(char));
-		strcpy(filename, argv[1]);
-	}
-	/* Open Output Files */
-	ofn[0] = (char *) malloc((strlen(filename) + 4) * sizeof(char));
-	strcpy(ofn[0], filename);
-	Ofile[0] = fopen(strcat(ofn[0], ".GW"), "w");
-	ofn[1] = (char *) malloc((strlen(filename) + 6) * sizeof(char));
-	strcpy(ofn[1], filename);
-	Ofile[1] = fopen(strcat(ofn[1], ".surf"), "w");
-	ofn[2] = (char *) malloc((strlen(filename) + 5) * sizeof(char));
-	strcpy(ofn[2], filename);
-	Ofile[2] = fopen(strcat(ofn[2], ".et0"), "w");
-	ofn[3] = (char *) malloc((strlen(filename) + 5) * sizeof(char));
-	strcpy(ofn[3], filename);
-	Ofile[3] = fopen(strcat(ofn[3], ".et1"), "w");
-	ofn[4] = (char *) malloc((strlen(filename) + 5) * sizeof(char));
-	strcpy(ofn[4], filename);
-	Ofile[4] = fopen(strcat(ofn[4], ".et2"), "w");
-	ofn[5] = (char *) malloc((strlen(filename) + 4) * sizeof(char));
-	strcpy(ofn[5], filename);
-	Ofile[5] = fopen(strcat(ofn[5], ".is"), "w");
-	ofn[6] = (char *) malloc((strlen(filename) + 6) * sizeof(char));
-	strcpy(ofn[6], filename);
-	Ofile[6] = fopen(strcat(ofn[6], ".snow"), "w");
-	for (i = 0; i < 11; i++) {
-		sprintf(tmpLName, ".rivFlx%d", i);
-		strcpy(tmpFName, filename);
-		strcat(tmpFName, tmpLName);
-		Ofile[7 + i] = fopen(tmpFName, "w");
-	}
-	ofn[18] = (char *) malloc((strlen(filename) + 7) * sizeof(char));
-	strcpy(ofn[18], filename);
-	Ofile[18] = fopen(strcat(ofn[18], ".stage"), "w");
-	ofn[19] = (char *) malloc((strlen(filename) + 7) * sizeof(char));
-	strcpy(ofn[19], filename);
-	Ofile[19] = fopen(strcat(ofn[19], ".unsat"), "w");
-	ofn[20] = (char *) malloc((strlen(filename) + 6) * sizeof(char));
-	strcpy(ofn[20], filename);
-	Ofile[20] = fopen(strcat(ofn[20], ".Rech"), "w");
-	ofn[21] = (char *) malloc((strlen(filename) + 6) * sizeof(char));
-		strcpy(ofn[21], filename);
-	Ofile[21] = fopen(strcat(ofn[21], ".rbed"), "w");
-	ofn[22] = (char *) malloc((strlen(filename) + 7) * sizeof(char));
-		strcpy(ofn[22], filename);
-	Ofile[22] = fopen(strcat(ofn[22], ".infil"), "w");
+		filename = (char *) malloc((strlen(projName) + 1) * sizeof(char));
+		strcpy(filename, projName);
+	}
+	/* Open Output Files; a restart appends to them (see ReadCheckpoint) */
+	omode = restart ? "r+" : "w";
+	if (ensFile == NULL) {
+		OpenOutput(filename, omode, Ofile);
+	}
 
 	/* allocate memory for model data structure */
 	mData = (Model_Data) malloc(sizeof *mData);
 
 	printf("\n ...  PIHM 2.2 is starting ... \n");
+#ifdef _OPENMP
+	if (nThreads > 0) {
+		omp_set_num_threads(nThreads);
+	}
+	printf("\n Threads: %d\n", omp_get_max_threads());
+#else
+	if (nThreads > 1) {
+		printf("\n Warning: built without OpenMP, --threads %d is ignored\n", nThreads);
+	}
+#endif
 
-	/* read in 9 input files with "filename" as prefix */
-	read_alloc(filename, mData, &cData);
+	/*
+	 * read in 9 input files with "filename" as prefix, or their parsed
+	 * form from filename.cache if it is up to date. The cache holds every
+	 * forcing record, so it is not used with --stream.
+	 */
+	mData->StreamForc = stream;
+	if (useCache == 0 || stream || LoadCache(filename, mData, &cData, reorder) == 0) {
+		read_alloc(filename, mData, &cData);
+		ReorderMesh(mData, reorder);
+		if (useCache && stream == 0) {
+			WriteCache(filename, mData, &cData, reorder);
+		}
+	}
 
 	/*
 	 * if(mData->UnsatMode ==1) {    }
@@ -177,73 +266,484 @@ main(int argc, char *argv[])
 	if (mData->UnsatMode == 2) {
 		/* problem size */
 		N = 3 * mData->NumEle + 2 * mData->NumRiv;
+		if (mData->CanopyODE == 1) {
+			/* interception, snow on the ground and on the canopy */
+			N = N + 3 * mData->NumEle;
+		}
 		mData->DummyY = (realtype *) malloc((3 * mData->NumEle + 2 * mData->NumRiv) * sizeof(realtype));
+	} else {
+		printf("\n  Fatal Error: UnsatMode %d is not supported, use 2\n", mData->UnsatMode);
+		exit(1);
 	}
 	/* initial state variable depending on machine */
 	CV_Y = N_VNew_Serial(N);
     CV_Ydot = N_VNew_Serial(N);
 	/* initialize mode data structure */
 	initialize(filename, mData, &cData, CV_Y);
+	if ((ckptIntv > 0 || restart) && cData.OutFormat != 0) {
+		printf("\n  Fatal Error: --checkpoint and --restart need text output (OutFormat 0)\n");
+		exit(1);
+	}
+	for (i = 0; i < 23 && ensFile == NULL; i++) {
+		if (Ofile[i] == NULL) {
+			printf("\n  Fatal Error: output file %d of %s cannot be opened\n", i, filename);
+			exit(1);
+		}
+	}
+	if ((steady || spinup) && restart) {
+		printf("\n  Fatal Error: --steady and --spinup cannot be used with --restart\n");
+		exit(1);
+	}
+	if (ensFile != NULL && (restart || ckptIntv > 0 || stream || spinup)) {
+		printf("\n  Fatal Error: --ensemble cannot be used with --restart, --checkpoint, --stream or --spinup\n");
+		exit(1);
+	}
+	if (spinup && (spinDays < 0 || spinDays * UNIT_C > cData.Tout[cData.NumSteps] - cData.StartTime)) {
+		printf("\n  Fatal Error: the --spinup window of %lf days is not within the run\n", spinDays);
+		exit(1);
+	}
+	if (steady) {
+		/* sat and bed heads of the initial state at rest */
+		SteadyState(filename, mData, &cData, CV_Y, steadyR);
+	}
+	if (ensFile != NULL) {
+		/* the members start from this state */
+		Ensemble(filename, ensFile, mData, &cData, CV_Y);
+		N_VDestroy_Serial(CV_Y);
+		N_VDestroy_Serial(CV_Ydot);
+		FreeData(mData, &cData);
+		free(filename);
+		free(mData);
+		return 0;
+	}
+	/* set start time */
+	t = cData.StartTime;
+	h0 = cData.InitStep;
+	if (restart) {
+		ReadCheckpoint(filename, mData, &cData, CV_Y, &t, &i0, &h0, &ckptIntv, Ofile, 23);
+	}
 
 	printf("\nSolving ODE system ... \n");
 
 	/* allocate memory for solver */
-	cvode_mem = CVodeCreate(CV_BDF, CV_NEWTON);
+	cvode_mem = SolverAlloc(mData, &cData, CV_Y, t, h0, &pData, &jData, &sData);
 	if (cvode_mem == NULL) {
-		printf("CVodeMalloc failed. \n");
 		return (1);
 	}
-	flag = CVodeSetFdata(cvode_mem, mData);
-	flag = CVodeSetInitStep(cvode_mem, cData.InitStep);
-	flag = CVodeSetStabLimDet(cvode_mem, TRUE);
-	flag = CVodeSetMaxStep(cvode_mem, cData.MaxStep);
-	flag = CVodeMalloc(cvode_mem, f, cData.StartTime, CV_Y, CV_SS, cData.reltol, &cData.abstol);
-	flag = CVSpgmr(cvode_mem, PREC_NONE, 0);
 	//flag = CVSpgmrSetGSType(cvode_mem, MODIFIED_GS);
 
-	/* set start time */
-	t = cData.StartTime;
+	if (spinup) {
+		/* the run then starts from the state the cycles settled to */
+		SpinUp(filename, cvode_mem, mData, &cData, CV_Y, (spinDays > 0) ? spinDays * UNIT_C : cData.Tout[cData.NumSteps] - cData.StartTime, spinTol, spinMax);
+	}
+	oData = OutputAlloc(mData, &cData);
 	start = clock();
 
-	/* start solver in loops */
-	for (i = 0; i < cData.NumSteps; i++) {
-		/*
-		 * if (cData.Verbose != 1) { printf("  Running: %-4.1f%% ...
-		 * ", (100*(i+1)/((realtype) cData.NumSteps)));
-		 * fflush(stdout); }
-		 */
-		/*
-		 * inner loops to next output points with ET step size
-		 * control
-		 */
-		while (t < cData.Tout[i + 1]) {
-			if (t + cData.ETStep >= cData.Tout[i + 1]) {
-				NextPtr = cData.Tout[i + 1];
-			} else {
-				NextPtr = t + cData.ETStep;
+	nStop = Simulate(filename, cvode_mem, oData, Ofile, mData, &cData, CV_Y, CV_Ydot, t, i0, ckptIntv, 1);
+	if (nStop < 0) {
+		exit(1);
+	}
+	OutputFinish(oData);
+	end_s = clock();
+	cputime_s = (realtype) (end_s - start) / CLOCKS_PER_SEC;
+	FPrintFinalStats(stdout, cvode_mem, &cData, cputime_s);
+	FPrintOutputStats(stdout, oData);
+	if (cData.ETBreaks == 1) {
+		/* stops the ETStep grid would have made over the same outputs */
+		k = 0;
+		for (i = i0; i < cData.NumSteps; i++) {
+			for (t = cData.Tout[i]; t < cData.Tout[i + 1]; k++) {
+				t = (t + cData.ETStep >= cData.Tout[i + 1]) ? cData.Tout[i + 1] : t + cData.ETStep;
 			}
-			StepSize = NextPtr - t;
-
-			/* calculate Interception Storage */
-			is_sm_et(t, StepSize, mData, CV_Y);
-			printf("\n Tsteps = %f ", t);
-			flag = CVode(cvode_mem, NextPtr, CV_Y, &t, CV_NORMAL);
-			update(t, mData);
 		}
-        f(t,CV_Y,CV_Ydot,mData);
-		PrintData(Ofile, &cData, mData, CV_Y, t);
+		printf("ET stops = %d\tETStep grid = %d\tsolver restarts avoided = %d\n", nStop, k, k - nStop);
 	}
+	OutputFree(oData);
 	/* Free memory */
 	N_VDestroy_Serial(CV_Y);
+	N_VDestroy_Serial(CV_Ydot);
 	/* Free integrator memory */
-	CVodeFree(&cvode_mem);
+	SolverFree(cvode_mem, pData, jData, sData);
 	FreeData(mData, &cData);
         for(i=0;i<23;i++)fclose(Ofile[i]);
-        for(i=0;i<7;i++)free(ofn[i]);
-        for(i=18;i<23;i++)free(ofn[i]);
         free(filename);
 
         free(mData);
         return 0;
 
 }
+
+
+/*
+ * Open the 23 output files prefix.GW .. prefix.infil, in the order of
+ * Ofile, with mode omode; a file that cannot be opened is left NULL
+ */
+void
+OpenOutput(char *prefix, char *omode, FILE ** Ofile)
+{
+	char           *ext[23] = {".GW", ".surf", ".et0", ".et1", ".et2", ".is", ".snow", ".rivFlx0", ".rivFlx1", ".rivFlx2", ".rivFlx3", ".rivFlx4", ".rivFlx5", ".rivFlx6", ".rivFlx7", ".rivFlx8", ".rivFlx9", ".rivFlx10", ".stage", ".unsat", ".Rech", ".rbed", ".infil"};
+	char           *fn;
+	int             k;
+
+	for (k = 0; k < 23; k++) {
+		fn = (char *) malloc((strlen(prefix) + strlen(ext[k]) + 1) * sizeof(char));
+		strcpy(fn, prefix);
+		strcat(fn, ext[k]);
+		Ofile[k] = fopen(fn, omode);
+		free(fn);
+	}
+}
+
+/*
+ * CVODE memory for the state CV_Y of MD at time t, with first step h0 and
+ * the linear solver of CS->Solver; the preconditioner and J*v data it uses
+ * are returned in *pData, *sData and *jData (NULL if not used). NULL if
+ * CVODE cannot be created.
+ */
+void           *
+SolverAlloc(Model_Data MD, Control_Data * CS, N_Vector CV_Y, realtype t, realtype h0, Precond_Data * pData, Jac_Data * jData, Sparse_Data * sData)
+{
+	void           *cvode_mem;
+	int             flag;
+
+	*pData = NULL;
+	*jData = NULL;
+	*sData = NULL;
+	cvode_mem = CVodeCreate(CV_BDF, CV_NEWTON);
+	if (cvode_mem == NULL) {
+		printf("CVodeMalloc failed. \n");
+		return (NULL);
+	}
+	flag = CVodeSetFdata(cvode_mem, MD);
+	flag = (flag == CV_SUCCESS) ? CVodeSetInitStep(cvode_mem, h0) : flag;
+	flag = (flag == CV_SUCCESS) ? CVodeSetStabLimDet(cvode_mem, TRUE) : flag;
+	flag = (flag == CV_SUCCESS) ? CVodeSetMaxStep(cvode_mem, CS->MaxStep) : flag;
+	flag = (flag == CV_SUCCESS) ? CVodeMalloc(cvode_mem, f, t, CV_Y, CV_SS, CS->reltol, &CS->abstol) : flag;
+	if (flag != CV_SUCCESS) {
+		printf("\n  Fatal Error: CVODE setup failed (flag %d)\n", flag);
+		CVodeFree(&cvode_mem);
+		return (NULL);
+	}
+	if (CS->Solver == 3 || CS->Solver == 5) {
+		/* GMRES with block Jacobi preconditioner */
+		*pData = PrecondAlloc(MD);
+		flag = CVSpgmr(cvode_mem, PREC_LEFT, CS->MaxK);
+		flag = (flag == CVSPILS_SUCCESS) ? CVSpilsSetPreconditioner(cvode_mem, PSetup, PSolve, *pData) : flag;
+	} else if (CS->Solver == 6) {
+		/* GMRES with sparse LU of I-gamma*J as preconditioner */
+		*sData = SparseAlloc(MD);
+		flag = CVSpgmr(cvode_mem, PREC_LEFT, CS->MaxK);
+		flag = (flag == CVSPILS_SUCCESS) ? CVSpilsSetPreconditioner(cvode_mem, SpSetup, SpSolve, *sData) : flag;
+	} else {
+		flag = CVSpgmr(cvode_mem, PREC_NONE, 0);
+	}
+	if ((CS->Solver == 4 || CS->Solver == 5) && MD->CanopyODE == 1) {
+		printf("\n Note: no analytic J*v with CanopyODE 1, difference quotients are used\n");
+	} else if (CS->Solver == 4 || CS->Solver == 5) {
+		/* analytic J*v; Debug = 2 checks it against finite differences */
+		*jData = JacAlloc(MD, (CS->Debug == 2) ? 1 : 0);
+		flag = (flag == CVSPILS_SUCCESS) ? CVSpilsSetJacTimesVecFn(cvode_mem, JTimes, *jData) : flag;
+	}
+	if (flag != CVSPILS_SUCCESS) {
+		printf("\n  Fatal Error: CVSPGMR setup failed (flag %d)\n", flag);
+		SolverFree(cvode_mem, *pData, *jData, *sData);
+		return (NULL);
+	}
+	return (cvode_mem);
+}
+
+/* Free the CVODE memory and the solver data of SolverAlloc */
+void
+SolverFree(void *cvode_mem, Precond_Data pData, Jac_Data jData, Sparse_Data sData)
+{
+	CVodeFree(&cvode_mem);
+	if (pData != NULL)
+		PrecondFree(pData);
+	if (jData != NULL)
+		JacFree(jData);
+	if (sData != NULL)
+		SparseFree(sData);
+}
+
+/*
+ * The run from time t, output step i0, to the end: ET steps, CVODE and the
+ * outputs to Ofile. trace = 1 prints the time of each ET step. Returns the
+ * number of ET steps, or -1 if CVODE fails.
+ */
+int
+Simulate(char *filename, void *cvode_mem, Output_Data oData, FILE ** Ofile, Model_Data MD, Control_Data * CS, N_Vector CV_Y, N_Vector CV_Ydot, realtype t, int i0, realtype ckptIntv, int trace)
+{
+	N_Vector        CV_Yout;	/* State at an output time (DenseOut) */
+	realtype        NextPtr, StepSize;	/* stress period & step size */
+	int             i, k, flag;
+	int             nStop = 0;	/* ET steps taken */
+
+	if (CS->DenseOut == 1) {
+		/*
+		 * CVODE steps freely up to the end of each ET step, a stop
+		 * time; the states at output times are interpolated from its
+		 * history
+		 */
+		CV_Yout = N_VNew_Serial(NV_LENGTH_S(CV_Y));
+		i = i0;
+		while (i < CS->NumSteps) {
+			if (CS->ETBreaks == 1) {
+				/* outputs are interpolated: only forcing stops */
+				NextPtr = NextBreak(MD, t, CS->Tout[CS->NumSteps]);
+			} else {
+				/* ET steps from StartTime, the last one cut at the end */
+				k = (int) floor((t - CS->StartTime) / CS->ETStep + 0.5);
+				NextPtr = CS->StartTime + (k + 1) * CS->ETStep;
+				NextPtr = (NextPtr < CS->Tout[CS->NumSteps]) ? NextPtr : CS->Tout[CS->NumSteps];
+			}
+			nStop++;
+			StepSize = NextPtr - t;
+			if (MD->CanopyODE != 1) {
+				is_sm_et(t, StepSize, MD);
+			}
+			if (trace) {
+				printf("\n Tsteps = %f ", t);
+			}
+			if (CS->QuadOut == 1) {
+				/* fluxes after is_sm_et */
+				OutputFluxes(t, CV_Y, CV_Ydot, MD);
+				OutputQuad(oData, CS, MD, t);
+			}
+			flag = CVodeSetStopTime(cvode_mem, NextPtr);
+			do {
+				flag = CVode(cvode_mem, NextPtr, CV_Y, &t, CV_ONE_STEP_TSTOP);
+				while (flag >= 0 && i < CS->NumSteps && CS->Tout[i + 1] <= t) {
+					CVodeGetDky(cvode_mem, CS->Tout[i + 1], 0, CV_Yout);
+					update(CS->Tout[i + 1], MD);
+					OutputFluxes(CS->Tout[i + 1], CV_Yout, CV_Ydot, MD);
+					if (CS->QuadOut == 1) {
+						OutputQuad(oData, CS, MD, CS->Tout[i + 1]);
+					}
+					PrintData(oData, Ofile, CS, MD, CV_Yout, CS->Tout[i + 1]);
+					i++;
+				}
+				if (CS->QuadOut == 1 && flag >= 0 && t > CS->Tout[i]) {
+					OutputFluxes(t, CV_Y, CV_Ydot, MD);
+					OutputQuad(oData, CS, MD, t);
+				}
+			} while (flag == CV_SUCCESS);
+			if (flag < 0) {
+				printf("\n  Fatal Error: CVODE failed at t = %lf (flag %d)\n", t, flag);
+				N_VDestroy_Serial(CV_Yout);
+				return (-1);
+			}
+			if (CS->ETBreaks == 1 && fabs(t - NextPtr) > BREAK_TOL) {
+				printf("\n  Fatal Error: CVODE stopped at t = %lf, not at the forcing breakpoint %lf\n", t, NextPtr);
+				N_VDestroy_Serial(CV_Yout);
+				return (-1);
+			}
+			update(t, MD);
+			if (i < CS->NumSteps && CheckpointDue(ckptIntv, CS->StartTime, t - StepSize, t)) {
+				Checkpoint(filename, cvode_mem, oData, MD, CS, CV_Y, t, i, ckptIntv, Ofile, 23);
+			}
+		}
+		N_VDestroy_Serial(CV_Yout);
+	} else {
+		/* start solver in loops */
+		for (i = i0; i < CS->NumSteps; i++) {
+			/*
+			 * if (CS->Verbose != 1) { printf("  Running: %-4.1f%% ...
+			 * ", (100*(i+1)/((realtype) CS->NumSteps)));
+			 * fflush(stdout); }
+			 */
+			/*
+			 * inner loops to next output points with ET step size
+			 * control
+			 */
+			while (t < CS->Tout[i + 1]) {
+				if (CS->ETBreaks == 1) {
+					/*
+					 * is_sm_et holds the forcing of t up to
+					 * the next breakpoint or output
+					 */
+					NextPtr = NextBreak(MD, t, CS->Tout[i + 1]);
+					flag = CVodeSetStopTime(cvode_mem, NextPtr);
+				} else if (t + CS->ETStep >= CS->Tout[i + 1] || MD->CanopyODE == 1) {
+					NextPtr = CS->Tout[i + 1];
+				} else {
+					NextPtr = t + CS->ETStep;
+				}
+				StepSize = NextPtr - t;
+				nStop++;
+
+				/* calculate Interception Storage */
+				if (MD->CanopyODE != 1) {
+					is_sm_et(t, StepSize, MD);
+				}
+				if (trace) {
+					printf("\n Tsteps = %f ", t);
+				}
+				if (CS->QuadOut == 1) {
+					/*
+					 * fluxes are integrated over each step
+					 * of CVODE, from their values after
+					 * is_sm_et
+					 */
+					OutputFluxes(t, CV_Y, CV_Ydot, MD);
+					OutputQuad(oData, CS, MD, t);
+					flag = CVodeSetStopTime(cvode_mem, NextPtr);
+					do {
+						flag = CVode(cvode_mem, NextPtr, CV_Y, &t, CV_ONE_STEP_TSTOP);
+						if (flag >= 0 && t < CS->Tout[i + 1]) {
+							OutputFluxes(t, CV_Y, CV_Ydot, MD);
+							OutputQuad(oData, CS, MD, t);
+						}
+					} while (flag == CV_SUCCESS);
+					if (flag < 0) {
+						printf("\n  Fatal Error: CVODE failed at t = %lf (flag %d)\n", t, flag);
+						return (-1);
+					}
+				} else {
+					/*
+					 * the stop time set for ETBreaks holds
+					 * only with CV_NORMAL_TSTOP
+					 */
+					flag = CVode(cvode_mem, NextPtr, CV_Y, &t, (CS->ETBreaks == 1) ? CV_NORMAL_TSTOP : CV_NORMAL);
+					if (flag < 0) {
+						printf("\n  Fatal Error: CVODE failed at t = %lf (flag %d)\n", t, flag);
+						return (-1);
+					}
+				}
+				if (CS->ETBreaks == 1 && fabs(t - NextPtr) > BREAK_TOL) {
+					printf("\n  Fatal Error: CVODE stopped at t = %lf, not at the forcing breakpoint %lf\n", t, NextPtr);
+					return (-1);
+				}
+				update(t, MD);
+			}
+			OutputFluxes(t, CV_Y, CV_Ydot, MD);
+			if (CS->QuadOut == 1) {
+				OutputQuad(oData, CS, MD, t);
+			}
+			PrintData(oData, Ofile, CS, MD, CV_Y, t);
+			/*
+			 * checkpoint at the first output time of each interval;
+			 * the integrator goes on undisturbed
+			 */
+			if (i + 1 < CS->NumSteps && CheckpointDue(ckptIntv, CS->StartTime, CS->Tout[i], CS->Tout[i + 1])) {
+				Checkpoint(filename, cvode_mem, oData, MD, CS, CV_Y, t, i + 1, ckptIntv, Ofile, 23);
+			}
+		}
+	}
+	return (nStop);
+}
+
+/* Water stored in each element and river cell (m), into S */
+static void
+Storage(Model_Data MD, N_Vector CV_Y, realtype * S)
+{
+	realtype       *Y;
+	int             i, k;
+
+	Y = NV_DATA_S(CV_Y);
+	k = 3 * MD->NumEle + 2 * MD->NumRiv;
+	for (i = 0; i < MD->NumEle; i++) {
+		S[i] = Y[i] + MD->EleH.Porosity[i] * (Y[i + MD->NumEle] + Y[i + 2 * MD->NumEle]);
+		if (MD->CanopyODE == 1) {
+			S[i] = S[i] + Y[k + i] + Y[k + MD->NumEle + i] + Y[k + 2 * MD->NumEle + i];
+		} else {
+			S[i] = S[i] + MD->EleIS[i] + MD->EleSnowGrnd[i] + MD->EleSnowCanopy[i];
+		}
+	}
+	for (i = 0; i < MD->NumRiv; i++) {
+		S[i + MD->NumEle] = Y[i + 3 * MD->NumEle] + MD->EleH.Porosity[i + MD->NumEle] * Y[i + 3 * MD->NumEle + MD->NumRiv];
+	}
+}
+
+/*
+ * Back to StartTime with the state CV_Y: the cursors of all time series
+ * are rewound and CVODE is started again
+ */
+static void
+Rewind(void *cvode_mem, Model_Data MD, Control_Data * CS, N_Vector CV_Y)
+{
+	int             j, k;
+
+	for (j = 0; j < MD->NumFam; j++) {
+		for (k = 0; k < MD->Fam[j].num; k++) {
+			MD->Fam[j].TS[k].iCounter = 0;
+		}
+	}
+	MD->ForcValid = 0;
+	update(CS->StartTime, MD);
+	CVodeSetInitStep(cvode_mem, CS->InitStep);
+	CVodeReInit(cvode_mem, f, CS->StartTime, CV_Y, CV_SS, CS->reltol, &CS->abstol);
+}
+
+/*
+ * Spin-up: the first `window` minutes of the run are simulated over and
+ * over, without output, each cycle starting at StartTime from the state
+ * (CV_Y and the interception and snow storages) the last one ended with.
+ * It stops once no element or river cell stores more than tol (m) more or
+ * less water than at the start of its cycle, or after maxCycle cycles, and
+ * writes the state to project.spinup.init. CVODE is left at StartTime for
+ * the run.
+ */
+void
+SpinUp(char *filename, void *cvode_mem, Model_Data MD, Control_Data * CS, N_Vector CV_Y, realtype window, realtype tol, int maxCycle)
+{
+	realtype       *S0, *S1;
+	realtype        t, tEnd, NextPtr, dS, dSmax;
+	int             i, n, nAbove, cycle, flag;
+	clock_t         start;
+
+	printf("\n Spin-up over %lf days, to a change of storage below %e m per cycle ...", window / UNIT_C, tol);
+	n = MD->NumEle + MD->NumRiv;
+	S0 = (realtype *) malloc(n * sizeof(realtype));
+	S1 = (realtype *) malloc(n * sizeof(realtype));
+	tEnd = CS->StartTime + window;
+	start = clock();
+	Storage(MD, CV_Y, S0);
+	dSmax = 0;
+	for (cycle = 1; cycle <= maxCycle; cycle++) {
+		t = CS->StartTime;
+		while (t < tEnd) {
+			/* ET steps as in the run, without output times */
+			if (CS->ETBreaks == 1) {
+				NextPtr = NextBreak(MD, t, tEnd);
+			} else if (t + CS->ETStep >= tEnd || MD->CanopyODE == 1) {
+				NextPtr = tEnd;
+			} else {
+				NextPtr = t + CS->ETStep;
+			}
+			if (MD->CanopyODE != 1) {
+				is_sm_et(t, NextPtr - t, MD);
+			}
+			flag = CVodeSetStopTime(cvode_mem, NextPtr);
+			flag = CVode(cvode_mem, NextPtr, CV_Y, &t, CV_NORMAL_TSTOP);
+			if (flag < 0) {
+				printf("\n  Fatal Error: CVODE failed at t = %lf of spin-up cycle %d (flag %d)\n", t, cycle, flag);
+				exit(1);
+			}
+			update(t, MD);
+		}
+		Storage(MD, CV_Y, S1);
+		dSmax = 0;
+		nAbove = 0;
+		for (i = 0; i < n; i++) {
+			dS = fabs(S1[i] - S0[i]);
+			dSmax = (dS > dSmax) ? dS : dSmax;
+			nAbove = (dS >= tol) ? nAbove + 1 : nAbove;
+			S0[i] = S1[i];
+		}
+		printf("\n Spin-up cycle %d: max |dS| = %e m, %d of %d cells at or above tol", cycle, dSmax, nAbove, n);
+		Rewind(cvode_mem, MD, CS, CV_Y);
+		if (nAbove == 0) {
+			break;
+		}
+	}
+	if (cycle > maxCycle) {
+		cycle = maxCycle;
+		printf("\n Warning: spin-up not converged after %d cycles, max |dS| = %e m", maxCycle, dSmax);
+	}
+	printf("\n Spin-up: %d cycles, %lf s", cycle, (realtype) (clock() - start) / CLOCKS_PER_SEC);
+	if (WriteInit(filename, ".spinup.init", MD, CV_Y)) {
+		printf("\n Spin-up state written to %s.spinup.init\n", filename);
+	}
+	free(S0);
+	free(S1);
+}
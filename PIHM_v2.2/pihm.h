@@ -35,60 +35,22 @@
 /* Definition of Global Variable Types */
 
 FILE           *riv_state_file;
-typedef struct element_type {	/* Data model for a triangular element */
+typedef struct element_type {	/* Data model for a triangular element
+					 * (fields used every RHS call are in
+					 * element_hot) */
 	int             index;	/* Element No. */
 	int             node[3];/* anti-clock-wise */
 	int             nabr[3];/* neighbor i shares edge i (0: on boundary) */
 
 	realtype        edge[3];/* edge i is from node i to node i+1 */
-	realtype        area;	/* area of element */
 
 	realtype        x;	/* x of centroid */
 	realtype        y;	/* y of centroid */
-	realtype        zmin;	/* z_min of centroid */
-	realtype        zmax;	/* z_max of centroid */
-
-	realtype        KsatH;	/* horizontal geologic saturated hydraulic
-				 * conductivity */
-	realtype        KsatV;	/* vertical geologic saturated hydraulic
-				 * conductivity */
-	realtype        infKsatV;	/* vertical surface saturated
-					 * hydraulic conductivity */
-	realtype        Porosity;
-	realtype        infD;	/* depth from ground surface accross which
-				 * head is calculated during infiltration */
-	realtype        Alpha;	/* Alpha from van-genuchten eqn which is
-				 * given by satn =
-				 * 1/pow(1+pow(abs(Alpha*psi),Beta),1-1/Beta) */
-	realtype        Beta;
-	realtype        RzD;	/* Root zone depth */
-	realtype        macD;	/* macropore Depth */
-	realtype        macKsatH;	/* macropore horizontal saturated
-					 * hydraulic conductivity */
-	realtype        macKsatV;	/* macropore vertical saturated
-					 * hydraulic conductivity */
-	realtype        vAreaF;	/* macropore area fraction on a vertical
-				 * cross-section */
-	realtype        hAreaF;	/* macropore area fraction on a horizontal
-				 * cross-section */
-	int             Macropore;	/* 1: macropore; 0: regular soil */
 
 	realtype        LAImax;	/* maxm. LAI accross all seasons for a
 				 * vegetation type */
-	realtype        VegFrac;/* areal vegetation fraction in a triangular
-				 * element */
-	realtype        Albedo;	/* albedo of a triangular element */
-	realtype        Rs_ref;	/* reference incoming solar flux for
-				 * photosynthetically active canopy */
-	realtype        Rmin;	/* minimum canopy resistance */
-	realtype        Rough;	/* surface roughness of an element */
-
-	realtype        windH;	/* wind measurement height */
-
 
-	int             soil;	/* soil type */
 	int             geol;	/* geology type */
-	int             LC;	/* Land Cover type  */
 	int             IC;	/* initial condition type */
 	int             BC[3];	/* boundary type. 0:natural bc (no flow);
 				 * 1:Dirichlet BC; 2:Neumann BC */
@@ -111,6 +73,59 @@ typedef struct element_type {	/* Data model for a triangular element */
 	realtype        dhBYdy;	/* Head gradient in y dirn. */
 }               element;
 
+typedef struct element_hot_type {	/* Element fields used in every call of
+					 * f() and is_sm_et(), one array per
+					 * field indexed like Ele */
+	realtype       *area;	/* area of element */
+	realtype       *zmin;	/* z_min of centroid */
+	realtype       *zmax;	/* z_max of centroid */
+	realtype       *KsatH;	/* horizontal geologic saturated hydraulic
+				 * conductivity */
+	realtype       *KsatV;	/* vertical geologic saturated hydraulic
+				 * conductivity */
+	realtype       *infKsatV;	/* vertical surface saturated
+					 * hydraulic conductivity */
+	realtype       *Porosity;
+	realtype       *infD;	/* depth from ground surface accross which
+				 * head is calculated during infiltration */
+	realtype       *Alpha;	/* Alpha from van-genuchten eqn which is
+				 * given by satn =
+				 * 1/pow(1+pow(abs(Alpha*psi),Beta),1-1/Beta) */
+	realtype       *Beta;
+	realtype       *RzD;	/* Root zone depth */
+	realtype       *macD;	/* macropore Depth */
+	realtype       *macKsatH;	/* macropore horizontal saturated
+					 * hydraulic conductivity */
+	realtype       *macKsatV;	/* macropore vertical saturated
+					 * hydraulic conductivity */
+	realtype       *vAreaF;	/* macropore area fraction on a vertical
+				 * cross-section */
+	realtype       *hAreaF;	/* macropore area fraction on a horizontal
+				 * cross-section */
+	int            *Macropore;	/* 1: macropore; 0: regular soil */
+	realtype       *VegFrac;/* areal vegetation fraction in a triangular
+				 * element */
+	realtype       *Albedo;	/* albedo of a triangular element */
+	realtype       *Rs_ref;	/* reference incoming solar flux for
+				 * photosynthetically active canopy */
+	realtype       *Rmin;	/* minimum canopy resistance */
+	realtype       *Rough;	/* surface roughness of an element */
+	realtype       *windH;	/* wind measurement height */
+	int            *soil;	/* soil type */
+	int            *LC;	/* Land Cover type  */
+}               element_hot;
+
+typedef struct edge_type {	/* Data model for an element edge; an edge
+				 * shared by two elements is stored once */
+	int             ele[2];	/* elements on either side (0 based); ele[1]
+				 * is -1 on boundary */
+	int             loc[2];	/* local index j of the edge in each element */
+	realtype        length;	/* edge length */
+	realtype        Distance;	/* distance between centroids;
+					 * circumcenter to edge on boundary */
+	int             BC;	/* BC of ele[0] on the edge (<= -4: river) */
+}               edge;
+
 typedef struct nodes_type {	/* Data model for a node */
 	int             index;	/* Node no. */
 
@@ -202,6 +217,8 @@ typedef struct river_segment_type {
 	int             FromNode;	/* Upstream Node no. */
 	int             ToNode;	/* Dnstream Node no. */
 	int             down;	/* down stream segment */
+	int             NumUp;	/* no. of up stream segments */
+	int            *up;	/* up stream segments (index from 0) */
 	int             LeftEle;/* Left neighboring element */
 	int             RightEle;	/* Right neighboring element */
 	int             shape;	/* shape type    */
@@ -242,11 +259,50 @@ typedef struct TSD_type {
 	char            name[5];
 	int             index;
 	int             length;	/* length of time series */
-	int             iCounter;	/* interpolation counter */
-	realtype      **TS;	/* 2D time series data */
+	int             iCounter;	/* cursor: first record with time >= the
+					 * last time sought (see TSDSeek) */
+	realtype       *time;	/* record times (days), from the TSD arena */
+	realtype       *value;	/* record values, from the TSD arena */
+	int             first;	/* index of the record in time[0], value[0] */
+	int             count;	/* records held in time, value */
+	struct tsd_stream_type *src;	/* NULL: all records held; else the
+					 * window of a streamed series (see
+					 * stream.c) */
 
 }               TSD;
 
+#define TSD_ALIGN 64		/* Alignment (bytes) of each TSD array */
+#define TSD_BLOCK 65536		/* Default TSD arena block (realtypes) */
+typedef struct tsd_block_type {	/* One block of the TSD arena: the time and
+				 * value arrays of all series are carved from
+				 * a chain of large blocks (see TSDArenaAlloc) */
+	struct tsd_block_type *next;
+	size_t          size;	/* capacity in realtypes */
+	size_t          used;	/* realtypes handed out */
+	void           *raw;	/* malloc'ed pointer */
+	realtype       *data;	/* raw aligned to TSD_ALIGN bytes */
+}               tsd_block;
+
+typedef struct tsd_family_type {	/* A family of time series kept current
+					 * by update() (see RegisterTSD) */
+	TSD            *TS;	/* series of the family */
+	int             num;	/* number of series */
+	realtype       *value;	/* value of each series at ForcT, filled by
+				 * EvalForcing; NULL if not needed by f() */
+}               tsd_family;
+
+#define TEXT_BUF 1048576		/* Read block of text input files */
+typedef struct text_file_type {	/* A text input file read in blocks (see
+					 * parse.c) */
+	char           *name;	/* file name, for error messages */
+	FILE           *fp;
+	char           *buf;	/* TEXT_BUF bytes, NUL terminated */
+	size_t          len;	/* bytes in buf */
+	size_t          pos;	/* next unread byte */
+	long            off;	/* file offset of buf[0] */
+	int             line;	/* line of pos */
+}               text_file;
+
 typedef struct global_calib {
 	realtype        KsatH;	/* For explanation of each calibration
 				 * variable, look for corresponding variables
@@ -287,6 +343,11 @@ typedef struct model_data_structure {	/* Model_data definition */
 	int             UnsatMode;	/* Unsat Mode */
 	int             SurfMode;	/* Surface Overland Flow Mode */
 	int             RivMode;/* River Routing Mode */
+	int             CanopyODE;	/* 1: interception and snow are state
+					 * variables 3*NumEle+2*NumRiv.. with
+					 * rates from CanopyRates ("CanopyODE 1"
+					 * in .para); 0: updated by is_sm_et
+					 * once per ETStep */
 
 	int             NumEle;	/* Number of Elements */
 	int             NumNode;/* Number of Nodes    */
@@ -320,6 +381,13 @@ typedef struct model_data_structure {	/* Model_data definition */
 	int             NumRivBC;	/* Number of River Boundary Condition */
 
 	element        *Ele;	/* Store Element Information  */
+	element_hot     EleH;	/* Element fields used every RHS call */
+	int             NumEdge;/* Number of element edges */
+	edge           *Edge;	/* Store Element Edge Information */
+	int            *EleNew;	/* internal index of element i of the input
+				 * files (see reorder.c) */
+	int            *RivNew;	/* internal index of river segment i of the
+				 * input files */
 	nodes          *Node;	/* Store Node Information     */
 	element_IC     *Ele_IC;	/* Store Element Initial Condtion */
 	soils          *Soil;	/* Store Soil Information     */
@@ -352,6 +420,29 @@ typedef struct model_data_structure {	/* Model_data definition */
 	TSD            *TSD_G;	/* Radiation into Ground Time Series Data */
 	TSD            *TSD_Pressure;	/* Vapor Pressure Time Series data       */
 	TSD            *TSD_Source;	/* Source (well) Time Series data  */
+	tsd_block      *TSArena;	/* Storage of all TSD records */
+	char           *CacheMap;	/* Mapped project.cache holding the TSD
+					 * records if loaded from it (cache.c) */
+	size_t          CacheLen;
+	int             StreamForc;	/* --stream: window the .forc series */
+	struct tsd_pool_type *Pool;	/* Streamed series and their reader
+					 * (stream.c), NULL if not streaming */
+	int             NumFam;	/* Number of registered TSD families */
+	tsd_family     *Fam;	/* Registered TSD families */
+
+	/* Forcing values at time ForcT, one per series (see EvalForcing) */
+	int             ForcValid;	/* 0: values have to be recomputed */
+	realtype        ForcT;
+	realtype       *ForcPrep;
+	realtype       *ForcTemp;
+	realtype       *ForcHumidity;
+	realtype       *ForcWindVel;
+	realtype       *ForcRn;
+	realtype       *ForcLAI;
+	realtype       *ForcRL;
+	realtype       *ForcMeltF;
+	realtype       *ForcEleBC;
+	realtype       *ForcRiv;
 
 	realtype      **FluxSurf;	/* Overland Flux   */
 	realtype      **FluxSub;/* Subsurface Flux */
@@ -379,11 +470,72 @@ typedef struct model_data_structure {	/* Model_data definition */
 	processCal      pcCal;
 }              *Model_Data;
 
+typedef struct precond_data_structure {	/* Block Jacobi preconditioner data
+					 * (Solver = 3) */
+	Model_Data      MD;
+	int             NumColor;	/* Number of colors of element/river
+					 * cells */
+	int            *Color;	/* Color of each cell. River segments follow
+				 * elements */
+	realtype       *JBlk;	/* Diagonal blocks of df/dy: 3x3 for each
+				 * element followed by 2x2 for each river */
+	realtype       *PBlk;	/* LU factors of I-gamma*JBlk */
+	int            *Piv;	/* Pivot rows of PBlk */
+}              *Precond_Data;
+
+#define JV_MAXCOL 6		/* Max. states a single flux depends on */
+typedef struct jac_data_structure {	/* Analytic J*v data (Solver = 4, 5) */
+	Model_Data      MD;
+	int             NumFlux;/* Number of linearized fluxes */
+	int            *Row;	/* 2 state rows receiving each flux (-1: none) */
+	realtype       *Scale;	/* Multiplier from flux to dy/dt of each row */
+	int            *NumCol;	/* Number of states each flux depends on */
+	int            *Col;	/* States each flux depends on */
+	realtype       *Der;	/* dFlux/dy for each of Col */
+	realtype       *EleBlk;	/* 3x3 infiltration/recharge block of each
+				 * element */
+	realtype       *Ylin;	/* State at which fluxes were linearized */
+	realtype        tlin;
+	int             Valid;
+	int             Verify;	/* 1: compare with finite difference J*v */
+	int             NumLin;	/* Number of linearizations */
+	N_Vector        Ftmp;
+}              *Jac_Data;
+
+typedef struct sparse_data_structure {	/* Sparse LU preconditioner data
+					 * (Solver = 6) */
+	Model_Data      MD;
+	int             N;	/* Number of states */
+	int            *RowPtr, *ColIdx;	/* Pattern of df/dy by rows */
+	realtype       *JVal;	/* Values of df/dy */
+	int            *ColPtr, *ColRow, *ColPos;	/* Pattern of df/dy by
+							 * columns and position
+							 * of each entry in JVal */
+	int             NumColor;	/* Number of column colors */
+	int            *Color;	/* Color of each column */
+	int            *ColorPtr, *ColorCol;	/* Columns of each color */
+	int            *Perm, *IPerm;	/* Elimination order of states and its
+					 * inverse */
+	int            *FPtr, *FIdx, *FDiag;	/* Pattern of LU factors by
+						 * permuted rows; FDiag is the
+						 * position of the diagonal */
+	realtype       *FVal;	/* LU factors of I-gamma*J */
+	int            *JMap;	/* Position of each entry of JVal in FVal */
+	realtype       *Work;
+}              *Sparse_Data;
+
+typedef struct output_data_structure *Output_Data;	/* Output ring and
+							 * its writer thread
+							 * (print.c) */
+
 typedef struct control_data_structure {
 	int             Verbose;
 	int             Debug;
 
-	int             Solver;	/* Solver type */
+	int             Solver;	/* Solver type. 2: GMRES; 3: GMRES with
+				 * block preconditioner; 4: GMRES with
+				 * analytic J*v; 5: 3 and 4 combined; 6:
+				 * GMRES with sparse LU preconditioner */
 	int             NumSteps;	/* Number of external time steps
 					 * (when results can be printed) for
 					 * the whole simulation */
@@ -436,6 +588,26 @@ typedef struct control_data_structure {
 
 
 	int             outtype;
+	int             OutFormat;	/* Output files: 0 text; 4, 8 binary
+					 * with float32, float64 values; 1
+					 * compressed chunk store (see
+					 * binout.h). Optional "OutFormat n"
+					 * at the end of .para */
+	realtype        OutError;	/* Max. error of values in the chunk
+					 * store, 0: lossless ("OutError e") */
+	int             DenseOut;	/* 1: CVODE steps freely between ET
+					 * steps and outputs are interpolated
+					 * ("DenseOut 1"); 0: it stops at each
+					 * output time */
+	int             ETBreaks;	/* 1: ET steps end at the breakpoints
+					 * of the forcing and BC series and at
+					 * output times instead of every
+					 * ETStep ("ETBreaks 1"; see
+					 * NextBreak) */
+	int             QuadOut;	/* 1: printed fluxes are integrated
+					 * over the CVODE steps ("QuadOut 1";
+					 * see OutputQuad); 0: sampled at the
+					 * output times */
 	realtype        a;	/* External time stepping controls */
 	realtype        b;
 
@@ -446,5 +618,6 @@ typedef struct control_data_structure {
 }               Control_Data;
 
 
-void            FPrintFinalStats(FILE *, long int iopt[], realtype ropt[]);
-void            PrintData(FILE **, Control_Data *, Model_Data, N_Vector, realtype);
+void            FPrintFinalStats(FILE *, void *, Control_Data *, realtype);
+void            PrintData(Output_Data, FILE **, Control_Data *, Model_Data, N_Vector, realtype);
+void            FPrintOutputStats(FILE *, Output_Data);
@@ -0,0 +1,329 @@
+/*******************************************************************************
+ * File        : precond.c                                                     *
+ * Function    : Block Jacobi preconditioner for the CVSPGMR linear solve      *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) Used when Solver = 3 in .para file. The preconditioner is P = I-gamma*D  *
+ *    where D is the block diagonal of df/dy: one 3x3 block (surf, unsat, sat) *
+ *    per triangular element, which carries the infiltration/recharge/ET      *
+ *    coupling of the vertical column, and one 2x2 block (stage, bed) per      *
+ *    river segment and the element beneath it.                               *
+ * b) D is built by finite differences of f() on a distance-2 coloring of the  *
+ *    element/river cell graph, so that all cells of one color are perturbed   *
+ *    together (3 f() calls per color). The overland slope term of f() couples *
+ *    an element to neighbors of its neighbors; distance-2 coloring keeps the  *
+ *    extracted blocks free of that contamination.                            *
+ * c) D is only rebuilt when CVODE asks for a fresh Jacobian (jok = FALSE),    *
+ *    otherwise the saved D is rescaled with the new gamma and refactored.     *
+ * d) The interception and snow states of CanopyODE 1 are not preconditioned. *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include "sundials_types.h"
+#include "nvector_serial.h"
+#include "cvode_spgmr.h"
+#include "pihm.h"
+
+#define SRUR 1.4901161193847656e-08	/* sqrt of unit roundoff */
+#define PC_YMIN 1.0		/* Lower bound of |y| used to scale the FD
+				 * increment */
+
+int             f(realtype, N_Vector, N_Vector, void *);
+
+/* LU factorization with partial pivoting of an n x n row-major block */
+static int
+BlkFactor(realtype * a, int n, int *p)
+{
+	int             i, j, k, l;
+	realtype        tmp;
+
+	for (k = 0; k < n; k++) {
+		l = k;
+		for (i = k + 1; i < n; i++) {
+			if (fabs(a[i * n + k]) > fabs(a[l * n + k]))
+				l = i;
+		}
+		p[k] = l;
+		if (a[l * n + k] == 0)
+			return (k + 1);
+		if (l != k) {
+			for (j = 0; j < n; j++) {
+				tmp = a[k * n + j];
+				a[k * n + j] = a[l * n + j];
+				a[l * n + j] = tmp;
+			}
+		}
+		for (i = k + 1; i < n; i++) {
+			a[i * n + k] = a[i * n + k] / a[k * n + k];
+			for (j = k + 1; j < n; j++) {
+				a[i * n + j] = a[i * n + j] - a[i * n + k] * a[k * n + j];
+			}
+		}
+	}
+	return 0;
+}
+
+static void
+BlkSolve(realtype * a, int n, int *p, realtype * b)
+{
+	int             i, j;
+	realtype        tmp;
+
+	for (i = 0; i < n; i++) {
+		if (p[i] != i) {
+			tmp = b[i];
+			b[i] = b[p[i]];
+			b[p[i]] = tmp;
+		}
+		for (j = 0; j < i; j++) {
+			b[i] = b[i] - a[i * n + j] * b[j];
+		}
+	}
+	for (i = n - 1; i >= 0; i--) {
+		for (j = i + 1; j < n; j++) {
+			b[i] = b[i] - a[i * n + j] * b[j];
+		}
+		b[i] = b[i] / a[i * n + i];
+	}
+}
+
+/*
+ * Greedy coloring of the cell graph (elements 0..NumEle-1 followed by river
+ * segments) such that no two cells within two hops share a color
+ */
+static int
+ColorCells(Model_Data MD, int *Color)
+{
+	int             i, j, k, n, m, c, NumCell, NumColor = 0;
+	int            *Deg, *Ptr, *Adj, *Mark;
+
+	NumCell = MD->NumEle + MD->NumRiv;
+	Deg = (int *) calloc(NumCell, sizeof(int));
+	Ptr = (int *) malloc((NumCell + 1) * sizeof(int));
+	Mark = (int *) malloc(NumCell * sizeof(int));
+
+	for (i = 0; i < MD->NumEle; i++) {
+		for (j = 0; j < 3; j++) {
+			if (MD->Ele[i].nabr[j] > 0)
+				Deg[i]++;
+		}
+	}
+	for (i = 0; i < MD->NumRiv; i++) {
+		Deg[MD->Riv[i].LeftEle - 1]++;
+		Deg[MD->Riv[i].RightEle - 1]++;
+		Deg[MD->NumEle + i] += 2;
+		if (MD->Riv[i].down > 0) {
+			Deg[MD->NumEle + i]++;
+			Deg[MD->NumEle + MD->Riv[i].down - 1]++;
+		}
+	}
+	Ptr[0] = 0;
+	for (i = 0; i < NumCell; i++) {
+		Ptr[i + 1] = Ptr[i] + Deg[i];
+		Deg[i] = 0;
+	}
+	Adj = (int *) malloc(Ptr[NumCell] * sizeof(int));
+	for (i = 0; i < MD->NumEle; i++) {
+		for (j = 0; j < 3; j++) {
+			if (MD->Ele[i].nabr[j] > 0)
+				Adj[Ptr[i] + Deg[i]++] = MD->Ele[i].nabr[j] - 1;
+		}
+	}
+	for (i = 0; i < MD->NumRiv; i++) {
+		k = MD->NumEle + i;
+		Adj[Ptr[k] + Deg[k]++] = MD->Riv[i].LeftEle - 1;
+		Adj[Ptr[k] + Deg[k]++] = MD->Riv[i].RightEle - 1;
+		Adj[Ptr[MD->Riv[i].LeftEle - 1] + Deg[MD->Riv[i].LeftEle - 1]++] = k;
+		Adj[Ptr[MD->Riv[i].RightEle - 1] + Deg[MD->Riv[i].RightEle - 1]++] = k;
+		if (MD->Riv[i].down > 0) {
+			n = MD->NumEle + MD->Riv[i].down - 1;
+			Adj[Ptr[k] + Deg[k]++] = n;
+			Adj[Ptr[n] + Deg[n]++] = k;
+		}
+	}
+
+	for (i = 0; i < NumCell; i++) {
+		Color[i] = -1;
+		Mark[i] = -1;
+	}
+	for (i = 0; i < NumCell; i++) {
+		for (j = Ptr[i]; j < Ptr[i + 1]; j++) {
+			n = Adj[j];
+			if (Color[n] >= 0)
+				Mark[Color[n]] = i;
+			for (k = Ptr[n]; k < Ptr[n + 1]; k++) {
+				m = Adj[k];
+				if (m != i && Color[m] >= 0)
+					Mark[Color[m]] = i;
+			}
+		}
+		for (c = 0; Mark[c] == i; c++);
+		Color[i] = c;
+		NumColor = (c + 1 > NumColor) ? c + 1 : NumColor;
+	}
+	free(Deg);
+	free(Ptr);
+	free(Adj);
+	free(Mark);
+	return NumColor;
+}
+
+Precond_Data
+PrecondAlloc(Model_Data MD)
+{
+	Precond_Data    PD;
+	int             NumBlk;
+
+	PD = (Precond_Data) malloc(sizeof *PD);
+	PD->MD = MD;
+	NumBlk = 9 * MD->NumEle + 4 * MD->NumRiv;
+	PD->Color = (int *) malloc((MD->NumEle + MD->NumRiv) * sizeof(int));
+	PD->JBlk = (realtype *) calloc(NumBlk, sizeof(realtype));
+	PD->PBlk = (realtype *) malloc(NumBlk * sizeof(realtype));
+	PD->Piv = (int *) malloc((3 * MD->NumEle + 2 * MD->NumRiv) * sizeof(int));
+	PD->NumColor = ColorCells(MD, PD->Color);
+	printf("\n Block preconditioner: %d colors (%d f() calls per setup)", PD->NumColor, 3 * PD->NumColor);
+	return PD;
+}
+
+void
+PrecondFree(Precond_Data PD)
+{
+	free(PD->Color);
+	free(PD->JBlk);
+	free(PD->PBlk);
+	free(PD->Piv);
+	free(PD);
+}
+
+int
+PSetup(realtype t, N_Vector CV_Y, N_Vector fy, booleantype jok, booleantype * jcurPtr, realtype gamma, void *P_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+	int             i, j, k, c, idx, NumEle, NumRiv;
+	realtype       *Y, *FY, *Yp, *Fp, *Inc, *J, *P;
+	Precond_Data    PD;
+	Model_Data      MD;
+
+	PD = (Precond_Data) P_data;
+	MD = PD->MD;
+	NumEle = MD->NumEle;
+	NumRiv = MD->NumRiv;
+
+	if (jok) {
+		*jcurPtr = FALSE;
+	} else {
+		Y = NV_DATA_S(CV_Y);
+		FY = NV_DATA_S(fy);
+		Yp = NV_DATA_S(tmp1);
+		Fp = NV_DATA_S(tmp2);
+		Inc = NV_DATA_S(tmp3);
+		for (i = 0; i < 3 * NumEle + 2 * NumRiv; i++) {
+			Yp[i] = Y[i];
+			Inc[i] = SRUR * ((fabs(Y[i]) > PC_YMIN) ? fabs(Y[i]) : PC_YMIN);
+		}
+		for (i = 3 * NumEle + 2 * NumRiv; i < NV_LENGTH_S(CV_Y); i++) {
+			Yp[i] = Y[i];
+		}
+		for (k = 0; k < PD->NumColor; k++) {
+			/*
+			 * c = 0: surf & river stage, 1: unsat & bed, 2: sat
+			 */
+			for (c = 0; c < 3; c++) {
+				for (i = 0; i < NumEle; i++) {
+					if (PD->Color[i] == k)
+						Yp[i + c * NumEle] = Y[i + c * NumEle] + Inc[i + c * NumEle];
+				}
+				if (c < 2) {
+					for (i = 0; i < NumRiv; i++) {
+						if (PD->Color[NumEle + i] == k)
+							Yp[3 * NumEle + c * NumRiv + i] = Y[3 * NumEle + c * NumRiv + i] + Inc[3 * NumEle + c * NumRiv + i];
+					}
+				}
+				f(t, tmp1, tmp2, MD);
+				for (i = 0; i < NumEle; i++) {
+					if (PD->Color[i] == k) {
+						idx = i + c * NumEle;
+						for (j = 0; j < 3; j++) {
+							PD->JBlk[9 * i + 3 * j + c] = (Fp[i + j * NumEle] - FY[i + j * NumEle]) / Inc[idx];
+						}
+						Yp[idx] = Y[idx];
+					}
+				}
+				if (c < 2) {
+					for (i = 0; i < NumRiv; i++) {
+						if (PD->Color[NumEle + i] == k) {
+							idx = 3 * NumEle + c * NumRiv + i;
+							J = PD->JBlk + 9 * NumEle + 4 * i;
+							for (j = 0; j < 2; j++) {
+								J[2 * j + c] = (Fp[3 * NumEle + j * NumRiv + i] - FY[3 * NumEle + j * NumRiv + i]) / Inc[idx];
+							}
+							Yp[idx] = Y[idx];
+						}
+					}
+				}
+			}
+		}
+		*jcurPtr = TRUE;
+	}
+
+	/* form and factor P = I - gamma*D */
+	for (i = 0; i < 9 * NumEle + 4 * NumRiv; i++) {
+		PD->PBlk[i] = -gamma * PD->JBlk[i];
+	}
+	for (i = 0; i < NumEle; i++) {
+		P = PD->PBlk + 9 * i;
+		P[0] = P[0] + 1.0;
+		P[4] = P[4] + 1.0;
+		P[8] = P[8] + 1.0;
+		if (BlkFactor(P, 3, PD->Piv + 3 * i) != 0)
+			return 1;
+	}
+	for (i = 0; i < NumRiv; i++) {
+		P = PD->PBlk + 9 * NumEle + 4 * i;
+		P[0] = P[0] + 1.0;
+		P[3] = P[3] + 1.0;
+		if (BlkFactor(P, 2, PD->Piv + 3 * NumEle + 2 * i) != 0)
+			return 1;
+	}
+	return 0;
+}
+
+int
+PSolve(realtype t, N_Vector CV_Y, N_Vector fy, N_Vector r, N_Vector z, realtype gamma, realtype delta, int lr, void *P_data, N_Vector tmp)
+{
+	int             i, NumEle, NumRiv;
+	realtype        b[3];
+	realtype       *R, *Z;
+	Precond_Data    PD;
+
+	PD = (Precond_Data) P_data;
+	NumEle = PD->MD->NumEle;
+	NumRiv = PD->MD->NumRiv;
+	R = NV_DATA_S(r);
+	Z = NV_DATA_S(z);
+
+	for (i = 0; i < NumEle; i++) {
+		b[0] = R[i];
+		b[1] = R[i + NumEle];
+		b[2] = R[i + 2 * NumEle];
+		BlkSolve(PD->PBlk + 9 * i, 3, PD->Piv + 3 * i, b);
+		Z[i] = b[0];
+		Z[i + NumEle] = b[1];
+		Z[i + 2 * NumEle] = b[2];
+	}
+	for (i = 0; i < NumRiv; i++) {
+		b[0] = R[3 * NumEle + i];
+		b[1] = R[3 * NumEle + NumRiv + i];
+		BlkSolve(PD->PBlk + 9 * NumEle + 4 * i, 2, PD->Piv + 3 * NumEle + 2 * i, b);
+		Z[3 * NumEle + i] = b[0];
+		Z[3 * NumEle + NumRiv + i] = b[1];
+	}
+	for (i = 3 * NumEle + 2 * NumRiv; i < NV_LENGTH_S(r); i++) {
+		Z[i] = R[i];
+	}
+	return 0;
+}
@@ -14,6 +14,19 @@
  *    output							               *
  * c) Addition of Average Function to output average variables at regular time *
  *    intervals								       *
+ * d) Element and river values are written in input numbering, also when the *
+ *    mesh is renumbered (see reorder.c)					       *
+ * e) The solver copies each record into a ring of preallocated buffers; a    *
+ *    writer thread formats and writes them. The solver waits only when the  *
+ *    ring is full, and that time is reported by FPrintOutputStats           *
+ * f) With OutFormat 4 or 8 in .para the records are written in the binary    *
+ *    layout of binout.h (float32 or float64 values) instead of as text       *
+ * g) OutFormat 1 sends them to a compressed chunk store per file (chunk.c)   *
+ * h) OutputSync waits for the ring to empty, before a checkpoint records the *
+ *    length of the output files (checkpoint.c)                               *
+ * i) With QuadOut 1 in .para the printed fluxes (ET, FluxRiv, Recharge,      *
+ *    EleViR) are integrated over every step of CVODE by OutputQuad instead   *
+ *    of being sampled at the output times                                    *
  *******************************************************************************/
 
 #include <stdio.h>
@@ -26,12 +39,377 @@
 #include "pihm.h"
 #include "cvode.h"
 #include "cvode_dense.h"
+#include "cvode_spgmr.h"
+#include "binout.h"
+#include <pthread.h>
+#include <sys/time.h>
+
+#define OUT_SLOTS 64		/* Max. records in the output ring */
+#define OUT_RING_BYTES 16777216	/* Memory of the ring; at least two
+				 * records are always kept */
+
+#define OUT_FILES 32		/* Max. output files */
+
+typedef struct out_record_type {
+	FILE           *fp;
+	realtype        t;
+	int             n;
+	int             intv;	/* averaging interval (minutes) */
+	realtype       *v;	/* n values, already averaged */
+}               out_record;
+
+typedef struct out_file_type {	/* An output file */
+	FILE           *fp;
+	out_header      H;	/* OutFormat 4, 8 (binout.h) */
+	double         *Time;	/* time of each record, for the index */
+	int64_t         Cap;
+	chunk_store    *C;	/* OutFormat 1 */
+}               out_file;
+
+chunk_store    *ChunkOpen(FILE *, chunk_header *, int);
+void            ChunkAppend(chunk_store *, double, const double *);
+int64_t         ChunkClose(chunk_store *);
+
+struct output_data_structure {
+	int             NumSlot;
+	out_record     *Rec;
+	int             Head;	/* oldest record not yet written */
+	int             Tail;	/* slot the solver fills next */
+	int             Count;	/* records in the ring */
+	int             Quit;
+	pthread_t       Thread;
+	pthread_mutex_t Lock;
+	pthread_cond_t  NotEmpty, NotFull;
+	long            NumRec;	/* records written */
+	double          Stall;	/* seconds the solver waited for a free slot */
+	double          Drain;	/* seconds waited at the end for the writer */
+	int             Format;	/* OutFormat: 0 text, 4 or 8 bytes per
+				 * value, 1 chunk store */
+	realtype        MaxError;	/* OutError of the chunk store */
+	int             NumEle, NumRiv;
+	realtype        StartTime;
+	double          Busy;	/* seconds the writer formatted and wrote */
+	double          Values;	/* values written */
+	int64_t         Bytes;	/* size of the output files */
+	int             NumFile;
+	out_file        File[OUT_FILES];
+	float          *Buf32;	/* record converted to float32 */
+	int             Quad;	/* QuadOut: fluxes are summed by OutputQuad */
+	int             QValid;	/* 1 once QPrev holds values */
+	realtype        QT;	/* time of QPrev */
+	realtype       *QPrev;	/* fluxes at QT: 5 per element (EleET,
+				 * Recharge, EleViR), then 10 per river
+				 * (those with a rivFlx switch) */
+};
+
+static double
+WallTime()
+{
+	struct timeval  tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+/* Entry of the file of R, started with its header on the first record */
+static out_file *
+OutFile(Output_Data W, out_record * R)
+{
+	out_file       *F;
+	chunk_header    CH;
+	int             k;
+
+	for (k = 0; k < W->NumFile && W->File[k].fp != R->fp; k++);
+	F = &W->File[k];
+	if (k < W->NumFile) {
+		return F;
+	}
+	if (W->NumFile == OUT_FILES) {
+		printf("\n  Fatal Error: more than %d output files\n", OUT_FILES);
+		exit(1);
+	}
+	W->NumFile++;
+	F->fp = R->fp;
+	F->Time = NULL;
+	F->C = NULL;
+	if (W->Format == 1) {
+		memset(&CH, 0, sizeof(chunk_header));
+		CH.NumEle = W->NumEle;
+		CH.NumRiv = W->NumRiv;
+		CH.Interval = R->intv;
+		CH.StartTime = W->StartTime;
+		CH.MaxError = W->MaxError;
+		F->C = ChunkOpen(F->fp, &CH, R->n);
+	} else if (W->Format != 0) {
+		memset(&F->H, 0, sizeof(out_header));
+		strcpy(F->H.Magic, OUT_MAGIC);
+		F->H.Version = OUT_VERSION;
+		F->H.Width = W->Format;
+		F->H.NumObj = R->n;
+		F->H.NumEle = W->NumEle;
+		F->H.NumRiv = W->NumRiv;
+		F->H.Interval = R->intv;
+		F->H.StartTime = W->StartTime;
+		F->Cap = 1024;
+		F->Time = (double *) malloc(F->Cap * sizeof(double));
+		fwrite(&F->H, sizeof(out_header), 1, F->fp);
+	}
+	return F;
+}
+
+/* Append R to its fixed width binary file */
+static void
+WriteBinary(Output_Data W, out_file * F, out_record * R)
+{
+	int             j;
+
+	if (F->H.NumRec == F->Cap) {
+		F->Cap = 2 * F->Cap;
+		F->Time = (double *) realloc(F->Time, F->Cap * sizeof(double));
+	}
+	F->Time[F->H.NumRec] = R->t;
+	F->H.NumRec++;
+	fwrite(&R->t, sizeof(double), 1, F->fp);
+	if (W->Format == 4) {
+		for (j = 0; j < R->n; j++) {
+			W->Buf32[j] = (float) R->v[j];
+		}
+		fwrite(W->Buf32, sizeof(float), R->n, F->fp);
+	} else {
+		fwrite(R->v, sizeof(double), R->n, F->fp);
+	}
+}
+
+/*
+ * Index and final header of each binary file or chunk store, once all
+ * records are written; sums the file sizes
+ */
+static void
+CloseFiles(Output_Data W)
+{
+	out_file       *F;
+	out_index       I;
+	int             k;
+	int64_t         r;
+
+	W->Bytes = 0;
+	for (k = 0; k < W->NumFile; k++) {
+		F = &W->File[k];
+		if (F->C != NULL) {
+			W->Bytes = W->Bytes + ChunkClose(F->C);
+			continue;
+		}
+		if (F->Time != NULL) {
+			F->H.IndexOff = (int64_t) sizeof(out_header) + F->H.NumRec * OUT_RECLEN(&F->H);
+			fseeko(F->fp, (off_t) F->H.IndexOff, SEEK_SET);
+			for (r = 0; r < F->H.NumRec; r++) {
+				I.Time = F->Time[r];
+				I.Offset = (int64_t) sizeof(out_header) + r * OUT_RECLEN(&F->H);
+				fwrite(&I, sizeof(out_index), 1, F->fp);
+			}
+			fseeko(F->fp, 0, SEEK_SET);
+			fwrite(&F->H, sizeof(out_header), 1, F->fp);
+			fseeko(F->fp, 0, SEEK_END);
+			free(F->Time);
+		}
+		W->Bytes = W->Bytes + (int64_t) ftello(F->fp);
+	}
+}
+
+/* Writer thread: formats the records in the order they were posted */
+static void    *
+OutputWriter(void *arg)
+{
+	Output_Data     W;
+	out_record     *R;
+	out_file       *F;
+	int             j;
+	double          t0;
+
+	W = (Output_Data) arg;
+	pthread_mutex_lock(&W->Lock);
+	for (;;) {
+		if (W->Count == 0) {
+			if (W->Quit) {
+				break;
+			}
+			pthread_cond_wait(&W->NotEmpty, &W->Lock);
+			continue;
+		}
+		R = &W->Rec[W->Head];
+		pthread_mutex_unlock(&W->Lock);
+		t0 = WallTime();
+		F = OutFile(W, R);
+		if (W->Format == 0) {
+			fprintf(R->fp, "%lf\t", R->t);
+			for (j = 0; j < R->n; j++) {
+				fprintf(R->fp, "%lf\t", R->v[j]);
+			}
+			fprintf(R->fp, "\n");
+		} else if (W->Format == 1) {
+			ChunkAppend(F->C, R->t, R->v);
+		} else {
+			WriteBinary(W, F, R);
+		}
+		W->Values = W->Values + R->n;
+		W->Busy = W->Busy + WallTime() - t0;
+		pthread_mutex_lock(&W->Lock);
+		W->Head = (W->Head + 1) % W->NumSlot;
+		W->Count--;
+		W->NumRec++;
+		pthread_cond_signal(&W->NotFull);
+		if (W->Count == 0) {
+			/* caught up: let the files be followed during the run */
+			pthread_mutex_unlock(&W->Lock);
+			fflush(NULL);
+			pthread_mutex_lock(&W->Lock);
+		}
+	}
+	pthread_mutex_unlock(&W->Lock);
+	return (NULL);
+}
+
+/* Output ring for records of up to max(NumEle, NumRiv) values */
+Output_Data
+OutputAlloc(Model_Data DS, Control_Data * CS)
+{
+	Output_Data     W;
+	int             i, cap;
+
+	W = (Output_Data) malloc(sizeof(struct output_data_structure));
+	cap = (DS->NumEle > DS->NumRiv) ? DS->NumEle : DS->NumRiv;
+	W->NumSlot = OUT_RING_BYTES / ((cap + 1) * sizeof(realtype));
+	W->NumSlot = (W->NumSlot < 2) ? 2 : (W->NumSlot > OUT_SLOTS) ? OUT_SLOTS : W->NumSlot;
+	W->Rec = (out_record *) malloc(W->NumSlot * sizeof(out_record));
+	for (i = 0; i < W->NumSlot; i++) {
+		W->Rec[i].v = (realtype *) malloc(cap * sizeof(realtype));
+	}
+	W->Head = 0;
+	W->Tail = 0;
+	W->Count = 0;
+	W->Quit = 0;
+	W->NumRec = 0;
+	W->Stall = 0;
+	W->Drain = 0;
+	W->Format = CS->OutFormat;
+	W->MaxError = CS->OutError;
+	W->Busy = 0;
+	W->Values = 0;
+	W->Bytes = 0;
+	W->NumEle = DS->NumEle;
+	W->NumRiv = DS->NumRiv;
+	W->StartTime = CS->StartTime;
+	W->NumFile = 0;
+	W->Buf32 = (float *) malloc(cap * sizeof(float));
+	W->Quad = CS->QuadOut;
+	W->QValid = 0;
+	W->QT = 0;
+	W->QPrev = (realtype *) malloc((5 * DS->NumEle + 10 * DS->NumRiv) * sizeof(realtype));
+	pthread_mutex_init(&W->Lock, NULL);
+	pthread_cond_init(&W->NotEmpty, NULL);
+	pthread_cond_init(&W->NotFull, NULL);
+	if (pthread_create(&W->Thread, NULL, OutputWriter, W) != 0) {
+		printf("\n  Fatal Error: cannot start the output writer thread\n");
+		exit(1);
+	}
+	return (W);
+}
+
+/* Buffer for the values of the next record, once a slot is free */
+static realtype *
+OutputSlot(Output_Data W)
+{
+	double          t0;
+
+	pthread_mutex_lock(&W->Lock);
+	if (W->Count == W->NumSlot) {
+		t0 = WallTime();
+		while (W->Count == W->NumSlot) {
+			pthread_cond_wait(&W->NotFull, &W->Lock);
+		}
+		W->Stall = W->Stall + WallTime() - t0;
+	}
+	pthread_mutex_unlock(&W->Lock);
+	return W->Rec[W->Tail].v;
+}
+
+/*
+ * Queue the record filled in OutputSlot for fp: time t and n values
+ * averaged over intv minutes
+ */
+static void
+OutputPost(Output_Data W, FILE * fp, realtype t, int n, int intv)
+{
+	W->Rec[W->Tail].fp = fp;
+	W->Rec[W->Tail].t = t;
+	W->Rec[W->Tail].n = n;
+	W->Rec[W->Tail].intv = intv;
+	pthread_mutex_lock(&W->Lock);
+	W->Tail = (W->Tail + 1) % W->NumSlot;
+	W->Count++;
+	pthread_cond_signal(&W->NotEmpty);
+	pthread_mutex_unlock(&W->Lock);
+}
+
+/* Wait until the writer has written and flushed all queued records */
+void
+OutputSync(Output_Data W)
+{
+	double          t0;
+
+	t0 = WallTime();
+	pthread_mutex_lock(&W->Lock);
+	while (W->Count > 0) {
+		pthread_cond_wait(&W->NotFull, &W->Lock);
+	}
+	pthread_mutex_unlock(&W->Lock);
+	fflush(NULL);
+	W->Stall = W->Stall + WallTime() - t0;
+}
+
+/* Write all queued records and stop the writer; before closing the files */
+void
+OutputFinish(Output_Data W)
+{
+	double          t0, t1;
+
+	t1 = WallTime();
+	pthread_mutex_lock(&W->Lock);
+	W->Quit = 1;
+	pthread_cond_signal(&W->NotEmpty);
+	pthread_mutex_unlock(&W->Lock);
+	pthread_join(W->Thread, NULL);
+	t0 = WallTime();
+	CloseFiles(W);
+	W->Busy = W->Busy + WallTime() - t0;
+	fflush(NULL);
+	W->Drain = WallTime() - t1;
+}
+
+void
+OutputFree(Output_Data W)
+{
+	int             i;
+
+	for (i = 0; i < W->NumSlot; i++) {
+		free(W->Rec[i].v);
+	}
+	free(W->Rec);
+	free(W->Buf32);
+	free(W->QPrev);
+	pthread_mutex_destroy(&W->Lock);
+	pthread_cond_destroy(&W->NotEmpty);
+	pthread_cond_destroy(&W->NotFull);
+	free(W);
+}
+
 /* Temporal average of State vectors */
 void
-avgResults_NV(FILE * fpin, realtype * tmpVarCal, N_Vector tmpNV, int tmpIntv, int tmpNumObj, realtype tmpt, int tmpInitObj)
+avgResults_NV(Output_Data W, FILE * fpin, realtype * tmpVarCal, N_Vector tmpNV, int tmpIntv, int tmpNumObj, realtype tmpt, int tmpInitObj, int *tmpMap)
 {
 	int             j;
 	int             TmpIntv;
+	realtype       *v;
 	//? ? TmpIntv = tmpIntv / 60;
 	//USE THIS IF RUNNING AT 60 MIN STEP
 	                TmpIntv = tmpIntv;
@@ -41,26 +419,31 @@ avgResults_NV(FILE * fpin, realtype * tmpVarCal, N_Vector tmpNV, int tmpIntv, in
 		tmpVarCal[j] = tmpVarCal[j] + NV_Ith_S(tmpNV, j + tmpInitObj);
 	}
 	if (((int) tmpt % tmpIntv) == 0) {
-		fprintf(fpin, "%lf\t", tmpt);
+		v = OutputSlot(W);
+		/* in input numbering */
 		for (j = 0; j < tmpNumObj; j++) {
-			fprintf(fpin, "%lf\t", tmpVarCal[j] / TmpIntv);
-			tmpVarCal[j] = 0;
+			v[j] = tmpVarCal[tmpMap[j]] / TmpIntv;
+			tmpVarCal[tmpMap[j]] = 0;
 		}
-		fprintf(fpin, "\n");
-		fflush(fpin);
+		OutputPost(W, fpin, tmpt, tmpNumObj, tmpIntv);
 	}
 }
 /* Temporal average of Derived states */
 void
-avgResults_MD(FILE * fpin, realtype * tmpVarCal, Model_Data tmpDS, int tmpIntv, int tmpNumObj, realtype tmpt, int tmpFC)
+avgResults_MD(Output_Data W, FILE * fpin, realtype * tmpVarCal, Model_Data tmpDS, int tmpIntv, int tmpNumObj, realtype tmpt, int tmpFC, int *tmpMap)
 {
 	int             j;
 	int             TmpIntv;
+	realtype       *v;
 	//? ? TmpIntv = tmpIntv / 60;
 	//USE THIS IF RUNNING AT 60 MIN STEP
 	                TmpIntv = tmpIntv;
 	//1;
 	//? ?
+	if (W->Quad == 1 && tmpFC != 6 && tmpFC != 7) {
+		/* fluxes: summed over the interval by OutputQuad */
+		tmpFC = -1;
+	}
 		switch (tmpFC) {
 		case 3 :
 			case 4 :
@@ -108,53 +491,129 @@ avgResults_MD(FILE * fpin, realtype * tmpVarCal, Model_Data tmpDS, int tmpIntv,
 		break;
 	}
 	if (((int) tmpt % tmpIntv) == 0) {
-		fprintf(fpin, "%lf\t", tmpt);
+		v = OutputSlot(W);
+		/* in input numbering */
 		for (j = 0; j < tmpNumObj; j++) {
-			fprintf(fpin, "%lf\t", tmpVarCal[j] / TmpIntv);
-			tmpVarCal[j] = 0;
+			v[j] = tmpVarCal[tmpMap[j]] / TmpIntv;
+			tmpVarCal[tmpMap[j]] = 0;
 		}
-		fprintf(fpin, "\n");
-		fflush(fpin);
+		OutputPost(W, fpin, tmpt, tmpNumObj, tmpIntv);
 	}
 }
+/*
+ * QuadOut 1: add the integral (trapezoidal rule) of each printed flux from
+ * the last call to t to its sum in PrintVar, which avgResults_MD divides by
+ * the interval as it does the sum of samples taken every minute. The
+ * fluxes at t are those set in DS by OutputFluxes. A call at the time of
+ * the last one only takes the new values, e.g. after is_sm_et.
+ */
+void
+OutputQuad(Output_Data W, Control_Data * cD, Model_Data DS, realtype t)
+{
+	int             i, k;
+	realtype        h, *q;
+
+	h = (W->QValid == 1) ? 0.5 * (t - W->QT) : 0;
+	q = W->QPrev;
+	for (i = 0; i < DS->NumEle; i++) {
+		for (k = 0; k < 3; k++) {
+			if (cD->et[k] == 1) {
+				DS->PrintVar[2 + k][i] = DS->PrintVar[2 + k][i] + h * (q[k] + DS->EleET[i][k]);
+			}
+			q[k] = DS->EleET[i][k];
+		}
+		if (cD->Rech == 1) {
+			DS->PrintVar[20][i] = DS->PrintVar[20][i] + h * (q[3] + DS->Recharge[i]);
+			DS->PrintVar[22][i] = DS->PrintVar[22][i] + h * (q[4] + DS->EleViR[i]);
+		}
+		q[3] = DS->Recharge[i];
+		q[4] = DS->EleViR[i];
+		q = q + 5;
+	}
+	for (i = 0; i < DS->NumRiv; i++) {
+		for (k = 0; k < 10; k++) {
+			if (cD->rivFlx[k] == 1) {
+				DS->PrintVar[7 + k][i] = DS->PrintVar[7 + k][i] + h * (q[k] + DS->FluxRiv[i][k]);
+			}
+			q[k] = DS->FluxRiv[i][k];
+		}
+		q = q + 10;
+	}
+	W->QT = t;
+	W->QValid = 1;
+}
+
 /* print individual states */
 void
-PrintData(FILE ** outp, Control_Data * cD, Model_Data DS, N_Vector CV_Y, realtype t)
+PrintData(Output_Data W, FILE ** outp, Control_Data * cD, Model_Data DS, N_Vector CV_Y, realtype t)
 {
 	int             k;
 	if (cD->gwD == 1) {
-		avgResults_NV(outp[0], DS->PrintVar[0], CV_Y, cD->gwDInt, DS->NumEle, t, 2 * DS->NumEle);
+		avgResults_NV(W, outp[0], DS->PrintVar[0], CV_Y, cD->gwDInt, DS->NumEle, t, 2 * DS->NumEle, DS->EleNew);
 	}
 	if (cD->surfD == 1) {
-		avgResults_NV(outp[1], DS->PrintVar[1], CV_Y, cD->surfDInt, DS->NumEle, t, 0 * DS->NumEle);
+		avgResults_NV(W, outp[1], DS->PrintVar[1], CV_Y, cD->surfDInt, DS->NumEle, t, 0 * DS->NumEle, DS->EleNew);
 	}
 	for (k = 0; k < 3; k++) {
 		if (cD->et[k] == 1) {
-			avgResults_MD(outp[2 + k], DS->PrintVar[2 + k], DS, cD->etInt, DS->NumEle, t, 3 + k);
+			avgResults_MD(W, outp[2 + k], DS->PrintVar[2 + k], DS, cD->etInt, DS->NumEle, t, 3 + k, DS->EleNew);
 		}
 	}
 	if (cD->IsD == 1) {
-		avgResults_MD(outp[5], DS->PrintVar[5], DS, cD->IsDInt, DS->NumEle, t, 6);
+		avgResults_MD(W, outp[5], DS->PrintVar[5], DS, cD->IsDInt, DS->NumEle, t, 6, DS->EleNew);
 	}
 	if (cD->snowD == 1) {
-		avgResults_MD(outp[6], DS->PrintVar[6], DS, cD->snowDInt, DS->NumEle, t, 7);
+		avgResults_MD(W, outp[6], DS->PrintVar[6], DS, cD->snowDInt, DS->NumEle, t, 7, DS->EleNew);
 	}
-	for (k = 0; k <= 10; k++) {
+	/* .para has switches for rivFlx0 to rivFlx9 only */
+	for (k = 0; k < 10; k++) {
 		if (cD->rivFlx[k] == 1) {
-			avgResults_MD(outp[7 + k], DS->PrintVar[k + 7], DS, cD->rivFlxInt, DS->NumRiv, t, k + 8);
+			avgResults_MD(W, outp[7 + k], DS->PrintVar[k + 7], DS, cD->rivFlxInt, DS->NumRiv, t, k + 8, DS->RivNew);
 		}
 	}
 	if (cD->rivStg == 1) {
-		avgResults_NV(outp[18], DS->PrintVar[18], CV_Y, cD->rivStgInt, DS->NumRiv, t, 3 * DS->NumEle);
-		avgResults_NV(outp[21], DS->PrintVar[21], CV_Y, cD->rivStgInt, DS->NumRiv, t, 3 * DS->NumEle + DS->NumRiv);
+		avgResults_NV(W, outp[18], DS->PrintVar[18], CV_Y, cD->rivStgInt, DS->NumRiv, t, 3 * DS->NumEle, DS->RivNew);
+		avgResults_NV(W, outp[21], DS->PrintVar[21], CV_Y, cD->rivStgInt, DS->NumRiv, t, 3 * DS->NumEle + DS->NumRiv, DS->RivNew);
 		//? ? BHATT
 	}
 	if (cD->Rech == 1) {
-		avgResults_MD(outp[20], DS->PrintVar[20], DS, cD->RechInt, DS->NumEle, t, 19);
-		avgResults_MD(outp[22], DS->PrintVar[22], DS, cD->RechInt, DS->NumEle, t, 21);
+		avgResults_MD(W, outp[20], DS->PrintVar[20], DS, cD->RechInt, DS->NumEle, t, 19, DS->EleNew);
+		avgResults_MD(W, outp[22], DS->PrintVar[22], DS, cD->RechInt, DS->NumEle, t, 21, DS->EleNew);
 		//? ? BHATT
 	}
 	if (cD->usD == 1) {
-		avgResults_NV(outp[19], DS->PrintVar[19], CV_Y, cD->usDInt, DS->NumEle, t, 1 * DS->NumEle);
+		avgResults_NV(W, outp[19], DS->PrintVar[19], CV_Y, cD->usDInt, DS->NumEle, t, 1 * DS->NumEle, DS->EleNew);
 	}
 }
+/* Solver statistics of the whole run (for comparison of solver options) */
+void
+FPrintFinalStats(FILE * fpin, void *cvode_mem, Control_Data * cD, realtype cputime)
+{
+	long int        nst, nfe, nni, ncfn, netf, nli, nfeLS, npe, nps;
+
+	CVodeGetNumSteps(cvode_mem, &nst);
+	CVodeGetNumRhsEvals(cvode_mem, &nfe);
+	CVodeGetNumNonlinSolvIters(cvode_mem, &nni);
+	CVodeGetNumNonlinSolvConvFails(cvode_mem, &ncfn);
+	CVodeGetNumErrTestFails(cvode_mem, &netf);
+	CVSpilsGetNumLinIters(cvode_mem, &nli);
+	CVSpilsGetNumRhsEvals(cvode_mem, &nfeLS);
+	CVSpilsGetNumPrecEvals(cvode_mem, &npe);
+	CVSpilsGetNumPrecSolves(cvode_mem, &nps);
+
+	fprintf(fpin, "\nFinal Statistics (Solver = %d)\n", cD->Solver);
+	fprintf(fpin, "Steps = %ld\tErr test fails = %ld\n", nst, netf);
+	fprintf(fpin, "Newton iters = %ld\tNewton conv fails = %ld\n", nni, ncfn);
+	fprintf(fpin, "Linear iters = %ld\tLinear iters per Newton iter = %lf\n", nli, (nni > 0) ? (realtype) nli / nni : 0);
+	fprintf(fpin, "RHS evals = %ld (CVODE) + %ld (J*v)\n", nfe, nfeLS);
+	fprintf(fpin, "Prec setups = %ld\tPrec solves = %ld\n", npe, nps);
+	fprintf(fpin, "CPU time = %lf s\n", cputime);
+}
+/* Output statistics of the whole run */
+void
+FPrintOutputStats(FILE * fpin, Output_Data W)
+{
+	fprintf(fpin, "Output records = %ld\tRing slots = %d\n", W->NumRec, W->NumSlot);
+	fprintf(fpin, "Stalled on output = %lf s (ring full) + %lf s (at end)\n", W->Stall, W->Drain);
+	fprintf(fpin, "Output bytes = %lld (%.3lf of float64 values)\tWriter busy = %lf s (%.1lf MB/s of float64 values)\n", (long long) W->Bytes, (W->Values > 0) ? W->Bytes / (8 * W->Values) : 0, W->Busy, (W->Busy > 0) ? 8 * W->Values / W->Busy / 1048576 : 0);
+}
@@ -13,6 +13,11 @@
  *    Stormflow, Element beneath river, river shapes, river bed property, 	 *
  *    thresholds for root zone, infiltration and macropore depths, land cover    * 
  *    attributes etc)                                                            *
+ * c) Time series records are read by ReadTSD into time/value arrays carved     *
+ *    from one arena (DS->TSArena), released with a single TSDArenaFree         *
+ * d) Files are read with the tokenizer of parse.c; the .mesh, .att and .forc   *
+ *    records are parsed in concurrent OpenMP sections                          *
+ * e) With DS->StreamForc long .forc series are windowed by stream.c            *
  *--------------------------------------------------------------------------------*
  * For questions or comments, please contact                                      *
  *      --> Mukesh Kumar (muk139@psu.edu)                                         *
@@ -30,121 +35,262 @@
 //#include "sundialstypes.h"
 #include "pihm.h"  
 
+void FreeCache(Model_Data DS);
+/* Buffered tokenizer (parse.c) */
+text_file *TextOpen(char *filename, char *ext);
+void TextClose(text_file *T);
+int TextInt(text_file *T, char *what);
+realtype TextReal(text_file *T, char *what);
+void TextWord(text_file *T, char *w, int size, char *what);
+int TextMore(text_file *T);
+/* Streamed .forc series (stream.c) */
+struct tsd_pool_type *StreamOpen(char *filename);
+int StreamTSD(struct tsd_pool_type *P, text_file *T, TSD *ts);
+void StreamClose(struct tsd_pool_type *P);
+/* Calibration factors, also read for each member of an ensemble */
+void ReadCalib(text_file *T, globalCal *Cal, processCal *pcCal);
+
+
+/* Allocate/free the per element arrays of element_hot (n entries each) */
+void EleHotAlloc(element_hot *EH, int n)
+	{
+	EH->area = (realtype *)malloc(n*sizeof(realtype));
+	EH->zmin = (realtype *)malloc(n*sizeof(realtype));
+	EH->zmax = (realtype *)malloc(n*sizeof(realtype));
+	EH->KsatH = (realtype *)malloc(n*sizeof(realtype));
+	EH->KsatV = (realtype *)malloc(n*sizeof(realtype));
+	EH->infKsatV = (realtype *)malloc(n*sizeof(realtype));
+	EH->Porosity = (realtype *)malloc(n*sizeof(realtype));
+	EH->infD = (realtype *)malloc(n*sizeof(realtype));
+	EH->Alpha = (realtype *)malloc(n*sizeof(realtype));
+	EH->Beta = (realtype *)malloc(n*sizeof(realtype));
+	EH->RzD = (realtype *)malloc(n*sizeof(realtype));
+	EH->macD = (realtype *)malloc(n*sizeof(realtype));
+	EH->macKsatH = (realtype *)malloc(n*sizeof(realtype));
+	EH->macKsatV = (realtype *)malloc(n*sizeof(realtype));
+	EH->vAreaF = (realtype *)malloc(n*sizeof(realtype));
+	EH->hAreaF = (realtype *)malloc(n*sizeof(realtype));
+	EH->Macropore = (int *)malloc(n*sizeof(int));
+	EH->VegFrac = (realtype *)malloc(n*sizeof(realtype));
+	EH->Albedo = (realtype *)malloc(n*sizeof(realtype));
+	EH->Rs_ref = (realtype *)malloc(n*sizeof(realtype));
+	EH->Rmin = (realtype *)malloc(n*sizeof(realtype));
+	EH->Rough = (realtype *)malloc(n*sizeof(realtype));
+	EH->windH = (realtype *)malloc(n*sizeof(realtype));
+	EH->soil = (int *)malloc(n*sizeof(int));
+	EH->LC = (int *)malloc(n*sizeof(int));
+	}
+void EleHotFree(element_hot *EH)
+	{
+	free(EH->area);
+	free(EH->zmin);
+	free(EH->zmax);
+	free(EH->KsatH);
+	free(EH->KsatV);
+	free(EH->infKsatV);
+	free(EH->Porosity);
+	free(EH->infD);
+	free(EH->Alpha);
+	free(EH->Beta);
+	free(EH->RzD);
+	free(EH->macD);
+	free(EH->macKsatH);
+	free(EH->macKsatV);
+	free(EH->vAreaF);
+	free(EH->hAreaF);
+	free(EH->Macropore);
+	free(EH->VegFrac);
+	free(EH->Albedo);
+	free(EH->Rs_ref);
+	free(EH->Rmin);
+	free(EH->Rough);
+	free(EH->windH);
+	free(EH->soil);
+	free(EH->LC);
+	}
+
+/* n realtypes from the TSD arena, aligned to TSD_ALIGN bytes */
+realtype *TSDArenaAlloc(tsd_block **A, int n)
+	{
+	size_t m;
+	tsd_block *B;
+
+	/* keep every array start aligned */
+	m = ((size_t)n*sizeof(realtype)+TSD_ALIGN-1)/TSD_ALIGN*TSD_ALIGN/sizeof(realtype);
+	if(*A == NULL || (*A)->used+m > (*A)->size)
+		{
+		B = (tsd_block *)malloc(sizeof(tsd_block));
+		B->size = (m > TSD_BLOCK) ? m : TSD_BLOCK;
+		B->used = 0;
+		B->raw = malloc(B->size*sizeof(realtype)+TSD_ALIGN);
+		B->data = (realtype *)(((size_t)B->raw+TSD_ALIGN-1)/TSD_ALIGN*TSD_ALIGN);
+		B->next = *A;
+		*A = B;
+		}
+	(*A)->used = (*A)->used+m;
+	return (*A)->data+(*A)->used-m;
+	}
+void TSDArenaFree(tsd_block *A)
+	{
+	tsd_block *B;
+
+	while(A != NULL)
+		{
+		B = A->next;
+		free(A->raw);
+		free(A);
+		A = B;
+		}
+	}
+
+/*
+ * Header (name index length) and length records of one time series; if
+ * extra is not NULL a fourth header field is read into it. With a pool
+ * (--stream) long series are left on disk and windowed by stream.c.
+ */
+void ReadTSD(text_file *fp, TSD *ts, realtype *extra, struct tsd_pool_type *P, tsd_block **A)
+	{
+	int j;
+
+	TextWord(fp, ts->name, sizeof(ts->name), "name");
+	ts->index = TextInt(fp, "index");
+	ts->length = TextInt(fp, "length");
+	if(extra != NULL)
+		{
+		*extra = TextReal(fp, "header value");
+		}
+	ts->iCounter = 0;
+	ts->src = NULL;
+	if(P != NULL && StreamTSD(P, fp, ts))
+		{
+		return;
+		}
+	ts->first = 0;
+	ts->count = ts->length;
+	ts->time = TSDArenaAlloc(A, ts->length);
+	ts->value = TSDArenaAlloc(A, ts->length);
+	for(j=0; j<ts->length; j++)
+		{
+		ts->time[j] = TextReal(fp, "time");
+		ts->value[j] = TextReal(fp, "value");
+		}
+	}
 
 void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
 	{
   	int i, j;
-  	int tempindex;
   
   	int NumTout;
-  	char *fn[10];
   	char tempchar[50];
-  
-  	FILE *mesh_file;	/* Pointer to .mesh file */
-  	FILE *att_file;		/* Pointer to .att file */
-  	FILE *forc_file;	/* Pointer to .forc file*/
-  	FILE *ibc_file;		/* Pointer to .ibc file*/
-  	FILE *soil_file;	/* Pointer to .soil file */
-  	FILE *geol_file;	/* Pointer to .geol file */
-  	FILE *lc_file;		/* Pointer to .lc file */
-  	FILE *para_file;	/* Pointer to .para file*/
-  	FILE *riv_file;		/* Pointer to .riv file */
-	FILE *global_calib;	/* Pointer to .calib file */
+  	char *tempend;
+  
+  	text_file *mesh_file;	/* Pointer to .mesh file */
+  	text_file *att_file;		/* Pointer to .att file */
+  	text_file *forc_file;	/* Pointer to .forc file*/
+  	text_file *ibc_file;		/* Pointer to .ibc file*/
+  	text_file *soil_file;	/* Pointer to .soil file */
+  	text_file *geol_file;	/* Pointer to .geol file */
+  	text_file *lc_file;		/* Pointer to .lc file */
+  	text_file *para_file;	/* Pointer to .para file*/
+  	text_file *riv_file;		/* Pointer to .riv file */
+	text_file *global_calib;	/* Pointer to .calib file */
  
   
 //  	printf("\nStart reading in input files ... \n");
+  	DS->TSArena = NULL;
+  	DS->CacheMap = NULL;
+  	DS->Pool = NULL;
   
   	/*========== open *.riv file ==========*/ 
 //  	printf("\n  1) reading %s.riv  ... ", filename);
-  	fn[0] = (char *)malloc((strlen(filename)+6)*sizeof(char));
-  	strcpy(fn[0], filename);
-  	riv_file =  fopen(strcat(fn[0], ".riv"), "r");
-    free(fn[0]);
+  	riv_file = TextOpen(filename, ".riv");
   	if(riv_file == NULL)
   		{
- //   		printf("\n  Fatal Error: %s.riv is in use or does not exist!\n", filename);
+     		printf("\n  Fatal Error: %s.riv is in use or does not exist!\n", filename);
     		exit(1);
   		}
   
   	/* start reading riv_file */ 
-  	fscanf(riv_file, "%d", &DS->NumRiv);
+  	DS->NumRiv = TextInt(riv_file, "NumRiv");
   
   	DS->Riv = (river_segment *)malloc(DS->NumRiv*sizeof(river_segment));
   //	DS->Riv_IC = (river_IC *)malloc(DS->NumRiv*sizeof(river_IC));
   
   	for (i=0; i<DS->NumRiv; i++)
   		{
-    		fscanf(riv_file, "%d", &(DS->Riv[i].index));
-    		fscanf(riv_file, "%d %d", &(DS->Riv[i].FromNode), &(DS->Riv[i].ToNode));
-    		fscanf(riv_file, "%d", &(DS->Riv[i].down));
-    		fscanf(riv_file, "%d %d", &(DS->Riv[i].LeftEle), &(DS->Riv[i].RightEle));
-    		fscanf(riv_file, "%d %d", &(DS->Riv[i].shape), &(DS->Riv[i].material));
-    		fscanf(riv_file, "%d %d", &(DS->Riv[i].IC), &(DS->Riv[i].BC));  
-    		fscanf(riv_file, "%d", &(DS->Riv[i].reservoir));                        
+    		DS->Riv[i].index = TextInt(riv_file, "index");
+    		DS->Riv[i].FromNode = TextInt(riv_file, "FromNode");
+    		DS->Riv[i].ToNode = TextInt(riv_file, "ToNode");
+    		DS->Riv[i].down = TextInt(riv_file, "down");
+    		DS->Riv[i].LeftEle = TextInt(riv_file, "LeftEle");
+    		DS->Riv[i].RightEle = TextInt(riv_file, "RightEle");
+    		DS->Riv[i].shape = TextInt(riv_file, "shape");
+    		DS->Riv[i].material = TextInt(riv_file, "material");
+    		DS->Riv[i].IC = TextInt(riv_file, "IC");
+    		DS->Riv[i].BC = TextInt(riv_file, "BC");
+    		DS->Riv[i].reservoir = TextInt(riv_file, "reservoir");
   		} 
   
-  	fscanf(riv_file, "%s %d", tempchar, &DS->NumRivShape);
+  	TextWord(riv_file, tempchar, sizeof(tempchar), "section name");
+  	DS->NumRivShape = TextInt(riv_file, "NumRivShape");
   	DS->Riv_Shape = (river_shape *)malloc(DS->NumRivShape*sizeof(river_shape));
   
   	for (i=0; i<DS->NumRivShape; i++)
   		{
-    		fscanf(riv_file, "%d", &DS->Riv_Shape[i].index);
-    		fscanf(riv_file, "%lf", &DS->Riv_Shape[i].depth);
-    		fscanf(riv_file, "%d %lf",&DS->Riv_Shape[i].interpOrd,&DS->Riv_Shape[i].coeff);
+    		DS->Riv_Shape[i].index = TextInt(riv_file, "index");
+    		DS->Riv_Shape[i].depth = TextReal(riv_file, "depth");
+    		DS->Riv_Shape[i].interpOrd = TextInt(riv_file, "interpOrd");
+    		DS->Riv_Shape[i].coeff = TextReal(riv_file, "coeff");
   		}
   
-  	fscanf(riv_file, "%s %d", tempchar, &DS->NumRivMaterial);
+  	TextWord(riv_file, tempchar, sizeof(tempchar), "section name");
+  	DS->NumRivMaterial = TextInt(riv_file, "NumRivMaterial");
   	DS->Riv_Mat = (river_material *)malloc(DS->NumRivMaterial*sizeof(river_material));
   
   	for (i=0; i<DS->NumRivMaterial; i++)
   		{
-    		fscanf(riv_file, "%d %lf %lf %lf %lf %lf", &DS->Riv_Mat[i].index, &DS->Riv_Mat[i].Rough, &DS->Riv_Mat[i].Cwr, &DS->Riv_Mat[i].KsatH,&DS->Riv_Mat[i].KsatV,&DS->Riv_Mat[i].bedThick);
+    		DS->Riv_Mat[i].index = TextInt(riv_file, "index");
+    		DS->Riv_Mat[i].Rough = TextReal(riv_file, "Rough");
+    		DS->Riv_Mat[i].Cwr = TextReal(riv_file, "Cwr");
+    		DS->Riv_Mat[i].KsatH = TextReal(riv_file, "KsatH");
+    		DS->Riv_Mat[i].KsatV = TextReal(riv_file, "KsatV");
+    		DS->Riv_Mat[i].bedThick = TextReal(riv_file, "bedThick");
   		}
   
-  	fscanf(riv_file, "%s %d", tempchar, &DS->NumRivIC);
+  	TextWord(riv_file, tempchar, sizeof(tempchar), "section name");
+  	DS->NumRivIC = TextInt(riv_file, "NumRivIC");
   	DS->Riv_IC = (river_IC *)malloc(DS->NumRivIC*sizeof(river_IC));
   
   	for (i=0; i<DS->NumRivIC; i++)
   		{
-    		fscanf(riv_file, "%d %lf", &DS->Riv_IC[i].index, &DS->Riv_IC[i].value);
+    		DS->Riv_IC[i].index = TextInt(riv_file, "index");
+    		DS->Riv_IC[i].value = TextReal(riv_file, "value");
   		}
 
-  	fscanf(riv_file, "%s %d", tempchar, &DS->NumRivBC);
+  	TextWord(riv_file, tempchar, sizeof(tempchar), "section name");
+  	DS->NumRivBC = TextInt(riv_file, "NumRivBC");
   	DS->TSD_Riv = (TSD *)malloc(DS->NumRivBC*sizeof(TSD));
   
   	for(i=0; i<DS->NumRivBC; i++)
   		{
-    		fscanf(riv_file, "%s %d %d", DS->TSD_Riv[i].name, &DS->TSD_Riv[i].index, &DS->TSD_Riv[i].length);
-    
-    		DS->TSD_Riv[i].TS = (realtype **)malloc((DS->TSD_Riv[i].length)*sizeof(realtype));
-    		for(j=0; j<DS->TSD_Riv[i].length; j++)
-    			{
-      			DS->TSD_Riv[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    
-    		for(j=0; j<DS->TSD_Riv[i].length; j++)
-    			{
-      			fscanf(riv_file, "%lf %lf", &DS->TSD_Riv[i].TS[j][0], &DS->TSD_Riv[i].TS[j][1]);
-    			}
+  		ReadTSD(riv_file, &DS->TSD_Riv[i], NULL, NULL, &DS->TSArena);
   		}  
   
   	// read in reservoir information
-  	fscanf(riv_file, "%s %d", tempchar, &DS->NumRes);
+  	TextWord(riv_file, tempchar, sizeof(tempchar), "section name");
+  	DS->NumRes = TextInt(riv_file, "NumRes");
   	if(DS->NumRes > 0)
   		{
     		/* read in reservoir information */
     
   		}
   
-  	fclose(riv_file);
+  	TextClose(riv_file);
 //  	printf("done.\n");
 	
   	/*========== open *.mesh file ==========*/
 //  	printf("\n  2) reading %s.mesh ... ", filename);
-  	fn[1] = (char *)malloc((strlen(filename)+6)*sizeof(char));
-  	strcpy(fn[1], filename);
-  	mesh_file = fopen(strcat(fn[1], ".mesh"), "r");
-	free(fn[1]);
+  	mesh_file = TextOpen(filename, ".mesh");
   	if(mesh_file == NULL)
   		{
     		printf("\n  Fatal Error: %s.mesh is in use or does not exist!\n", filename);
@@ -152,73 +298,42 @@ void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
   		}
     
   	/* start reading mesh_file */ 
-  	fscanf(mesh_file,"%d %d", &DS->NumEle, &DS->NumNode);
+  	DS->NumEle = TextInt(mesh_file, "NumEle");
+  	DS->NumNode = TextInt(mesh_file, "NumNode");
   
   	DS->Ele = (element *)malloc((DS->NumEle+DS->NumRiv)*sizeof(element));
+  	EleHotAlloc(&DS->EleH, DS->NumEle+DS->NumRiv);
   	DS->Node = (nodes *)malloc(DS->NumNode*sizeof(nodes));
   
-  	/* read in elements information */ 
-  	for (i=0; i<DS->NumEle; i++)
-  		{
-    		fscanf(mesh_file, "%d", &(DS->Ele[i].index));
-    		fscanf(mesh_file, "%d %d %d", &(DS->Ele[i].node[0]), &(DS->Ele[i].node[1]), &(DS->Ele[i].node[2]));
-    		fscanf(mesh_file, "%d %d %d", &(DS->Ele[i].nabr[0]), &(DS->Ele[i].nabr[1]), &(DS->Ele[i].nabr[2]));
-  		}
-  
-  	/* read in nodes information */   
-  	for (i=0; i<DS->NumNode; i++)
-  		{
-    		fscanf(mesh_file, "%d", &(DS->Node[i].index));
-    		fscanf(mesh_file, "%lf %lf", &(DS->Node[i].x), &(DS->Node[i].y));
-    		fscanf(mesh_file, "%lf %lf", &(DS->Node[i].zmin),&(DS->Node[i].zmax));
-  		}  
-  
-//  	printf("done.\n");
-  
-  	/* finish reading mesh_files */  
-  	fclose(mesh_file);
-  
   	/*========== open *.att file ==========*/
 //  	printf("\n  3) reading %s.att  ... ", filename);
-  	fn[2] = (char *)malloc((strlen(filename)+5)*sizeof(char));
-  	strcpy(fn[2], filename);
-  	att_file = fopen(strcat(fn[2], ".att"), "r");
-	free(fn[2]);
+  	att_file = TextOpen(filename, ".att");
   	if(att_file == NULL)
   		{
     		printf("\n  Fatal Error: %s.att is in use or does not exist!\n", filename);
     		exit(1);
   		}
     
-  	/* start reading att_file */ 
   	DS->Ele_IC = (element_IC *)malloc(DS->NumEle*sizeof(element_IC));
-  	for (i=0; i<DS->NumEle; i++)
+
+  	/*========== open *.forc file ==========*/  
+  //	printf("\n  7) reading %s.forc ... ", filename);
+  	forc_file = TextOpen(filename, ".forc");
+  	if(forc_file == NULL)
+  	{
+    	printf("\n  Fatal Error: %s.forc is in use or does not exist!\n", filename);
+    	exit(1);
+  	}
+  	if(DS->StreamForc)
   		{
-    		fscanf(att_file, "%d", &(tempindex));
-    		fscanf(att_file, "%d %d %d", &(DS->Ele[i].soil), &(DS->Ele[i].geol), &(DS->Ele[i].LC));
-    		fscanf(att_file, "%lf %lf %lf %lf %lf",&(DS->Ele_IC[i].interception),&(DS->Ele_IC[i].snow),&(DS->Ele_IC[i].surf),&(DS->Ele_IC[i].unsat),&(DS->Ele_IC[i].sat));
-    		fscanf(att_file, "%d %d", &(DS->Ele[i].prep), &(DS->Ele[i].temp));
-    		fscanf(att_file, "%d %d", &(DS->Ele[i].humidity), &(DS->Ele[i].WindVel));
-    		fscanf(att_file, "%d %d", &(DS->Ele[i].Rn), &(DS->Ele[i].G));
-    		fscanf(att_file, "%d %d %d", &(DS->Ele[i].pressure), &(DS->Ele[i].source), &(DS->Ele[i].meltF));
-		for(j=0;j<3;j++)
-			{
-    			fscanf(att_file, "%d", &(DS->Ele[i].BC[j]));
-			}
-		fscanf(att_file, "%d", &(DS->Ele[i].Macropore));
- 		}
-  
-//  	printf("done.\n");
-  
-  	/* finish reading att_files */  
-  	fclose(att_file);
+  		DS->Pool = StreamOpen(filename);
+  		}
+
+  	/* the .mesh, .att and .forc records are read below, after .lc */
 
   	/*========== open *.soil file ==========*/  
 //  	printf("\n  4) reading %s.soil ... ", filename);
-  	fn[3] = (char *)malloc((strlen(filename)+6)*sizeof(char));
-  	strcpy(fn[3], filename);
-  	soil_file = fopen(strcat(fn[3], ".soil"), "r");
-	free(fn[3]);
+  	soil_file = TextOpen(filename, ".soil");
   	if(soil_file == NULL)
   		{
     		printf("\n  Fatal Error: %s.soil is in use or does not exist!\n", filename);
@@ -226,28 +341,29 @@ void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
   		}
   
   	/* start reading soil_file */  
-  	fscanf(soil_file, "%d", &DS->NumSoil);
+  	DS->NumSoil = TextInt(soil_file, "NumSoil");
   	DS->Soil = (soils *)malloc(DS->NumSoil*sizeof(soils));
   
   	for (i=0; i<DS->NumSoil; i++)
   		{
-    		fscanf(soil_file, "%d", &(DS->Soil[i].index));
+    		DS->Soil[i].index = TextInt(soil_file, "index");
 		/* Note: Soil KsatH and macKsatH is not used in model calculation anywhere */
-    		fscanf(soil_file, "%lf",&(DS->Soil[i].KsatV));
-    		fscanf(soil_file, "%lf %lf %lf", &(DS->Soil[i].ThetaS), &(DS->Soil[i].ThetaR), &(DS->Soil[i].infD));
-    		fscanf(soil_file, "%lf %lf", &(DS->Soil[i].Alpha), &(DS->Soil[i].Beta));
-    		fscanf(soil_file, "%lf %lf", &(DS->Soil[i].hAreaF),&(DS->Soil[i].macKsatV));
+    		DS->Soil[i].KsatV = TextReal(soil_file, "KsatV");
+    		DS->Soil[i].ThetaS = TextReal(soil_file, "ThetaS");
+    		DS->Soil[i].ThetaR = TextReal(soil_file, "ThetaR");
+    		DS->Soil[i].infD = TextReal(soil_file, "infD");
+    		DS->Soil[i].Alpha = TextReal(soil_file, "Alpha");
+    		DS->Soil[i].Beta = TextReal(soil_file, "Beta");
+    		DS->Soil[i].hAreaF = TextReal(soil_file, "hAreaF");
+    		DS->Soil[i].macKsatV = TextReal(soil_file, "macKsatV");
   		} 
  
-  	fclose(soil_file);
+  	TextClose(soil_file);
 //  	printf("done.\n");
 
         /*========== open *.geol file ==========*/
 //        printf("\n  5) reading %s.geol ... ", filename);
-        fn[4] = (char *)malloc((strlen(filename)+6)*sizeof(char));
-        strcpy(fn[4], filename);
-        geol_file = fopen(strcat(fn[4], ".geol"), "r");
-		free(fn[4]);
+        geol_file = TextOpen(filename, ".geol");
         if(geol_file == NULL)
                 {
                 printf("\n  Fatal Error: %s.geol is in use or does not exist!\n", filename);
@@ -255,29 +371,31 @@ void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
                 }
 
         /* start reading*/ 
-        fscanf(geol_file, "%d", &DS->NumGeol);
+        DS->NumGeol = TextInt(geol_file, "NumGeol");
         DS->Geol = (geol *)malloc(DS->NumGeol*sizeof(geol));
 
         for (i=0; i<DS->NumGeol; i++)
                 {
-                fscanf(geol_file, "%d", &(DS->Geol[i].index));
+                DS->Geol[i].index = TextInt(geol_file, "index");
                 /* Geol macKsatV is not used in model calculation anywhere */
-                fscanf(geol_file, "%lf %lf", &(DS->Geol[i].KsatH),&(DS->Geol[i].KsatV));
-                fscanf(geol_file, "%lf %lf", &(DS->Geol[i].ThetaS), &(DS->Geol[i].ThetaR));
-                fscanf(geol_file, "%lf %lf", &(DS->Geol[i].Alpha), &(DS->Geol[i].Beta));
-                fscanf(geol_file, "%lf %lf %lf", &(DS->Geol[i].vAreaF),&(DS->Geol[i].macKsatH),&(DS->Geol[i].macD));
+                DS->Geol[i].KsatH = TextReal(geol_file, "KsatH");
+                DS->Geol[i].KsatV = TextReal(geol_file, "KsatV");
+                DS->Geol[i].ThetaS = TextReal(geol_file, "ThetaS");
+                DS->Geol[i].ThetaR = TextReal(geol_file, "ThetaR");
+                DS->Geol[i].Alpha = TextReal(geol_file, "Alpha");
+                DS->Geol[i].Beta = TextReal(geol_file, "Beta");
+                DS->Geol[i].vAreaF = TextReal(geol_file, "vAreaF");
+                DS->Geol[i].macKsatH = TextReal(geol_file, "macKsatH");
+                DS->Geol[i].macD = TextReal(geol_file, "macD");
                 }
 
-        fclose(geol_file);
+        TextClose(geol_file);
 //        printf("done.\n");
 
 
   	/*========== open *.lc file ==========*/  
 //  	printf("\n  6) reading %s.lc ... ", filename);
-  	fn[5] = (char *)malloc((strlen(filename)+4)*sizeof(char));
-  	strcpy(fn[5], filename);
-  	lc_file = fopen(strcat(fn[5], ".lc"), "r");
-    free(fn[5]);
+  	lc_file = TextOpen(filename, ".lc");
   	if(lc_file == NULL)
   		{
     		printf("\n  Fatal Error: %s.land cover is in use or does not exist!\n", filename);
@@ -285,253 +403,186 @@ void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
   		}
   
   	/* start reading land cover file */  
-  	fscanf(lc_file, "%d", &DS->NumLC);
+  	DS->NumLC = TextInt(lc_file, "NumLC");
   
   	DS->LandC = (LC *)malloc(DS->NumLC*sizeof(LC));
   
   	for (i=0; i<DS->NumLC; i++)
   		{
-    		fscanf(lc_file, "%d", &(DS->LandC[i].index));
-    		fscanf(lc_file, "%lf", &(DS->LandC[i].LAImax));
-    		fscanf(lc_file, "%lf %lf", &(DS->LandC[i].Rmin), &(DS->LandC[i].Rs_ref));
-    		fscanf(lc_file, "%lf %lf", &(DS->LandC[i].Albedo), &(DS->LandC[i].VegFrac));
-    		fscanf(lc_file, "%lf %lf", &(DS->LandC[i].Rough),&(DS->LandC[i].RzD));
+    		DS->LandC[i].index = TextInt(lc_file, "index");
+    		DS->LandC[i].LAImax = TextReal(lc_file, "LAImax");
+    		DS->LandC[i].Rmin = TextReal(lc_file, "Rmin");
+    		DS->LandC[i].Rs_ref = TextReal(lc_file, "Rs_ref");
+    		DS->LandC[i].Albedo = TextReal(lc_file, "Albedo");
+    		DS->LandC[i].VegFrac = TextReal(lc_file, "VegFrac");
+    		DS->LandC[i].Rough = TextReal(lc_file, "Rough");
+    		DS->LandC[i].RzD = TextReal(lc_file, "RzD");
   		} 
  
-  	fclose(lc_file);
+  	TextClose(lc_file);
  // 	printf("done.\n");
+  	/*
+  	 * The large files are parsed concurrently: element and node records,
+  	 * element attributes and forcing are independent of each other
+  	 */
+#pragma omp parallel sections private(i, j)
+  	{
+#pragma omp section
+  		{
+  		/* read in elements information */ 
+  		for (i=0; i<DS->NumEle; i++)
+  			{
+    			DS->Ele[i].index = TextInt(mesh_file, "index");
+    			DS->Ele[i].node[0] = TextInt(mesh_file, "node[0]");
+    			DS->Ele[i].node[1] = TextInt(mesh_file, "node[1]");
+    			DS->Ele[i].node[2] = TextInt(mesh_file, "node[2]");
+    			DS->Ele[i].nabr[0] = TextInt(mesh_file, "nabr[0]");
+    			DS->Ele[i].nabr[1] = TextInt(mesh_file, "nabr[1]");
+    			DS->Ele[i].nabr[2] = TextInt(mesh_file, "nabr[2]");
+  			}
 
+  		/* read in nodes information */   
+  		for (i=0; i<DS->NumNode; i++)
+  			{
+    			DS->Node[i].index = TextInt(mesh_file, "index");
+    			DS->Node[i].x = TextReal(mesh_file, "x");
+    			DS->Node[i].y = TextReal(mesh_file, "y");
+    			DS->Node[i].zmin = TextReal(mesh_file, "zmin");
+    			DS->Node[i].zmax = TextReal(mesh_file, "zmax");
+  			}  
 
-  	/*========== open *.forc file ==========*/  
-  //	printf("\n  7) reading %s.forc ... ", filename);
-  	fn[6] = (char *)malloc((strlen(filename)+6)*sizeof(char));
-  	strcpy(fn[6], filename);
-  	forc_file = fopen(strcat(fn[6], ".forc"), "r");
-    free(fn[6]);
-  	if(forc_file == NULL)
-  	{
-    	printf("\n  Fatal Error: %s.forc is in use or does not exist!\n", filename);
-    	exit(1);
-  	}
-  
-  	/* start reading forc_file */
-  	fscanf(forc_file, "%d %d", &DS->NumPrep, &DS->NumTemp);
-  	fscanf(forc_file, "%d %d", &DS->NumHumidity, &DS->NumWindVel);
-  	fscanf(forc_file, "%d %d", &DS->NumRn, &DS->NumG);
-  	fscanf(forc_file, "%d %d", &DS->NumP, &DS->NumLC);
-  	fscanf(forc_file, "%d", &DS->NumMeltF);
-  	fscanf(forc_file, "%d", &DS->NumSource);
-  
-  	DS->TSD_Prep = (TSD *)malloc(DS->NumPrep*sizeof(TSD));
-  	DS->TSD_Temp = (TSD *)malloc(DS->NumTemp*sizeof(TSD));
-  	DS->TSD_Humidity = (TSD *)malloc(DS->NumHumidity*sizeof(TSD));
-  	DS->TSD_WindVel = (TSD *)malloc(DS->NumWindVel*sizeof(TSD));
-  	DS->TSD_Rn = (TSD *)malloc(DS->NumRn*sizeof(TSD));
-  	DS->TSD_G = (TSD *)malloc(DS->NumG*sizeof(TSD));
-  	DS->TSD_Pressure = (TSD *)malloc(DS->NumP*sizeof(TSD));
-  	DS->TSD_LAI = (TSD *)malloc(DS->NumLC*sizeof(TSD));
-  	DS->TSD_RL = (TSD *)malloc(DS->NumLC*sizeof(TSD));  
-  	DS->TSD_MeltF = (TSD *)malloc(DS->NumMeltF*sizeof(TSD));
-  	DS->TSD_Source = (TSD *)malloc(DS->NumSource*sizeof(TSD));
-  
-  	DS->ISFactor = (realtype *)malloc(DS->NumLC*sizeof(realtype));
-  	DS->windH = (realtype *)malloc(DS->NumWindVel*sizeof(realtype));
-     
-  	for(i=0; i<DS->NumPrep; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d", DS->TSD_Prep[i].name, &DS->TSD_Prep[i].index, &DS->TSD_Prep[i].length);
-    
-    		DS->TSD_Prep[i].TS = (realtype **)malloc((DS->TSD_Prep[i].length)*sizeof(realtype));
-    
-    		for(j=0; j<DS->TSD_Prep[i].length; j++)
-    			{
-      			DS->TSD_Prep[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-   		DS->TSD_Prep[i].iCounter=0; 
-    		for(j=0; j<DS->TSD_Prep[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_Prep[i].TS[j][0], &DS->TSD_Prep[i].TS[j][1]);
-    			}
-  		}  
-  
-  	for(i=0; i<DS->NumTemp; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d", DS->TSD_Temp[i].name, &DS->TSD_Temp[i].index, &DS->TSD_Temp[i].length);
-    
-    		DS->TSD_Temp[i].TS = (realtype **)malloc((DS->TSD_Temp[i].length)*sizeof(realtype));
-    
-    		for(j=0; j<DS->TSD_Temp[i].length; j++)
-    			{
-      			DS->TSD_Temp[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    		DS->TSD_Temp[i].iCounter=0;
-    		for(j=0; j<DS->TSD_Temp[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_Temp[i].TS[j][0], &DS->TSD_Temp[i].TS[j][1]);
-    			}
-  		} 
-  
-  	for(i=0; i<DS->NumHumidity; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d", DS->TSD_Humidity[i].name, &DS->TSD_Humidity[i].index, &DS->TSD_Humidity[i].length);
-    
-    		DS->TSD_Humidity[i].TS = (realtype **)malloc((DS->TSD_Humidity[i].length)*sizeof(realtype));
-    
-    		for(j=0; j<DS->TSD_Humidity[i].length; j++)
-    			{
-      			DS->TSD_Humidity[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    		DS->TSD_Humidity[i].iCounter=0;
-    		for(j=0; j<DS->TSD_Humidity[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_Humidity[i].TS[j][0], &DS->TSD_Humidity[i].TS[j][1]);
-    			}
-  		} 
-  
-  	for(i=0; i<DS->NumWindVel; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d %lf", DS->TSD_WindVel[i].name, &DS->TSD_WindVel[i].index, &DS->TSD_WindVel[i].length, &DS->windH[i]);
-    		DS->TSD_WindVel[i].TS = (realtype **)malloc((DS->TSD_WindVel[i].length)*sizeof(realtype));
-    DS->TSD_WindVel[i].iCounter=0;
-    		for(j=0; j<DS->TSD_WindVel[i].length; j++)
-    			{
-      			DS->TSD_WindVel[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    
-    		for(j=0; j<DS->TSD_WindVel[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_WindVel[i].TS[j][0], &DS->TSD_WindVel[i].TS[j][1]);
-    			}
-  		} 
+//  	printf("done.\n");
 
-  	for(i=0; i<DS->NumRn; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d", DS->TSD_Rn[i].name, &DS->TSD_Rn[i].index, &DS->TSD_Rn[i].length);
-    DS->TSD_Rn[i].iCounter=0;
-    		DS->TSD_Rn[i].TS = (realtype **)malloc((DS->TSD_Rn[i].length)*sizeof(realtype));
-    
-    		for(j=0; j<DS->TSD_Rn[i].length; j++)
-    			{
-      			DS->TSD_Rn[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    
-    		for(j=0; j<DS->TSD_Rn[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_Rn[i].TS[j][0], &DS->TSD_Rn[i].TS[j][1]);
-    			}
-  		} 
+  		/* finish reading mesh_files */  
+  		TextClose(mesh_file);
+  		}
+#pragma omp section
+  		{
+  		/* start reading att_file */ 
+  		for (i=0; i<DS->NumEle; i++)
+  			{
+    			TextInt(att_file, "index");	/* index, not kept */
+    			DS->EleH.soil[i] = TextInt(att_file, "soil");
+    			DS->Ele[i].geol = TextInt(att_file, "geol");
+    			DS->EleH.LC[i] = TextInt(att_file, "LC");
+    			DS->Ele_IC[i].interception = TextReal(att_file, "interception");
+    			DS->Ele_IC[i].snow = TextReal(att_file, "snow");
+    			DS->Ele_IC[i].surf = TextReal(att_file, "surf");
+    			DS->Ele_IC[i].unsat = TextReal(att_file, "unsat");
+    			DS->Ele_IC[i].sat = TextReal(att_file, "sat");
+    			DS->Ele[i].prep = TextInt(att_file, "prep");
+    			DS->Ele[i].temp = TextInt(att_file, "temp");
+    			DS->Ele[i].humidity = TextInt(att_file, "humidity");
+    			DS->Ele[i].WindVel = TextInt(att_file, "WindVel");
+    			DS->Ele[i].Rn = TextInt(att_file, "Rn");
+    			DS->Ele[i].G = TextInt(att_file, "G");
+    			DS->Ele[i].pressure = TextInt(att_file, "pressure");
+    			DS->Ele[i].source = TextInt(att_file, "source");
+    			DS->Ele[i].meltF = TextInt(att_file, "meltF");
+				for(j=0;j<3;j++)
+					{
+    				DS->Ele[i].BC[j] = TextInt(att_file, "BC");
+					}
+				DS->EleH.Macropore[i] = TextInt(att_file, "Macropore");
+ 			}
 
-  	for(i=0; i<DS->NumG; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d", DS->TSD_G[i].name, &DS->TSD_G[i].index, &DS->TSD_G[i].length);
-     DS->TSD_G[i].iCounter=0;
-    		DS->TSD_G[i].TS = (realtype **)malloc((DS->TSD_G[i].length)*sizeof(realtype));
-    
-    		for(j=0; j<DS->TSD_G[i].length; j++)
-    			{
-      			DS->TSD_G[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    
-    		for(j=0; j<DS->TSD_G[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_G[i].TS[j][0], &DS->TSD_G[i].TS[j][1]);
-    			}
-  		} 
+//  	printf("done.\n");
 
-  	for(i=0; i<DS->NumP; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d", DS->TSD_Pressure[i].name, &DS->TSD_Pressure[i].index, &DS->TSD_Pressure[i].length);
-    DS->TSD_Pressure[i].iCounter=0;
-    		DS->TSD_Pressure[i].TS = (realtype **)malloc((DS->TSD_Pressure[i].length)*sizeof(realtype));
-    
-    		for(j=0; j<DS->TSD_Pressure[i].length; j++)
-    			{
-      			DS->TSD_Pressure[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    
-    		for(j=0; j<DS->TSD_Pressure[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_Pressure[i].TS[j][0], &DS->TSD_Pressure[i].TS[j][1]);
-    			}
-  		} 
+  		/* finish reading att_files */  
+  		TextClose(att_file);
+  		}
+#pragma omp section
+  		{
+  		/* start reading forc_file */
+  		DS->NumPrep = TextInt(forc_file, "NumPrep");
+  		DS->NumTemp = TextInt(forc_file, "NumTemp");
+  		DS->NumHumidity = TextInt(forc_file, "NumHumidity");
+  		DS->NumWindVel = TextInt(forc_file, "NumWindVel");
+  		DS->NumRn = TextInt(forc_file, "NumRn");
+  		DS->NumG = TextInt(forc_file, "NumG");
+  		DS->NumP = TextInt(forc_file, "NumP");
+  		DS->NumLC = TextInt(forc_file, "NumLC");
+  		DS->NumMeltF = TextInt(forc_file, "NumMeltF");
+  		DS->NumSource = TextInt(forc_file, "NumSource");
 
-  	for(i=0; i<DS->NumLC; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d %lf", DS->TSD_LAI[i].name, &DS->TSD_LAI[i].index, &DS->TSD_LAI[i].length, &DS->ISFactor[i]);
-    DS->TSD_LAI[i].iCounter=0;
-    		DS->TSD_LAI[i].TS = (realtype **)malloc((DS->TSD_LAI[i].length)*sizeof(realtype));
-    
-    		for(j=0; j<DS->TSD_LAI[i].length; j++)
-    			{
-      			DS->TSD_LAI[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    
-    		for(j=0; j<DS->TSD_LAI[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_LAI[i].TS[j][0], &DS->TSD_LAI[i].TS[j][1]);
-    			}
-  		} 
+  		DS->TSD_Prep = (TSD *)malloc(DS->NumPrep*sizeof(TSD));
+  		DS->TSD_Temp = (TSD *)malloc(DS->NumTemp*sizeof(TSD));
+  		DS->TSD_Humidity = (TSD *)malloc(DS->NumHumidity*sizeof(TSD));
+  		DS->TSD_WindVel = (TSD *)malloc(DS->NumWindVel*sizeof(TSD));
+  		DS->TSD_Rn = (TSD *)malloc(DS->NumRn*sizeof(TSD));
+  		DS->TSD_G = (TSD *)malloc(DS->NumG*sizeof(TSD));
+  		DS->TSD_Pressure = (TSD *)malloc(DS->NumP*sizeof(TSD));
+  		DS->TSD_LAI = (TSD *)malloc(DS->NumLC*sizeof(TSD));
+  		DS->TSD_RL = (TSD *)malloc(DS->NumLC*sizeof(TSD));  
+  		DS->TSD_MeltF = (TSD *)malloc(DS->NumMeltF*sizeof(TSD));
+  		DS->TSD_Source = (TSD *)malloc(DS->NumSource*sizeof(TSD));
 
-  	for(i=0; i<DS->NumLC; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d", DS->TSD_RL[i].name, &DS->TSD_RL[i].index, &DS->TSD_RL[i].length);
-    
-    		DS->TSD_RL[i].TS = (realtype **)malloc((DS->TSD_RL[i].length)*sizeof(realtype));
-    DS->TSD_RL[i].iCounter=0;
-    		for(j=0; j<DS->TSD_RL[i].length; j++)
-    			{
-      			DS->TSD_RL[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    
-    		for(j=0; j<DS->TSD_RL[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_RL[i].TS[j][0], &DS->TSD_RL[i].TS[j][1]);
-    			}
-  		} 
-  
-  	for(i=0; i<DS->NumMeltF; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d", DS->TSD_MeltF[i].name, &DS->TSD_MeltF[i].index, &DS->TSD_MeltF[i].length);
-    DS->TSD_MeltF[i].iCounter=0;
-    		DS->TSD_MeltF[i].TS = (realtype **)malloc((DS->TSD_MeltF[i].length)*sizeof(realtype));
-    
-    		for(j=0; j<DS->TSD_MeltF[i].length; j++)
-    			{
-      			DS->TSD_MeltF[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    
-    		for(j=0; j<DS->TSD_MeltF[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_MeltF[i].TS[j][0], &DS->TSD_MeltF[i].TS[j][1]);
-    			}
-  		} 
-  
-  	for(i=0; i<DS->NumSource; i++)
-  		{
-    		fscanf(forc_file, "%s %d %d", DS->TSD_Source[i].name, &DS->TSD_Source[i].index, &DS->TSD_Source[i].length);
-    
-    		DS->TSD_Source[i].TS = (realtype **)malloc((DS->TSD_Source[i].length)*sizeof(realtype));
-    
-    		for(j=0; j<DS->TSD_Source[i].length; j++)
-    			{
-      			DS->TSD_Source[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-    			}
-    
-    		for(j=0; j<DS->TSD_Source[i].length; j++)
-    			{
-      			fscanf(forc_file, "%lf %lf", &DS->TSD_Source[i].TS[j][0], &DS->TSD_Source[i].TS[j][1]);
-    			}
-  		} 
+  		DS->ISFactor = (realtype *)malloc(DS->NumLC*sizeof(realtype));
+  		DS->windH = (realtype *)malloc(DS->NumWindVel*sizeof(realtype));
+
+  		for(i=0; i<DS->NumPrep; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_Prep[i], NULL, DS->Pool, &DS->TSArena);
+  			}  
 
-  	fclose(forc_file);
+  		for(i=0; i<DS->NumTemp; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_Temp[i], NULL, DS->Pool, &DS->TSArena);
+  			} 
+
+  		for(i=0; i<DS->NumHumidity; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_Humidity[i], NULL, DS->Pool, &DS->TSArena);
+  			} 
+
+  		for(i=0; i<DS->NumWindVel; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_WindVel[i], &DS->windH[i], DS->Pool, &DS->TSArena);
+  			} 
+
+  		for(i=0; i<DS->NumRn; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_Rn[i], NULL, DS->Pool, &DS->TSArena);
+  			} 
+
+  		for(i=0; i<DS->NumG; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_G[i], NULL, DS->Pool, &DS->TSArena);
+  			} 
+
+  		for(i=0; i<DS->NumP; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_Pressure[i], NULL, DS->Pool, &DS->TSArena);
+  			} 
+
+  		for(i=0; i<DS->NumLC; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_LAI[i], &DS->ISFactor[i], DS->Pool, &DS->TSArena);
+  			} 
+
+  		for(i=0; i<DS->NumLC; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_RL[i], NULL, DS->Pool, &DS->TSArena);
+  			} 
+
+  		for(i=0; i<DS->NumMeltF; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_MeltF[i], NULL, DS->Pool, &DS->TSArena);
+  			} 
+
+  		for(i=0; i<DS->NumSource; i++)
+  			{
+  			ReadTSD(forc_file, &DS->TSD_Source[i], NULL, DS->Pool, &DS->TSArena);
+  			} 
+
+  		TextClose(forc_file);
 //  	printf("done.\n");
+  		}
+  	}
  
   	/*========== open *.ibc file ==========*/     
 //  	printf("\n  8) reading %s.ibc  ... ", filename);  
-  	fn[7] = (char *)malloc((strlen(filename)+5)*sizeof(char));
-  	strcpy(fn[7], filename);
-  	ibc_file =  fopen(strcat(fn[7], ".ibc"), "r");
-    free(fn[7]);
+  	ibc_file = TextOpen(filename, ".ibc");
   	if(ibc_file == NULL)
   		{
     		printf("\n  Fatal Error: %s.ibc is in use or does not exist!\n", filename);
@@ -539,7 +590,8 @@ void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
   		}
   
   	/* start reading ibc_file */
-  	fscanf(ibc_file, "%d %d", &DS->Num1BC, &DS->Num2BC);
+  	DS->Num1BC = TextInt(ibc_file, "Num1BC");
+  	DS->Num2BC = TextInt(ibc_file, "Num2BC");
   
   	if(DS->Num1BC+DS->Num2BC > 0)
   		{
@@ -551,19 +603,7 @@ void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
     		/* For elements with Dirichilet Boundary Conditions */
     		for(i=0; i<DS->Num1BC; i++)
     			{
-      			fscanf(ibc_file, "%s %d %d", DS->TSD_EleBC[i].name, &DS->TSD_EleBC[i].index,&DS->TSD_EleBC[i].length);
-      
-      			DS->TSD_EleBC[i].TS = (realtype **)malloc((DS->TSD_EleBC[i].length)*sizeof(realtype));
-      
-      			for(j=0; j<DS->TSD_EleBC[i].length; j++)
-      				{
-        			DS->TSD_EleBC[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-      				}
-      
-      			for(j=0; j<DS->TSD_EleBC[i].length; j++)
-      				{
-        			fscanf(forc_file, "%lf %lf", &DS->TSD_EleBC[i].TS[j][0],&DS->TSD_EleBC[i].TS[j][1]);
-      				}
+    			ReadTSD(ibc_file, &DS->TSD_EleBC[i], NULL, NULL, &DS->TSArena);
     			}    
   		}
   
@@ -572,29 +612,15 @@ void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
     		/* For elements with Neumann (non-natural) Boundary Conditions */
     		for(i=DS->Num1BC; i<DS->Num1BC+DS->Num2BC; i++)
     			{
-      			fscanf(ibc_file, "%s %d %d", DS->TSD_EleBC[i].name, &DS->TSD_EleBC[i].index,&DS->TSD_EleBC[i].length);
-      
-      			DS->TSD_EleBC[i].TS = (realtype **)malloc((DS->TSD_EleBC[i].length)*sizeof(realtype));
-      
-      			for(j=0; j<DS->TSD_EleBC[i].length; j++)
-      				{
-        			DS->TSD_EleBC[i].TS[j] = (realtype *)malloc(2*sizeof(realtype));
-      				}
-      			for(j=0; j<DS->TSD_EleBC[i].length; j++)
-      				{
-        			fscanf(forc_file, "%lf %lf", &DS->TSD_EleBC[i].TS[j][0],&DS->TSD_EleBC[i].TS[j][1]);
-      				}
+    			ReadTSD(ibc_file, &DS->TSD_EleBC[i], NULL, NULL, &DS->TSArena);
     			}     
   		}
-  	fclose(ibc_file);
+  	TextClose(ibc_file);
  // 	printf("done.\n");
 
   	/*========== open *.para file ==========*/ 
   //	printf("\n  9) reading %s.para ... ", filename); 
-  	fn[8] = (char *)malloc((strlen(filename)+6)*sizeof(char));
-  	strcpy(fn[8], filename);
-  	para_file = fopen(strcat(fn[8], ".para"), "r");  
-    free(fn[8]);
+  	para_file = TextOpen(filename, ".para");
   	if(para_file == NULL)
   		{
     		printf("\n  Fatal Error: %s.para is in use or does not exist!\n", filename);
@@ -602,31 +628,124 @@ void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
   		}
   
   	/* start reading para_file */
-  	fscanf(para_file, "%d %d", &(CS->Verbose), &(CS->Debug));
-  	fscanf(para_file, "%d", &(CS->init_type));
-  	fscanf(para_file, "%d %d %d %d", &(CS->gwD), &(CS->surfD), &(CS->snowD), &(CS->rivStg));
-  	fscanf(para_file, "%d %d %d", &(CS->Rech), &(CS->IsD), &(CS->usD));
-	fscanf(para_file, "%d %d %d", &(CS->et[0]), &(CS->et[1]), &(CS->et[2]));
+  	CS->Verbose = TextInt(para_file, "Verbose");
+  	CS->Debug = TextInt(para_file, "Debug");
+  	CS->init_type = TextInt(para_file, "init_type");
+  	CS->gwD = TextInt(para_file, "gwD");
+  	CS->surfD = TextInt(para_file, "surfD");
+  	CS->snowD = TextInt(para_file, "snowD");
+  	CS->rivStg = TextInt(para_file, "rivStg");
+  	CS->Rech = TextInt(para_file, "Rech");
+  	CS->IsD = TextInt(para_file, "IsD");
+  	CS->usD = TextInt(para_file, "usD");
+	CS->et[0] = TextInt(para_file, "et[0]");
+	CS->et[1] = TextInt(para_file, "et[1]");
+	CS->et[2] = TextInt(para_file, "et[2]");
 	for(i=0;i<10;i++)
 		{
-		fscanf(para_file, "%d", &(CS->rivFlx[i]));
+		CS->rivFlx[i] = TextInt(para_file, "rivFlx");
 		}
-        fscanf(para_file, "%d %d %d %d", &(CS->gwDInt), &(CS->surfDInt), &(CS->snowDInt), &(CS->rivStgInt));
-        fscanf(para_file, "%d %d %d %d", &(CS->RechInt), &(CS->IsDInt), &(CS->usDInt), &(CS->etInt));
-	fscanf(para_file, "%d",&(CS->rivFlxInt));
+        CS->gwDInt = TextInt(para_file, "gwDInt");
+        CS->surfDInt = TextInt(para_file, "surfDInt");
+        CS->snowDInt = TextInt(para_file, "snowDInt");
+        CS->rivStgInt = TextInt(para_file, "rivStgInt");
+        CS->RechInt = TextInt(para_file, "RechInt");
+        CS->IsDInt = TextInt(para_file, "IsDInt");
+        CS->usDInt = TextInt(para_file, "usDInt");
+        CS->etInt = TextInt(para_file, "etInt");
+	CS->rivFlxInt = TextInt(para_file, "rivFlxInt");
 	
-  	fscanf(para_file, "%d %d %d", &DS->UnsatMode, &DS->SurfMode, &DS->RivMode);
-  	fscanf(para_file, "%d", &(CS->Solver));
-  	if(CS->Solver == 2)
-  		{
-    		fscanf(para_file, "%d %d %lf", &CS->GSType, &CS->MaxK, &CS->delt);
+  	DS->UnsatMode = TextInt(para_file, "UnsatMode");
+  	DS->SurfMode = TextInt(para_file, "SurfMode");
+  	DS->RivMode = TextInt(para_file, "RivMode");
+  	CS->Solver = TextInt(para_file, "Solver");
+  	if(CS->Solver >= 2)
+  		{
+    		CS->GSType = TextInt(para_file, "GSType");
+    		CS->MaxK = TextInt(para_file, "MaxK");
+    		CS->delt = TextReal(para_file, "delt");
   		}
-  	fscanf(para_file, "%lf %lf", &(CS->abstol), &(CS->reltol));
-  	fscanf(para_file, "%lf %lf %lf", &(CS->InitStep), &(CS->MaxStep), &(CS->ETStep));
-  	fscanf(para_file, "%lf %lf %d", &(CS->StartTime), &(CS->EndTime), &(CS->outtype));
+  	CS->abstol = TextReal(para_file, "abstol");
+  	CS->reltol = TextReal(para_file, "reltol");
+  	CS->InitStep = TextReal(para_file, "InitStep");
+  	CS->MaxStep = TextReal(para_file, "MaxStep");
+  	CS->ETStep = TextReal(para_file, "ETStep");
+  	CS->StartTime = TextReal(para_file, "StartTime");
+  	CS->EndTime = TextReal(para_file, "EndTime");
+  	CS->outtype = TextInt(para_file, "outtype");
   	if(CS->outtype == 0)
   		{
-    		fscanf(para_file, "%lf %lf", &CS->a, &CS->b);
+    		CS->a = TextReal(para_file, "a");
+    		CS->b = TextReal(para_file, "b");
+  		}
+  	/* optional keyword fields after the required ones */
+  	CS->OutFormat = 0;
+  	CS->OutError = 0;
+  	CS->DenseOut = 0;
+  	CS->ETBreaks = 0;
+  	CS->QuadOut = 0;
+  	DS->CanopyODE = 0;
+  	while(TextMore(para_file))
+  		{
+  		TextWord(para_file, tempchar, sizeof(tempchar), "keyword");
+  		if(strcmp(tempchar, "OutFormat") == 0)
+  			{
+  			CS->OutFormat = TextInt(para_file, "OutFormat");
+  			if(CS->OutFormat != 0 && CS->OutFormat != 1 && CS->OutFormat != 4 && CS->OutFormat != 8)
+  				{
+  				printf("\n  Fatal Error: %s.para: OutFormat must be 0 (text), 1 (chunk store), 4 or 8 (binary)\n", filename);
+  				exit(1);
+  				}
+  			}
+  		else if(strcmp(tempchar, "OutError") == 0)
+  			{
+  			CS->OutError = TextReal(para_file, "OutError");
+  			}
+  		else if(strcmp(tempchar, "DenseOut") == 0)
+  			{
+  			CS->DenseOut = TextInt(para_file, "DenseOut");
+  			if(CS->DenseOut != 0 && CS->DenseOut != 1)
+  				{
+  				printf("\n  Fatal Error: %s.para: DenseOut must be 0 (off) or 1 (on)\n", filename);
+  				exit(1);
+  				}
+  			}
+  		else if(strcmp(tempchar, "ETBreaks") == 0)
+  			{
+  			CS->ETBreaks = TextInt(para_file, "ETBreaks");
+  			if(CS->ETBreaks != 0 && CS->ETBreaks != 1)
+  				{
+  				printf("\n  Fatal Error: %s.para: ETBreaks must be 0 (off) or 1 (on)\n", filename);
+  				exit(1);
+  				}
+  			}
+  		else if(strcmp(tempchar, "QuadOut") == 0)
+  			{
+  			CS->QuadOut = TextInt(para_file, "QuadOut");
+  			if(CS->QuadOut != 0 && CS->QuadOut != 1)
+  				{
+  				printf("\n  Fatal Error: %s.para: QuadOut must be 0 (off) or 1 (on)\n", filename);
+  				exit(1);
+  				}
+  			}
+  		else if(strcmp(tempchar, "CanopyODE") == 0)
+  			{
+  			DS->CanopyODE = TextInt(para_file, "CanopyODE");
+  			if(DS->CanopyODE != 0 && DS->CanopyODE != 1)
+  				{
+  				printf("\n  Fatal Error: %s.para: CanopyODE must be 0 (off) or 1 (on)\n", filename);
+  				exit(1);
+  				}
+  			}
+  		else
+  			{
+  			/* bare numbers (e.g. the trailing "1 1" of older .para files) are skipped */
+  			strtod(tempchar, &tempend);
+  			if(tempend == tempchar || *tempend != '\0')
+  				{
+  				printf("\n Warning: %s.para: unknown keyword \"%s\" ignored\n", filename, tempchar);
+  				}
+  			}
   		}
   
   	if(CS->a != 1.0)
@@ -666,17 +785,14 @@ void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
     		CS->Tout[CS->NumSteps] = CS->EndTime;
   		}
   
-  	fclose(para_file); 
+  	TextClose(para_file); 
  // 	printf("done.\n"); 
 
 //	printf("\nStart reading in calibration file...\n");
 
 	/*========= open *.calib file ==========*/
 //	printf("\n  10) reading %s.calib ... ", filename);
-        fn[9] = (char *)malloc((strlen(filename)+7)*sizeof(char));
-        strcpy(fn[9], filename);
-        global_calib = fopen(strcat(fn[9], ".calib"), "r");
-		free(fn[9]);
+        global_calib = TextOpen(filename, ".calib");
         if(global_calib == NULL)
                 {
                 printf("\n  Fatal Error: %s.calib is in use or does not exist!\n", filename);
@@ -684,31 +800,52 @@ void read_alloc(char *filename, Model_Data DS, Control_Data *CS)
                 }
 
 	/* start reading calib_file */
-	fscanf(global_calib,"%lf %lf %lf %lf %lf",&CS->Cal.KsatH,&CS->Cal.KsatV,&CS->Cal.infKsatV,&CS->Cal.macKsatH,&CS->Cal.macKsatV);
-	fscanf(global_calib,"%lf %lf %lf",&CS->Cal.infD,&CS->Cal.RzD,&CS->Cal.macD);
-	fscanf(global_calib,"%lf %lf %lf",&CS->Cal.Porosity,&CS->Cal.Alpha,&CS->Cal.Beta);
-	fscanf(global_calib,"%lf %lf",&CS->Cal.vAreaF,&CS->Cal.hAreaF);
-	fscanf(global_calib,"%lf %lf %lf",&CS->Cal.VegFrac,&CS->Cal.Albedo,&CS->Cal.Rough);
-	fscanf(global_calib,"%lf %lf",&CS->Cal.Prep,&CS->Cal.Temp);
-	fscanf(global_calib,"%lf %lf %lf",&DS->pcCal.Et0,&DS->pcCal.Et1,&DS->pcCal.Et2);
-	fscanf(global_calib,"%lf %lf %lf %lf",&CS->Cal.rivRough,&CS->Cal.rivKsatH,&CS->Cal.rivKsatV,&CS->Cal.rivbedThick);
-	fscanf(global_calib,"%lf %lf",&CS->Cal.rivDepth,&CS->Cal.rivShapeCoeff);
+	ReadCalib(global_calib, &CS->Cal, &DS->pcCal);
  // 	printf("done.\n");
   
   	/* finish reading calib file */  
-  	fclose(global_calib);
+  	TextClose(global_calib);
 
 }
+
+/* The factors of a .calib file, in its order, from T */
+void
+ReadCalib(text_file * T, globalCal * Cal, processCal * pcCal)
+{
+	Cal->KsatH = TextReal(T, "KsatH");
+	Cal->KsatV = TextReal(T, "KsatV");
+	Cal->infKsatV = TextReal(T, "infKsatV");
+	Cal->macKsatH = TextReal(T, "macKsatH");
+	Cal->macKsatV = TextReal(T, "macKsatV");
+	Cal->infD = TextReal(T, "infD");
+	Cal->RzD = TextReal(T, "RzD");
+	Cal->macD = TextReal(T, "macD");
+	Cal->Porosity = TextReal(T, "Porosity");
+	Cal->Alpha = TextReal(T, "Alpha");
+	Cal->Beta = TextReal(T, "Beta");
+	Cal->vAreaF = TextReal(T, "vAreaF");
+	Cal->hAreaF = TextReal(T, "hAreaF");
+	Cal->VegFrac = TextReal(T, "VegFrac");
+	Cal->Albedo = TextReal(T, "Albedo");
+	Cal->Rough = TextReal(T, "Rough");
+	Cal->Prep = TextReal(T, "Prep");
+	Cal->Temp = TextReal(T, "Temp");
+	pcCal->Et0 = TextReal(T, "Et0");
+	pcCal->Et1 = TextReal(T, "Et1");
+	pcCal->Et2 = TextReal(T, "Et2");
+	Cal->rivRough = TextReal(T, "rivRough");
+	Cal->rivKsatH = TextReal(T, "rivKsatH");
+	Cal->rivKsatV = TextReal(T, "rivKsatV");
+	Cal->rivbedThick = TextReal(T, "rivbedThick");
+	Cal->rivDepth = TextReal(T, "rivDepth");
+	Cal->rivShapeCoeff = TextReal(T, "rivShapeCoeff");
+}
+
 void    FreeData(Model_Data DS, Control_Data * CS){
 
 /*free river*/
-int i,j;
-for (i=0;i<DS->NumRivBC;i++)
-        {
-                for(j= 0; j < DS->TSD_Riv[i].length; j++) free(DS->TSD_Riv[i].TS[j]);
-        free(DS->TSD_Riv[i].TS);
-        }
-
+int i;
+for (i = 0; i < DS->NumRiv; i++) free(DS->Riv[i].up);
 free(DS->Riv);
 free(DS->Riv_IC);
 free(DS->Riv_Shape);
@@ -717,6 +854,7 @@ free(DS->TSD_Riv);
 /*free mesh*/
 
 free(DS->Ele);
+EleHotFree(&DS->EleH);
 free(DS->Node);
 /*free att*/
 free(DS->Ele_IC);
@@ -727,88 +865,25 @@ free(DS->Geol);
 /*free lc*/
 free( DS->LandC);
 /*free forc*/
-for (i = 0; i < DS->NumPrep; i++)
-        {
-                for (j = 0; j < DS->TSD_Prep[i].length; j++)free(DS->TSD_Prep[i].TS[j]);
-        free(DS->TSD_Prep[i].TS);
-        }
 free(DS->TSD_Prep);
-for (i = 0; i < DS->NumTemp; i++)
-        {
-                for (j = 0; j < DS->TSD_Temp[i].length; j++)free(DS->TSD_Temp[i].TS[j]);
-        free(DS->TSD_Temp[i].TS);
-        }
 free(DS->TSD_Temp);
-for (i = 0; i < DS->NumHumidity; i++)
-        {
-                for (j = 0; j < DS->TSD_Humidity[i].length; j++)free(DS->TSD_Humidity[i].TS[j]);
-        free(DS->TSD_Humidity[i].TS);
-        }
 free(DS->TSD_Humidity);
-for (i = 0; i < DS->NumWindVel; i++)
-        {
-                for (j = 0; j < DS->TSD_WindVel[i].length; j++)free(DS->TSD_WindVel[i].TS[j]);
-        free(DS->TSD_WindVel[i].TS);
-        }
 free(DS->TSD_WindVel);
 free(DS->windH);
-for (i = 0; i < DS->NumRn; i++)
-        {
-                for (j = 0; j < DS->TSD_Rn[i].length; j++)free(DS->TSD_Rn[i].TS[j]);
-        free(DS->TSD_Rn[i].TS);
-        }
 free(DS->TSD_Rn);
-for (i = 0; i < DS->NumG; i++)
-        {
-                for (j = 0; j < DS->TSD_G[i].length; j++)free(DS->TSD_G[i].TS[j]);
-        free(DS->TSD_G[i].TS);
-        }
 free(DS->TSD_G);
-for (i = 0; i < DS->NumP; i++)
-        {
-                for (j = 0; j < DS->TSD_Pressure[i].length; j++)free(DS->TSD_Pressure[i].TS[j]);
-        free(DS->TSD_Pressure[i].TS);
-        }       
 free(DS->TSD_Pressure);
-for (i = 0; i < DS->NumLC; i++)
-        {
-                for (j = 0; j < DS->TSD_LAI[i].length; j++)free(DS->TSD_LAI[i].TS[j]);
-                for (j=0;j<DS->TSD_RL[i].length; j++)   free(DS->TSD_RL[i].TS[j]);
-        
-        free(DS->TSD_LAI[i].TS);
-        free(DS->TSD_RL[i].TS);
-        }
 free(DS->TSD_LAI);
 free(DS->TSD_RL);
-for (i = 0; i < DS->NumMeltF; i++)
-        {
-                for (j = 0; j < DS->TSD_MeltF[i].length; j++)free(DS->TSD_MeltF[i].TS[j]);
-        free(DS->TSD_MeltF[i].TS);
-        }
 free(DS->TSD_MeltF);
-for (i = 0; i < DS->NumSource; i++)
-        {
-                for (j = 0; j < DS->TSD_Source[i].length; j++)free(DS->TSD_Source[i].TS[j]);
-        free(DS->TSD_Source[i].TS);
-        }
 free(DS->TSD_Source);
 free(DS->ISFactor);
 /*free ibc*/
- if (DS->Num1BC > 0)
-        for (i = 0; i < DS->Num1BC; i++)
-                {
-                for (j = 0; j < DS->TSD_EleBC[i].length; j++)free(DS->TSD_EleBC[i].TS[j]);
-                free(DS->TSD_EleBC[i].TS);
-                }
- if (DS->Num2BC > 0)
-        for (i = DS->Num1BC; i < DS->Num1BC + DS->Num2BC; i++)
-                {
-                for (j = 0; j < DS->TSD_EleBC[i].length; j++)free(DS->TSD_EleBC[i].TS[j]);
-                free(DS->TSD_EleBC[i].TS);
-                }
-        
-        
 if (DS->Num1BC + DS->Num2BC > 0) free(DS->TSD_EleBC);
+/*free records of all time series*/
+TSDArenaFree(DS->TSArena);
+StreamClose(DS->Pool);
+FreeCache(DS);
 /*free para*/ 
 free(CS->Tout);
 /*free initialize.c*/
@@ -816,6 +891,20 @@ free(CS->Tout);
 free(DS->FluxSurf);
 for (i = 0; i < DS->NumEle; i++)free(DS->FluxSub[i]);
 free(DS->FluxSub);
+free(DS->Edge);
+free(DS->ForcPrep);
+free(DS->ForcTemp);
+free(DS->ForcHumidity);
+free(DS->ForcWindVel);
+free(DS->ForcRn);
+free(DS->ForcLAI);
+free(DS->ForcRL);
+free(DS->ForcMeltF);
+free(DS->ForcEleBC);
+free(DS->ForcRiv);
+free(DS->Fam);
+free(DS->EleNew);
+free(DS->RivNew);
 for (i = 0; i < DS->NumEle; i++)free(DS->EleET[i]);
 free(DS->EleET);
 for (i = 0; i < DS->NumRiv; i++)free(DS->FluxRiv[i]);
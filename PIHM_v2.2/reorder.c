@@ -0,0 +1,263 @@
+/*******************************************************************************
+ * File        : reorder.c                                                     *
+ * Function    : Load time renumbering of elements, nodes and river segments   *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) Enabled with ./pihm --reorder. Elements are renumbered by Reverse        *
+ *    Cuthill-McKee on the element adjacency (nabr) graph, so that neighbors   *
+ *    are close in Ele[], EleH and the state vector. Nodes are renumbered in   *
+ *    order of first use by the renumbered elements and river segments in     *
+ *    order of their lower numbered bank element.                              *
+ * b) Called between read_alloc() and initialize(), so only the data read     *
+ *    from the input files is permuted (Ele, EleH.soil/LC/Macropore, Ele_IC,   *
+ *    Node, Riv). All references are remapped: nabr, node, FromNode/ToNode,    *
+ *    LeftEle/RightEle, down and the river code -4*(r+1) in Ele.BC. The index  *
+ *    field of each record keeps its number in the input files.               *
+ * c) EleNew/RivNew hold the internal index of each input element/segment.    *
+ *    The .init reader and the output writers use them, so files keep the     *
+ *    original numbering. Without --reorder they are the identity.            *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sundials_types.h"
+#include "pihm.h"
+
+/* Largest |new(i) - new(nabr of i)| over the element graph */
+static int
+Bandwidth(Model_Data DS, int *pos)
+{
+	int             i, j, k, bw = 0;
+
+	for (i = 0; i < DS->NumEle; i++) {
+		for (j = 0; j < 3; j++) {
+			if (DS->Ele[i].nabr[j] > 0) {
+				k = abs(pos[i] - pos[DS->Ele[i].nabr[j] - 1]);
+				bw = (k > bw) ? k : bw;
+			}
+		}
+	}
+	return (bw);
+}
+
+/*
+ * Breadth first search from start over unmarked elements; visited elements
+ * are marked with stamp and appended to queue[n...]. Neighbors are queued
+ * in increasing degree (Cuthill-McKee). Returns the new end of the queue.
+ */
+static int
+BFS(Model_Data DS, int start, int *deg, int *mark, int stamp, int *queue, int n)
+{
+	int             head, v, j, k, m, nb[3], tmp;
+
+	head = n;
+	queue[n++] = start;
+	mark[start] = stamp;
+	while (head < n) {
+		v = queue[head++];
+		m = 0;
+		for (j = 0; j < 3; j++) {
+			if (DS->Ele[v].nabr[j] > 0 && mark[DS->Ele[v].nabr[j] - 1] != stamp) {
+				nb[m] = DS->Ele[v].nabr[j] - 1;
+				mark[nb[m]] = stamp;
+				m++;
+			}
+		}
+		for (j = 1; j < m; j++) {
+			for (k = j; k > 0 && deg[nb[k]] < deg[nb[k - 1]]; k--) {
+				tmp = nb[k];
+				nb[k] = nb[k - 1];
+				nb[k - 1] = tmp;
+			}
+		}
+		for (j = 0; j < m; j++) {
+			queue[n++] = nb[j];
+		}
+	}
+	return (n);
+}
+
+/* Reverse Cuthill-McKee order of the elements: order[new] = old */
+static void
+RCM(Model_Data DS, int *order)
+{
+	int             i, j, n, m, start, stamp;
+	int            *deg, *mark, *queue;
+
+	deg = (int *) malloc(DS->NumEle * sizeof(int));
+	mark = (int *) malloc(DS->NumEle * sizeof(int));
+	queue = (int *) malloc(DS->NumEle * sizeof(int));
+	for (i = 0; i < DS->NumEle; i++) {
+		deg[i] = 0;
+		for (j = 0; j < 3; j++) {
+			deg[i] = deg[i] + ((DS->Ele[i].nabr[j] > 0) ? 1 : 0);
+		}
+		mark[i] = 0;
+	}
+	n = 0;
+	stamp = 1;
+	while (n < DS->NumEle) {
+		/* unnumbered element of minimum degree */
+		start = -1;
+		for (i = 0; i < DS->NumEle; i++) {
+			if (mark[i] == 0 && (start < 0 || deg[i] < deg[start])) {
+				start = i;
+			}
+		}
+		/*
+		 * pseudo-peripheral start: the element reached last by a
+		 * search from the first guess
+		 */
+		stamp++;
+		m = BFS(DS, start, deg, mark, stamp, queue, 0);
+		start = queue[m - 1];
+		for (i = 0; i < m; i++) {
+			mark[queue[i]] = 0;
+		}
+		n = BFS(DS, start, deg, mark, 1, order, n);
+	}
+	/* reverse */
+	for (i = 0; i < DS->NumEle / 2; i++) {
+		j = order[i];
+		order[i] = order[DS->NumEle - 1 - i];
+		order[DS->NumEle - 1 - i] = j;
+	}
+	free(deg);
+	free(mark);
+	free(queue);
+}
+
+/* a[new] = a[order[new]] for n items of size sz */
+static void
+Permute(void *a, int *order, int n, size_t sz)
+{
+	int             i;
+	char           *tmp;
+
+	tmp = (char *) malloc(n * sz);
+	for (i = 0; i < n; i++) {
+		memcpy(tmp + i * sz, (char *) a + order[i] * sz, sz);
+	}
+	memcpy(a, tmp, n * sz);
+	free(tmp);
+}
+
+void
+ReorderMesh(Model_Data DS, int method)
+{
+	int             i, j, k, r, bw0, bw1;
+	int            *order, *nodeNew, *rivOrder;
+
+	DS->EleNew = (int *) malloc(DS->NumEle * sizeof(int));
+	DS->RivNew = (int *) malloc(DS->NumRiv * sizeof(int));
+	for (i = 0; i < DS->NumEle; i++) {
+		DS->EleNew[i] = i;
+	}
+	for (i = 0; i < DS->NumRiv; i++) {
+		DS->RivNew[i] = i;
+	}
+	if (method == 0) {
+		return;
+	}
+	/* elements */
+	bw0 = Bandwidth(DS, DS->EleNew);
+	order = (int *) malloc(DS->NumEle * sizeof(int));
+	RCM(DS, order);
+	for (i = 0; i < DS->NumEle; i++) {
+		DS->EleNew[order[i]] = i;
+	}
+	bw1 = Bandwidth(DS, DS->EleNew);
+	Permute(DS->Ele, order, DS->NumEle, sizeof(element));
+	Permute(DS->EleH.soil, order, DS->NumEle, sizeof(int));
+	Permute(DS->EleH.LC, order, DS->NumEle, sizeof(int));
+	Permute(DS->EleH.Macropore, order, DS->NumEle, sizeof(int));
+	Permute(DS->Ele_IC, order, DS->NumEle, sizeof(element_IC));
+	for (i = 0; i < DS->NumEle; i++) {
+		for (j = 0; j < 3; j++) {
+			if (DS->Ele[i].nabr[j] > 0) {
+				DS->Ele[i].nabr[j] = DS->EleNew[DS->Ele[i].nabr[j] - 1] + 1;
+			}
+		}
+	}
+	for (r = 0; r < DS->NumRiv; r++) {
+		if (DS->Riv[r].LeftEle > 0) {
+			DS->Riv[r].LeftEle = DS->EleNew[DS->Riv[r].LeftEle - 1] + 1;
+		}
+		if (DS->Riv[r].RightEle > 0) {
+			DS->Riv[r].RightEle = DS->EleNew[DS->Riv[r].RightEle - 1] + 1;
+		}
+	}
+	free(order);
+
+	/* nodes, in order of first use */
+	nodeNew = (int *) malloc(DS->NumNode * sizeof(int));
+	order = (int *) malloc(DS->NumNode * sizeof(int));
+	for (i = 0; i < DS->NumNode; i++) {
+		nodeNew[i] = -1;
+	}
+	k = 0;
+	for (i = 0; i < DS->NumEle; i++) {
+		for (j = 0; j < 3; j++) {
+			if (nodeNew[DS->Ele[i].node[j] - 1] < 0) {
+				nodeNew[DS->Ele[i].node[j] - 1] = k++;
+			}
+		}
+	}
+	for (i = 0; i < DS->NumNode; i++) {
+		if (nodeNew[i] < 0) {
+			nodeNew[i] = k++;
+		}
+		order[nodeNew[i]] = i;
+	}
+	Permute(DS->Node, order, DS->NumNode, sizeof(nodes));
+	for (i = 0; i < DS->NumEle; i++) {
+		for (j = 0; j < 3; j++) {
+			DS->Ele[i].node[j] = nodeNew[DS->Ele[i].node[j] - 1] + 1;
+		}
+	}
+	for (r = 0; r < DS->NumRiv; r++) {
+		DS->Riv[r].FromNode = nodeNew[DS->Riv[r].FromNode - 1] + 1;
+		DS->Riv[r].ToNode = nodeNew[DS->Riv[r].ToNode - 1] + 1;
+	}
+	free(nodeNew);
+	free(order);
+
+	/*
+	 * river segments, by lower bank element (counting sort keeps the
+	 * input order of segments with the same key)
+	 */
+	rivOrder = (int *) calloc(DS->NumEle + 1, sizeof(int));
+	order = (int *) malloc(DS->NumRiv * sizeof(int));
+	for (r = 0; r < DS->NumRiv; r++) {
+		k = (DS->Riv[r].LeftEle < DS->Riv[r].RightEle) ? DS->Riv[r].LeftEle : DS->Riv[r].RightEle;
+		rivOrder[k]++;
+	}
+	for (i = 1; i <= DS->NumEle; i++) {
+		rivOrder[i] = rivOrder[i] + rivOrder[i - 1];
+	}
+	for (r = DS->NumRiv - 1; r >= 0; r--) {
+		k = (DS->Riv[r].LeftEle < DS->Riv[r].RightEle) ? DS->Riv[r].LeftEle : DS->Riv[r].RightEle;
+		rivOrder[k]--;
+		DS->RivNew[r] = rivOrder[k];
+		order[rivOrder[k]] = r;
+	}
+	Permute(DS->Riv, order, DS->NumRiv, sizeof(river_segment));
+	for (r = 0; r < DS->NumRiv; r++) {
+		if (DS->Riv[r].down > 0) {
+			DS->Riv[r].down = DS->RivNew[DS->Riv[r].down - 1] + 1;
+		}
+	}
+	for (i = 0; i < DS->NumEle; i++) {
+		for (j = 0; j < 3; j++) {
+			if (DS->Ele[i].nabr[j] > 0 && DS->Ele[i].BC[j] <= -4) {
+				DS->Ele[i].BC[j] = -4 * (DS->RivNew[-(DS->Ele[i].BC[j] / 4) - 1] + 1);
+			}
+		}
+	}
+	free(rivOrder);
+	free(order);
+
+	printf("\n Mesh renumbered (RCM): element bandwidth %d -> %d\n", bw0, bw1);
+}
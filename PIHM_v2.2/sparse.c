@@ -0,0 +1,739 @@
+/*******************************************************************************
+ * File        : sparse.c                                                      *
+ * Function    : Sparse LU preconditioner of the Newton systems of CVODE       *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) Used when Solver = 6 in .para file. The sparsity pattern of df/dy is     *
+ *    derived once from the mesh adjacency (Ele[i].nabr, Riv[i].LeftEle,       *
+ *    RightEle, down and the elements beneath river at NumEle+i), following    *
+ *    the flux terms of f().                                                   *
+ * b) Columns of df/dy are colored so that no two columns of one color share a *
+ *    row; the Jacobian is built by finite differences with one f() call per   *
+ *    color, and only when CVODE asks for a fresh Jacobian (jok = FALSE).      *
+ * c) Symbolic analysis (minimum degree ordering of the element/river cell     *
+ *    graph and fill pattern of the LU factors) is done once in SparseAlloc;   *
+ *    each setup only refactors I-gamma*J numerically. No pivoting is done;    *
+ *    a zero pivot is reported as a recoverable failure to CVODE.              *
+ * d) CVODE 2.x has no sparse direct linear solver interface. The factors are  *
+ *    therefore applied as preconditioner of CVSPGMR, which then converges in  *
+ *    a few iterations. J*v is left to the difference quotient of CVSPGMR, so  *
+ *    the Newton iteration sees the current Jacobian even where a reused one   *
+ *    has crossed a switch (e.g. the EPS/100 ponding depth) in f().            *
+ * e) SpFactor and SpSolve are also used with a Jacobian of its own by the     *
+ *    steady state groundwater solver (steady.c).                              *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+
+#include "sundials_types.h"
+#include "nvector_serial.h"
+#include "cvode_spgmr.h"
+#include "pihm.h"
+
+#define SRUR 1.4901161193847656e-08	/* sqrt of unit roundoff */
+#define PC_YMIN 1.0		/* Lower bound of |y| used to scale the FD
+				 * increment */
+
+int             f(realtype, N_Vector, N_Vector, void *);
+
+/* (row, col) pairs of df/dy collected before conversion to CSR */
+typedef struct pair_list {
+	int             Num, Max;
+	int            *Row, *Col;
+}               pair_list;
+
+static void
+AddPair(pair_list * PL, int r, int c)
+{
+	if (PL->Num == PL->Max) {
+		PL->Max = 2 * PL->Max + 64;
+		PL->Row = (int *) realloc(PL->Row, PL->Max * sizeof(int));
+		PL->Col = (int *) realloc(PL->Col, PL->Max * sizeof(int));
+	}
+	PL->Row[PL->Num] = r;
+	PL->Col[PL->Num] = c;
+	PL->Num++;
+}
+
+/* every state of Rows depends on every state of Cols */
+static void
+AddBlock(pair_list * PL, int nr, int *Rows, int nc, int *Cols)
+{
+	int             i, j;
+
+	for (i = 0; i < nr; i++) {
+		for (j = 0; j < nc; j++) {
+			AddPair(PL, Rows[i], Cols[j]);
+		}
+	}
+}
+
+/* surface heads entering dh/dx, dh/dy of element i (SurfMode = 2) */
+static int
+SlopeCols(Model_Data MD, int i, int *Cols)
+{
+	int             j, n = 0;
+
+	Cols[n++] = i;
+	for (j = 0; j < 3; j++) {
+		if (MD->Ele[i].nabr[j] > 0) {
+			if (MD->Ele[i].BC[j] > -4)
+				Cols[n++] = MD->Ele[i].nabr[j] - 1;
+			else
+				Cols[n++] = 3 * MD->NumEle - (MD->Ele[i].BC[j] / 4) - 1;
+		}
+	}
+	return n;
+}
+
+/* Pattern of df/dy following the flux terms of f() */
+static void
+JacPattern(Model_Data MD, pair_list * PL)
+{
+	int             i, j, k, e, n, d, nc, NumEle, NumRiv, Rows[3], Cols[16];
+
+	NumEle = MD->NumEle;
+	NumRiv = MD->NumRiv;
+	for (i = 0; i < NumEle; i++) {
+		/* infiltration, recharge and ET of the vertical column */
+		for (k = 0; k < 3; k++) {
+			Rows[k] = i + k * NumEle;
+		}
+		AddBlock(PL, 3, Rows, 3, Rows);
+		for (j = 0; j < 3; j++) {
+			if (MD->Ele[i].nabr[j] > 0 && MD->Ele[i].BC[j] > -4) {
+				n = MD->Ele[i].nabr[j] - 1;
+				AddPair(PL, i + 2 * NumEle, n + 2 * NumEle);
+				AddPair(PL, i, n);
+				if (MD->SurfMode == 2) {
+					nc = SlopeCols(MD, i, Cols);
+					nc = nc + SlopeCols(MD, n, Cols + nc);
+					AddBlock(PL, 1, Rows, nc, Cols);
+				}
+			}
+		}
+	}
+	for (i = 0; i < NumRiv; i++) {
+		Rows[0] = 3 * NumEle + i;
+		Rows[1] = 3 * NumEle + NumRiv + i;
+		if (MD->Riv[i].down > 0) {
+			d = MD->Riv[i].down - 1;
+			/* river-river flux */
+			Rows[2] = 3 * NumEle + d;
+			Cols[0] = 3 * NumEle + i;
+			Cols[1] = 3 * NumEle + d;
+			AddBlock(PL, 1, Rows, 2, Cols);
+			AddBlock(PL, 1, Rows + 2, 2, Cols);
+			/* flux between elements beneath river segments */
+			Rows[2] = 3 * NumEle + NumRiv + d;
+			Cols[0] = 3 * NumEle + NumRiv + i;
+			Cols[1] = 3 * NumEle + NumRiv + d;
+			Cols[2] = MD->Riv[i].LeftEle - 1 + 2 * NumEle;
+			Cols[3] = MD->Riv[i].RightEle - 1 + 2 * NumEle;
+			Cols[4] = MD->Riv[d].LeftEle - 1 + 2 * NumEle;
+			Cols[5] = MD->Riv[d].RightEle - 1 + 2 * NumEle;
+			AddBlock(PL, 1, Rows + 1, 6, Cols);
+			AddBlock(PL, 1, Rows + 2, 6, Cols);
+		} else {
+			AddPair(PL, Rows[0], Rows[0]);
+		}
+		for (k = 0; k < 2; k++) {
+			e = ((k == 0) ? MD->Riv[i].LeftEle : MD->Riv[i].RightEle) - 1;
+			if (e < 0)
+				continue;
+			/* overland and subsurface flux between river and bank */
+			Rows[2] = e;
+			Cols[0] = e;
+			Cols[1] = Rows[0];
+			AddBlock(PL, 1, Rows, 2, Cols);
+			AddBlock(PL, 1, Rows + 2, 2, Cols);
+			Rows[2] = e + 2 * NumEle;
+			Cols[0] = e + 2 * NumEle;
+			AddBlock(PL, 1, Rows, 2, Cols);
+			AddBlock(PL, 1, Rows + 2, 2, Cols);
+			/* flux between element beneath river and bank */
+			Cols[0] = Rows[1];
+			Cols[1] = MD->Riv[i].LeftEle - 1 + 2 * NumEle;
+			Cols[2] = MD->Riv[i].RightEle - 1 + 2 * NumEle;
+			AddBlock(PL, 1, Rows + 1, 3, Cols);
+			AddBlock(PL, 1, Rows + 2, 3, Cols);
+		}
+		/* leakage through river bed */
+		AddBlock(PL, 2, Rows, 2, Rows);
+	}
+}
+
+static int
+CmpInt(const void *a, const void *b)
+{
+	return (*(const int *) a - *(const int *) b);
+}
+
+/* Compressed rows of (row, col) pairs, duplicates removed */
+static void
+PairsToCSR(pair_list * PL, int n, int **Ptr, int **Idx)
+{
+	int             i, j, k, *Cnt;
+
+	Cnt = (int *) calloc(n + 1, sizeof(int));
+	for (k = 0; k < PL->Num; k++) {
+		Cnt[PL->Row[k] + 1]++;
+	}
+	for (i = 0; i < n; i++) {
+		Cnt[i + 1] = Cnt[i + 1] + Cnt[i];
+	}
+	*Idx = (int *) malloc((PL->Num + 1) * sizeof(int));
+	for (k = 0; k < PL->Num; k++) {
+		(*Idx)[Cnt[PL->Row[k]]++] = PL->Col[k];
+	}
+	for (i = n; i > 0; i--) {
+		Cnt[i] = Cnt[i - 1];
+	}
+	Cnt[0] = 0;
+	/* sort and compact each row */
+	k = 0;
+	for (i = 0; i < n; i++) {
+		qsort(*Idx + Cnt[i], Cnt[i + 1] - Cnt[i], sizeof(int), CmpInt);
+		j = Cnt[i];
+		Cnt[i] = k;
+		for (; j < Cnt[i + 1]; j++) {
+			if (k == Cnt[i] || (*Idx)[k - 1] != (*Idx)[j])
+				(*Idx)[k++] = (*Idx)[j];
+		}
+	}
+	Cnt[n] = k;
+	*Ptr = Cnt;
+}
+
+/*
+ * Minimum degree ordering of the cell graph. On return Order[k] is the cell
+ * eliminated at step k and SIdx[SPtr[k]..SPtr[k+1]-1] are the cells it is
+ * connected to at that time, i.e. the fill pattern of the factors
+ */
+static void
+MinDegree(int n, int *Ptr, int *Adj, int *Order, int **SPtr, int **SIdx)
+{
+	int           **L, *Len, *Cap, *Head, *Next, *Prev, *Mark, *Done;
+	int             i, j, k, u, v, w, d, MinD, Stamp;
+	size_t          NumS, MaxS;	/* entries of SIdx used and allocated */
+
+	L = (int **) malloc(n * sizeof(int *));
+	Len = (int *) malloc(n * sizeof(int));
+	Cap = (int *) malloc(n * sizeof(int));
+	Head = (int *) malloc((n + 1) * sizeof(int));
+	Next = (int *) malloc(n * sizeof(int));
+	Prev = (int *) malloc(n * sizeof(int));
+	Mark = (int *) calloc(n, sizeof(int));
+	Done = (int *) calloc(n, sizeof(int));
+	for (d = 0; d <= n; d++) {
+		Head[d] = -1;
+	}
+	for (i = 0; i < n; i++) {
+		Len[i] = 0;
+		Cap[i] = Ptr[i + 1] - Ptr[i] + 4;
+		L[i] = (int *) malloc(Cap[i] * sizeof(int));
+		for (j = Ptr[i]; j < Ptr[i + 1]; j++) {
+			if (Adj[j] != i)
+				L[i][Len[i]++] = Adj[j];
+		}
+	}
+	for (i = n - 1; i >= 0; i--) {
+		Prev[i] = -1;
+		Next[i] = Head[Len[i]];
+		if (Head[Len[i]] >= 0)
+			Prev[Head[Len[i]]] = i;
+		Head[Len[i]] = i;
+	}
+	*SPtr = (int *) malloc((n + 1) * sizeof(int));
+	if (n <= 0 || (size_t) n > INT_MAX / 8) {
+		printf("\n  Fatal Error: %d cells are too many for the sparse factors\n", n);
+		exit(1);
+	}
+	MaxS = 8 * (size_t) n;
+	*SIdx = (int *) malloc(MaxS * sizeof(int));
+	NumS = 0;
+	MinD = 0;
+	Stamp = 0;
+	for (k = 0; k < n; k++) {
+		while (Head[MinD] < 0)
+			MinD++;
+		v = Head[MinD];
+		Head[MinD] = Next[v];
+		if (Next[v] >= 0)
+			Prev[Next[v]] = -1;
+		Done[v] = 1;
+		Order[k] = v;
+		(*SPtr)[k] = (int) NumS;
+		if (NumS + Len[v] > MaxS) {
+			MaxS = 2 * MaxS + Len[v];
+			if (MaxS > INT_MAX) {
+				printf("\n  Fatal Error: the fill of the sparse factors exceeds %d entries\n", INT_MAX);
+				exit(1);
+			}
+			*SIdx = (int *) realloc(*SIdx, MaxS * sizeof(int));
+		}
+		for (j = 0; j < Len[v]; j++) {
+			(*SIdx)[NumS++] = L[v][j];
+		}
+		/* neighbors of v become a clique */
+		for (j = 0; j < Len[v]; j++) {
+			u = L[v][j];
+			if (Prev[u] >= 0)
+				Next[Prev[u]] = Next[u];
+			else
+				Head[Len[u]] = Next[u];
+			if (Next[u] >= 0)
+				Prev[Next[u]] = Prev[u];
+			Stamp++;
+			Mark[u] = Stamp;
+			d = 0;
+			for (i = 0; i < Len[u]; i++) {
+				if (L[u][i] != v) {
+					L[u][d++] = L[u][i];
+					Mark[L[u][i]] = Stamp;
+				}
+			}
+			Len[u] = d;
+			for (i = 0; i < Len[v]; i++) {
+				w = L[v][i];
+				if (Mark[w] != Stamp) {
+					if (Len[u] == Cap[u]) {
+						Cap[u] = 2 * Cap[u];
+						L[u] = (int *) realloc(L[u], Cap[u] * sizeof(int));
+					}
+					L[u][Len[u]++] = w;
+				}
+			}
+			Prev[u] = -1;
+			Next[u] = Head[Len[u]];
+			if (Head[Len[u]] >= 0)
+				Prev[Head[Len[u]]] = u;
+			Head[Len[u]] = u;
+			MinD = (Len[u] < MinD) ? Len[u] : MinD;
+		}
+		free(L[v]);
+		L[v] = NULL;
+	}
+	(*SPtr)[n] = (int) NumS;
+	free(L);
+	free(Len);
+	free(Cap);
+	free(Head);
+	free(Next);
+	free(Prev);
+	free(Mark);
+	free(Done);
+}
+
+/* state index of component k of cell c */
+static int
+StateIdx(Model_Data MD, int c, int k)
+{
+	if (c < MD->NumEle)
+		return c + k * MD->NumEle;
+	return 3 * MD->NumEle + k * MD->NumRiv + (c - MD->NumEle);
+}
+
+/* Symbolic analysis: elimination order of states and fill pattern of LU */
+static void
+Symbolic(Sparse_Data SD)
+{
+	Model_Data      MD;
+	pair_list       CL;
+	int             i, j, k, p, q, c, v, NumCell, NumComp, NumEle, N;
+	int            *CellOf, *CPtr, *CIdx, *Order, *Pos, *SPtr, *SIdx, *FNPtr, *FNIdx,
+	               *Cnt, *Start, *List;
+
+	MD = SD->MD;
+	NumEle = MD->NumEle;
+	N = SD->N;
+	NumCell = NumEle + MD->NumRiv;
+
+	/* cell graph from the pattern of df/dy, symmetrized */
+	CellOf = (int *) malloc(N * sizeof(int));
+	for (c = 0; c < NumCell; c++) {
+		for (k = 0; k < ((c < NumEle) ? 3 : 2); k++) {
+			CellOf[StateIdx(MD, c, k)] = c;
+		}
+	}
+	CL.Num = CL.Max = 0;
+	CL.Row = CL.Col = NULL;
+	for (i = 0; i < N; i++) {
+		for (p = SD->RowPtr[i]; p < SD->RowPtr[i + 1]; p++) {
+			if (CellOf[i] != CellOf[SD->ColIdx[p]]) {
+				AddPair(&CL, CellOf[i], CellOf[SD->ColIdx[p]]);
+				AddPair(&CL, CellOf[SD->ColIdx[p]], CellOf[i]);
+			}
+		}
+	}
+	PairsToCSR(&CL, NumCell, &CPtr, &CIdx);
+	free(CL.Row);
+	free(CL.Col);
+
+	Order = (int *) malloc(NumCell * sizeof(int));
+	Pos = (int *) malloc(NumCell * sizeof(int));
+	MinDegree(NumCell, CPtr, CIdx, Order, &SPtr, &SIdx);
+	for (k = 0; k < NumCell; k++) {
+		Pos[Order[k]] = k;
+	}
+
+	/* filled cell graph: cells connected before or after elimination */
+	Cnt = (int *) calloc(NumCell + 1, sizeof(int));
+	for (k = 0; k < NumCell; k++) {
+		for (p = SPtr[k]; p < SPtr[k + 1]; p++) {
+			Cnt[Order[k] + 1]++;
+			Cnt[SIdx[p] + 1]++;
+		}
+	}
+	for (c = 0; c < NumCell; c++) {
+		Cnt[c + 1] = Cnt[c + 1] + Cnt[c];
+	}
+	FNPtr = (int *) malloc((NumCell + 1) * sizeof(int));
+	memcpy(FNPtr, Cnt, (NumCell + 1) * sizeof(int));
+	FNIdx = (int *) malloc((Cnt[NumCell] + 1) * sizeof(int));
+	for (k = 0; k < NumCell; k++) {
+		for (p = SPtr[k]; p < SPtr[k + 1]; p++) {
+			FNIdx[Cnt[Order[k]]++] = Pos[SIdx[p]];
+			FNIdx[Cnt[SIdx[p]]++] = k;
+		}
+	}
+
+	/* states of a cell are consecutive in the elimination order */
+	Start = (int *) malloc((NumCell + 1) * sizeof(int));
+	Start[0] = 0;
+	for (k = 0; k < NumCell; k++) {
+		NumComp = (Order[k] < NumEle) ? 3 : 2;
+		Start[k + 1] = Start[k] + NumComp;
+		for (j = 0; j < NumComp; j++) {
+			SD->Perm[Start[k] + j] = StateIdx(MD, Order[k], j);
+			SD->IPerm[StateIdx(MD, Order[k], j)] = Start[k] + j;
+		}
+	}
+
+	/* filled rows of the permuted matrix; row pattern is that of its cell */
+	SD->FPtr = (int *) malloc((N + 1) * sizeof(int));
+	SD->FPtr[0] = 0;
+	for (k = 0; k < NumCell; k++) {
+		v = Order[k];
+		q = 0;
+		for (p = FNPtr[v]; p < FNPtr[v + 1]; p++) {
+			q = q + Start[FNIdx[p] + 1] - Start[FNIdx[p]];
+		}
+		q = q + Start[k + 1] - Start[k];
+		for (j = Start[k]; j < Start[k + 1]; j++) {
+			SD->FPtr[j + 1] = SD->FPtr[j] + q;
+		}
+	}
+	SD->FIdx = (int *) malloc((SD->FPtr[N] + 1) * sizeof(int));
+	SD->FDiag = (int *) malloc(N * sizeof(int));
+	List = (int *) malloc((NumCell + 1) * sizeof(int));
+	for (k = 0; k < NumCell; k++) {
+		v = Order[k];
+		q = 0;
+		List[q++] = k;
+		for (p = FNPtr[v]; p < FNPtr[v + 1]; p++) {
+			List[q++] = FNIdx[p];
+		}
+		qsort(List, q, sizeof(int), CmpInt);
+		for (j = Start[k]; j < Start[k + 1]; j++) {
+			p = SD->FPtr[j];
+			for (i = 0; i < q; i++) {
+				for (c = Start[List[i]]; c < Start[List[i] + 1]; c++) {
+					if (c == j)
+						SD->FDiag[j] = p;
+					SD->FIdx[p++] = c;
+				}
+			}
+		}
+	}
+
+	/* position of each entry of df/dy in the factors */
+	for (i = 0; i < N; i++) {
+		for (p = SD->RowPtr[i]; p < SD->RowPtr[i + 1]; p++) {
+			j = SD->IPerm[SD->ColIdx[p]];
+			SD->JMap[p] = -1;
+			for (q = SD->FPtr[SD->IPerm[i]]; q < SD->FPtr[SD->IPerm[i] + 1]; q++) {
+				if (SD->FIdx[q] == j) {
+					SD->JMap[p] = q;
+					break;
+				}
+			}
+		}
+	}
+
+	free(CellOf);
+	free(CPtr);
+	free(CIdx);
+	free(Order);
+	free(Pos);
+	free(SPtr);
+	free(SIdx);
+	free(Cnt);
+	free(FNPtr);
+	free(FNIdx);
+	free(Start);
+	free(List);
+}
+
+/* Greedy coloring of columns such that no two columns of a color share a row */
+static void
+ColorColumns(Sparse_Data SD)
+{
+	int             i, j, p, q, c, *Mark, *Cnt;
+
+	Mark = (int *) malloc(SD->N * sizeof(int));
+	for (j = 0; j < SD->N; j++) {
+		Mark[j] = -1;
+	}
+	SD->NumColor = 0;
+	for (j = 0; j < SD->N; j++) {
+		for (p = SD->ColPtr[j]; p < SD->ColPtr[j + 1]; p++) {
+			i = SD->ColRow[p];
+			for (q = SD->RowPtr[i]; q < SD->RowPtr[i + 1]; q++) {
+				if (SD->ColIdx[q] < j)
+					Mark[SD->Color[SD->ColIdx[q]]] = j;
+			}
+		}
+		for (c = 0; Mark[c] == j; c++);
+		SD->Color[j] = c;
+		SD->NumColor = (c + 1 > SD->NumColor) ? c + 1 : SD->NumColor;
+	}
+	Cnt = (int *) calloc(SD->NumColor + 1, sizeof(int));
+	for (j = 0; j < SD->N; j++) {
+		Cnt[SD->Color[j] + 1]++;
+	}
+	for (c = 0; c < SD->NumColor; c++) {
+		Cnt[c + 1] = Cnt[c + 1] + Cnt[c];
+	}
+	SD->ColorPtr = (int *) malloc((SD->NumColor + 1) * sizeof(int));
+	memcpy(SD->ColorPtr, Cnt, (SD->NumColor + 1) * sizeof(int));
+	for (j = 0; j < SD->N; j++) {
+		SD->ColorCol[Cnt[SD->Color[j]]++] = j;
+	}
+	free(Cnt);
+	free(Mark);
+}
+
+Sparse_Data
+SparseAlloc(Model_Data MD)
+{
+	Sparse_Data     SD;
+	pair_list       PL;
+	int             i, j, p, N, *Cnt;
+
+	SD = (Sparse_Data) malloc(sizeof *SD);
+	SD->MD = MD;
+	N = 3 * MD->NumEle + 2 * MD->NumRiv;
+	SD->N = N;
+
+	/* pattern of df/dy by rows and by columns */
+	PL.Num = PL.Max = 0;
+	PL.Row = PL.Col = NULL;
+	JacPattern(MD, &PL);
+	PairsToCSR(&PL, N, &SD->RowPtr, &SD->ColIdx);
+	free(PL.Row);
+	free(PL.Col);
+	SD->JVal = (realtype *) calloc(SD->RowPtr[N] + 1, sizeof(realtype));
+	SD->JMap = (int *) malloc((SD->RowPtr[N] + 1) * sizeof(int));
+	Cnt = (int *) calloc(N + 1, sizeof(int));
+	for (p = 0; p < SD->RowPtr[N]; p++) {
+		Cnt[SD->ColIdx[p] + 1]++;
+	}
+	for (j = 0; j < N; j++) {
+		Cnt[j + 1] = Cnt[j + 1] + Cnt[j];
+	}
+	SD->ColPtr = (int *) malloc((N + 1) * sizeof(int));
+	memcpy(SD->ColPtr, Cnt, (N + 1) * sizeof(int));
+	SD->ColRow = (int *) malloc((SD->RowPtr[N] + 1) * sizeof(int));
+	SD->ColPos = (int *) malloc((SD->RowPtr[N] + 1) * sizeof(int));
+	for (i = 0; i < N; i++) {
+		for (p = SD->RowPtr[i]; p < SD->RowPtr[i + 1]; p++) {
+			SD->ColRow[Cnt[SD->ColIdx[p]]] = i;
+			SD->ColPos[Cnt[SD->ColIdx[p]]++] = p;
+		}
+	}
+	free(Cnt);
+
+	SD->Color = (int *) malloc(N * sizeof(int));
+	SD->ColorCol = (int *) malloc(N * sizeof(int));
+	ColorColumns(SD);
+
+	SD->Perm = (int *) malloc(N * sizeof(int));
+	SD->IPerm = (int *) malloc(N * sizeof(int));
+	Symbolic(SD);
+	SD->FVal = (realtype *) malloc((SD->FPtr[N] + 1) * sizeof(realtype));
+	SD->Work = (realtype *) malloc(N * sizeof(realtype));
+	printf("\n Sparse LU preconditioner: %d unknowns, %d nonzeros in df/dy (%d colors), %d in LU factors", N, SD->RowPtr[N], SD->NumColor, SD->FPtr[N]);
+	return SD;
+}
+
+void
+SparseFree(Sparse_Data SD)
+{
+	free(SD->RowPtr);
+	free(SD->ColIdx);
+	free(SD->JVal);
+	free(SD->JMap);
+	free(SD->ColPtr);
+	free(SD->ColRow);
+	free(SD->ColPos);
+	free(SD->Color);
+	free(SD->ColorPtr);
+	free(SD->ColorCol);
+	free(SD->Perm);
+	free(SD->IPerm);
+	free(SD->FPtr);
+	free(SD->FIdx);
+	free(SD->FDiag);
+	free(SD->FVal);
+	free(SD->Work);
+	free(SD);
+}
+
+/* Row oriented LU of the permuted I-gamma*J in place of FVal, no pivoting */
+static int
+Factor(Sparse_Data SD)
+{
+	int             i, k, p, q;
+	realtype        lik, *W;
+
+	W = SD->Work;
+	for (i = 0; i < SD->N; i++) {
+		for (p = SD->FPtr[i]; p < SD->FPtr[i + 1]; p++) {
+			W[SD->FIdx[p]] = SD->FVal[p];
+		}
+		for (p = SD->FPtr[i]; p < SD->FDiag[i]; p++) {
+			k = SD->FIdx[p];
+			lik = W[k] / SD->FVal[SD->FDiag[k]];
+			W[k] = lik;
+			if (lik != 0) {
+				for (q = SD->FDiag[k] + 1; q < SD->FPtr[k + 1]; q++) {
+					W[SD->FIdx[q]] = W[SD->FIdx[q]] - lik * SD->FVal[q];
+				}
+			}
+		}
+		for (p = SD->FPtr[i]; p < SD->FPtr[i + 1]; p++) {
+			SD->FVal[p] = W[SD->FIdx[p]];
+		}
+		if (SD->FVal[SD->FDiag[i]] == 0)
+			return (i + 1);
+	}
+	return 0;
+}
+
+/*
+ * Form and factor P = I - gamma*J of the values in JVal with the saved
+ * symbolic analysis; 1 on a zero pivot
+ */
+int
+SpFactor(Sparse_Data SD, realtype gamma)
+{
+	int             i, p;
+
+	for (p = 0; p < SD->FPtr[SD->N]; p++) {
+		SD->FVal[p] = 0;
+	}
+	for (i = 0; i < SD->N; i++) {
+		SD->FVal[SD->FDiag[i]] = 1.0;
+	}
+	for (p = 0; p < SD->RowPtr[SD->N]; p++) {
+		SD->FVal[SD->JMap[p]] = SD->FVal[SD->JMap[p]] - gamma * SD->JVal[p];
+	}
+	if (Factor(SD) != 0)
+		return 1;
+	return 0;
+}
+
+int
+SpSetup(realtype t, N_Vector CV_Y, N_Vector fy, booleantype jok, booleantype * jcurPtr, realtype gamma, void *P_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+	int             i, j, k, p, q;
+	realtype       *Y, *FY, *Yp, *Fp, *Inc;
+	Sparse_Data     SD;
+
+	SD = (Sparse_Data) P_data;
+
+	if (jok) {
+		*jcurPtr = FALSE;
+	} else {
+		/* df/dy by finite differences, one f() call per color */
+		Y = NV_DATA_S(CV_Y);
+		FY = NV_DATA_S(fy);
+		Yp = NV_DATA_S(tmp1);
+		Fp = NV_DATA_S(tmp2);
+		Inc = NV_DATA_S(tmp3);
+		for (i = 0; i < SD->N; i++) {
+			Yp[i] = Y[i];
+			Inc[i] = SRUR * ((fabs(Y[i]) > PC_YMIN) ? fabs(Y[i]) : PC_YMIN);
+		}
+		/* states of CanopyODE 1, not in the pattern */
+		for (i = SD->N; i < NV_LENGTH_S(CV_Y); i++) {
+			Yp[i] = Y[i];
+		}
+		for (k = 0; k < SD->NumColor; k++) {
+			for (q = SD->ColorPtr[k]; q < SD->ColorPtr[k + 1]; q++) {
+				j = SD->ColorCol[q];
+				Yp[j] = Y[j] + Inc[j];
+			}
+			f(t, tmp1, tmp2, SD->MD);
+			for (q = SD->ColorPtr[k]; q < SD->ColorPtr[k + 1]; q++) {
+				j = SD->ColorCol[q];
+				for (p = SD->ColPtr[j]; p < SD->ColPtr[j + 1]; p++) {
+					i = SD->ColRow[p];
+					SD->JVal[SD->ColPos[p]] = (Fp[i] - FY[i]) / Inc[j];
+				}
+				Yp[j] = Y[j];
+			}
+		}
+		*jcurPtr = TRUE;
+	}
+
+	return SpFactor(SD, gamma);
+}
+
+int
+SpSolve(realtype t, N_Vector CV_Y, N_Vector fy, N_Vector r, N_Vector z, realtype gamma, realtype delta, int lr, void *P_data, N_Vector tmp)
+{
+	int             i, p;
+	realtype       *R, *Z, *W;
+	Sparse_Data     SD;
+
+	/* the factors of SpSetup are applied as they are */
+	(void) t;
+	(void) CV_Y;
+	(void) fy;
+	(void) gamma;
+	(void) delta;
+	(void) lr;
+	(void) tmp;
+	SD = (Sparse_Data) P_data;
+	R = NV_DATA_S(r);
+	Z = NV_DATA_S(z);
+	W = SD->Work;
+
+	for (i = 0; i < SD->N; i++) {
+		W[i] = R[SD->Perm[i]];
+	}
+	for (i = 0; i < SD->N; i++) {
+		for (p = SD->FPtr[i]; p < SD->FDiag[i]; p++) {
+			W[i] = W[i] - SD->FVal[p] * W[SD->FIdx[p]];
+		}
+	}
+	for (i = SD->N - 1; i >= 0; i--) {
+		for (p = SD->FDiag[i] + 1; p < SD->FPtr[i + 1]; p++) {
+			W[i] = W[i] - SD->FVal[p] * W[SD->FIdx[p]];
+		}
+		W[i] = W[i] / SD->FVal[SD->FDiag[i]];
+	}
+	for (i = 0; i < SD->N; i++) {
+		Z[SD->Perm[i]] = W[i];
+	}
+	for (i = SD->N; i < NV_LENGTH_S(r); i++) {
+		Z[i] = R[i];
+	}
+	return 0;
+}
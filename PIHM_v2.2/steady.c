@@ -0,0 +1,301 @@
+/*******************************************************************************
+ * File        : steady.c                                                      *
+ * Function    : Steady state groundwater heads under a mean recharge          *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) With ./pihm --steady R the sat heads of the elements and the heads of    *
+ *    the cells beneath the rivers are replaced, after initialize(), by the    *
+ *    solution of                                                              *
+ *        R - sum of FluxSub / area = 0          (element aquifers)            *
+ *        FluxRiv[6] - FluxRiv[7..10] = 0         (river bed cells)            *
+ *    R is the mean net recharge to the water table (m/day: infiltration less  *
+ *    ET from the saturated zone). The fluxes are those of f() at StartTime;   *
+ *    surface, unsat and river stage are held at their initial values.         *
+ * b) The system is solved by Newton iterations on pseudo time (dh/dtau =      *
+ *    residual / porosity): each iteration solves (I - dtau*J) dh = dtau*G     *
+ *    with the sparse LU of sparse.c, and dtau grows as the residual falls,    *
+ *    so the first iterations follow the transient and the last ones are       *
+ *    plain Newton. A step that does not lower the 2-norm of the residual is   *
+ *    shortened, then retried with less dtau. J is built by finite             *
+ *    differences with the column colors of sparse.c, perturbing only the      *
+ *    sat and bed heads.                                                       *
+ * c) Heads are kept above 0, and those of the elements below the surface.     *
+ *    An element whose water table reaches the surface with a positive         *
+ *    residual seeps: it is held there and left out of the convergence test.   *
+ * d) The heads are written to project.steady.init in the layout of .init      *
+ *    (copy it to project.init and use init_type 3 to start other runs from    *
+ *    it); unsat storage above a raised water table is cut as in init_type 1.  *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include "sundials_types.h"
+#include "nvector_serial.h"
+#include "pihm.h"
+
+#define SRUR 1.4901161193847656e-08	/* sqrt of unit roundoff */
+#define STEADY_TOL 1.0e-6	/* Max. residual (m/day of head) */
+#define STEADY_MAXIT 200	/* Max. Newton iterations */
+#define STEADY_DTAU0 1.0	/* First pseudo time step (days) */
+#define STEADY_DTAUMAX 1.0e12	/* Largest pseudo time step (days) */
+#define STEADY_LAMMIN 0.01	/* Shortest fraction of a step tried */
+
+int             f(realtype, N_Vector, N_Vector, void *);
+realtype        CS_AreaOrPerem(int, realtype, realtype, realtype);
+Sparse_Data     SparseAlloc(Model_Data);
+void            SparseFree(Sparse_Data);
+int             SpFactor(Sparse_Data, realtype);
+int             SpSolve(realtype, N_Vector, N_Vector, N_Vector, N_Vector, realtype, realtype, int, void *, N_Vector);
+int             WriteInit(char *, char *, Model_Data, N_Vector);
+
+/* 1 for the unknowns of the steady state: sat heads and bed heads */
+static int
+Unknown(Model_Data DS, int i)
+{
+	return (i >= 2 * DS->NumEle && i < 3 * DS->NumEle) || (i >= 3 * DS->NumEle + DS->NumRiv && i < 3 * DS->NumEle + 2 * DS->NumRiv);
+}
+
+/*
+ * Upper bound of unknown i: the aquifer depth of an element; a cell beneath
+ * a river has none, its water leaks to the river
+ */
+static realtype
+Top(Model_Data DS, int i)
+{
+	if (i < 3 * DS->NumEle) {
+		return DS->EleH.zmax[i - 2 * DS->NumEle] - DS->EleH.zmin[i - 2 * DS->NumEle];
+	}
+	return 1.0e30;
+}
+
+/* Rates of change of the heads (m/day) at the state Y, into G */
+static void
+Residual(Model_Data DS, realtype t, N_Vector Y, N_Vector Ydot, realtype R, realtype * G)
+{
+	int             i, j;
+	realtype        width;
+
+	f(t, Y, Ydot, DS);
+	for (i = 0; i < 3 * DS->NumEle + 2 * DS->NumRiv; i++) {
+		G[i] = 0;
+	}
+	for (i = 0; i < DS->NumEle; i++) {
+		G[i + 2 * DS->NumEle] = R;
+		for (j = 0; j < 3; j++) {
+			G[i + 2 * DS->NumEle] = G[i + 2 * DS->NumEle] - DS->FluxSub[i][j] / DS->EleH.area[i];
+		}
+		G[i + 2 * DS->NumEle] = G[i + 2 * DS->NumEle] / DS->EleH.Porosity[i];
+	}
+	for (i = 0; i < DS->NumRiv; i++) {
+		width = CS_AreaOrPerem(DS->Riv_Shape[DS->Riv[i].shape - 1].interpOrd, DS->Riv[i].depth, DS->Riv[i].coeff, 3);
+		G[i + 3 * DS->NumEle + DS->NumRiv] = (DS->FluxRiv[i][6] - DS->FluxRiv[i][7] - DS->FluxRiv[i][8] - DS->FluxRiv[i][9] - DS->FluxRiv[i][10]) / (DS->EleH.Porosity[i + DS->NumEle] * DS->Riv[i].Length * width);
+	}
+}
+
+/* 1 if unknown i is held at a bound: the water table at the surface (seepage) or dry */
+static int
+Held(Model_Data DS, int i, realtype y, realtype g)
+{
+	return (y >= Top(DS, i) && g > 0) || (y <= 0 && g < 0);
+}
+
+/*
+ * Residual of the unknowns that are free to move into Gm (0 elsewhere);
+ * returns its max norm, its 2-norm in *l2 and the number of seeping elements
+ */
+static realtype
+Free(Model_Data DS, realtype * Y, realtype * G, realtype * Gm, realtype * l2, int *nSeep)
+{
+	int             i;
+	realtype        norm;
+
+	norm = 0;
+	*l2 = 0;
+	*nSeep = 0;
+	for (i = 0; i < 3 * DS->NumEle + 2 * DS->NumRiv; i++) {
+		Gm[i] = 0;
+		if (Unknown(DS, i) == 0) {
+			continue;
+		}
+		if (Held(DS, i, Y[i], G[i])) {
+			*nSeep = *nSeep + (i < 3 * DS->NumEle && G[i] > 0);
+		} else {
+			Gm[i] = G[i];
+			norm = (fabs(G[i]) > norm) ? fabs(G[i]) : norm;
+			*l2 = *l2 + G[i] * G[i];
+		}
+	}
+	*l2 = sqrt(*l2);
+	return norm;
+}
+
+/* dG/dh of the free unknowns by finite differences, one f() call per color */
+static void
+Jacobian(Sparse_Data SD, realtype t, N_Vector CV_Y, N_Vector Yp, N_Vector Ydot, realtype R, realtype * G, realtype * Gp)
+{
+	Model_Data      DS;
+	realtype       *Y, *P, *Inc;
+	int             i, j, k, p, q, n;
+
+	DS = SD->MD;
+	Y = NV_DATA_S(CV_Y);
+	P = NV_DATA_S(Yp);
+	Inc = SD->Work;
+	for (p = 0; p < SD->RowPtr[SD->N]; p++) {
+		SD->JVal[p] = 0;
+	}
+	for (i = 0; i < NV_LENGTH_S(CV_Y); i++) {
+		P[i] = Y[i];
+	}
+	for (j = 0; j < SD->N; j++) {
+		Inc[j] = SRUR * ((fabs(Y[j]) > 1.0) ? fabs(Y[j]) : 1.0);
+	}
+	for (k = 0; k < SD->NumColor; k++) {
+		n = 0;
+		for (q = SD->ColorPtr[k]; q < SD->ColorPtr[k + 1]; q++) {
+			j = SD->ColorCol[q];
+			if (Unknown(DS, j)) {
+				P[j] = Y[j] + Inc[j];
+				n++;
+			}
+		}
+		if (n == 0) {
+			continue;
+		}
+		Residual(DS, t, Yp, Ydot, R, Gp);
+		for (q = SD->ColorPtr[k]; q < SD->ColorPtr[k + 1]; q++) {
+			j = SD->ColorCol[q];
+			if (Unknown(DS, j) == 0) {
+				continue;
+			}
+			for (p = SD->ColPtr[j]; p < SD->ColPtr[j + 1]; p++) {
+				i = SD->ColRow[p];
+				if (Unknown(DS, i) && Held(DS, i, Y[i], G[i]) == 0) {
+					SD->JVal[SD->ColPos[p]] = (Gp[i] - G[i]) / Inc[j];
+				}
+			}
+			P[j] = Y[j];
+		}
+	}
+}
+
+/*
+ * Replace the sat and bed heads of CV_Y by their steady state under the mean
+ * recharge R (m/day) and write them to project.steady.init
+ */
+void
+SteadyState(char *filename, Model_Data DS, Control_Data * CS, N_Vector CV_Y, realtype R)
+{
+	Sparse_Data     SD;
+	N_Vector        Yp, Ydot, Rv, Zv;
+	realtype       *Y, *P, *G, *Gm, *Gp, *Gt, *Z;
+	realtype        t, dtau, lam, norm, norm1, l2, l21, h;
+	int             i, m, it, nSeep, nSeep1, nFac;
+
+	printf("\n Steady state groundwater under a recharge of %lf m/day ...", R);
+	SD = SparseAlloc(DS);
+	m = SD->N;
+	t = CS->StartTime;
+	Yp = N_VNew_Serial(NV_LENGTH_S(CV_Y));
+	Ydot = N_VNew_Serial(NV_LENGTH_S(CV_Y));
+	Rv = N_VNew_Serial(NV_LENGTH_S(CV_Y));
+	Zv = N_VNew_Serial(NV_LENGTH_S(CV_Y));
+	N_VConst(0, Rv);
+	Y = NV_DATA_S(CV_Y);
+	P = NV_DATA_S(Yp);
+	Z = NV_DATA_S(Zv);
+	G = (realtype *) malloc(m * sizeof(realtype));
+	Gm = (realtype *) malloc(m * sizeof(realtype));
+	Gp = (realtype *) malloc(m * sizeof(realtype));
+	Gt = (realtype *) malloc(m * sizeof(realtype));
+
+	for (i = 0; i < m; i++) {
+		if (Unknown(DS, i)) {
+			Y[i] = (Y[i] < 0) ? 0 : (Y[i] > Top(DS, i)) ? Top(DS, i) : Y[i];
+		}
+	}
+	Residual(DS, t, CV_Y, Ydot, R, G);
+	norm = Free(DS, Y, G, Gm, &l2, &nSeep);
+	norm1 = norm;
+	dtau = STEADY_DTAU0;
+	nFac = 0;
+	for (it = 0; it < STEADY_MAXIT && norm > STEADY_TOL; it++) {
+		Jacobian(SD, t, CV_Y, Yp, Ydot, R, G, Gp);
+		/*
+		 * a step that does not lower the residual is cut back along its
+		 * direction, and failing that retried with less dtau
+		 */
+		lam = 0;
+		while (lam == 0 && dtau > STEADY_DTAU0 * 1.0e-6) {
+			nFac++;
+			if (SpFactor(SD, dtau) == 0) {
+				for (i = 0; i < m; i++) {
+					NV_Ith_S(Rv, i) = dtau * Gm[i];
+				}
+				SpSolve(t, CV_Y, Ydot, Rv, Zv, dtau, 0, 0, SD, NULL);
+				for (lam = 1.0; lam > STEADY_LAMMIN; lam = 0.5 * lam) {
+					N_VScale(1.0, CV_Y, Yp);
+					for (i = 0; i < m; i++) {
+						if (Unknown(DS, i)) {
+							h = Y[i] + lam * Z[i];
+							P[i] = (h < 0) ? 0 : (h > Top(DS, i)) ? Top(DS, i) : h;
+						}
+					}
+					Residual(DS, t, Yp, Ydot, R, Gp);
+					norm1 = Free(DS, P, Gp, Gt, &l21, &nSeep1);
+					if (l21 < l2) {
+						break;
+					}
+				}
+				lam = (lam > STEADY_LAMMIN) ? lam : 0;
+			}
+			dtau = (lam == 0) ? 0.25 * dtau : dtau;
+		}
+		if (lam == 0) {
+			/* no step lowers the residual */
+			break;
+		}
+		N_VScale(1.0, Yp, CV_Y);
+		memcpy(G, Gp, m * sizeof(realtype));
+		memcpy(Gm, Gt, m * sizeof(realtype));
+		if (lam == 1.0) {
+			/* switched evolution relaxation, at least doubling */
+			dtau = (l21 > 0 && l2 / l21 > 2) ? dtau * l2 / l21 : 2 * dtau;
+			dtau = (dtau < STEADY_DTAUMAX) ? dtau : STEADY_DTAUMAX;
+		}
+		norm = norm1;
+		l2 = l21;
+		nSeep = nSeep1;
+		if (CS->Verbose == 1) {
+			printf("\n  iteration %d: max |dh/dtau| = %e m/day, dtau = %e days, step %lf", it + 1, norm, dtau, lam);
+		}
+	}
+	if (norm > STEADY_TOL) {
+		printf("\n Warning: no steady state after %d iterations, max |dh/dtau| = %e m/day", it, norm);
+	}
+	printf("\n Steady state: %d iterations, %d factorizations, max |dh/dtau| = %e m/day, %d seeping elements", it, nFac, norm, nSeep);
+
+	/* unsat storage that no longer fits above the water table */
+	for (i = 0; i < DS->NumEle; i++) {
+		if (Y[i + DS->NumEle] + Y[i + 2 * DS->NumEle] >= DS->EleH.zmax[i] - DS->EleH.zmin[i]) {
+			Y[i + DS->NumEle] = ((DS->EleH.zmax[i] - DS->EleH.zmin[i]) - Y[i + 2 * DS->NumEle]) * 0.98;
+			Y[i + DS->NumEle] = (Y[i + DS->NumEle] < 0) ? 0 : Y[i + DS->NumEle];
+		}
+	}
+	if (WriteInit(filename, ".steady.init", DS, CV_Y)) {
+		printf("\n Steady state written to %s.steady.init\n", filename);
+	}
+
+	free(G);
+	free(Gm);
+	free(Gp);
+	free(Gt);
+	N_VDestroy_Serial(Yp);
+	N_VDestroy_Serial(Ydot);
+	N_VDestroy_Serial(Rv);
+	N_VDestroy_Serial(Zv);
+	SparseFree(SD);
+}
@@ -0,0 +1,330 @@
+/*******************************************************************************
+ * File        : stream.c                                                      *
+ * Function    : Sliding window over the long .forc series (./pihm --stream)   *
+ *-----------------------------------------------------------------------------*
+ *                                                                             *
+ * a) A .forc series longer than two blocks of STREAM_BLOCK records is not     *
+ *    kept in memory: while the file is read only the offset, line and time   *
+ *    of the first record of each block are kept (StreamTSD).                 *
+ * b) The TSD then holds a window of two consecutive blocks, records first to *
+ *    first+count-1. TSDSeek (update.c) calls StreamSeek, which moves the     *
+ *    window when it does not bracket t.                                      *
+ * c) When t enters the second block of the window, the window one block      *
+ *    later is queued for a background thread that reads it into the spare   *
+ *    buffers, so the next move is a swap. Windows not prefetched (a jump, or *
+ *    CVODE stepping back past the window) are read by the caller at once.    *
+ * d) Values are multiplied by the calibration factor as they are read        *
+ *    (TSDScale), the product initialize() forms for series held in memory.   *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "sundials_types.h"
+#include "pihm.h"
+
+#define STREAM_BLOCK 1024	/* records per block; a window holds two */
+
+/* states of the spare window */
+#define SPARE_EMPTY 0
+#define SPARE_QUEUED 1
+#define SPARE_READING 2
+#define SPARE_READY 3
+
+typedef struct tsd_stream_type {
+	struct tsd_pool_type *pool;
+	int             length;	/* records in the file */
+	int             nBlock;
+	long           *off;	/* file offset of the first record of a block */
+	int            *line;	/* its line, for error messages */
+	realtype       *t0;	/* its time */
+	realtype        scale;	/* applied to values as they are read */
+	realtype       *wTime;	/* window in use (TSD time, value) */
+	realtype       *wValue;
+	realtype       *sTime;	/* spare window, filled by the reader */
+	realtype       *sValue;
+	int             sBlock;	/* first block of the spare window */
+	int             sState;
+}               tsd_stream;
+
+typedef struct tsd_pool_type {
+	int             num;
+	tsd_stream    **S;	/* all streamed series */
+	tsd_stream    **Q;	/* queue of spare windows to read, num+1 */
+	int             qHead, qTail;
+	text_file      *T;	/* read by the integrator */
+	text_file      *R;	/* read by the background thread */
+	pthread_t       thread;
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;	/* a window was queued or read */
+	int             quit;
+}               tsd_pool;
+
+text_file      *TextOpen(char *filename, char *ext);
+void            TextClose(text_file * T);
+void            TextSeek(text_file * T, long off, int line);
+long            TextTell(text_file * T);
+realtype        TextReal(text_file * T, char *what);
+
+/* Records in the window starting at block b */
+static int
+WindowCount(tsd_stream * S, int b)
+{
+	int             n;
+
+	n = S->length - b * STREAM_BLOCK;
+	return (n < 2 * STREAM_BLOCK) ? n : 2 * STREAM_BLOCK;
+}
+
+static void
+ReadWindow(tsd_stream * S, text_file * T, int b, realtype * time, realtype * value)
+{
+	int             j, n;
+
+	n = WindowCount(S, b);
+	TextSeek(T, S->off[b], S->line[b]);
+	for (j = 0; j < n; j++) {
+		time[j] = TextReal(T, "time");
+		value[j] = S->scale * TextReal(T, "value");
+	}
+}
+
+static void    *
+Reader(void *arg)
+{
+	tsd_pool       *P;
+	tsd_stream     *S;
+	int             b;
+
+	P = (tsd_pool *) arg;
+	pthread_mutex_lock(&P->lock);
+	while (P->quit == 0) {
+		if (P->qHead == P->qTail) {
+			pthread_cond_wait(&P->cond, &P->lock);
+			continue;
+		}
+		S = P->Q[P->qHead];
+		P->qHead = (P->qHead + 1) % (P->num + 1);
+		S->sState = SPARE_READING;
+		b = S->sBlock;
+		pthread_mutex_unlock(&P->lock);
+		ReadWindow(S, P->R, b, S->sTime, S->sValue);
+		pthread_mutex_lock(&P->lock);
+		S->sState = SPARE_READY;
+		pthread_cond_broadcast(&P->cond);
+	}
+	pthread_mutex_unlock(&P->lock);
+	return (NULL);
+}
+
+/* Streaming reader of filename.forc and its background thread */
+tsd_pool       *
+StreamOpen(char *filename)
+{
+	tsd_pool       *P;
+
+	P = (tsd_pool *) malloc(sizeof(tsd_pool));
+	P->T = TextOpen(filename, ".forc");
+	P->R = TextOpen(filename, ".forc");
+	if (P->T == NULL || P->R == NULL) {
+		printf("\n  Fatal Error: %s.forc cannot be opened for streaming\n", filename);
+		exit(1);
+	}
+	P->num = 0;
+	P->S = NULL;
+	P->Q = NULL;
+	P->qHead = 0;
+	P->qTail = 0;
+	P->quit = 0;
+	pthread_mutex_init(&P->lock, NULL);
+	pthread_cond_init(&P->cond, NULL);
+	if (pthread_create(&P->thread, NULL, Reader, P) != 0) {
+		printf("\n  Fatal Error: cannot start the forcing reader thread\n");
+		exit(1);
+	}
+	return (P);
+}
+
+void
+StreamClose(tsd_pool * P)
+{
+	int             k;
+	tsd_stream     *S;
+
+	if (P == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&P->lock);
+	P->quit = 1;
+	pthread_cond_broadcast(&P->cond);
+	pthread_mutex_unlock(&P->lock);
+	pthread_join(P->thread, NULL);
+	for (k = 0; k < P->num; k++) {
+		S = P->S[k];
+		free(S->off);
+		free(S->line);
+		free(S->t0);
+		free(S->wTime);
+		free(S->wValue);
+		free(S->sTime);
+		free(S->sValue);
+		free(S);
+	}
+	free(P->S);
+	free(P->Q);
+	TextClose(P->T);
+	TextClose(P->R);
+	pthread_mutex_destroy(&P->lock);
+	pthread_cond_destroy(&P->cond);
+	free(P);
+}
+
+/*
+ * Records of ts, whose header has just been read from T. Returns 0 if the
+ * series is short enough to be held in memory (the caller reads it);
+ * otherwise the records are skipped, keeping only the block index.
+ */
+int
+StreamTSD(tsd_pool * P, text_file * T, TSD * ts)
+{
+	tsd_stream     *S;
+	int             j, b;
+
+	if (ts->length <= 2 * STREAM_BLOCK) {
+		return (0);
+	}
+	S = (tsd_stream *) malloc(sizeof(tsd_stream));
+	S->pool = P;
+	S->length = ts->length;
+	S->nBlock = (ts->length + STREAM_BLOCK - 1) / STREAM_BLOCK;
+	S->off = (long *) malloc(S->nBlock * sizeof(long));
+	S->line = (int *) malloc(S->nBlock * sizeof(int));
+	S->t0 = (realtype *) malloc(S->nBlock * sizeof(realtype));
+	for (j = 0; j < ts->length; j++) {
+		if (j % STREAM_BLOCK == 0) {
+			b = j / STREAM_BLOCK;
+			S->off[b] = TextTell(T);
+			S->line[b] = T->line;
+			S->t0[b] = TextReal(T, "time");
+		} else {
+			TextReal(T, "time");
+		}
+		TextReal(T, "value");
+	}
+	S->scale = 1.0;
+	S->wTime = (realtype *) malloc(2 * STREAM_BLOCK * sizeof(realtype));
+	S->wValue = (realtype *) malloc(2 * STREAM_BLOCK * sizeof(realtype));
+	S->sTime = (realtype *) malloc(2 * STREAM_BLOCK * sizeof(realtype));
+	S->sValue = (realtype *) malloc(2 * STREAM_BLOCK * sizeof(realtype));
+	S->sState = SPARE_EMPTY;
+	S->sBlock = 0;
+
+	pthread_mutex_lock(&P->lock);
+	P->S = (tsd_stream **) realloc(P->S, (P->num + 1) * sizeof(tsd_stream *));
+	P->S[P->num] = S;
+	P->num++;
+	P->Q = (tsd_stream **) realloc(P->Q, (P->num + 1) * sizeof(tsd_stream *));
+	pthread_mutex_unlock(&P->lock);
+
+	/* the first window is read by the first StreamSeek */
+	ts->time = S->wTime;
+	ts->value = S->wValue;
+	ts->first = 0;
+	ts->count = 0;
+	ts->src = S;
+	return (1);
+}
+
+/* Multiply the values of ts by a */
+void
+TSDScale(TSD * ts, realtype a)
+{
+	int             j;
+
+	if (ts->src != NULL) {
+		ts->src->scale = a;
+		/* read the window again */
+		ts->count = 0;
+		return;
+	}
+	for (j = 0; j < ts->length; j++) {
+		ts->value[j] = a * ts->value[j];
+	}
+}
+
+/* 1 if the window of ts holds the records bracketing t */
+static int
+Holds(TSD * ts, realtype t)
+{
+	return ts->count > 0
+		&& (ts->first == 0 || ts->time[0] < t)
+		&& (ts->first + ts->count == ts->length || ts->time[ts->count - 1] >= t);
+}
+
+/* Move the window of a streamed series to bracket t (days) */
+void
+StreamSeek(TSD * ts, realtype t)
+{
+	tsd_stream     *S;
+	tsd_pool       *P;
+	realtype       *p;
+	int             b, lo, hi, k;
+
+	S = ts->src;
+	P = S->pool;
+	if (Holds(ts, t) == 0) {
+		/* start at the last block that begins before t */
+		lo = 0;
+		hi = S->nBlock;
+		while (lo < hi) {
+			k = (lo + hi) / 2;
+			if (S->t0[k] < t) {
+				lo = k + 1;
+			} else {
+				hi = k;
+			}
+		}
+		b = (lo > 0) ? lo - 1 : 0;
+		pthread_mutex_lock(&P->lock);
+		if (S->sState != SPARE_EMPTY && S->sBlock == b) {
+			while (S->sState != SPARE_READY) {
+				pthread_cond_wait(&P->cond, &P->lock);
+			}
+			p = S->wTime;
+			S->wTime = S->sTime;
+			S->sTime = p;
+			p = S->wValue;
+			S->wValue = S->sValue;
+			S->sValue = p;
+			S->sState = SPARE_EMPTY;
+			pthread_mutex_unlock(&P->lock);
+		} else {
+			pthread_mutex_unlock(&P->lock);
+			ReadWindow(S, P->T, b, S->wTime, S->wValue);
+		}
+		ts->time = S->wTime;
+		ts->value = S->wValue;
+		ts->first = b * STREAM_BLOCK;
+		ts->count = WindowCount(S, b);
+	}
+	/* prefetch the next window once t is in the second block */
+	if (ts->first + ts->count < ts->length && t > ts->time[STREAM_BLOCK]) {
+		b = ts->first / STREAM_BLOCK + 1;
+		pthread_mutex_lock(&P->lock);
+		if (S->sState == SPARE_READY && S->sBlock != b) {
+			S->sState = SPARE_EMPTY;
+		}
+		if (S->sState == SPARE_EMPTY) {
+			S->sBlock = b;
+			S->sState = SPARE_QUEUED;
+			P->Q[P->qTail] = S;
+			P->qTail = (P->qTail + 1) % (P->num + 1);
+			pthread_cond_broadcast(&P->cond);
+		} else if (S->sState == SPARE_QUEUED) {
+			S->sBlock = b;
+		}
+		pthread_mutex_unlock(&P->lock);
+	}
+}
@@ -10,6 +10,14 @@
  * a) New File for resetting TS index counter                                  *
  * b) Can be used in refinement/(de)refinement simulation or for any other     *
  *    temporal update of model parameters				       *
+ * c) EvalForcing interpolates each forcing series once per time into the     *
+ *    Forc* arrays read by f() and is_sm_et()				       *
+ * d) iCounter is a cursor moved both ways by TSDSeek; series families are    *
+ *    added with RegisterTSD (initialize.c) instead of a loop per family      *
+ * e) TSDSeek only uses the records held by the TSD, and moves the window of  *
+ *    streamed series (stream.c) first                                        *
+ * f) NextBreak gives the next time the slope of a series read by f() changes *
+ *    (ETBreaks 1)                                                             *
  * Acknowledgement: Thanks to Bhatt, G. for idenfication of inefficiency in    *
  * Interpolation funcn.							       *
  *******************************************************************************/
@@ -27,71 +35,154 @@
 #define UNIT_C 1440		/* 60*24 for calculation of yDot in m/min
 				 * units while forcing is in m/day. */
 
+#define TSD_STEPS 4		/* records the cursor is stepped before
+				 * falling back to binary search */
+#define BREAK_EPS 1.0e-6	/* Breakpoints closer than this (minutes)
+				 * are taken as one */
+
 realtype        Interpolation(TSD * Data, realtype t);
+void            StreamSeek(TSD * ts, realtype t);
 
-void
-update(realtype t, void *DS)
+/*
+ * Move the cursor of Data to the first record with time >= t (t in days);
+ * returns Data->length if t is past the last record. Successive times are
+ * close, so the bracket is stepped forward or backward a few records
+ * first; larger jumps (e.g. CVODE stepping back after a failed step, or a
+ * restart) use a binary search. Only records first .. first+count-1 are
+ * held; a streamed series first moves its window to bracket t.
+ */
+int
+TSDSeek(TSD * Data, realtype t)
 {
-	int             k;
-
-	Model_Data      MD;
+	int             i, k, lo, hi;
 
-	MD = (Model_Data) DS;
-	for (k = 0; k < MD->NumPrep; k++) {
-		while (MD->TSD_Prep[k].iCounter < MD->TSD_Prep[k].length && t / (UNIT_C) > MD->TSD_Prep[k].TS[MD->TSD_Prep[k].iCounter + 1][0]) {
-			MD->TSD_Prep[k].iCounter++;
-		}
-	}
-	for (k = 0; k < MD->NumTemp; k++) {
-		while (MD->TSD_Temp[k].iCounter < MD->TSD_Temp[k].length && t / (UNIT_C) > MD->TSD_Temp[k].TS[MD->TSD_Temp[k].iCounter + 1][0]) {
-			MD->TSD_Temp[k].iCounter++;
-		}
+	if (Data->src != NULL) {
+		StreamSeek(Data, t);
 	}
-	for (k = 0; k < MD->NumHumidity; k++) {
-		while (MD->TSD_Humidity[k].iCounter < MD->TSD_Humidity[k].length && t / (UNIT_C) > MD->TSD_Humidity[k].TS[MD->TSD_Humidity[k].iCounter + 1][0]) {
-			MD->TSD_Humidity[k].iCounter++;
+	lo = Data->first;
+	hi = Data->first + Data->count;
+	i = Data->iCounter;
+	for (k = 0; k < TSD_STEPS && i >= lo && i <= hi; k++) {
+		if (i < hi && t > Data->time[i - lo]) {
+			i++;
+		} else if (i > lo && t <= Data->time[i - 1 - lo]) {
+			i--;
+		} else {
+			Data->iCounter = i;
+			return i;
 		}
 	}
-	for (k = 0; k < MD->NumWindVel; k++) {
-		while (MD->TSD_WindVel[k].iCounter < MD->TSD_WindVel[k].length && t / (UNIT_C) > MD->TSD_WindVel[k].TS[MD->TSD_WindVel[k].iCounter + 1][0]) {
-			MD->TSD_WindVel[k].iCounter++;
+	while (lo < hi) {
+		k = (lo + hi) / 2;
+		if (Data->time[k - Data->first] < t) {
+			lo = k + 1;
+		} else {
+			hi = k;
 		}
 	}
+	Data->iCounter = lo;
+	return lo;
+}
 
-	for (k = 0; k < MD->NumRn; k++) {
-		while (MD->TSD_Rn[k].iCounter < MD->TSD_Rn[k].length && t / (UNIT_C) > MD->TSD_Rn[k].TS[MD->TSD_Rn[k].iCounter + 1][0]) {
-			MD->TSD_Rn[k].iCounter++;
-		}
-	}
-	for (k = 0; k < MD->NumG; k++) {
-		while (MD->TSD_G[k].iCounter < MD->TSD_G[k].length && t / (UNIT_C) > MD->TSD_G[k].TS[MD->TSD_G[k].iCounter + 1][0]) {
-			MD->TSD_G[k].iCounter++;
-		}
+/*
+ * Add num series to the families kept current by update(). If value is
+ * not NULL, EvalForcing fills value[k] with series k at the current time.
+ */
+void
+RegisterTSD(Model_Data MD, TSD * ts, int num, realtype * value)
+{
+	int             k;
+
+	MD->Fam = (tsd_family *) realloc(MD->Fam, (MD->NumFam + 1) * sizeof(tsd_family));
+	MD->Fam[MD->NumFam].TS = ts;
+	MD->Fam[MD->NumFam].num = num;
+	MD->Fam[MD->NumFam].value = value;
+	MD->NumFam++;
+	for (k = 0; k < num; k++) {
+		ts[k].iCounter = 0;
 	}
-	for (k = 0; k < MD->NumP; k++) {
-		while (MD->TSD_Pressure[k].iCounter < MD->TSD_Pressure[k].length && t / (UNIT_C) > MD->TSD_Pressure[k].TS[MD->TSD_Pressure[k].iCounter + 1][0]) {
-			MD->TSD_Pressure[k].iCounter++;
+}
+
+void
+update(realtype t, void *DS)
+{
+	int             j, k;
+
+	Model_Data      MD;
+
+	MD = (Model_Data) DS;
+	for (j = 0; j < MD->NumFam; j++) {
+		for (k = 0; k < MD->Fam[j].num; k++) {
+			TSDSeek(&MD->Fam[j].TS[k], t / (UNIT_C));
 		}
 	}
-	for (k = 0; k < MD->NumLC; k++) {
-		while (MD->TSD_LAI[k].iCounter < MD->TSD_LAI[k].length && t / (UNIT_C) > MD->TSD_LAI[k].TS[MD->TSD_LAI[k].iCounter + 1][0]) {
-			MD->TSD_LAI[k].iCounter++;
+}
+
+/*
+ * Next breakpoint after t (minutes) of the series with values read by f(),
+ * or tmax if there is none before it: the first record past t where the
+ * slope of the linear interpolation changes; records inside a straight
+ * or constant run are passed over. Records at the end of the window of a
+ * streamed series are taken as breakpoints. Moves the cursors (serial code
+ * only), as update() does.
+ */
+realtype
+NextBreak(Model_Data MD, realtype t, realtype tmax)
+{
+	int             j, k, i, last;
+	realtype        b, *T, *V;
+	TSD            *ts;
+
+	for (j = 0; j < MD->NumFam; j++) {
+		if (MD->Fam[j].value == NULL) {
+			continue;
 		}
-	}
-	for (k = 0; k < MD->NumLC; k++) {
-		while (MD->TSD_RL[k].iCounter < MD->TSD_RL[k].length && t / (UNIT_C) > MD->TSD_RL[k].TS[MD->TSD_RL[k].iCounter + 1][0]) {
-			MD->TSD_RL[k].iCounter++;
+		for (k = 0; k < MD->Fam[j].num; k++) {
+			ts = &MD->Fam[j].TS[k];
+			i = TSDSeek(ts, (t + BREAK_EPS) / UNIT_C);
+			if (i >= ts->length) {
+				continue;
+			}
+			/* records held from ts->first on */
+			T = ts->time - ts->first;
+			V = ts->value - ts->first;
+			last = ts->first + ts->count - 1;
+			if (i > 0) {
+				while (i < last && (V[i] - V[i - 1]) * (T[i + 1] - T[i]) == (V[i + 1] - V[i]) * (T[i] - T[i - 1])) {
+					i++;
+				}
+				if (i == ts->length - 1 && V[i] == V[i - 1]) {
+					/* constant after the last record */
+					continue;
+				}
+			}
+			b = T[i] * UNIT_C;
+			tmax = (b < tmax - BREAK_EPS) ? b : tmax;
 		}
 	}
-	for (k = 0; k < MD->NumMeltF; k++) {
-		while (MD->TSD_MeltF[k].iCounter < MD->TSD_MeltF[k].length && t / (UNIT_C) > MD->TSD_MeltF[k].TS[MD->TSD_MeltF[k].iCounter + 1][0]) {
-			MD->TSD_MeltF[k].iCounter++;
-		}
+	return tmax;
+}
+
+/*
+ * Forcing values of all series at time t. Elements share a handful of
+ * series, so each series is interpolated once here instead of once per
+ * element; values are reused until t changes.
+ */
+void
+EvalForcing(realtype t, Model_Data MD)
+{
+	int             j, k;
+
+	if (MD->ForcValid == 1 && MD->ForcT == t) {
+		return;
 	}
-	for (k = 0; k < MD->NumSource; k++) {
-		while (MD->TSD_Source[k].iCounter < MD->TSD_Source[k].length && t / (UNIT_C) > MD->TSD_Source[k].TS[MD->TSD_Source[k].iCounter + 1][0]) {
-			MD->TSD_Source[k].iCounter++;
+	for (j = 0; j < MD->NumFam; j++) {
+		if (MD->Fam[j].value != NULL) {
+			for (k = 0; k < MD->Fam[j].num; k++) {
+				MD->Fam[j].value[k] = Interpolation(&MD->Fam[j].TS[k], t);
+			}
 		}
 	}
-
+	MD->ForcT = t;
+	MD->ForcValid = 1;
 }